@@ -0,0 +1,125 @@
+/*******************************************************************************
+  File: Arena.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c Arena.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created Arena.cpp file.
+  - Added Arena class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "Arena.h"
+
+//
+// Standard libraries.
+//
+#include <algorithm>
+#include <cstdlib>
+
+
+/// <summary>
+///   Default constructor.
+/// </summary>
+Arena::Arena(void) : next(NULL), left(0), used(0), reserved(0) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Destructor.  Frees every block.
+/// </summary>
+Arena::~Arena(void) {
+  this->Reset();
+}
+
+
+/// <summary>
+///   Allocates the given number of bytes.
+/// </summary>
+char * Arena::Allocate(size_t size) {
+
+  this->used += size;
+
+  // Large allocations get a block of their own so that the current block
+  //   keeps its free space.
+  if(size > ARENA_BLOCK_SIZE / 4) {
+    char *block = (char *)malloc(size);
+    this->blocks.push_back(block);
+    this->reserved += size;
+    return block;
+  }
+
+  // Start a new block once the current one is full.
+  if(size > this->left) {
+    this->next = (char *)malloc(ARENA_BLOCK_SIZE);
+    this->left = ARENA_BLOCK_SIZE;
+    this->blocks.push_back(this->next);
+    this->reserved += ARENA_BLOCK_SIZE;
+  }
+
+  char *p = this->next;
+  this->next += size;
+  this->left -= size;
+  return p;
+
+}
+
+
+/// <summary>
+///   Frees every block.
+/// </summary>
+void Arena::Reset(void) {
+
+  for(size_t i = 0; i < this->blocks.size(); i++)
+    free(this->blocks[i]);
+  this->blocks.clear();
+
+  this->next = NULL;
+  this->left = 0;
+  this->used = 0;
+  this->reserved = 0;
+
+}
+
+
+/// <summary>
+///   Exchanges the memory of two arenas.
+/// </summary>
+void Arena::Swap(Arena &other) {
+  this->blocks.swap(other.blocks);
+  std::swap(this->next, other.next);
+  std::swap(this->left, other.left);
+  std::swap(this->used, other.used);
+  std::swap(this->reserved, other.reserved);
+}
+
+
+/// <summary>
+///   Gets the total number of bytes handed out.
+/// </summary>
+size_t Arena::Used(void) const {
+  return this->used;
+}
+
+
+/// <summary>
+///   Gets the total number of bytes held in blocks.
+/// </summary>
+size_t Arena::Reserved(void) const {
+  return this->reserved;
+}
@@ -0,0 +1,136 @@
+/*******************************************************************************
+  File: Arena.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created Arena.h file.
+  - Added Arena class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <vector>
+
+
+//
+// Size of the blocks that small allocations are carved out of.
+//
+#define ARENA_BLOCK_SIZE 16384
+
+
+/// <summary>
+///   A monotonic allocator that hands out memory from large blocks.
+/// </summary>
+/// <remarks>
+///   Allocations are never freed individually.  All of the memory of an arena
+///   is given back at once when the arena is reset or destroyed, which makes
+///   allocation a pointer bump and teardown a handful of frees regardless of
+///   how many objects were allocated.
+/// </remarks>
+class Arena {
+
+private:
+
+  /// <summary>
+  ///   The blocks allocated so far.
+  /// </summary>
+  std::vector<char *> blocks;
+
+
+  /// <summary>
+  ///   The next free byte of the current block.
+  /// </summary>
+  char *next;
+
+
+  /// <summary>
+  ///   The number of free bytes left in the current block.
+  /// </summary>
+  size_t left;
+
+
+  /// <summary>
+  ///   The total number of bytes handed out.
+  /// </summary>
+  size_t used;
+
+
+  /// <summary>
+  ///   The total number of bytes held in blocks.
+  /// </summary>
+  size_t reserved;
+
+
+  /// <summary>
+  ///   Copy constructor.  Arenas cannot be copied.
+  /// </summary>
+  Arena(const Arena &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Arenas cannot be copied.
+  /// </summary>
+  Arena & operator=(const Arena &other);
+
+
+public:
+
+  /// <summary>
+  ///   Default constructor.
+  /// </summary>
+  Arena(void);
+
+
+  /// <summary>
+  ///   Destructor.  Frees every block.
+  /// </summary>
+  ~Arena(void);
+
+
+  /// <summary>
+  ///   Allocates the given number of bytes.  The memory is not aligned.
+  /// </summary>
+  char * Allocate(size_t size);
+
+
+  /// <summary>
+  ///   Frees every block.
+  /// </summary>
+  void Reset(void);
+
+
+  /// <summary>
+  ///   Exchanges the memory of two arenas.
+  /// </summary>
+  void Swap(Arena &other);
+
+
+  /// <summary>
+  ///   Gets the total number of bytes handed out.
+  /// </summary>
+  size_t Used(void) const;
+
+
+  /// <summary>
+  ///   Gets the total number of bytes held in blocks.
+  /// </summary>
+  size_t Reserved(void) const;
+
+};
+
+
+#endif
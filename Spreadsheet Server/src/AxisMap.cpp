@@ -0,0 +1,245 @@
+/*******************************************************************************
+  File: AxisMap.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c AxisMap.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created AxisMap.cpp file.
+  - Added AxisMap class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "AxisMap.h"
+
+//
+// Standard libraries.
+//
+#include <algorithm>
+
+
+/// <summary>
+///   Orders runs by their first logical index.
+/// </summary>
+static bool logicalLess(const axisRun &a, const axisRun &b) {
+  return a.logical < b.logical;
+}
+
+
+/// <summary>
+///   Orders runs by their first physical index.
+/// </summary>
+static bool physicalLess(const axisRun &a, const axisRun &b) {
+  return a.physical < b.physical;
+}
+
+
+/// <summary>
+///   Finds the run containing an index, given runs sorted on that index.
+/// </summary>
+static size_t findRun(const std::vector<axisRun> &runs, int index,
+    bool logical) {
+
+  axisRun key;
+  key.logical = index;
+  key.physical = index;
+  key.length = 0;
+
+  // The run is the last one starting at or before the index.
+  std::vector<axisRun>::const_iterator it = std::upper_bound(runs.begin(),
+      runs.end(), key, logical ? logicalLess : physicalLess);
+  return (it - runs.begin()) - 1;
+
+}
+
+
+/// <summary>
+///   Creates the identity map over the given number of indices.
+/// </summary>
+AxisMap::AxisMap(int size) : size(size) {
+  this->Reset();
+}
+
+
+/// <summary>
+///   Copy constructor.
+/// </summary>
+AxisMap::AxisMap(const AxisMap &other)
+    : size(other.size), byLogical(other.byLogical),
+      byPhysical(other.byPhysical) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Gets the physical index stored at a logical index.
+/// </summary>
+int AxisMap::ToPhysical(int logical) const {
+  const axisRun &run = this->byLogical[findRun(this->byLogical, logical,
+      true)];
+  return run.physical + (logical - run.logical);
+}
+
+
+/// <summary>
+///   Gets the logical index at which a physical index appears.
+/// </summary>
+int AxisMap::ToLogical(int physical) const {
+  const axisRun &run = this->byPhysical[findRun(this->byPhysical, physical,
+      false)];
+  return run.logical + (physical - run.physical);
+}
+
+
+/// <summary>
+///   Gets the runs covering the logical indices from first to last,
+///   inclusive, trimmed to that span.
+/// </summary>
+void AxisMap::Runs(int first, int last, std::vector<axisRun> *runs) const {
+
+  runs->clear();
+  if(first < 0)
+    first = 0;
+  if(last >= this->size)
+    last = this->size - 1;
+  if(first > last)
+    return;
+
+  for(size_t i = findRun(this->byLogical, first, true);
+      i < this->byLogical.size() && this->byLogical[i].logical <= last; i++) {
+    axisRun run = this->byLogical[i];
+    int end = run.logical + run.length - 1;
+
+    // Trim the run to the span.
+    if(run.logical < first) {
+      run.physical += first - run.logical;
+      run.logical = first;
+    }
+    if(end > last)
+      end = last;
+    run.length = end - run.logical + 1;
+
+    runs->push_back(run);
+  }
+
+}
+
+
+/// <summary>
+///   Swaps the logical indices [first, middle) with [middle, last), so that
+///   middle becomes first.
+/// </summary>
+void AxisMap::Rotate(int first, int middle, int last) {
+
+  if(first < 0 || first >= middle || middle >= last || last > this->size)
+    return;
+
+  // Make runs start at each boundary so that every run moves as a whole.
+  this->split(first);
+  this->split(middle);
+  this->split(last);
+
+  int left = middle - first;
+  int right = last - middle;
+  for(size_t i = 0; i < this->byLogical.size(); i++) {
+    axisRun &run = this->byLogical[i];
+    if(run.logical >= first && run.logical < middle)
+      run.logical += right;
+    else if(run.logical >= middle && run.logical < last)
+      run.logical -= left;
+  }
+
+  this->rebuild();
+
+}
+
+
+/// <summary>
+///   Returns the map to the identity.
+/// </summary>
+void AxisMap::Reset(void) {
+
+  axisRun run;
+  run.logical = 0;
+  run.physical = 0;
+  run.length = this->size;
+
+  this->byLogical.assign(1, run);
+  this->byPhysical.assign(1, run);
+
+}
+
+
+/// <summary>
+///   Gets the number of runs in the map.
+/// </summary>
+int AxisMap::RunCount(void) const {
+  return this->byLogical.size();
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Splits the run containing a logical index so that a run starts there.
+/// </summary>
+void AxisMap::split(int logical) {
+
+  if(logical <= 0 || logical >= this->size)
+    return;
+
+  size_t i = findRun(this->byLogical, logical, true);
+  axisRun &run = this->byLogical[i];
+  if(run.logical == logical)
+    return;
+
+  axisRun tail;
+  tail.logical = logical;
+  tail.physical = run.physical + (logical - run.logical);
+  tail.length = run.length - (logical - run.logical);
+  run.length -= tail.length;
+
+  this->byLogical.insert(this->byLogical.begin() + i + 1, tail);
+
+}
+
+
+/// <summary>
+///   Joins neighbouring runs that are also neighbours physically and
+///   rebuilds the physical order.
+/// </summary>
+void AxisMap::rebuild(void) {
+
+  std::sort(this->byLogical.begin(), this->byLogical.end(), logicalLess);
+
+  size_t n = 0;
+  for(size_t i = 1; i < this->byLogical.size(); i++) {
+    axisRun &last = this->byLogical[n];
+    const axisRun &run = this->byLogical[i];
+    if(last.physical + last.length == run.physical)
+      last.length += run.length;
+    else
+      this->byLogical[++n] = run;
+  }
+  this->byLogical.resize(n + 1);
+
+  this->byPhysical = this->byLogical;
+  std::sort(this->byPhysical.begin(), this->byPhysical.end(), physicalLess);
+
+}
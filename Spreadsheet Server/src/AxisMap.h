@@ -0,0 +1,151 @@
+/*******************************************************************************
+  File: AxisMap.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created AxisMap.h file.
+  - Added AxisMap class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __AXISMAP_H__
+#define __AXISMAP_H__
+
+
+//
+// Standard libraries.
+//
+#include <vector>
+
+
+/// <summary>
+///   A run of consecutive logical indices stored at consecutive physical
+///   indices.
+/// </summary>
+typedef struct axisRun {
+  int logical;                // The first logical index of the run.
+  int physical;               // The physical index of the first logical one.
+  int length;                 // The number of indices in the run.
+} axisRun;
+
+
+/// <summary>
+///   Maps the rows or columns of a sheet as the user sees them onto the rows
+///   or columns where their cells are stored.
+/// </summary>
+/// <remarks>
+/// <para>
+///   Inserting or deleting rows would otherwise move every cell below the
+///   change.  Instead, cells keep the physical index they were stored at and
+///   the map records where each physical index currently appears.  An insert
+///   or a delete is a rotation of part of the logical order, which only
+///   splits a few runs no matter how many cells it moves.
+/// </para>
+/// <para>
+///   The map is a list of runs sorted by logical index, plus the same runs
+///   sorted by physical index, so that lookups in either direction are a
+///   binary search.  A map that has never been rotated is a single run.
+/// </para>
+/// </remarks>
+class AxisMap {
+
+private:
+
+  /// <summary>
+  ///   The number of indices along the axis.
+  /// </summary>
+  int size;
+
+
+  /// <summary>
+  ///   The runs in logical order.
+  /// </summary>
+  std::vector<axisRun> byLogical;
+
+
+  /// <summary>
+  ///   The runs in physical order.
+  /// </summary>
+  std::vector<axisRun> byPhysical;
+
+
+public:
+
+  /// <summary>
+  ///   Creates the identity map over the given number of indices.
+  /// </summary>
+  AxisMap(int size);
+
+
+  /// <summary>
+  ///   Copy constructor.
+  /// </summary>
+  AxisMap(const AxisMap &other);
+
+
+  /// <summary>
+  ///   Gets the physical index stored at a logical index.
+  /// </summary>
+  int ToPhysical(int logical) const;
+
+
+  /// <summary>
+  ///   Gets the logical index at which a physical index appears.
+  /// </summary>
+  int ToLogical(int physical) const;
+
+
+  /// <summary>
+  ///   Gets the runs covering the logical indices from first to last,
+  ///   inclusive, trimmed to that span.  Indices off the axis are skipped.
+  /// </summary>
+  /// <param name="runs">An output parameter for the runs, in logical order.</param>
+  void Runs(int first, int last, std::vector<axisRun> *runs) const;
+
+
+  /// <summary>
+  ///   Swaps the logical indices [first, middle) with [middle, last), so that
+  ///   middle becomes first.  Inserting n indices at i rotates the n unused
+  ///   indices after the end of the sheet to i; deleting them rotates them
+  ///   back to the end.
+  /// </summary>
+  void Rotate(int first, int middle, int last);
+
+
+  /// <summary>
+  ///   Returns the map to the identity.
+  /// </summary>
+  void Reset(void);
+
+
+  /// <summary>
+  ///   Gets the number of runs in the map.
+  /// </summary>
+  int RunCount(void) const;
+
+
+private:
+
+  /// <summary>
+  ///   Splits the run containing a logical index so that a run starts there.
+  /// </summary>
+  void split(int logical);
+
+
+  /// <summary>
+  ///   Joins neighbouring runs that are also neighbours physically and
+  ///   rebuilds the physical order.
+  /// </summary>
+  void rebuild(void);
+
+};
+
+
+#endif
@@ -0,0 +1,207 @@
+/*******************************************************************************
+  File: CellAddress.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c CellAddress.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created CellAddress.cpp file.
+  - Added cell name parsing and formatting functions.
+  - Added cell range parsing and formatting functions.
+  - Added column name parsing and formatting functions.
+*******************************************************************************/
+
+
+//
+// Header file.
+//
+#include "CellAddress.h"
+
+
+/*******************************************************************************
+  Global functions.
+*******************************************************************************/
+
+
+/// <summary>
+///   Attempts to parse a cell name of the form [A-Za-z]+[0-9]+ into
+///   zero-based column and row indices.
+/// </summary>
+bool ParseCellName(const std::string &name, int *col, int *row) {
+
+  // The whole string must be consumed by the cell name.
+  size_t pos = 0;
+  return ParseCellName(name, &pos, col, row) && pos == name.length();
+
+}
+
+
+/// <summary>
+///   Attempts to parse a cell name starting at the given position of a string.
+/// </summary>
+bool ParseCellName(const std::string &str, size_t *pos, int *col, int *row) {
+
+  size_t i = *pos;
+  long c = 0;
+  long r = 0;
+
+
+  // Read the column letters as a bijective base-26 number.
+  size_t start = i;
+  while(i < str.length() && ((str[i] >= 'a' && str[i] <= 'z')
+      || (str[i] >= 'A' && str[i] <= 'Z'))) {
+    char ch = str[i];
+    if(ch >= 'a')
+      ch = ch - 'a' + 'A';
+    c = c * 26 + (ch - 'A' + 1);
+    if(c - 1 > CA_MAX_COL)
+      return false;
+    i++;
+  }
+  if(i == start)
+    return false;
+
+
+  // Read the row digits.
+  start = i;
+  while(i < str.length() && str[i] >= '0' && str[i] <= '9') {
+    r = r * 10 + (str[i] - '0');
+    if(r - 1 > CA_MAX_ROW)
+      return false;
+    i++;
+  }
+  if(i == start || r == 0)
+    return false;
+
+
+  // Cell names are one-based; indices are zero-based.
+  *col = (int)(c - 1);
+  *row = (int)(r - 1);
+  *pos = i;
+  return true;
+
+}
+
+
+/// <summary>
+///   Gets the upper-case cell name for the given column and row indices.
+/// </summary>
+std::string FormatCellName(int col, int row) {
+
+  std::string name = FormatColumnName(col);
+
+
+  // Append the one-based row number.
+  char digits[12];
+  int n = 0;
+  for(int r = row + 1; r > 0; r /= 10)
+    digits[n++] = (char)('0' + r % 10);
+  while(n > 0)
+    name += digits[--n];
+
+  return name;
+
+}
+
+
+/// <summary>
+///   Attempts to parse a column name of the form [A-Za-z]+ into a zero-based
+///   column index.
+/// </summary>
+bool ParseColumnName(const std::string &name, int *col) {
+
+  if(name.empty())
+    return false;
+
+  long c = 0;
+  for(size_t i = 0; i < name.length(); i++) {
+    char ch = name[i];
+    if(ch >= 'a' && ch <= 'z')
+      ch = ch - 'a' + 'A';
+    if(ch < 'A' || ch > 'Z')
+      return false;
+    c = c * 26 + (ch - 'A' + 1);
+    if(c - 1 > CA_MAX_COL)
+      return false;
+  }
+
+  *col = (int)(c - 1);
+  return true;
+
+}
+
+
+/// <summary>
+///   Gets the upper-case column letters for the given column index.
+/// </summary>
+std::string FormatColumnName(int col) {
+
+  // Build the column letters from least to most significant.
+  char letters[8];
+  int n = 0;
+  for(int c = col + 1; c > 0; c = (c - 1) / 26)
+    letters[n++] = (char)('A' + (c - 1) % 26);
+
+  std::string name;
+  while(n > 0)
+    name += letters[--n];
+
+  return name;
+
+}
+
+
+/// <summary>
+///   Attempts to parse a range of the form A1:B2, or a single cell name, into
+///   the column and row indices of its corners.
+/// </summary>
+bool ParseCellRange(const std::string &range, int *col0, int *row0,
+    int *col1, int *row1) {
+
+  size_t pos = 0;
+  int c0, r0, c1, r1;
+  if(!ParseCellName(range, &pos, &c0, &r0))
+    return false;
+
+  // A single cell is a range of one.
+  if(pos == range.length()) {
+    c1 = c0;
+    r1 = r0;
+  }
+  else {
+    if(range[pos] != ':')
+      return false;
+    pos++;
+    if(!ParseCellName(range, &pos, &c1, &r1) || pos != range.length())
+      return false;
+  }
+
+  *col0 = c0 < c1 ? c0 : c1;
+  *col1 = c0 < c1 ? c1 : c0;
+  *row0 = r0 < r1 ? r0 : r1;
+  *row1 = r0 < r1 ? r1 : r0;
+  return true;
+
+}
+
+
+/// <summary>
+///   Gets the range name for the given corners.
+/// </summary>
+std::string FormatCellRange(int col0, int row0, int col1, int row1) {
+
+  // A range of a single cell is just the name of the cell.
+  if(col0 == col1 && row0 == row1)
+    return FormatCellName(col0, row0);
+
+  return FormatCellName(col0, row0) + ":" + FormatCellName(col1, row1);
+
+}
@@ -0,0 +1,127 @@
+/*******************************************************************************
+  File: CellAddress.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created CellAddress.h file.
+  - Added cell name parsing and formatting functions.
+  - Added packed cell keys.
+  - Added cell range parsing and formatting functions.
+  - Added column name parsing and formatting functions.
+*******************************************************************************/
+
+
+#ifndef __CELLADDRESS_H__
+#define __CELLADDRESS_H__
+
+
+//
+// Standard libraries.
+//
+#include <string>
+
+
+//
+// Largest column and row indices that a cell name may refer to.  Column
+//   indices run from 0 (A) and row indices run from 0 (row 1).
+//
+#define CA_MAX_COL  0x3FFF
+#define CA_MAX_ROW  0xFFFFF
+
+
+//
+// Cells are identified by a single integer key that packs the row index above
+//   the column index, so that sorting keys sorts cells by row and then by
+//   column.
+//
+#define CA_COL_BITS 14
+#define CA_KEY(col, row) \
+    (((cellKey)(row) << CA_COL_BITS) | (cellKey)(col))
+#define CA_KEY_COL(key) ((int)((key) & CA_MAX_COL))
+#define CA_KEY_ROW(key) ((int)((key) >> CA_COL_BITS))
+
+
+/// <summary>
+///   A packed (row, column) cell key.
+/// </summary>
+typedef unsigned long long cellKey;
+
+
+/// <summary>
+///   Attempts to parse a cell name of the form [A-Za-z]+[0-9]+ into
+///   zero-based column and row indices.
+/// </summary>
+/// <param name="name">The cell name to parse.</param>
+/// <param name="col">An output parameter for the column index.</param>
+/// <param name="row">An output parameter for the row index.</param>
+/// <returns>
+///   True if the name is a valid cell name; otherwise, false.
+/// </returns>
+extern bool ParseCellName(const std::string &name, int *col, int *row);
+
+
+/// <summary>
+///   Attempts to parse a cell name starting at the given position of a string.
+/// </summary>
+/// <param name="str">The string containing the cell name.</param>
+/// <param name="pos">
+///   The position of the first letter of the cell name.  On success, this is
+///   advanced to the first character after the cell name.
+/// </param>
+/// <param name="col">An output parameter for the column index.</param>
+/// <param name="row">An output parameter for the row index.</param>
+/// <returns>
+///   True if a valid cell name was found; otherwise, false.
+/// </returns>
+extern bool ParseCellName(const std::string &str, size_t *pos, int *col,
+    int *row);
+
+
+/// <summary>
+///   Gets the upper-case cell name for the given column and row indices.
+/// </summary>
+extern std::string FormatCellName(int col, int row);
+
+
+/// <summary>
+///   Attempts to parse a column name of the form [A-Za-z]+ into a zero-based
+///   column index.
+/// </summary>
+/// <returns>
+///   True if the name is a valid column name; otherwise, false.
+/// </returns>
+extern bool ParseColumnName(const std::string &name, int *col);
+
+
+/// <summary>
+///   Gets the upper-case column letters for the given column index.
+/// </summary>
+extern std::string FormatColumnName(int col);
+
+
+/// <summary>
+///   Attempts to parse a range of the form A1:B2, or a single cell name, into
+///   the column and row indices of its corners.  The corners are ordered so
+///   that col0 <= col1 and row0 <= row1.
+/// </summary>
+/// <returns>
+///   True if the string is a valid range; otherwise, false.
+/// </returns>
+extern bool ParseCellRange(const std::string &range, int *col0, int *row0,
+    int *col1, int *row1);
+
+
+/// <summary>
+///   Gets the range name for the given corners, such as A1:B2, or just the
+///   cell name if the corners are the same cell.
+/// </summary>
+extern std::string FormatCellRange(int col0, int row0, int col1, int row1);
+
+
+#endif
@@ -0,0 +1,355 @@
+/*******************************************************************************
+  File: CellGrid.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c CellGrid.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created CellGrid.cpp file.
+  - Added CellGrid class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "CellGrid.h"
+
+
+/*******************************************************************************
+  CellGrid::iterator
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates an iterator over the given rectangle.
+/// </summary>
+CellGrid::iterator::iterator(const tileMap *tiles, int col0, int row0,
+    int col1, int row1)
+    : tiles(tiles), col0(col0 < 0 ? 0 : col0),
+      col1(col1 > CA_MAX_COL ? CA_MAX_COL : col1),
+      row1(row1 > CA_MAX_ROW ? CA_MAX_ROW : row1) {
+
+  if(row0 < 0)
+    row0 = 0;
+
+  // An empty rectangle has nothing to visit.
+  if(this->col0 > this->col1) {
+    this->row = this->row1 + 1;
+    return;
+  }
+
+  this->seekBand(row0);
+  this->settle();
+
+}
+
+
+/// <summary>
+///   Moves to the first band of tiles at or after the given row that has a
+///   tile within the columns of the rectangle.
+/// </summary>
+void CellGrid::iterator::seekBand(int r) {
+
+  int tc0 = this->col0 >> CG_TILE_BITS;
+  int tc1 = this->col1 >> CG_TILE_BITS;
+  int tr = r >> CG_TILE_BITS;
+
+  while(r <= this->row1) {
+
+    this->band = this->tiles->lower_bound(CA_KEY(tc0, tr));
+    if(this->band == this->tiles->end())
+      break;
+
+    int bandRow = CA_KEY_ROW(this->band->first);
+    if(bandRow == tr && CA_KEY_COL(this->band->first) <= tc1) {
+      this->it = this->band;
+      this->row = r;
+      this->col = this->col0;
+      return;
+    }
+
+    // Skip straight to the next tile row that has any tiles.
+    tr = bandRow == tr ? tr + 1 : bandRow;
+    r = tr << CG_TILE_BITS;
+
+  }
+
+  this->row = this->row1 + 1;
+
+}
+
+
+/// <summary>
+///   Moves to the next cell in use at or after the current position.
+/// </summary>
+void CellGrid::iterator::settle(void) {
+
+  while(this->row <= this->row1) {
+
+    // Look for a cell in the current row of the current tile.
+    int base = CA_KEY_COL(this->it->first) << CG_TILE_BITS;
+    int lo = (this->col > this->col0 ? this->col : this->col0) - base;
+    int hi = this->col1 - base;
+    if(lo < 0)
+      lo = 0;
+    if(hi > CG_TILE_MASK)
+      hi = CG_TILE_MASK;
+
+    if(lo <= hi) {
+      unsigned int bits = this->it->second->used[this->row & CG_TILE_MASK];
+      bits &= (0xFFu << lo) & (0xFFu >> (CG_TILE_MASK - hi));
+      if(bits != 0) {
+        this->col = base + __builtin_ctz(bits);
+        return;
+      }
+    }
+
+
+    // Move on to the next tile of the band.
+    this->it++;
+    if(this->it != this->tiles->end()
+        && CA_KEY_ROW(this->it->first) == CA_KEY_ROW(this->band->first)
+        && CA_KEY_COL(this->it->first) <= (this->col1 >> CG_TILE_BITS)) {
+      this->col = this->col0;
+      continue;
+    }
+
+
+    // Move on to the next row of the band, or else the next band.
+    this->row++;
+    this->col = this->col0;
+    if((this->row & CG_TILE_MASK) != 0)
+      this->it = this->band;
+    else
+      this->seekBand(this->row);
+
+  }
+
+}
+
+
+/// <summary>
+///   Gets whether the iterator is past the last cell.
+/// </summary>
+bool CellGrid::iterator::Done(void) const {
+  return this->row > this->row1;
+}
+
+
+/// <summary>
+///   Moves to the next cell.
+/// </summary>
+void CellGrid::iterator::Next(void) {
+  this->col++;
+  this->settle();
+}
+
+
+/// <summary>
+///   Gets the column index of the current cell.
+/// </summary>
+int CellGrid::iterator::Col(void) const {
+  return this->col;
+}
+
+
+/// <summary>
+///   Gets the row index of the current cell.
+/// </summary>
+int CellGrid::iterator::Row(void) const {
+  return this->row;
+}
+
+
+/// <summary>
+///   Gets the current cell.
+/// </summary>
+const cellEntry & CellGrid::iterator::Cell(void) const {
+  return this->it->second->cells[((this->row & CG_TILE_MASK) << CG_TILE_BITS)
+      | (this->col & CG_TILE_MASK)];
+}
+
+
+/*******************************************************************************
+  CellGrid
+*******************************************************************************/
+
+
+/// <summary>
+///   Default constructor.
+/// </summary>
+CellGrid::CellGrid(void) : count(0) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Copy constructor.
+/// </summary>
+CellGrid::CellGrid(const CellGrid &other) : count(0) {
+  *this = other;
+}
+
+
+/// <summary>
+///   Destructor.
+/// </summary>
+CellGrid::~CellGrid(void) {
+  this->Clear();
+}
+
+
+/// <summary>
+///   Assignment operator.
+/// </summary>
+CellGrid & CellGrid::operator=(const CellGrid &other) {
+
+  if(this == &other)
+    return *this;
+
+  this->Clear();
+  for(tileMap::const_iterator it = other.tiles.begin();
+      it != other.tiles.end(); it++)
+    this->tiles[it->first] = new tile(*it->second);
+  this->count = other.count;
+
+  return *this;
+
+}
+
+
+/// <summary>
+///   Gets a cell in use.
+/// </summary>
+cellEntry * CellGrid::Find(int col, int row) {
+  return const_cast<cellEntry *>(
+      static_cast<const CellGrid *>(this)->Find(col, row));
+}
+
+
+/// <summary>
+///   Gets a cell in use.
+/// </summary>
+const cellEntry * CellGrid::Find(int col, int row) const {
+
+  tileMap::const_iterator it = this->tiles.find(
+      CA_KEY(col >> CG_TILE_BITS, row >> CG_TILE_BITS));
+  if(it == this->tiles.end())
+    return NULL;
+
+  int r = row & CG_TILE_MASK;
+  int c = col & CG_TILE_MASK;
+  if(!(it->second->used[r] & (1 << c)))
+    return NULL;
+
+  return &it->second->cells[(r << CG_TILE_BITS) | c];
+
+}
+
+
+/// <summary>
+///   Gets a cell, marking it as in use if it was empty.
+/// </summary>
+cellEntry & CellGrid::Insert(int col, int row) {
+
+  // Allocate the tile the first time one of its cells is used.
+  tile *&t = this->tiles[CA_KEY(col >> CG_TILE_BITS, row >> CG_TILE_BITS)];
+  if(t == NULL) {
+    t = new tile();
+    t->count = 0;
+    for(int i = 0; i < CG_TILE_DIM; i++)
+      t->used[i] = 0;
+  }
+
+  int r = row & CG_TILE_MASK;
+  int c = col & CG_TILE_MASK;
+  cellEntry &cell = t->cells[(r << CG_TILE_BITS) | c];
+  if(!(t->used[r] & (1 << c))) {
+    t->used[r] |= (unsigned char)(1 << c);
+    t->count++;
+    this->count++;
+    cell.contents = 0;
+    cell.templateId = -1;
+  }
+
+  return cell;
+
+}
+
+
+/// <summary>
+///   Empties a cell, freeing its tile if the tile has no other cells.
+/// </summary>
+void CellGrid::Erase(int col, int row) {
+
+  tileMap::iterator it = this->tiles.find(
+      CA_KEY(col >> CG_TILE_BITS, row >> CG_TILE_BITS));
+  if(it == this->tiles.end())
+    return;
+
+  tile *t = it->second;
+  int r = row & CG_TILE_MASK;
+  int c = col & CG_TILE_MASK;
+  if(!(t->used[r] & (1 << c)))
+    return;
+
+  t->used[r] &= (unsigned char)~(1 << c);
+  t->cells[(r << CG_TILE_BITS) | c].contents = 0;
+  this->count--;
+
+  if(--t->count == 0) {
+    delete t;
+    this->tiles.erase(it);
+  }
+
+}
+
+
+/// <summary>
+///   Empties every cell.
+/// </summary>
+void CellGrid::Clear(void) {
+
+  for(tileMap::iterator it = this->tiles.begin(); it != this->tiles.end();
+      it++)
+    delete it->second;
+  this->tiles.clear();
+  this->count = 0;
+
+}
+
+
+/// <summary>
+///   Gets the number of cells in use.
+/// </summary>
+size_t CellGrid::Size(void) const {
+  return this->count;
+}
+
+
+/// <summary>
+///   Gets an iterator over every cell in use.
+/// </summary>
+CellGrid::iterator CellGrid::Begin(void) const {
+  return iterator(&this->tiles, 0, 0, CA_MAX_COL, CA_MAX_ROW);
+}
+
+
+/// <summary>
+///   Gets an iterator over the cells in use within a rectangle.
+/// </summary>
+CellGrid::iterator CellGrid::Range(int col0, int row0, int col1, int row1)
+    const {
+  return iterator(&this->tiles, col0, row0, col1, row1);
+}
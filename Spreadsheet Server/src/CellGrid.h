@@ -0,0 +1,242 @@
+/*******************************************************************************
+  File: CellGrid.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created CellGrid.h file.
+  - Added CellGrid class declaration.
+  - Added documentation.
+  - Made cell contents interned string ids.
+*******************************************************************************/
+
+
+#ifndef __CELLGRID_H__
+#define __CELLGRID_H__
+
+
+//
+// Project headers.
+//
+#include "CellAddress.h"
+#include "StringPool.h"
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <map>
+
+
+//
+// Tiles cover CG_TILE_DIM x CG_TILE_DIM cells.
+//
+#define CG_TILE_BITS 3
+#define CG_TILE_DIM  (1 << CG_TILE_BITS)
+#define CG_TILE_MASK (CG_TILE_DIM - 1)
+
+
+/// <summary>
+///   The contents of a single non-empty cell.
+/// </summary>
+typedef struct cellEntry {
+  stringId contents;          // The interned cell contents as entered, or 0
+                              //   for a formula that reads as its template.
+  int templateId;             // The formula template id, or -1 if none.
+} cellEntry;
+
+
+/// <summary>
+///   A sparse grid of cell contents stored in fixed-size tiles.
+/// </summary>
+/// <remarks>
+/// <para>
+///   The sheet is divided into square tiles that are only allocated once one
+///   of their cells is set.  Each tile holds its cells in a contiguous array
+///   along with a bitmap of which cells are in use, so an edit only ever
+///   touches a single tile and neighbouring cells share cache lines.
+/// </para>
+/// <para>
+///   Tiles are kept in a map ordered by their packed key, which places them
+///   in row-major order.  Iteration walks a band of tiles one sheet row at a
+///   time, so cells are visited in true row and column order.
+/// </para>
+/// </remarks>
+class CellGrid {
+
+private:
+
+  /// <summary>
+  ///   A block of CG_TILE_DIM x CG_TILE_DIM cells.
+  /// </summary>
+  typedef struct tile {
+    cellEntry cells[CG_TILE_DIM * CG_TILE_DIM];   // Cells indexed by row, col.
+    unsigned char used[CG_TILE_DIM];              // Bitmap of cells per row.
+    int count;                                    // Number of cells in use.
+  } tile;
+
+
+  /// <summary>
+  ///   Tiles keyed by the packed key of their tile column and tile row.
+  /// </summary>
+  typedef std::map<cellKey, tile *> tileMap;
+
+
+  /// <summary>
+  ///   The allocated tiles.
+  /// </summary>
+  tileMap tiles;
+
+
+  /// <summary>
+  ///   The number of cells in use.
+  /// </summary>
+  size_t count;
+
+
+public:
+
+  /// <summary>
+  ///   Visits the cells within a rectangle of the grid in row-major order.
+  /// </summary>
+  class iterator {
+
+  private:
+
+    const tileMap *tiles;       // The tiles of the grid.
+    tileMap::const_iterator band;  // The first tile of the current band.
+    tileMap::const_iterator it;    // The current tile.
+    int col0;                   // The first column of the rectangle.
+    int col1;                   // The last column of the rectangle.
+    int row1;                   // The last row of the rectangle.
+    int row;                    // The current row.
+    int col;                    // The current column.
+
+    /// <summary>
+    ///   Moves to the first band of tiles at or after the given row.
+    /// </summary>
+    void seekBand(int row);
+
+    /// <summary>
+    ///   Moves to the next cell in use at or after the current position.
+    /// </summary>
+    void settle(void);
+
+  public:
+
+    /// <summary>
+    ///   Creates an iterator over the given rectangle.
+    /// </summary>
+    iterator(const tileMap *tiles, int col0, int row0, int col1, int row1);
+
+    /// <summary>
+    ///   Gets whether the iterator is past the last cell.
+    /// </summary>
+    bool Done(void) const;
+
+    /// <summary>
+    ///   Moves to the next cell.
+    /// </summary>
+    void Next(void);
+
+    /// <summary>
+    ///   Gets the column index of the current cell.
+    /// </summary>
+    int Col(void) const;
+
+    /// <summary>
+    ///   Gets the row index of the current cell.
+    /// </summary>
+    int Row(void) const;
+
+    /// <summary>
+    ///   Gets the current cell.
+    /// </summary>
+    const cellEntry & Cell(void) const;
+
+  };
+
+
+  /// <summary>
+  ///   Default constructor.
+  /// </summary>
+  CellGrid(void);
+
+
+  /// <summary>
+  ///   Copy constructor.
+  /// </summary>
+  CellGrid(const CellGrid &other);
+
+
+  /// <summary>
+  ///   Destructor.
+  /// </summary>
+  ~CellGrid(void);
+
+
+  /// <summary>
+  ///   Assignment operator.
+  /// </summary>
+  CellGrid & operator=(const CellGrid &other);
+
+
+  /// <summary>
+  ///   Gets a cell in use.
+  /// </summary>
+  /// <returns>The cell, or NULL if the cell is empty.</returns>
+  cellEntry * Find(int col, int row);
+
+
+  /// <summary>
+  ///   Gets a cell in use.
+  /// </summary>
+  /// <returns>The cell, or NULL if the cell is empty.</returns>
+  const cellEntry * Find(int col, int row) const;
+
+
+  /// <summary>
+  ///   Gets a cell, marking it as in use if it was empty.  New cells have no
+  ///   contents and no template.
+  /// </summary>
+  cellEntry & Insert(int col, int row);
+
+
+  /// <summary>
+  ///   Empties a cell, freeing its tile if the tile has no other cells.
+  /// </summary>
+  void Erase(int col, int row);
+
+
+  /// <summary>
+  ///   Empties every cell.
+  /// </summary>
+  void Clear(void);
+
+
+  /// <summary>
+  ///   Gets the number of cells in use.
+  /// </summary>
+  size_t Size(void) const;
+
+
+  /// <summary>
+  ///   Gets an iterator over every cell in use.
+  /// </summary>
+  iterator Begin(void) const;
+
+
+  /// <summary>
+  ///   Gets an iterator over the cells in use within a rectangle.
+  /// </summary>
+  iterator Range(int col0, int row0, int col1, int row1) const;
+
+};
+
+
+#endif
@@ -0,0 +1,541 @@
+/*******************************************************************************
+  File: ColumnStore.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -pthread -O2 -c ColumnStore.cpp
+
+
+  Resources:
+  - https://software.intel.com/sites/landingpage/IntrinsicsGuide/
+  - https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ColumnStore.cpp file.
+  - Added ColumnStore class implementation.
+  - Added scalar, AVX2 and AVX-512 aggregate kernels.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "ColumnStore.h"
+
+//
+// Standard libraries.
+//
+#include <limits>
+
+//
+// SIMD intrinsics.
+//
+#include <immintrin.h>
+
+//
+// Multithreading library.
+//
+#include <pthread.h>
+#include <unistd.h>
+
+
+//
+// Number of rows covered by one word of a validity bitmap.
+//
+#define CS_WORD_BITS 64
+
+//
+// Upper bound on the number of threads used for one parallel reduction.
+//
+#define CS_MAX_THREADS 16
+
+
+/*******************************************************************************
+  Aggregate kernels.
+*******************************************************************************/
+
+
+/// <summary>
+///   Accumulates the values of rows [begin, end) of a column into an
+///   aggregate.
+/// </summary>
+typedef void (*aggregateKernel)(const double *values,
+    const unsigned long long *valid, size_t begin, size_t end,
+    aggregateResult *acc);
+
+
+/// <summary>
+///   Accumulates a single bitmap word, or part of one, one set bit at a time.
+/// </summary>
+static inline void aggregateWord(const double *values, unsigned long long bits,
+    size_t base, aggregateResult *acc) {
+
+  while(bits != 0) {
+    double v = values[base + __builtin_ctzll(bits)];
+    acc->sum += v;
+    acc->count++;
+    if(v < acc->min)
+      acc->min = v;
+    if(v > acc->max)
+      acc->max = v;
+    bits &= bits - 1;
+  }
+
+}
+
+
+/// <summary>
+///   Accumulates the partial bitmap words at the ends of a row range and
+///   returns the first and last full words in between.
+/// </summary>
+static inline void aggregateEdges(const double *values,
+    const unsigned long long *valid, size_t begin, size_t end,
+    aggregateResult *acc, size_t *firstWord, size_t *lastWord) {
+
+  size_t w0 = begin / CS_WORD_BITS;
+  size_t w1 = end / CS_WORD_BITS;
+  unsigned int b0 = begin % CS_WORD_BITS;
+  unsigned int b1 = end % CS_WORD_BITS;
+
+
+  // The whole range falls within a single word.
+  if(w0 == w1) {
+    unsigned long long mask = (~0ULL << b0) & ((1ULL << b1) - 1);
+    aggregateWord(values, valid[w0] & mask, w0 * CS_WORD_BITS, acc);
+    *firstWord = *lastWord = 0;
+    return;
+  }
+
+
+  // Leading partial word.
+  if(b0 != 0) {
+    aggregateWord(values, valid[w0] & (~0ULL << b0), w0 * CS_WORD_BITS, acc);
+    w0++;
+  }
+
+  // Trailing partial word.
+  if(b1 != 0)
+    aggregateWord(values, valid[w1] & ((1ULL << b1) - 1),
+        w1 * CS_WORD_BITS, acc);
+
+  *firstWord = w0;
+  *lastWord = w1;
+
+}
+
+
+/// <summary>
+///   Portable aggregate kernel.
+/// </summary>
+static void aggregateScalar(const double *values,
+    const unsigned long long *valid, size_t begin, size_t end,
+    aggregateResult *acc) {
+
+  size_t w0, w1;
+  aggregateEdges(values, valid, begin, end, acc, &w0, &w1);
+
+  for(size_t w = w0; w < w1; w++)
+    aggregateWord(values, valid[w], w * CS_WORD_BITS, acc);
+
+}
+
+
+/// <summary>
+///   AVX2 aggregate kernel.  Processes four rows per instruction and builds
+///   the min/max lane masks from four bits of the validity bitmap at a time.
+/// </summary>
+__attribute__((target("avx2,popcnt")))
+static void aggregateAvx2(const double *values,
+    const unsigned long long *valid, size_t begin, size_t end,
+    aggregateResult *acc) {
+
+  size_t w0, w1;
+  aggregateEdges(values, valid, begin, end, acc, &w0, &w1);
+
+  const __m256i lanes = _mm256_set_epi64x(8, 4, 2, 1);
+  const __m256d inf = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+  const __m256d ninf = _mm256_set1_pd(
+      -std::numeric_limits<double>::infinity());
+  __m256d sum = _mm256_setzero_pd();
+  __m256d min = inf;
+  __m256d max = ninf;
+  long count = 0;
+
+  for(size_t w = w0; w < w1; w++) {
+    unsigned long long bits = valid[w];
+    if(bits == 0)
+      continue;
+
+    count += __builtin_popcountll(bits);
+    const double *p = values + w * CS_WORD_BITS;
+
+    // Every row of the word holds a value, so no masking is needed.
+    if(bits == ~0ULL) {
+      for(int i = 0; i < CS_WORD_BITS; i += 4) {
+        __m256d v = _mm256_loadu_pd(p + i);
+        sum = _mm256_add_pd(sum, v);
+        min = _mm256_min_pd(min, v);
+        max = _mm256_max_pd(max, v);
+      }
+    }
+
+    // Rows without values hold 0, which is harmless to the sum but has to be
+    //   masked out of min and max.
+    else {
+      for(int i = 0; i < CS_WORD_BITS; i += 4) {
+        __m256d v = _mm256_loadu_pd(p + i);
+        __m256i sel = _mm256_set1_epi64x((long long)((bits >> i) & 0xF));
+        __m256d mask = _mm256_castsi256_pd(
+            _mm256_cmpeq_epi64(_mm256_and_si256(sel, lanes), lanes));
+        sum = _mm256_add_pd(sum, v);
+        min = _mm256_min_pd(min, _mm256_blendv_pd(inf, v, mask));
+        max = _mm256_max_pd(max, _mm256_blendv_pd(ninf, v, mask));
+      }
+    }
+  }
+
+
+  // Reduce the lanes into the accumulator.
+  double s[4], lo[4], hi[4];
+  _mm256_storeu_pd(s, sum);
+  _mm256_storeu_pd(lo, min);
+  _mm256_storeu_pd(hi, max);
+  for(int i = 0; i < 4; i++) {
+    acc->sum += s[i];
+    if(lo[i] < acc->min)
+      acc->min = lo[i];
+    if(hi[i] > acc->max)
+      acc->max = hi[i];
+  }
+  acc->count += count;
+
+}
+
+
+/// <summary>
+///   AVX-512 aggregate kernel.  Processes eight rows per instruction and uses
+///   each byte of the validity bitmap directly as a lane mask.
+/// </summary>
+__attribute__((target("avx512f,popcnt")))
+static void aggregateAvx512(const double *values,
+    const unsigned long long *valid, size_t begin, size_t end,
+    aggregateResult *acc) {
+
+  size_t w0, w1;
+  aggregateEdges(values, valid, begin, end, acc, &w0, &w1);
+
+  __m512d sum = _mm512_setzero_pd();
+  __m512d min = _mm512_set1_pd(std::numeric_limits<double>::infinity());
+  __m512d max = _mm512_set1_pd(-std::numeric_limits<double>::infinity());
+  long count = 0;
+
+  for(size_t w = w0; w < w1; w++) {
+    unsigned long long bits = valid[w];
+    if(bits == 0)
+      continue;
+
+    count += __builtin_popcountll(bits);
+    const double *p = values + w * CS_WORD_BITS;
+    for(int i = 0; i < CS_WORD_BITS; i += 8) {
+      __mmask8 mask = (__mmask8)(bits >> i);
+      __m512d v = _mm512_loadu_pd(p + i);
+      sum = _mm512_add_pd(sum, v);
+      min = _mm512_mask_min_pd(min, mask, min, v);
+      max = _mm512_mask_max_pd(max, mask, max, v);
+    }
+  }
+
+
+  // Reduce the lanes into the accumulator.
+  double lo = _mm512_reduce_min_pd(min);
+  double hi = _mm512_reduce_max_pd(max);
+  acc->sum += _mm512_reduce_add_pd(sum);
+  if(lo < acc->min)
+    acc->min = lo;
+  if(hi > acc->max)
+    acc->max = hi;
+  acc->count += count;
+
+}
+
+
+/// <summary>
+///   Picks the widest kernel that the processor supports.
+/// </summary>
+static aggregateKernel selectKernel(void) {
+
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return aggregateAvx512;
+  if(__builtin_cpu_supports("avx2"))
+    return aggregateAvx2;
+  return aggregateScalar;
+
+}
+
+
+//
+// The kernel used for every aggregate, selected once at start up.
+//
+static const aggregateKernel kernel = selectKernel();
+
+
+/*******************************************************************************
+  Static functions.
+*******************************************************************************/
+
+
+/// <summary>
+///   Resets an aggregate so that values can be accumulated into it.
+/// </summary>
+static void resetAggregate(aggregateResult *acc) {
+  acc->sum = 0.0;
+  acc->min = std::numeric_limits<double>::infinity();
+  acc->max = -std::numeric_limits<double>::infinity();
+  acc->count = 0;
+}
+
+
+/// <summary>
+///   Merges one aggregate into another.
+/// </summary>
+static void mergeAggregate(aggregateResult *acc, const aggregateResult &part) {
+  acc->sum += part.sum;
+  acc->count += part.count;
+  if(part.min < acc->min)
+    acc->min = part.min;
+  if(part.max > acc->max)
+    acc->max = part.max;
+}
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Default constructor.
+/// </summary>
+ColumnStore::ColumnStore(void) : parallelRows(CS_PARALLEL_ROWS) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Copy constructor.
+/// </summary>
+ColumnStore::ColumnStore(const ColumnStore &other)
+    : columns(other.columns), parallelRows(other.parallelRows) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Sets the value of a cell.
+/// </summary>
+void ColumnStore::Set(int col, int row, double value) {
+
+  // Grow the columns and rows in whole bitmap words.
+  if((size_t)col >= this->columns.size())
+    this->columns.resize(col + 1);
+  column &c = this->columns[col];
+  if((size_t)row >= c.values.size()) {
+    size_t words = row / CS_WORD_BITS + 1;
+    c.values.resize(words * CS_WORD_BITS, 0.0);
+    c.valid.resize(words, 0);
+  }
+
+  c.values[row] = value;
+  c.valid[row / CS_WORD_BITS] |= 1ULL << (row % CS_WORD_BITS);
+
+}
+
+
+/// <summary>
+///   Removes the value of a cell.
+/// </summary>
+void ColumnStore::Clear(int col, int row) {
+
+  if((size_t)col >= this->columns.size())
+    return;
+  column &c = this->columns[col];
+  if((size_t)row >= c.values.size())
+    return;
+
+  // Rows without values must hold 0 for the sum kernels.
+  c.values[row] = 0.0;
+  c.valid[row / CS_WORD_BITS] &= ~(1ULL << (row % CS_WORD_BITS));
+
+}
+
+
+/// <summary>
+///   Removes all values.
+/// </summary>
+void ColumnStore::ClearAll(void) {
+  this->columns.clear();
+}
+
+
+/// <summary>
+///   Gets the value of a cell.
+/// </summary>
+bool ColumnStore::Get(int col, int row, double *value) const {
+
+  if((size_t)col >= this->columns.size())
+    return false;
+  const column &c = this->columns[col];
+  if((size_t)row >= c.values.size()
+      || !(c.valid[row / CS_WORD_BITS] & (1ULL << (row % CS_WORD_BITS))))
+    return false;
+
+  *value = c.values[row];
+  return true;
+
+}
+
+
+/// <summary>
+///   Aggregates the values in the rectangular range with the given corners.
+/// </summary>
+void ColumnStore::Aggregate(int col0, int row0, int col1, int row1,
+    aggregateResult *result) const {
+
+  resetAggregate(result);
+
+
+  // Normalize the corners.
+  if(col0 > col1) {
+    int t = col0;
+    col0 = col1;
+    col1 = t;
+  }
+  if(row0 > row1) {
+    int t = row0;
+    row0 = row1;
+    row1 = t;
+  }
+
+
+  // Split tall ranges into row blocks that are reduced on separate threads.
+  long rows = (long)row1 - row0 + 1;
+  long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+  if(cpus > CS_MAX_THREADS)
+    cpus = CS_MAX_THREADS;
+  if(this->parallelRows > 0 && rows >= this->parallelRows && cpus > 1) {
+
+    // Keep every block a whole number of bitmap words.
+    long block = (rows / cpus + CS_WORD_BITS - 1) / CS_WORD_BITS
+        * CS_WORD_BITS;
+    if(block < CS_WORD_BITS)
+      block = CS_WORD_BITS;
+    reductionState states[CS_MAX_THREADS];
+    pthread_t threads[CS_MAX_THREADS];
+    bool started[CS_MAX_THREADS];
+    int n = 0;
+    for(long r = row0; r <= row1; r += block, n++) {
+      states[n].store = this;
+      states[n].col0 = col0;
+      states[n].col1 = col1;
+      states[n].row0 = (int)r;
+      states[n].row1 = (int)(r + block - 1 < row1 ? r + block - 1 : row1);
+    }
+
+    // Reduce each block on its own thread, or on this thread if a thread
+    //   could not be created.
+    for(int i = 0; i < n; i++)
+      started[i] = pthread_create(&threads[i], NULL,
+          ColumnStore::reduceBlock, &states[i]) == 0;
+    for(int i = 0; i < n; i++) {
+      if(started[i])
+        pthread_join(threads[i], NULL);
+      else
+        ColumnStore::reduceBlock(&states[i]);
+      mergeAggregate(result, states[i].result);
+    }
+
+  }
+
+  // Reduce the range on this thread.
+  else
+    this->aggregateSerial(col0, row0, col1, row1, result);
+
+
+  // Ranges without values have a min and max of 0.
+  if(result->count == 0) {
+    result->min = 0.0;
+    result->max = 0.0;
+  }
+
+}
+
+
+/// <summary>
+///   Sets the minimum number of rows in a range before the aggregate is
+///   split across threads.  A value of 0 disables parallel reductions.
+/// </summary>
+void ColumnStore::SetParallelRows(long rows) {
+  this->parallelRows = rows;
+}
+
+
+/// <summary>
+///   Gets the name of the aggregate kernel selected for this processor.
+/// </summary>
+const char * ColumnStore::KernelName(void) {
+  if(kernel == aggregateAvx512)
+    return "avx512";
+  if(kernel == aggregateAvx2)
+    return "avx2";
+  return "scalar";
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Accumulates the values in a normalized range on the calling thread.
+/// </summary>
+void ColumnStore::aggregateSerial(int col0, int row0, int col1, int row1,
+    aggregateResult *acc) const {
+
+  for(int col = col0; col <= col1 && (size_t)col < this->columns.size();
+      col++) {
+    const column &c = this->columns[col];
+    size_t end = (size_t)row1 + 1;
+    if(end > c.values.size())
+      end = c.values.size();
+    if((size_t)row0 < end)
+      kernel(&c.values[0], &c.valid[0], row0, end, acc);
+  }
+
+}
+
+
+/// <summary>
+///   Aggregates one block of a parallel reduction.
+/// </summary>
+void * ColumnStore::reduceBlock(void *arg) {
+
+  reductionState *state = static_cast<reductionState *>(arg);
+  resetAggregate(&state->result);
+  state->store->aggregateSerial(state->col0, state->row0, state->col1,
+      state->row1, &state->result);
+  return NULL;
+
+}
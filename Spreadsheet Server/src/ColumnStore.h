@@ -0,0 +1,186 @@
+/*******************************************************************************
+  File: ColumnStore.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ColumnStore.h file.
+  - Added ColumnStore class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __COLUMNSTORE_H__
+#define __COLUMNSTORE_H__
+
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <vector>
+
+
+//
+// Ranges with at least this many rows are split across threads by default.
+//
+#define CS_PARALLEL_ROWS 262144
+
+
+/// <summary>
+///   The result of aggregating the numeric values in a range of cells.
+/// </summary>
+typedef struct aggregateResult {
+  double sum;                 // The sum of the values.
+  double min;                 // The smallest value, or 0 if count is 0.
+  double max;                 // The largest value, or 0 if count is 0.
+  long count;                 // The number of cells with numeric values.
+} aggregateResult;
+
+
+/// <summary>
+///   Stores the numeric values of cells in dense per-column arrays.
+/// </summary>
+/// <remarks>
+/// <para>
+///   Every column is an array of doubles indexed by row alongside a bitmap
+///   that marks which rows hold a value.  Rows without a value hold 0 so that
+///   sums never have to consult the bitmap.
+/// </para>
+/// <para>
+///   Range aggregates are computed by SIMD kernels.  The AVX-512 or AVX2
+///   kernel is picked at run time based on the processor, with a scalar
+///   kernel as the fallback.  Very tall ranges are split into row blocks that
+///   are reduced on separate threads.
+/// </para>
+/// </remarks>
+class ColumnStore {
+
+private:
+
+  /// <summary>
+  ///   A single column of values.
+  /// </summary>
+  typedef struct column {
+    std::vector<double> values;               // Values indexed by row.
+    std::vector<unsigned long long> valid;    // One bit per row.
+  } column;
+
+
+  /// <summary>
+  ///   The work of one thread in a parallel reduction.
+  /// </summary>
+  typedef struct reductionState {
+    const ColumnStore *store;   // The store being aggregated.
+    int col0;                   // The first column of the range.
+    int col1;                   // The last column of the range.
+    int row0;                   // The first row of this thread's block.
+    int row1;                   // The last row of this thread's block.
+    aggregateResult result;     // The aggregate of this thread's block.
+  } reductionState;
+
+
+  /// <summary>
+  ///   The columns indexed by column.
+  /// </summary>
+  std::vector<column> columns;
+
+
+  /// <summary>
+  ///   The minimum number of rows in a range before the aggregate is split
+  ///   across threads, or 0 to never split.
+  /// </summary>
+  long parallelRows;
+
+
+public:
+
+  /// <summary>
+  ///   Default constructor.
+  /// </summary>
+  ColumnStore(void);
+
+
+  /// <summary>
+  ///   Copy constructor.
+  /// </summary>
+  ColumnStore(const ColumnStore &other);
+
+
+  /// <summary>
+  ///   Sets the value of a cell.
+  /// </summary>
+  void Set(int col, int row, double value);
+
+
+  /// <summary>
+  ///   Removes the value of a cell.
+  /// </summary>
+  void Clear(int col, int row);
+
+
+  /// <summary>
+  ///   Removes all values.
+  /// </summary>
+  void ClearAll(void);
+
+
+  /// <summary>
+  ///   Gets the value of a cell.
+  /// </summary>
+  /// <returns>True if the cell has a value; otherwise, false.</returns>
+  bool Get(int col, int row, double *value) const;
+
+
+  /// <summary>
+  ///   Aggregates the values in the rectangular range with the given corners.
+  /// </summary>
+  /// <param name="col0">The first column of the range.</param>
+  /// <param name="row0">The first row of the range.</param>
+  /// <param name="col1">The last column of the range.</param>
+  /// <param name="row1">The last row of the range.</param>
+  /// <param name="result">An output parameter for the aggregate.</param>
+  void Aggregate(int col0, int row0, int col1, int row1,
+      aggregateResult *result) const;
+
+
+  /// <summary>
+  ///   Sets the minimum number of rows in a range before the aggregate is
+  ///   split across threads.  A value of 0 disables parallel reductions.
+  /// </summary>
+  void SetParallelRows(long rows);
+
+
+  /// <summary>
+  ///   Gets the name of the aggregate kernel selected for this processor.
+  /// </summary>
+  static const char * KernelName(void);
+
+
+private:
+
+  /// <summary>
+  ///   Accumulates the values in a normalized range on the calling thread.
+  /// </summary>
+  void aggregateSerial(int col0, int row0, int col1, int row1,
+      aggregateResult *acc) const;
+
+
+  /// <summary>
+  ///   Aggregates one block of a parallel reduction.
+  /// </summary>
+  /// <param name="state">Pointer to the reductionState of the block.</param>
+  /// <remarks>
+  ///   This method is executed on a separate thread.
+  /// </remarks>
+  static void * reduceBlock(void *state);
+
+};
+
+
+#endif
@@ -0,0 +1,1095 @@
+/*******************************************************************************
+  File: Formula.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c Formula.cpp
+
+
+  Resources:
+  - Formula from CS 3500 Fall 2014.
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created Formula.cpp file.
+  - Added Formula class implementation.
+  - Added SUM, AVERAGE, MIN, MAX and COUNT range functions.
+  - Made references relative to the cell that owns the formula.
+  - Added Normalize method.
+  - Added Denormalize method.
+  - Added Restructure method.
+  - Trimmed ranges that an insert pushes off the sheet.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "Formula.h"
+
+//
+// Project headers.
+//
+#include "CellAddress.h"
+
+//
+// Standard libraries.
+//
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+
+
+//
+// Bytecode opcodes.
+//
+#define FO_CONST    0       // Push constants[arg].
+#define FO_LOAD     1       // Push the value of refs[arg].
+#define FO_ADD      2       // Pop b, pop a, push a + b.
+#define FO_SUB      3       // Pop b, pop a, push a - b.
+#define FO_MUL      4       // Pop b, pop a, push a * b.
+#define FO_DIV      5       // Pop b, pop a, push a / b.
+#define FO_NEG      6       // Pop a, push -a.
+#define FO_CALL     7       // Push the result of calls[arg].
+
+//
+// Function identifiers.
+//
+#define FN_SUM      0
+#define FN_AVERAGE  1
+#define FN_MIN      2
+#define FN_MAX      3
+#define FN_COUNT    4
+
+//
+// Instruction encoding helpers.
+//
+#define FO_OP(ins)        ((ins) & 0xFF)
+#define FO_ARG(ins)       ((ins) >> 8)
+#define FO_INS(op, arg)   ((unsigned int)(op) | ((unsigned int)(arg) << 8))
+
+//
+// Number of stack entries that are kept on the native stack while running the
+//   bytecode.  Deeper formulas fall back to a heap allocated stack.
+//
+#define FO_LOCAL_STACK 32
+
+//
+// Number of parentheses and unary minuses that may enclose any part of a
+//   formula.  The parser recurses once for each, so deeper formulas are
+//   invalid rather than a way to run the thread out of stack.
+//
+#define FO_MAX_NESTING 256
+
+
+/*******************************************************************************
+  Static functions.
+*******************************************************************************/
+
+
+/// <summary>
+///   Applies a binary operator.  Specialized per opcode so that the fast path
+///   evaluators compile down to a single arithmetic instruction.
+/// </summary>
+template <unsigned int OP>
+struct binaryOperator;
+
+template <>
+struct binaryOperator<FO_ADD> {
+  static inline bool Apply(double a, double b, double *r) {
+    *r = a + b;
+    return true;
+  }
+};
+
+template <>
+struct binaryOperator<FO_SUB> {
+  static inline bool Apply(double a, double b, double *r) {
+    *r = a - b;
+    return true;
+  }
+};
+
+template <>
+struct binaryOperator<FO_MUL> {
+  static inline bool Apply(double a, double b, double *r) {
+    *r = a * b;
+    return true;
+  }
+};
+
+template <>
+struct binaryOperator<FO_DIV> {
+  static inline bool Apply(double a, double b, double *r) {
+    if(b == 0.0)
+      return false;
+    *r = a / b;
+    return true;
+  }
+};
+
+
+/// <summary>
+///   Applies the binary operator for the given opcode.
+/// </summary>
+static inline bool applyOperator(unsigned int op, double a, double b,
+    double *r) {
+
+  switch(op) {
+    case FO_ADD: return binaryOperator<FO_ADD>::Apply(a, b, r);
+    case FO_SUB: return binaryOperator<FO_SUB>::Apply(a, b, r);
+    case FO_MUL: return binaryOperator<FO_MUL>::Apply(a, b, r);
+    case FO_DIV: return binaryOperator<FO_DIV>::Apply(a, b, r);
+  }
+  return false;
+
+}
+
+
+/// <summary>
+///   Advances the position past any whitespace.
+/// </summary>
+static void skipSpaces(const std::string &s, size_t *pos) {
+  while(*pos < s.length() && (s[*pos] == ' ' || s[*pos] == '\t'))
+    (*pos)++;
+}
+
+
+/// <summary>
+///   Attempts to read a decimal number of the form d[.d][e[+-]d] or .d[...].
+/// </summary>
+static bool readNumber(const std::string &s, size_t *pos, double *value) {
+
+  size_t i = *pos;
+  size_t digits = 0;
+
+  // Integer and fractional parts.
+  while(i < s.length() && s[i] >= '0' && s[i] <= '9') {
+    i++;
+    digits++;
+  }
+  if(i < s.length() && s[i] == '.') {
+    i++;
+    while(i < s.length() && s[i] >= '0' && s[i] <= '9') {
+      i++;
+      digits++;
+    }
+  }
+  if(digits == 0)
+    return false;
+
+  // Exponent.
+  if(i < s.length() && (s[i] == 'e' || s[i] == 'E')) {
+    size_t e = i + 1;
+    if(e < s.length() && (s[e] == '+' || s[e] == '-'))
+      e++;
+    if(e < s.length() && s[e] >= '0' && s[e] <= '9') {
+      while(e < s.length() && s[e] >= '0' && s[e] <= '9')
+        e++;
+      i = e;
+    }
+  }
+
+  *value = strtod(s.substr(*pos, i - *pos).c_str(), NULL);
+  *pos = i;
+  return true;
+
+}
+
+
+/// <summary>
+///   Looks up the identifier of a function by its upper-case name.
+/// </summary>
+static int findFunction(const std::string &name) {
+  if(name == "SUM")
+    return FN_SUM;
+  if(name == "AVERAGE" || name == "AVG")
+    return FN_AVERAGE;
+  if(name == "MIN")
+    return FN_MIN;
+  if(name == "MAX")
+    return FN_MAX;
+  if(name == "COUNT")
+    return FN_COUNT;
+  return -1;
+}
+
+
+/// <summary>
+///   Moves an index past an insert (count > 0) or a delete (count < 0) of
+///   lines at the given index.  Returns false if the line the index refers
+///   to was deleted or pushed off the sheet.
+/// </summary>
+static bool shiftIndex(long *index, int at, int count, long limit) {
+
+  if(*index < at)
+    return true;
+
+  if(count < 0 && *index < at - count)
+    return false;
+
+  *index += count;
+  return *index <= limit;
+
+}
+
+
+/// <summary>
+///   Moves the ends of a range past an insert (count > 0) or a delete
+///   (count < 0) of lines at the given index.  A range only loses the lines
+///   that were deleted, and is lost only if all of them were.  An insert
+///   trims the lines it pushes off the sheet, which are empty.
+/// </summary>
+static bool shiftRange(long *first, long *last, int at, int count,
+    long limit) {
+
+  if(count > 0) {
+    if(*first >= at)
+      *first += count;
+    if(*last >= at)
+      *last = std::min(*last + count, limit);
+    return *first <= limit;
+  }
+
+  long end = at - count;
+  *first = *first < at ? *first : (*first >= end ? *first + count : at);
+  *last = *last < at ? *last : (*last >= end ? *last + count : at - 1);
+  return *first <= *last;
+
+}
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Default constructor.  Creates an invalid formula.
+/// </summary>
+Formula::Formula(void)
+    : maxDepth(0), depth(0), nesting(0), originCol(0), originRow(0),
+      eval(&Formula::evalInvalid) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Copy constructor.
+/// </summary>
+Formula::Formula(const Formula &other)
+    : code(other.code), constants(other.constants), refs(other.refs),
+      ranges(other.ranges), calls(other.calls), maxDepth(other.maxDepth),
+      depth(other.depth), nesting(other.nesting), originCol(other.originCol),
+      originRow(other.originRow), eval(other.eval) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Assignment operator.
+/// </summary>
+Formula & Formula::operator=(const Formula &other) {
+  this->code = other.code;
+  this->constants = other.constants;
+  this->refs = other.refs;
+  this->ranges = other.ranges;
+  this->calls = other.calls;
+  this->maxDepth = other.maxDepth;
+  this->depth = other.depth;
+  this->nesting = other.nesting;
+  this->originCol = other.originCol;
+  this->originRow = other.originRow;
+  this->eval = other.eval;
+  return *this;
+}
+
+
+/// <summary>
+///   Compiles the given cell contents.
+/// </summary>
+bool Formula::Compile(const std::string &contents, int col, int row) {
+
+  // Reset the formula.
+  this->code.clear();
+  this->constants.clear();
+  this->refs.clear();
+  this->ranges.clear();
+  this->calls.clear();
+  this->maxDepth = 0;
+  this->depth = 0;
+  this->nesting = 0;
+  this->originCol = col;
+  this->originRow = row;
+  this->eval = &Formula::evalInvalid;
+
+
+  // Formulas must begin with '='.
+  if(contents.length() == 0 || contents[0] != '=')
+    return false;
+
+
+  // Parse the expression and make sure that all of the text was consumed.
+  size_t pos = 1;
+  bool ok = this->parseExpression(contents, &pos);
+  skipSpaces(contents, &pos);
+  if(!ok || pos != contents.length() || this->depth != 1) {
+    this->code.clear();
+    this->constants.clear();
+    this->refs.clear();
+    this->ranges.clear();
+    this->calls.clear();
+    return false;
+  }
+
+
+  // Pick the fastest evaluator for the shape of the bytecode.
+  this->selectEvaluator();
+  return true;
+
+}
+
+
+/// <summary>
+///   Gets whether or not this formula was successfully compiled.
+/// </summary>
+bool Formula::IsValid(void) const {
+  return this->eval != &Formula::evalInvalid;
+}
+
+
+/// <summary>
+///   Evaluates the formula.
+/// </summary>
+bool Formula::Evaluate(FormulaContext &context, int col, int row,
+    double *result) const {
+  return (this->*eval)(context, col, row, result);
+}
+
+
+/// <summary>
+///   Gets the distinct cells referenced by this formula.
+/// </summary>
+const std::vector<Formula::cellRef> & Formula::GetReferences(void) const {
+  return this->refs;
+}
+
+
+/// <summary>
+///   Gets the ranges referenced by functions in this formula.
+/// </summary>
+const std::vector<Formula::rangeRef> & Formula::GetRanges(void) const {
+  return this->ranges;
+}
+
+
+/// <summary>
+///   Rewrites formula contents into a relative form in which every cell name
+///   is replaced by R[row offset]C[column offset] and spacing is removed.
+/// </summary>
+std::string Formula::Normalize(const std::string &contents, int col, int row) {
+
+  std::ostringstream out;
+  size_t i = 0;
+  while(i < contents.length()) {
+    char ch = contents[i];
+
+    // Drop spacing.
+    if(ch == ' ' || ch == '\t') {
+      i++;
+      continue;
+    }
+
+    // Copy numbers whole so that exponents are not mistaken for cell names.
+    double value;
+    size_t end = i;
+    if(readNumber(contents, &end, &value)) {
+      out << contents.substr(i, end - i);
+      i = end;
+      continue;
+    }
+
+    // Upper-case function names and rewrite cell names relative to the cell.
+    if((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z')) {
+      end = i;
+      std::string name;
+      while(end < contents.length() && ((contents[end] >= 'a'
+          && contents[end] <= 'z') || (contents[end] >= 'A'
+          && contents[end] <= 'Z'))) {
+        name += (char)(contents[end] >= 'a' ? contents[end] - 'a' + 'A'
+            : contents[end]);
+        end++;
+      }
+
+      size_t paren = end;
+      skipSpaces(contents, &paren);
+      int c, r;
+      end = i;
+      if((paren >= contents.length() || contents[paren] != '(')
+          && ParseCellName(contents, &end, &c, &r)) {
+        out << "R[" << (r - row) << "]C[" << (c - col) << "]";
+        i = end;
+      }
+      else {
+        out << name;
+        i += name.length();
+      }
+      continue;
+    }
+
+    out << ch;
+    i++;
+  }
+
+  return out.str();
+
+}
+
+
+/// <summary>
+///   Rewrites the relative form produced by Normalize back into cell contents
+///   for a formula owned by the given cell.
+/// </summary>
+std::string Formula::Denormalize(const std::string &relative, int col,
+    int row) {
+
+  std::string out;
+  size_t i = 0;
+  while(i < relative.length()) {
+
+    // Relative references are the only place that R[ appears.
+    int dr, dc;
+    int n = 0;
+    if(relative.compare(i, 2, "R[") == 0
+        && sscanf(relative.c_str() + i, "R[%d]C[%d]%n", &dr, &dc, &n) == 2
+        && n > 0) {
+      long c = (long)col + dc;
+      long r = (long)row + dr;
+      if(c < 0 || r < 0 || c > CA_MAX_COL || r > CA_MAX_ROW)
+        out += "#REF!";
+      else
+        out += FormatCellName((int)c, (int)r);
+      i += n;
+      continue;
+    }
+
+    out += relative[i];
+    i++;
+  }
+
+  return out;
+
+}
+
+
+/// <summary>
+///   Rewrites the relative form produced by Normalize into cell contents for
+///   a formula owned by the given cell, as it reads once rows or columns are
+///   inserted or deleted.
+/// </summary>
+std::string Formula::Restructure(const std::string &relative, int col,
+    int row, bool rows, int at, int count) {
+
+  long limit = rows ? CA_MAX_ROW : CA_MAX_COL;
+  std::string out;
+  size_t i = 0;
+  while(i < relative.length()) {
+
+    int dr0, dc0;
+    int n = 0;
+    if(relative.compare(i, 2, "R[") == 0
+        && sscanf(relative.c_str() + i, "R[%d]C[%d]%n", &dr0, &dc0, &n) == 2
+        && n > 0) {
+      long c0 = (long)col + dc0;
+      long r0 = (long)row + dr0;
+      long c1 = c0;
+      long r1 = r0;
+      i += n;
+
+      // A second reference after a colon makes a range.
+      int dr1, dc1;
+      bool range = false;
+      n = 0;
+      if(relative.compare(i, 3, ":R[") == 0
+          && sscanf(relative.c_str() + i, ":R[%d]C[%d]%n", &dr1, &dc1, &n) == 2
+          && n > 0) {
+        c1 = (long)col + dc1;
+        r1 = (long)row + dr1;
+        range = true;
+        i += n;
+      }
+
+      bool valid = c0 >= 0 && r0 >= 0 && c1 >= 0 && r1 >= 0
+          && c0 <= CA_MAX_COL && r0 <= CA_MAX_ROW
+          && c1 <= CA_MAX_COL && r1 <= CA_MAX_ROW;
+      if(valid && range) {
+        if(c0 > c1)
+          std::swap(c0, c1);
+        if(r0 > r1)
+          std::swap(r0, r1);
+        valid = rows ? shiftRange(&r0, &r1, at, count, limit)
+            : shiftRange(&c0, &c1, at, count, limit);
+      }
+      else if(valid)
+        valid = rows ? shiftIndex(&r0, at, count, limit)
+            : shiftIndex(&c0, at, count, limit);
+
+      if(!valid)
+        out += "#REF!";
+      else if(range)
+        out += FormatCellName((int)c0, (int)r0) + ":"
+            + FormatCellName((int)c1, (int)r1);
+      else
+        out += FormatCellName((int)c0, (int)r0);
+      continue;
+    }
+
+    out += relative[i];
+    i++;
+  }
+
+  return out;
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Parses an expression: term { (+|-) term }.
+/// </summary>
+bool Formula::parseExpression(const std::string &s, size_t *pos) {
+
+  if(!this->parseTerm(s, pos))
+    return false;
+
+  skipSpaces(s, pos);
+  while(*pos < s.length() && (s[*pos] == '+' || s[*pos] == '-')) {
+    unsigned int op = s[*pos] == '+' ? FO_ADD : FO_SUB;
+    (*pos)++;
+    if(!this->parseTerm(s, pos))
+      return false;
+    this->emitOperator(op);
+    skipSpaces(s, pos);
+  }
+
+  return true;
+
+}
+
+
+/// <summary>
+///   Parses a term: factor { (*|/) factor }.
+/// </summary>
+bool Formula::parseTerm(const std::string &s, size_t *pos) {
+
+  if(!this->parseFactor(s, pos))
+    return false;
+
+  skipSpaces(s, pos);
+  while(*pos < s.length() && (s[*pos] == '*' || s[*pos] == '/')) {
+    unsigned int op = s[*pos] == '*' ? FO_MUL : FO_DIV;
+    (*pos)++;
+    if(!this->parseFactor(s, pos))
+      return false;
+    this->emitOperator(op);
+    skipSpaces(s, pos);
+  }
+
+  return true;
+
+}
+
+
+/// <summary>
+///   Parses a factor: number, cell name, -factor or ( expression ).
+/// </summary>
+bool Formula::parseFactor(const std::string &s, size_t *pos) {
+
+  skipSpaces(s, pos);
+  if(*pos >= s.length())
+    return false;
+
+  char ch = s[*pos];
+
+
+  // Parenthesized expression.
+  if(ch == '(') {
+    if(++this->nesting > FO_MAX_NESTING)
+      return false;
+    (*pos)++;
+    if(!this->parseExpression(s, pos))
+      return false;
+    skipSpaces(s, pos);
+    if(*pos >= s.length() || s[*pos] != ')')
+      return false;
+    (*pos)++;
+    this->nesting--;
+    return true;
+  }
+
+
+  // Unary minus.
+  if(ch == '-') {
+    if(++this->nesting > FO_MAX_NESTING)
+      return false;
+    (*pos)++;
+    if(!this->parseFactor(s, pos))
+      return false;
+    this->emitOperator(FO_NEG);
+    this->nesting--;
+    return true;
+  }
+
+
+  // Number.
+  double value;
+  if(readNumber(s, pos, &value)) {
+    this->emitConstant(value);
+    return true;
+  }
+
+
+  // Function call.  A name followed by an opening parenthesis.
+  size_t end = *pos;
+  std::string name;
+  while(end < s.length() && ((s[end] >= 'a' && s[end] <= 'z')
+      || (s[end] >= 'A' && s[end] <= 'Z'))) {
+    name += (char)(s[end] >= 'a' ? s[end] - 'a' + 'A' : s[end]);
+    end++;
+  }
+  size_t paren = end;
+  skipSpaces(s, &paren);
+  if(name.length() > 0 && paren < s.length() && s[paren] == '(') {
+    int function = findFunction(name);
+    if(function < 0)
+      return false;
+    *pos = paren + 1;
+    return this->parseCall(s, pos, function);
+  }
+
+
+  // Cell name.
+  int col, row;
+  if(ParseCellName(s, pos, &col, &row)) {
+    this->emitLoad(col, row);
+    return true;
+  }
+
+  return false;
+
+}
+
+
+/// <summary>
+///   Parses the argument list of a function: ( range { , range } ).  The
+///   opening parenthesis has already been consumed.
+/// </summary>
+bool Formula::parseCall(const std::string &s, size_t *pos, int function) {
+
+  functionCall fn;
+  fn.function = function;
+  fn.first = this->ranges.size();
+  fn.count = 0;
+
+
+  // Read each argument as a cell or a range of cells.
+  while(true) {
+    rangeRef range;
+    skipSpaces(s, pos);
+    if(!ParseCellName(s, pos, &range.col0, &range.row0))
+      return false;
+    range.col0 -= this->originCol;
+    range.row0 -= this->originRow;
+    range.col1 = range.col0;
+    range.row1 = range.row0;
+
+    skipSpaces(s, pos);
+    if(*pos < s.length() && s[*pos] == ':') {
+      (*pos)++;
+      skipSpaces(s, pos);
+      if(!ParseCellName(s, pos, &range.col1, &range.row1))
+        return false;
+      range.col1 -= this->originCol;
+      range.row1 -= this->originRow;
+    }
+
+    // Store the corners in ascending order.
+    if(range.col0 > range.col1) {
+      int t = range.col0;
+      range.col0 = range.col1;
+      range.col1 = t;
+    }
+    if(range.row0 > range.row1) {
+      int t = range.row0;
+      range.row0 = range.row1;
+      range.row1 = t;
+    }
+
+    this->ranges.push_back(range);
+    fn.count++;
+
+    // Continue with the next argument if there is one.
+    skipSpaces(s, pos);
+    if(*pos < s.length() && s[*pos] == ',') {
+      (*pos)++;
+      continue;
+    }
+    break;
+  }
+
+
+  // The argument list must be closed.
+  if(*pos >= s.length() || s[*pos] != ')')
+    return false;
+  (*pos)++;
+
+  this->code.push_back(FO_INS(FO_CALL, this->calls.size()));
+  this->calls.push_back(fn);
+
+  if(++this->depth > this->maxDepth)
+    this->maxDepth = this->depth;
+
+  return true;
+
+}
+
+
+/// <summary>
+///   Emits an instruction to push a constant.
+/// </summary>
+void Formula::emitConstant(double value) {
+
+  this->code.push_back(FO_INS(FO_CONST, this->constants.size()));
+  this->constants.push_back(value);
+
+  if(++this->depth > this->maxDepth)
+    this->maxDepth = this->depth;
+
+}
+
+
+/// <summary>
+///   Emits an instruction to push the value of a cell.
+/// </summary>
+void Formula::emitLoad(int col, int row) {
+
+  // Store the cell as an offset from the owning cell.
+  col -= this->originCol;
+  row -= this->originRow;
+
+  // Reuse the slot if the cell was already referenced.
+  size_t slot = 0;
+  while(slot < this->refs.size()
+      && (this->refs[slot].col != col || this->refs[slot].row != row))
+    slot++;
+  if(slot == this->refs.size()) {
+    cellRef ref;
+    ref.col = col;
+    ref.row = row;
+    this->refs.push_back(ref);
+  }
+
+  this->code.push_back(FO_INS(FO_LOAD, slot));
+
+  if(++this->depth > this->maxDepth)
+    this->maxDepth = this->depth;
+
+}
+
+
+/// <summary>
+///   Emits an operator instruction, folding it if its operands are
+///   constants.
+/// </summary>
+void Formula::emitOperator(unsigned int op) {
+
+  size_t n = this->code.size();
+
+
+  // Fold negation of a constant.
+  if(op == FO_NEG) {
+    if(n >= 1 && FO_OP(this->code[n - 1]) == FO_CONST) {
+      this->constants.back() = -this->constants.back();
+      return;
+    }
+    this->code.push_back(FO_INS(op, 0));
+    return;
+  }
+
+
+  // Fold a binary operator on two constants.  The last two instructions can
+  //   only both be pushes if they are exactly the two operands.  Division by
+  //   zero is left for run time so that it fails evaluation.
+  double r;
+  if(n >= 2 && FO_OP(this->code[n - 1]) == FO_CONST
+      && FO_OP(this->code[n - 2]) == FO_CONST) {
+    size_t k = this->constants.size();
+    if(applyOperator(op, this->constants[k - 2], this->constants[k - 1], &r)) {
+      this->code.pop_back();
+      this->constants.pop_back();
+      this->constants.back() = r;
+      this->depth--;
+      return;
+    }
+  }
+
+  this->code.push_back(FO_INS(op, 0));
+  this->depth--;
+
+}
+
+
+/// <summary>
+///   Picks the specialized evaluator of a binary operator.
+/// </summary>
+#define FO_SELECT(fn, op)                                                      \
+  switch(op) {                                                                 \
+    case FO_ADD: this->eval = &Formula::fn<FO_ADD>; break;                     \
+    case FO_SUB: this->eval = &Formula::fn<FO_SUB>; break;                     \
+    case FO_MUL: this->eval = &Formula::fn<FO_MUL>; break;                     \
+    case FO_DIV: this->eval = &Formula::fn<FO_DIV>; break;                     \
+  }
+
+
+/// <summary>
+///   Selects the evaluator for the compiled bytecode.
+/// </summary>
+void Formula::selectEvaluator(void) {
+
+  // Default to the stack machine.
+  this->eval = &Formula::run;
+
+  size_t n = this->code.size();
+  if(n == 1) {
+    if(FO_OP(this->code[0]) == FO_CONST)
+      this->eval = &Formula::evalConstant;
+    else if(FO_OP(this->code[0]) == FO_LOAD)
+      this->eval = &Formula::evalLoad;
+  }
+  else if(n == 3) {
+    unsigned int a = FO_OP(this->code[0]);
+    unsigned int b = FO_OP(this->code[1]);
+    unsigned int op = FO_OP(this->code[2]);
+    if(a == FO_LOAD && b == FO_LOAD)
+      FO_SELECT(evalLoadLoad, op)
+    else if(a == FO_LOAD && b == FO_CONST)
+      FO_SELECT(evalLoadConstant, op)
+    else if(a == FO_CONST && b == FO_LOAD)
+      FO_SELECT(evalConstantLoad, op)
+  }
+
+}
+
+
+/// <summary>
+///   Evaluates the bytecode on the stack machine.
+/// </summary>
+bool Formula::run(FormulaContext &context, int col, int row,
+    double *result) const {
+
+  // Use a local stack unless the formula is very deeply nested.
+  double local[FO_LOCAL_STACK];
+  std::vector<double> heap;
+  double *stack = local;
+  if(this->maxDepth > FO_LOCAL_STACK) {
+    heap.resize(this->maxDepth);
+    stack = &heap[0];
+  }
+  int sp = 0;
+
+
+  // Execute each instruction.
+  const unsigned int *ip = &this->code[0];
+  const unsigned int *end = ip + this->code.size();
+  for(; ip != end; ip++) {
+    unsigned int op = FO_OP(*ip);
+    switch(op) {
+
+      case FO_CONST:
+        stack[sp++] = this->constants[FO_ARG(*ip)];
+        break;
+
+      case FO_LOAD: {
+        const cellRef &ref = this->refs[FO_ARG(*ip)];
+        if(!context.Lookup(ref.col + col, ref.row + row, &stack[sp]))
+          return false;
+        sp++;
+        break;
+      }
+
+      case FO_NEG:
+        stack[sp - 1] = -stack[sp - 1];
+        break;
+
+      case FO_CALL:
+        if(!this->call(this->calls[FO_ARG(*ip)], context, col, row,
+            &stack[sp]))
+          return false;
+        sp++;
+        break;
+
+      default:
+        sp--;
+        if(!applyOperator(op, stack[sp - 1], stack[sp], &stack[sp - 1]))
+          return false;
+        break;
+
+    }
+  }
+
+  *result = stack[0];
+  return true;
+
+}
+
+
+/// <summary>
+///   Evaluates a function call.
+/// </summary>
+bool Formula::call(const functionCall &fn, FormulaContext &context, int col,
+    int row, double *result) const {
+
+  // Combine the aggregates of every argument range.
+  aggregateResult total;
+  total.sum = 0.0;
+  total.count = 0;
+  for(int i = fn.first; i < fn.first + fn.count; i++) {
+    const rangeRef &range = this->ranges[i];
+
+    // Clip the range to the sheet.  Ranges that lie entirely off the sheet
+    //   hold no values.
+    int col0 = range.col0 + col < 0 ? 0 : range.col0 + col;
+    int row0 = range.row0 + row < 0 ? 0 : range.row0 + row;
+    int col1 = range.col1 + col;
+    int row1 = range.row1 + row;
+    if(col1 < 0 || row1 < 0)
+      continue;
+
+    aggregateResult part;
+    context.Aggregate(col0, row0, col1, row1, &part);
+    if(part.count > 0) {
+      if(total.count == 0 || part.min < total.min)
+        total.min = part.min;
+      if(total.count == 0 || part.max > total.max)
+        total.max = part.max;
+    }
+    total.sum += part.sum;
+    total.count += part.count;
+  }
+  if(total.count == 0)
+    total.min = total.max = 0.0;
+
+
+  switch(fn.function) {
+    case FN_SUM:
+      *result = total.sum;
+      return true;
+    case FN_AVERAGE:
+      if(total.count == 0)
+        return false;
+      *result = total.sum / total.count;
+      return true;
+    case FN_MIN:
+      *result = total.min;
+      return true;
+    case FN_MAX:
+      *result = total.max;
+      return true;
+    case FN_COUNT:
+      *result = (double)total.count;
+      return true;
+  }
+  return false;
+
+}
+
+
+/// <summary>
+///   Fails evaluation of an invalid formula.
+/// </summary>
+bool Formula::evalInvalid(FormulaContext &, int, int, double *) const {
+  return false;
+}
+
+
+/// <summary>
+///   Evaluates a formula consisting of a single constant.
+/// </summary>
+bool Formula::evalConstant(FormulaContext &, int, int,
+    double *result) const {
+  *result = this->constants[0];
+  return true;
+}
+
+
+/// <summary>
+///   Evaluates a formula consisting of a single cell.
+/// </summary>
+bool Formula::evalLoad(FormulaContext &context, int col, int row,
+    double *result) const {
+  return context.Lookup(this->refs[0].col + col, this->refs[0].row + row,
+      result);
+}
+
+
+/// <summary>
+///   Evaluates a formula of the form cell OP cell.
+/// </summary>
+template <unsigned int OP>
+bool Formula::evalLoadLoad(FormulaContext &context, int col, int row,
+    double *result) const {
+
+  double a, b;
+  const cellRef &ra = this->refs[FO_ARG(this->code[0])];
+  const cellRef &rb = this->refs[FO_ARG(this->code[1])];
+  if(!context.Lookup(ra.col + col, ra.row + row, &a)
+      || !context.Lookup(rb.col + col, rb.row + row, &b))
+    return false;
+  return binaryOperator<OP>::Apply(a, b, result);
+
+}
+
+
+/// <summary>
+///   Evaluates a formula of the form cell OP constant.
+/// </summary>
+template <unsigned int OP>
+bool Formula::evalLoadConstant(FormulaContext &context, int col, int row,
+    double *result) const {
+
+  double a;
+  if(!context.Lookup(this->refs[0].col + col, this->refs[0].row + row, &a))
+    return false;
+  return binaryOperator<OP>::Apply(a, this->constants[0], result);
+
+}
+
+
+/// <summary>
+///   Evaluates a formula of the form constant OP cell.
+/// </summary>
+template <unsigned int OP>
+bool Formula::evalConstantLoad(FormulaContext &context, int col, int row,
+    double *result) const {
+
+  double b;
+  if(!context.Lookup(this->refs[0].col + col, this->refs[0].row + row, &b))
+    return false;
+  return binaryOperator<OP>::Apply(this->constants[0], b, result);
+
+}
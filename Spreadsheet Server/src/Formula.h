@@ -0,0 +1,442 @@
+/*******************************************************************************
+  File: Formula.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Resources:
+  - Formula from CS 3500 Fall 2014.
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created Formula.h file.
+  - Added FormulaContext and Formula class declarations.
+  - Added documentation.
+  - Added SUM, AVERAGE, MIN, MAX and COUNT range functions.
+  - Made references relative to the cell that owns the formula.
+  - Added Normalize method.
+  - Added Denormalize method.
+  - Added Restructure method.
+*******************************************************************************/
+
+
+#ifndef __FORMULA_H__
+#define __FORMULA_H__
+
+
+//
+// Project headers.
+//
+#include "ColumnStore.h"
+
+//
+// Standard libraries.
+//
+#include <string>
+#include <vector>
+
+
+/// <summary>
+///   Supplies cell values to a Formula while it is being evaluated.
+/// </summary>
+class FormulaContext {
+
+public:
+
+  /// <summary>
+  ///   Destructor.
+  /// </summary>
+  virtual ~FormulaContext(void) { }
+
+
+  /// <summary>
+  ///   Looks up the numeric value of a cell.
+  /// </summary>
+  /// <param name="col">The zero-based column index of the cell.</param>
+  /// <param name="row">The zero-based row index of the cell.</param>
+  /// <param name="value">An output parameter for the cell value.</param>
+  /// <returns>
+  ///   True if the cell has a numeric value; otherwise, false.
+  /// </returns>
+  virtual bool Lookup(int col, int row, double *value) = 0;
+
+
+  /// <summary>
+  ///   Aggregates the numeric values of a rectangular range of cells.
+  /// </summary>
+  /// <param name="col0">The first column of the range.</param>
+  /// <param name="row0">The first row of the range.</param>
+  /// <param name="col1">The last column of the range.</param>
+  /// <param name="row1">The last row of the range.</param>
+  /// <param name="result">An output parameter for the aggregate.</param>
+  virtual void Aggregate(int col0, int row0, int col1, int row1,
+      aggregateResult *result) = 0;
+
+};
+
+
+/// <summary>
+///   A spreadsheet formula compiled into bytecode for a small stack machine.
+/// </summary>
+/// <remarks>
+/// <para>
+///   Formulas consist of numbers, cell names, the operators +, -, * and /,
+///   parentheses, and the functions SUM, AVERAGE, MIN, MAX and COUNT applied
+///   to a list of cells and ranges such as SUM(A1:A100, C1).  Cell names are
+///   resolved to column and row indices when the formula is compiled so that
+///   evaluation never has to look at the formula text again.
+/// </para>
+/// <para>
+///   References are stored as offsets from the cell that owns the formula, so
+///   a formula filled down a column, such as =B2*C2, =B3*C3, and so on, is
+///   the same compiled formula at every row and can be shared.
+/// </para>
+/// <para>
+///   Operations on constant operands are folded during compilation.  Formulas
+///   with the shape of a single constant, a single cell, or a single binary
+///   operation on cells and constants are evaluated by specialized functions
+///   that bypass the stack machine entirely.
+/// </para>
+/// </remarks>
+class Formula {
+
+public:
+
+  /// <summary>
+  ///   A cell referenced by a formula.
+  /// </summary>
+  typedef struct cellRef {
+    int col;                  // The column offset from the owning cell.
+    int row;                  // The row offset from the owning cell.
+  } cellRef;
+
+
+  /// <summary>
+  ///   A rectangular range of cells referenced by a function.
+  /// </summary>
+  typedef struct rangeRef {
+    int col0;                 // The first column offset of the range.
+    int row0;                 // The first row offset of the range.
+    int col1;                 // The last column offset of the range.
+    int row1;                 // The last row offset of the range.
+  } rangeRef;
+
+
+  /// <summary>
+  ///   Default constructor.  Creates an invalid formula.
+  /// </summary>
+  Formula(void);
+
+
+  /// <summary>
+  ///   Copy constructor.
+  /// </summary>
+  Formula(const Formula &other);
+
+
+  /// <summary>
+  ///   Assignment operator.
+  /// </summary>
+  Formula & operator=(const Formula &other);
+
+
+  /// <summary>
+  ///   Compiles the given cell contents.
+  /// </summary>
+  /// <param name="contents">
+  ///   The cell contents, including the leading '=' character.
+  /// </param>
+  /// <param name="col">The column index of the cell that owns the formula.</param>
+  /// <param name="row">The row index of the cell that owns the formula.</param>
+  /// <returns>
+  ///   True if the contents are a syntactically valid formula that nests
+  ///   no more than 256 parentheses and unary minuses deep;
+  ///   otherwise, false.
+  /// </returns>
+  bool Compile(const std::string &contents, int col, int row);
+
+
+  /// <summary>
+  ///   Gets whether or not this formula was successfully compiled.
+  /// </summary>
+  bool IsValid(void) const;
+
+
+  /// <summary>
+  ///   Evaluates the formula.
+  /// </summary>
+  /// <param name="context">Supplies the values of referenced cells.</param>
+  /// <param name="col">The column index of the cell being evaluated.</param>
+  /// <param name="row">The row index of the cell being evaluated.</param>
+  /// <param name="result">An output parameter for the result.</param>
+  /// <returns>
+  ///   True if the formula evaluated to a number; otherwise, false.  A formula
+  ///   fails to evaluate if it is invalid, refers to a cell without a numeric
+  ///   value, or divides by zero.
+  /// </returns>
+  bool Evaluate(FormulaContext &context, int col, int row, double *result)
+      const;
+
+
+  /// <summary>
+  ///   Gets the distinct cells referenced by this formula as offsets from the
+  ///   owning cell.
+  /// </summary>
+  const std::vector<cellRef> & GetReferences(void) const;
+
+
+  /// <summary>
+  ///   Gets the ranges referenced by functions in this formula as offsets from
+  ///   the owning cell.
+  /// </summary>
+  const std::vector<rangeRef> & GetRanges(void) const;
+
+
+  /// <summary>
+  ///   Rewrites formula contents into a relative form in which every cell name
+  ///   is replaced by R[row offset]C[column offset] and spacing is removed.
+  ///   Formulas that differ only by a consistent shift of their references
+  ///   normalize to the same text.
+  /// </summary>
+  /// <param name="contents">
+  ///   The cell contents, including the leading '=' character.
+  /// </param>
+  /// <param name="col">The column index of the cell that owns the formula.</param>
+  /// <param name="row">The row index of the cell that owns the formula.</param>
+  static std::string Normalize(const std::string &contents, int col, int row);
+
+
+  /// <summary>
+  ///   Rewrites the relative form produced by Normalize back into cell
+  ///   contents for a formula owned by the given cell.  References that fall
+  ///   off the sheet are written as #REF!, which makes the formula invalid.
+  /// </summary>
+  /// <param name="relative">The relative form of the formula.</param>
+  /// <param name="col">The column index of the cell that owns the formula.</param>
+  /// <param name="row">The row index of the cell that owns the formula.</param>
+  static std::string Denormalize(const std::string &relative, int col,
+      int row);
+
+
+  /// <summary>
+  ///   Rewrites the relative form produced by Normalize into cell contents
+  ///   for a formula owned by the given cell, with its references moved past
+  ///   an insert or a delete of rows or columns.  References to deleted cells
+  ///   are written as #REF!, while ranges only shrink unless every line they
+  ///   cover was deleted.  Ranges lose the lines an insert pushes off the
+  ///   sheet.
+  /// </summary>
+  /// <param name="relative">The relative form of the formula.</param>
+  /// <param name="col">The column index of the cell that owns the formula.</param>
+  /// <param name="row">The row index of the cell that owns the formula.</param>
+  /// <param name="rows">True if rows change; false if columns change.</param>
+  /// <param name="at">The index of the first row or column inserted or deleted.</param>
+  /// <param name="count">
+  ///   The number of rows or columns inserted, or minus the number deleted.
+  /// </param>
+  static std::string Restructure(const std::string &relative, int col,
+      int row, bool rows, int at, int count);
+
+
+private:
+
+  /// <summary>
+  ///   A function call referred to by an OP_CALL instruction.
+  /// </summary>
+  typedef struct functionCall {
+    int function;             // The function identifier.
+    int first;                // The index of the first argument range.
+    int count;                // The number of argument ranges.
+  } functionCall;
+
+
+  /// <summary>
+  ///   Pointer to the function used to evaluate this formula.
+  /// </summary>
+  typedef bool (Formula::*evaluator)(FormulaContext &, int, int, double *)
+      const;
+
+
+  /// <summary>
+  ///   Bytecode instructions.  The low byte of every instruction is the
+  ///   opcode and the remaining bits are the operand.
+  /// </summary>
+  std::vector<unsigned int> code;
+
+
+  /// <summary>
+  ///   The constant pool referred to by OP_CONST instructions.
+  /// </summary>
+  std::vector<double> constants;
+
+
+  /// <summary>
+  ///   The cell slots referred to by OP_LOAD instructions.
+  /// </summary>
+  std::vector<cellRef> refs;
+
+
+  /// <summary>
+  ///   The argument ranges of function calls.
+  /// </summary>
+  std::vector<rangeRef> ranges;
+
+
+  /// <summary>
+  ///   The function calls referred to by OP_CALL instructions.
+  /// </summary>
+  std::vector<functionCall> calls;
+
+
+  /// <summary>
+  ///   The maximum stack depth needed to run the bytecode.
+  /// </summary>
+  int maxDepth;
+
+
+  /// <summary>
+  ///   The stack depth at the current point of compilation.
+  /// </summary>
+  int depth;
+
+
+  /// <summary>
+  ///   The number of parentheses and unary minuses enclosing the current point
+  ///   of compilation.
+  /// </summary>
+  int nesting;
+
+
+  /// <summary>
+  ///   The column index of the owning cell at the point of compilation.
+  /// </summary>
+  int originCol;
+
+
+  /// <summary>
+  ///   The row index of the owning cell at the point of compilation.
+  /// </summary>
+  int originRow;
+
+
+  /// <summary>
+  ///   The function used to evaluate this formula.
+  /// </summary>
+  evaluator eval;
+
+
+  /// <summary>
+  ///   Parses an expression: term { (+|-) term }.
+  /// </summary>
+  bool parseExpression(const std::string &s, size_t *pos);
+
+
+  /// <summary>
+  ///   Parses a term: factor { (*|/) factor }.
+  /// </summary>
+  bool parseTerm(const std::string &s, size_t *pos);
+
+
+  /// <summary>
+  ///   Parses a factor: number, cell name, -factor or ( expression ).
+  /// </summary>
+  bool parseFactor(const std::string &s, size_t *pos);
+
+
+  /// <summary>
+  ///   Parses the argument list of a function: ( range { , range } ).
+  /// </summary>
+  bool parseCall(const std::string &s, size_t *pos, int function);
+
+
+  /// <summary>
+  ///   Emits an instruction to push a constant.
+  /// </summary>
+  void emitConstant(double value);
+
+
+  /// <summary>
+  ///   Emits an instruction to push the value of a cell.
+  /// </summary>
+  void emitLoad(int col, int row);
+
+
+  /// <summary>
+  ///   Emits an operator instruction, folding it if its operands are
+  ///   constants.
+  /// </summary>
+  void emitOperator(unsigned int op);
+
+
+  /// <summary>
+  ///   Evaluates a function call.
+  /// </summary>
+  bool call(const functionCall &fn, FormulaContext &context, int col, int row,
+      double *result) const;
+
+
+  /// <summary>
+  ///   Selects the evaluator for the compiled bytecode.
+  /// </summary>
+  void selectEvaluator(void);
+
+
+  /// <summary>
+  ///   Evaluates the bytecode on the stack machine.
+  /// </summary>
+  bool run(FormulaContext &context, int col, int row,
+      double *result) const;
+
+
+  /// <summary>
+  ///   Fails evaluation of an invalid formula.
+  /// </summary>
+  bool evalInvalid(FormulaContext &context, int col, int row,
+      double *result) const;
+
+
+  /// <summary>
+  ///   Evaluates a formula consisting of a single constant.
+  /// </summary>
+  bool evalConstant(FormulaContext &context, int col, int row,
+      double *result) const;
+
+
+  /// <summary>
+  ///   Evaluates a formula consisting of a single cell.
+  /// </summary>
+  bool evalLoad(FormulaContext &context, int col, int row,
+      double *result) const;
+
+
+  /// <summary>
+  ///   Evaluates a formula of the form cell OP cell.
+  /// </summary>
+  template <unsigned int OP>
+  bool evalLoadLoad(FormulaContext &context, int col, int row,
+      double *result) const;
+
+
+  /// <summary>
+  ///   Evaluates a formula of the form cell OP constant.
+  /// </summary>
+  template <unsigned int OP>
+  bool evalLoadConstant(FormulaContext &context, int col, int row,
+      double *result) const;
+
+
+  /// <summary>
+  ///   Evaluates a formula of the form constant OP cell.
+  /// </summary>
+  template <unsigned int OP>
+  bool evalConstantLoad(FormulaContext &context, int col, int row,
+      double *result) const;
+
+};
+
+
+#endif
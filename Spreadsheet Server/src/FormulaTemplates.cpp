@@ -0,0 +1,255 @@
+/*******************************************************************************
+  File: FormulaTemplates.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c FormulaTemplates.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created FormulaTemplates.cpp file.
+  - Added FormulaTemplates class implementation.
+  - Added the span of each template and the cells that use it.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "FormulaTemplates.h"
+
+//
+// Standard libraries.
+//
+#include <algorithm>
+
+
+//
+// Packs a cell position into a key that sorts in column-major order.
+//
+#define FT_COL_KEY(col, row) (((cellKey)(col) << 20) | (cellKey)(row))
+#define FT_COL_KEY_COL(key) ((int)((key) >> 20))
+#define FT_COL_KEY_ROW(key) ((int)((key) & 0xFFFFF))
+
+
+/// <summary>
+///   Default constructor.
+/// </summary>
+FormulaTemplates::FormulaTemplates(void) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Copy constructor.
+/// </summary>
+FormulaTemplates::FormulaTemplates(const FormulaTemplates &other)
+    : entries(other.entries), ids(other.ids), freeIds(other.freeIds) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Gets the template for formula contents owned by the given cell,
+///   compiling it only if no cell has used it before.
+/// </summary>
+int FormulaTemplates::Intern(const std::string &contents, int col, int row) {
+
+  // Share the template if the relative form has been seen before.
+  std::string text = Formula::Normalize(contents, col, row);
+  std::map<std::string, int>::iterator it = this->ids.find(text);
+  if(it != this->ids.end()) {
+    this->entries[it->second].uses++;
+    return it->second;
+  }
+
+
+  // Compile the formula for the new template.
+  Formula formula;
+  if(!formula.Compile(contents, col, row))
+    return -1;
+
+
+  // Reuse a free slot if there is one.
+  int id;
+  if(!this->freeIds.empty()) {
+    id = this->freeIds.back();
+    this->freeIds.pop_back();
+  }
+  else {
+    id = this->entries.size();
+    this->entries.push_back(entry());
+  }
+
+  entry &e = this->entries[id];
+  e.text = text;
+  e.formula = formula;
+  e.uses = 1;
+  this->ids[text] = id;
+
+
+  // Find the span of the references, starting from the owning cell.
+  e.col0 = e.row0 = e.col1 = e.row1 = 0;
+  const std::vector<Formula::cellRef> &refs = formula.GetReferences();
+  for(size_t i = 0; i < refs.size(); i++) {
+    e.col0 = std::min(e.col0, refs[i].col);
+    e.row0 = std::min(e.row0, refs[i].row);
+    e.col1 = std::max(e.col1, refs[i].col);
+    e.row1 = std::max(e.row1, refs[i].row);
+  }
+  const std::vector<Formula::rangeRef> &ranges = formula.GetRanges();
+  for(size_t i = 0; i < ranges.size(); i++) {
+    e.col0 = std::min(e.col0, std::min(ranges[i].col0, ranges[i].col1));
+    e.row0 = std::min(e.row0, std::min(ranges[i].row0, ranges[i].row1));
+    e.col1 = std::max(e.col1, std::max(ranges[i].col0, ranges[i].col1));
+    e.row1 = std::max(e.row1, std::max(ranges[i].row0, ranges[i].row1));
+  }
+
+  return id;
+
+}
+
+
+/// <summary>
+///   Takes another use of an existing template.
+/// </summary>
+void FormulaTemplates::Retain(int id) {
+  this->entries[id].uses++;
+}
+
+
+/// <summary>
+///   Gives back a use of a template.  The template is freed once it has no
+///   more uses.
+/// </summary>
+void FormulaTemplates::Release(int id) {
+
+  entry &e = this->entries[id];
+  if(--e.uses > 0)
+    return;
+
+  this->ids.erase(e.text);
+  e.text.clear();
+  e.formula = Formula();
+  e.byRow.clear();
+  e.byCol.clear();
+  this->freeIds.push_back(id);
+
+}
+
+
+/// <summary>
+///   Gets the compiled formula of a template.
+/// </summary>
+const Formula & FormulaTemplates::GetFormula(int id) const {
+  return this->entries[id].formula;
+}
+
+
+/// <summary>
+///   Gets the relative text of a template.
+/// </summary>
+const std::string & FormulaTemplates::GetText(int id) const {
+  return this->entries[id].text;
+}
+
+
+/// <summary>
+///   Gets the smallest rectangle, as offsets from the owning cell, that holds
+///   the owning cell and every cell a template refers to.
+/// </summary>
+void FormulaTemplates::GetSpan(int id, int *col0, int *row0, int *col1,
+    int *row1) const {
+
+  const entry &e = this->entries[id];
+  *col0 = e.col0;
+  *row0 = e.row0;
+  *col1 = e.col1;
+  *row1 = e.row1;
+
+}
+
+
+/// <summary>
+///   Records that the cell at the given position uses a template.
+/// </summary>
+void FormulaTemplates::Attach(int id, int col, int row) {
+  entry &e = this->entries[id];
+  e.byRow.insert(CA_KEY(col, row));
+  e.byCol.insert(FT_COL_KEY(col, row));
+}
+
+
+/// <summary>
+///   Records that the cell at the given position no longer uses a template.
+/// </summary>
+void FormulaTemplates::Detach(int id, int col, int row) {
+  entry &e = this->entries[id];
+  e.byRow.erase(CA_KEY(col, row));
+  e.byCol.erase(FT_COL_KEY(col, row));
+}
+
+
+/// <summary>
+///   Gets the cells attached to a template whose rows, or else columns, are
+///   between first and last, inclusive.
+/// </summary>
+void FormulaTemplates::FindCells(int id, bool rows, int first, int last,
+    std::vector<cellKey> *found) const {
+
+  const entry &e = this->entries[id];
+  std::set<cellKey>::const_iterator it;
+
+  if(rows) {
+    cellKey end = CA_KEY(CA_MAX_COL, last);
+    for(it = e.byRow.lower_bound(CA_KEY(0, first));
+        it != e.byRow.end() && *it <= end; it++)
+      found->push_back(*it);
+  }
+  else {
+    cellKey end = FT_COL_KEY(last, CA_MAX_ROW);
+    for(it = e.byCol.lower_bound(FT_COL_KEY(first, 0));
+        it != e.byCol.end() && *it <= end; it++)
+      found->push_back(CA_KEY(FT_COL_KEY_COL(*it), FT_COL_KEY_ROW(*it)));
+  }
+
+}
+
+
+/// <summary>
+///   Gets the ids of every template in use.
+/// </summary>
+void FormulaTemplates::GetIds(std::vector<int> *result) const {
+  result->clear();
+  for(std::map<std::string, int>::const_iterator it = this->ids.begin();
+      it != this->ids.end(); it++)
+    result->push_back(it->second);
+}
+
+
+/// <summary>
+///   Gets the number of distinct templates in use.
+/// </summary>
+int FormulaTemplates::Count(void) const {
+  return this->ids.size();
+}
+
+
+/// <summary>
+///   Removes every template.
+/// </summary>
+void FormulaTemplates::Clear(void) {
+  this->entries.clear();
+  this->ids.clear();
+  this->freeIds.clear();
+}
@@ -0,0 +1,206 @@
+/*******************************************************************************
+  File: FormulaTemplates.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created FormulaTemplates.h file.
+  - Added FormulaTemplates class declaration.
+  - Added documentation.
+  - Added the span of each template and the cells that use it.
+*******************************************************************************/
+
+
+#ifndef __FORMULATEMPLATES_H__
+#define __FORMULATEMPLATES_H__
+
+
+//
+// Project headers.
+//
+#include "CellAddress.h"
+#include "Formula.h"
+
+//
+// Standard libraries.
+//
+#include <deque>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+
+/// <summary>
+///   An interning table of compiled formulas keyed by their relative (R1C1)
+///   form.
+/// </summary>
+/// <remarks>
+/// <para>
+///   A formula that is filled down or across a sheet, such as =B2*C2, =B3*C3,
+///   and so on, normalizes to the same relative text at every cell.  The
+///   table compiles that text once and hands out a template id that every
+///   such cell shares.  A cell then only needs its template id and its own
+///   position to be evaluated.
+/// </para>
+/// <para>
+///   Templates are reference counted and their ids are reused once the last
+///   cell using them lets go.
+/// </para>
+/// <para>
+///   Each template also knows the rows and columns its references reach
+///   relative to the owning cell, and the cells attached to it in row-major
+///   and column-major order.  Together these answer which cells have
+///   formulas that reach across a given row or column without visiting
+///   every formula on the sheet.
+/// </para>
+/// </remarks>
+class FormulaTemplates {
+
+private:
+
+  /// <summary>
+  ///   A single interned template.
+  /// </summary>
+  typedef struct entry {
+    std::string text;         // The relative form of the formula.
+    Formula formula;          // The compiled formula.
+    int uses;                 // The number of cells using the template.
+    int col0;                 // The first column offset referenced, or 0.
+    int row0;                 // The first row offset referenced, or 0.
+    int col1;                 // The last column offset referenced, or 0.
+    int row1;                 // The last row offset referenced, or 0.
+    std::set<cellKey> byRow;  // The attached cells in row-major order.
+    std::set<cellKey> byCol;  // The attached cells in column-major order.
+  } entry;
+
+
+  /// <summary>
+  ///   The templates indexed by id.
+  /// </summary>
+  std::deque<entry> entries;
+
+
+  /// <summary>
+  ///   Maps the relative text of each template to its id.
+  /// </summary>
+  std::map<std::string, int> ids;
+
+
+  /// <summary>
+  ///   Ids of entries that are no longer used.
+  /// </summary>
+  std::vector<int> freeIds;
+
+
+public:
+
+  /// <summary>
+  ///   Default constructor.
+  /// </summary>
+  FormulaTemplates(void);
+
+
+  /// <summary>
+  ///   Copy constructor.
+  /// </summary>
+  FormulaTemplates(const FormulaTemplates &other);
+
+
+  /// <summary>
+  ///   Gets the template for formula contents owned by the given cell,
+  ///   compiling it only if no cell has used it before.
+  /// </summary>
+  /// <param name="contents">
+  ///   The cell contents, including the leading '=' character.
+  /// </param>
+  /// <param name="col">The column index of the owning cell.</param>
+  /// <param name="row">The row index of the owning cell.</param>
+  /// <returns>
+  ///   The template id, or -1 if the contents are not a valid formula.  Every
+  ///   id returned must eventually be given back with Release.
+  /// </returns>
+  int Intern(const std::string &contents, int col, int row);
+
+
+  /// <summary>
+  ///   Takes another use of an existing template.
+  /// </summary>
+  void Retain(int id);
+
+
+  /// <summary>
+  ///   Gives back a use of a template.  The template is freed once it has no
+  ///   more uses.
+  /// </summary>
+  void Release(int id);
+
+
+  /// <summary>
+  ///   Gets the compiled formula of a template.
+  /// </summary>
+  const Formula & GetFormula(int id) const;
+
+
+  /// <summary>
+  ///   Gets the relative text of a template.
+  /// </summary>
+  const std::string & GetText(int id) const;
+
+
+  /// <summary>
+  ///   Gets the smallest rectangle, as offsets from the owning cell, that
+  ///   holds the owning cell and every cell a template refers to.
+  /// </summary>
+  void GetSpan(int id, int *col0, int *row0, int *col1, int *row1) const;
+
+
+  /// <summary>
+  ///   Records that the cell at the given position uses a template.
+  /// </summary>
+  void Attach(int id, int col, int row);
+
+
+  /// <summary>
+  ///   Records that the cell at the given position no longer uses a template.
+  /// </summary>
+  void Detach(int id, int col, int row);
+
+
+  /// <summary>
+  ///   Gets the cells attached to a template whose rows, or else columns,
+  ///   are between first and last, inclusive.
+  /// </summary>
+  /// <param name="found">
+  ///   An output parameter that the packed keys of the cells are appended to.
+  /// </param>
+  void FindCells(int id, bool rows, int first, int last,
+      std::vector<cellKey> *found) const;
+
+
+  /// <summary>
+  ///   Gets the ids of every template in use.
+  /// </summary>
+  void GetIds(std::vector<int> *result) const;
+
+
+  /// <summary>
+  ///   Gets the number of distinct templates in use.
+  /// </summary>
+  int Count(void) const;
+
+
+  /// <summary>
+  ///   Removes every template.
+  /// </summary>
+  void Clear(void);
+
+};
+
+
+#endif
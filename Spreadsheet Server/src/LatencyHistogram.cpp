@@ -0,0 +1,235 @@
+/*******************************************************************************
+  File: LatencyHistogram.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c LatencyHistogram.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created LatencyHistogram.cpp file.
+  - Added LatencyHistogram class implementation.
+  - Changed the buckets to log-linear ones of bounded relative error.
+  - Added Count, Percentile and WritePercentiles implementations.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "LatencyHistogram.h"
+
+//
+// Standard libraries.
+//
+#include <cstdio>
+
+//
+// Clock library.
+//
+#include <time.h>
+
+
+//
+// Upper bound of each exported bucket, in microseconds.
+//
+static const unsigned long long bounds[LH_EXPORT_BUCKETS] = {
+  100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000,
+  500000, 1000000, 2500000, 5000000, 10000000
+};
+
+//
+// Upper bound of each exported bucket as Prometheus writes it, in seconds.
+//
+static const char * const boundLabels[LH_EXPORT_BUCKETS] = {
+  "0.0001", "0.00025", "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025",
+  "0.05", "0.1", "0.25", "0.5", "1", "2.5", "5", "10"
+};
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates an empty histogram.
+/// </summary>
+LatencyHistogram::LatencyHistogram(void) : count(0), sum(0) {
+
+  for(int i = 0; i < LH_BUCKETS; i++)
+    this->buckets[i] = 0;
+
+}
+
+
+/// <summary>
+///   Counts a duration.
+/// </summary>
+void LatencyHistogram::Record(unsigned long long micros) {
+
+  __sync_fetch_and_add(&this->buckets[LatencyHistogram::index(micros)], 1);
+  __sync_fetch_and_add(&this->count, 1);
+  __sync_fetch_and_add(&this->sum, micros);
+
+}
+
+
+/// <summary>
+///   Counts the time since a start time taken with NowMicros.
+/// </summary>
+void LatencyHistogram::RecordSince(unsigned long long start) {
+  this->Record(LatencyHistogram::NowMicros() - start);
+}
+
+
+/// <summary>
+///   Gets the number of durations counted.
+/// </summary>
+unsigned long long LatencyHistogram::Count(void) const {
+  return *(const volatile unsigned long long *)&this->count;
+}
+
+
+/// <summary>
+///   Gets the duration that a fraction of the durations counted took at most,
+///   in microseconds.
+/// </summary>
+unsigned long long LatencyHistogram::Percentile(double fraction) const {
+
+  // Durations recorded meanwhile may be in the buckets but not yet in the
+  //   count, so the buckets are summed instead.
+  const volatile unsigned long long *buckets = this->buckets;
+  unsigned long long total = 0;
+  for(int i = 0; i < LH_BUCKETS; i++)
+    total += buckets[i];
+  if(total == 0)
+    return 0;
+
+  // The rank of the duration wanted, counting from 1.
+  unsigned long long rank = (unsigned long long)(fraction * total + 0.999999);
+  if(rank < 1)
+    rank = 1;
+
+  unsigned long long seen = 0;
+  for(int i = 0; i < LH_BUCKETS; i++) {
+    seen += buckets[i];
+    if(seen >= rank)
+      return LatencyHistogram::lowest(i + 1) - 1;
+  }
+
+  return LatencyHistogram::lowest(LH_BUCKETS) - 1;
+
+}
+
+
+/// <summary>
+///   Writes the buckets, sum and count of the histogram as Prometheus samples.
+/// </summary>
+void LatencyHistogram::Write(std::ostream &out, const std::string &name,
+    const std::string &labels) const {
+
+  std::string prefix = labels.empty() ? "" : labels + ",";
+
+  // Each exported bucket takes in every bucket that starts at or below its
+  //   bound.
+  const volatile unsigned long long *buckets = this->buckets;
+  unsigned long long counted = 0;
+  int bucket = 0;
+  for(int i = 0; i <= LH_EXPORT_BUCKETS; i++) {
+    while(bucket < LH_BUCKETS && (i == LH_EXPORT_BUCKETS
+        || LatencyHistogram::lowest(bucket) <= bounds[i]))
+      counted += buckets[bucket++];
+    out << name << "_bucket{" << prefix << "le=\""
+        << (i < LH_EXPORT_BUCKETS ? boundLabels[i] : "+Inf") << "\"} "
+        << counted << "\n";
+  }
+
+  unsigned long long micros = *(const volatile unsigned long long *)&this->sum;
+  std::string braces = labels.empty() ? "" : "{" + labels + "}";
+  char seconds[32];
+  snprintf(seconds, sizeof(seconds), "%llu.%06llu", micros / 1000000,
+      micros % 1000000);
+  out << name << "_sum" << braces << " " << seconds << "\n";
+  out << name << "_count" << braces << " " << counted << "\n";
+
+}
+
+
+/// <summary>
+///   Writes the count of the histogram and its percentiles, in milliseconds,
+///   on one line.
+/// </summary>
+void LatencyHistogram::WritePercentiles(std::ostream &out) const {
+
+  static const double fractions[] = { 0.5, 0.9, 0.99, 0.999, 1 };
+  static const char * const names[] = { "p50", "p90", "p99", "p99.9", "max" };
+
+  out << "count " << this->Count();
+  for(int i = 0; i < 5; i++) {
+    unsigned long long micros = this->Percentile(fractions[i]);
+    char millis[32];
+    snprintf(millis, sizeof(millis), "%llu.%03llu", micros / 1000,
+        micros % 1000);
+    out << " " << names[i] << " " << millis;
+  }
+
+}
+
+
+/// <summary>
+///   Gets the time on a clock that never goes backwards, in microseconds.
+/// </summary>
+unsigned long long LatencyHistogram::NowMicros(void) {
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (unsigned long long)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Gets the bucket of a duration.  Durations below 2^(LH_SUB_BITS + 1) are
+///   their own bucket; above that, the highest set bit picks the power of two
+///   and the LH_SUB_BITS bits below it the bucket within it.
+/// </summary>
+int LatencyHistogram::index(unsigned long long micros) {
+
+  if(micros >= (1ULL << LH_MAX_BITS))
+    micros = (1ULL << LH_MAX_BITS) - 1;
+  if(micros < (2ULL << LH_SUB_BITS))
+    return (int)micros;
+
+  int shift = 63 - __builtin_clzll(micros) - LH_SUB_BITS;
+  return ((shift + 1) << LH_SUB_BITS) + (int)(micros >> shift)
+      - (1 << LH_SUB_BITS);
+
+}
+
+
+/// <summary>
+///   Gets the shortest duration that falls in a bucket.  The bucket past the
+///   last one starts at 2^LH_MAX_BITS.
+/// </summary>
+unsigned long long LatencyHistogram::lowest(int bucket) {
+
+  if(bucket < (2 << LH_SUB_BITS))
+    return bucket;
+
+  int shift = (bucket >> LH_SUB_BITS) - 1;
+  return (unsigned long long)((bucket & ((1 << LH_SUB_BITS) - 1))
+      + (1 << LH_SUB_BITS)) << shift;
+
+}
@@ -0,0 +1,184 @@
+/*******************************************************************************
+  File: LatencyHistogram.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created LatencyHistogram.h file.
+  - Added LatencyHistogram class declaration.
+  - Changed the buckets to log-linear ones of bounded relative error.
+  - Added Count, Percentile and WritePercentiles methods.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __LATENCYHISTOGRAM_H__
+#define __LATENCYHISTOGRAM_H__
+
+
+//
+// Standard libraries.
+//
+#include <ostream>
+#include <string>
+
+
+//
+// Number of bits of precision of a histogram.  Every power of two is split
+//   into 2^LH_SUB_BITS buckets, so a duration is known to within 1 part in
+//   2^LH_SUB_BITS, about 6%.
+//
+#define LH_SUB_BITS 4
+
+//
+// Number of bits of the longest duration that is told apart, in
+//   microseconds: 2^40 microseconds is about 12 days.  Longer ones are
+//   counted as that long.
+//
+#define LH_MAX_BITS 40
+
+//
+// Number of buckets of a histogram.
+//
+#define LH_BUCKETS ((LH_MAX_BITS - LH_SUB_BITS + 1) << LH_SUB_BITS)
+
+//
+// Number of buckets written out in the Prometheus text format, not counting
+//   the one for everything slower than the last.
+//
+#define LH_EXPORT_BUCKETS 16
+
+
+/// <summary>
+///   Counts how long something took, in microseconds, with a precision of
+///   about 6% from 1 microsecond to days.
+/// </summary>
+/// <remarks>
+///   This is a high dynamic range histogram: durations below 2^(LH_SUB_BITS +
+///   1) microseconds each get a bucket, and every power of two above that is
+///   split into 2^LH_SUB_BITS buckets of equal width.  Finding the bucket of a
+///   duration is a few bit operations, and recording it a few atomic adds, so
+///   any number of threads may record at once without a lock.  Percentiles
+///   are read off the buckets, and the histogram is written out in the
+///   Prometheus text format in fewer, fixed buckets from 100 microseconds to
+///   10 seconds.
+/// </remarks>
+class LatencyHistogram {
+
+private:
+
+  /// <summary>
+  ///   The number of durations in each bucket.
+  /// </summary>
+  unsigned long long buckets[LH_BUCKETS];
+
+
+  /// <summary>
+  ///   The number of durations.
+  /// </summary>
+  unsigned long long count;
+
+
+  /// <summary>
+  ///   The sum of the durations, in microseconds.
+  /// </summary>
+  unsigned long long sum;
+
+
+  /// <summary>
+  ///   Copy constructor.  Histograms cannot be copied.
+  /// </summary>
+  LatencyHistogram(const LatencyHistogram &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Histograms cannot be copied.
+  /// </summary>
+  LatencyHistogram & operator=(const LatencyHistogram &other);
+
+
+public:
+
+  /// <summary>
+  ///   Creates an empty histogram.
+  /// </summary>
+  LatencyHistogram(void);
+
+
+  /// <summary>
+  ///   Counts a duration.
+  /// </summary>
+  /// <param name="micros">The duration, in microseconds.</param>
+  void Record(unsigned long long micros);
+
+
+  /// <summary>
+  ///   Counts the time since a start time taken with NowMicros.
+  /// </summary>
+  void RecordSince(unsigned long long start);
+
+
+  /// <summary>
+  ///   Gets the number of durations counted.
+  /// </summary>
+  unsigned long long Count(void) const;
+
+
+  /// <summary>
+  ///   Gets the duration that a fraction of the durations counted took at
+  ///   most, in microseconds, or 0 if none were counted.
+  /// </summary>
+  /// <param name="fraction">The fraction, from 0 to 1, such as 0.99.</param>
+  unsigned long long Percentile(double fraction) const;
+
+
+  /// <summary>
+  ///   Writes the buckets, sum and count of the histogram as Prometheus
+  ///   samples, in seconds.  Each exported bucket counts the durations up to
+  ///   its bound, to within the precision of the histogram.
+  /// </summary>
+  /// <param name="out">The stream to write to.</param>
+  /// <param name="name">The name of the metric.</param>
+  /// <param name="labels">
+  ///   The labels of the samples, such as command="cell", or empty.
+  /// </param>
+  void Write(std::ostream &out, const std::string &name,
+      const std::string &labels) const;
+
+
+  /// <summary>
+  ///   Writes the count of the histogram and its 50th, 90th, 99th and 99.9th
+  ///   percentiles and maximum, in milliseconds, on one line, such as
+  ///   "count 12 p50 0.031 p90 0.055 p99 0.120 p99.9 0.120 max 0.120".
+  /// </summary>
+  void WritePercentiles(std::ostream &out) const;
+
+
+  /// <summary>
+  ///   Gets the time on a clock that never goes backwards, in microseconds.
+  /// </summary>
+  static unsigned long long NowMicros(void);
+
+
+private:
+
+  /// <summary>
+  ///   Gets the bucket of a duration.
+  /// </summary>
+  static int index(unsigned long long micros);
+
+
+  /// <summary>
+  ///   Gets the shortest duration that falls in a bucket.
+  /// </summary>
+  static unsigned long long lowest(int bucket);
+
+};
+
+
+#endif
@@ -0,0 +1,145 @@
+/*******************************************************************************
+  File: MessageCodec.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c MessageCodec.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created MessageCodec.cpp file.
+  - Added compressed message framing functions.
+*******************************************************************************/
+
+
+//
+// Header file.
+//
+#include "MessageCodec.h"
+
+//
+// Standard libraries.
+//
+#include <sstream>
+#include <vector>
+
+//
+// Compression library.
+//
+#include <zlib.h>
+
+
+//
+// Text common in cell messages.  Deflate finds matches nearest the end of the
+//   dictionary most cheaply, so the most common text comes last.
+//
+static const std::string dictionary(
+    "#REF! -0.5 0.25 100 1000 TRUE FALSE "
+    "=AVERAGE(A1:A10) =COUNT(B1:B10) =MIN(C1:C10) =MAX(D1:D10) "
+    "=SUM(E1:E10) =A1+B1 =A1-B1 =A1*B1 =A1/B1 =(A1+B1)/2 "
+    "version 1234567890\n"
+    "cell Z1 \ncell Y1 \ncell X1 \ncell W1 \ncell V1 \ncell U1 \n"
+    "cell T1 \ncell S1 \ncell R1 \ncell Q1 \ncell P1 \ncell O1 \n"
+    "cell N1 \ncell M1 \ncell L1 \ncell K1 \ncell J1 \ncell I1 \n"
+    "cell H1 =SUM(\ncell G1 =\ncell F1 =\ncell E1 =\ncell D1 =\n"
+    "cell C1 =\ncell B1 =\ncell A10 \ncell A11 \ncell A12 \ncell A1 0\n");
+
+
+//
+// Characters of the base64 alphabet.
+//
+static const char base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/// <summary>
+///   Appends the base64 encoding of a buffer to a string.
+/// </summary>
+static void appendBase64(const unsigned char *data, size_t length,
+    std::string *out) {
+
+  out->reserve(out->size() + (length + 2) / 3 * 4);
+  size_t i = 0;
+  for(; i + 2 < length; i += 3) {
+    unsigned int bits = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+    *out += base64[(bits >> 18) & 0x3F];
+    *out += base64[(bits >> 12) & 0x3F];
+    *out += base64[(bits >> 6) & 0x3F];
+    *out += base64[bits & 0x3F];
+  }
+
+  // Pad the last group of one or two bytes.
+  if(i < length) {
+    unsigned int bits = data[i] << 16;
+    if(i + 1 < length)
+      bits |= data[i + 1] << 8;
+    *out += base64[(bits >> 18) & 0x3F];
+    *out += base64[(bits >> 12) & 0x3F];
+    *out += i + 1 < length ? base64[(bits >> 6) & 0x3F] : '=';
+    *out += '=';
+  }
+
+}
+
+
+/*******************************************************************************
+  Global functions.
+*******************************************************************************/
+
+
+/// <summary>
+///   Attempts to compress one or more newline separated messages into a
+///   single "deflate" message.
+/// </summary>
+bool CompressMessage(const std::string &messages, std::string *framed) {
+
+  if(messages.size() < MC_MIN_SIZE)
+    return false;
+
+  z_stream zs;
+  zs.zalloc = Z_NULL;
+  zs.zfree = Z_NULL;
+  zs.opaque = Z_NULL;
+  if(deflateInit(&zs, Z_DEFAULT_COMPRESSION) != Z_OK)
+    return false;
+
+  std::vector<unsigned char> buffer(deflateBound(&zs, messages.size()));
+  bool done = deflateSetDictionary(&zs,
+        (const Bytef *)dictionary.data(), dictionary.size()) == Z_OK;
+  if(done) {
+    zs.next_in = (Bytef *)messages.data();
+    zs.avail_in = messages.size();
+    zs.next_out = &buffer[0];
+    zs.avail_out = buffer.size();
+    done = deflate(&zs, Z_FINISH) == Z_STREAM_END;
+  }
+  size_t length = buffer.size() - zs.avail_out;
+  deflateEnd(&zs);
+
+
+  // Only send the compressed form if it saves something after encoding.
+  if(!done || (length + 2) / 3 * 4 + 32 >= messages.size())
+    return false;
+
+  std::ostringstream header;
+  header << "deflate " << messages.size() << " ";
+  *framed = header.str();
+  appendBase64(&buffer[0], length, framed);
+
+  return true;
+
+}
+
+
+/// <summary>
+///   Gets the preset dictionary that compressed messages are deflated with.
+/// </summary>
+const std::string & MessageDictionary(void) {
+  return dictionary;
+}
@@ -0,0 +1,67 @@
+/*******************************************************************************
+  File: MessageCodec.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created MessageCodec.h file.
+  - Added compressed message framing functions.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __MESSAGECODEC_H__
+#define __MESSAGECODEC_H__
+
+
+//
+// Standard libraries.
+//
+#include <string>
+
+
+//
+// Messages shorter than this many bytes are always sent as they are.
+//
+#define MC_MIN_SIZE 512
+
+
+/// <summary>
+///   Attempts to compress one or more newline separated messages into a
+///   single "deflate" message for clients with the deflate capability.
+/// </summary>
+/// <remarks>
+/// <para>
+///   The compressed message has the form "deflate &lt;length&gt; &lt;data&gt;",
+///   where length is the number of bytes of the original messages and data is
+///   the base64 encoding of a zlib stream of them.  A client inflates the data
+///   and handles the lines of the result as if they had been sent one by one.
+/// </para>
+/// <para>
+///   Every stream is compressed on its own with the preset dictionary returned
+///   by MessageDictionary, which holds text that is common in cell messages,
+///   so that even a short batch compresses well.  Clients must inflate with
+///   the same dictionary.
+/// </para>
+/// </remarks>
+/// <param name="messages">The messages to compress.</param>
+/// <param name="framed">An output parameter for the compressed message.</param>
+/// <returns>
+///   True if the compressed message is shorter than the messages; otherwise,
+///   false, and the messages should be sent as they are.
+/// </returns>
+extern bool CompressMessage(const std::string &messages, std::string *framed);
+
+
+/// <summary>
+///   Gets the preset dictionary that compressed messages are deflated with.
+/// </summary>
+extern const std::string & MessageDictionary(void);
+
+
+#endif
@@ -0,0 +1,223 @@
+/*******************************************************************************
+  File: ProfiledMutex.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -pthread -c ProfiledMutex.cpp
+  g++ -pthread -DLOCK_PROFILING -c ProfiledMutex.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ProfiledMutex.cpp file.
+  - Added ProfiledMutex class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "ProfiledMutex.h"
+
+// Without profiling, every method is inline in the header.
+#ifdef LOCK_PROFILING
+
+//
+// Standard libraries.
+//
+#include <cstring>
+
+
+/*******************************************************************************
+  Static members.
+*******************************************************************************/
+
+
+ProfiledMutex::lockSite *ProfiledMutex::sites = NULL;
+pthread_mutex_t ProfiledMutex::sitesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates an unlocked mutex.
+/// </summary>
+ProfiledMutex::ProfiledMutex(const char *name)
+    : site(ProfiledMutex::findSite(name)), acquired(0) {
+  pthread_mutex_init(&this->mutex, NULL);
+}
+
+
+/// <summary>
+///   Destructor.
+/// </summary>
+ProfiledMutex::~ProfiledMutex() {
+  pthread_mutex_destroy(&this->mutex);
+}
+
+
+/// <summary>
+///   Locks the mutex.  A lock that does not have to wait is counted as a
+///   wait of 0, so the wait histogram holds every lock.
+/// </summary>
+void ProfiledMutex::Lock(void) {
+
+  if(pthread_mutex_trylock(&this->mutex) == 0) {
+    this->acquired = LatencyHistogram::NowMicros();
+    this->site->wait.Record(0);
+    return;
+  }
+
+  unsigned long long start = LatencyHistogram::NowMicros();
+  pthread_mutex_lock(&this->mutex);
+  this->acquired = LatencyHistogram::NowMicros();
+  __sync_fetch_and_add(&this->site->contended, 1);
+  this->site->wait.Record(this->acquired - start);
+
+}
+
+
+/// <summary>
+///   Unlocks the mutex.  The hold is recorded after unlocking, so that
+///   recording it does not keep other threads waiting.
+/// </summary>
+void ProfiledMutex::Unlock(void) {
+
+  unsigned long long held = LatencyHistogram::NowMicros() - this->acquired;
+  pthread_mutex_unlock(&this->mutex);
+  this->site->hold.Record(held);
+
+}
+
+
+/// <summary>
+///   Waits on a condition variable, unlocking the mutex meanwhile.
+/// </summary>
+void ProfiledMutex::Wait(pthread_cond_t *cond) {
+
+  this->site->hold.RecordSince(this->acquired);
+  pthread_cond_wait(cond, &this->mutex);
+  this->acquired = LatencyHistogram::NowMicros();
+
+}
+
+
+/// <summary>
+///   Waits on a condition variable until an absolute time, unlocking the mutex
+///   meanwhile.
+/// </summary>
+int ProfiledMutex::TimedWait(pthread_cond_t *cond,
+    const struct timespec *until) {
+
+  this->site->hold.RecordSince(this->acquired);
+  int result = pthread_cond_timedwait(cond, &this->mutex, until);
+  this->acquired = LatencyHistogram::NowMicros();
+
+  return result;
+
+}
+
+
+/// <summary>
+///   Writes the counters of every name as Prometheus metrics.
+/// </summary>
+void ProfiledMutex::WriteMetrics(std::ostream &out) {
+
+  // Sites are only ever added at the head, so the list from the head taken
+  //   here on does not change.
+  lockSite *first;
+  pthread_mutex_lock(&ProfiledMutex::sitesMutex); {
+    first = ProfiledMutex::sites;
+  } pthread_mutex_unlock(&ProfiledMutex::sitesMutex);
+
+  out << "# HELP spreadsheet_lock_acquisitions_total Times each lock was "
+      << "locked.\n";
+  out << "# TYPE spreadsheet_lock_acquisitions_total counter\n";
+  for(lockSite *site = first; site != NULL; site = site->next)
+    out << "spreadsheet_lock_acquisitions_total{lock=\"" << site->name
+        << "\"} " << site->wait.Count() << "\n";
+
+  out << "# HELP spreadsheet_lock_contended_total Times each lock had to wait "
+      << "for another thread.\n";
+  out << "# TYPE spreadsheet_lock_contended_total counter\n";
+  for(lockSite *site = first; site != NULL; site = site->next)
+    out << "spreadsheet_lock_contended_total{lock=\"" << site->name << "\"} "
+        << *(volatile unsigned long long *)&site->contended << "\n";
+
+  out << "# HELP spreadsheet_lock_wait_seconds Time spent waiting for each "
+      << "lock.\n";
+  out << "# TYPE spreadsheet_lock_wait_seconds histogram\n";
+  for(lockSite *site = first; site != NULL; site = site->next)
+    site->wait.Write(out, "spreadsheet_lock_wait_seconds",
+        std::string("lock=\"") + site->name + "\"");
+
+  out << "# HELP spreadsheet_lock_hold_seconds Time each lock was held.\n";
+  out << "# TYPE spreadsheet_lock_hold_seconds histogram\n";
+  for(lockSite *site = first; site != NULL; site = site->next)
+    site->hold.Write(out, "spreadsheet_lock_hold_seconds",
+        std::string("lock=\"") + site->name + "\"");
+
+}
+
+
+/// <summary>
+///   Writes the wait and hold percentiles of every name, one line each.
+/// </summary>
+void ProfiledMutex::WriteReport(std::ostream &out) {
+
+  lockSite *first;
+  pthread_mutex_lock(&ProfiledMutex::sitesMutex); {
+    first = ProfiledMutex::sites;
+  } pthread_mutex_unlock(&ProfiledMutex::sitesMutex);
+
+  for(lockSite *site = first; site != NULL; site = site->next) {
+    out << "lock " << site->name << " wait ";
+    site->wait.WritePercentiles(out);
+    out << " contended "
+        << *(volatile unsigned long long *)&site->contended << "\n";
+    out << "lock " << site->name << " hold ";
+    site->hold.WritePercentiles(out);
+    out << "\n";
+  }
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Gets the site of a name, creating it the first time.
+/// </summary>
+ProfiledMutex::lockSite * ProfiledMutex::findSite(const char *name) {
+
+  lockSite *site;
+  pthread_mutex_lock(&ProfiledMutex::sitesMutex); {
+    for(site = ProfiledMutex::sites; site != NULL; site = site->next)
+      if(strcmp(site->name, name) == 0)
+        break;
+
+    if(site == NULL) {
+      site = new lockSite;
+      site->name = name;
+      site->contended = 0;
+      site->next = ProfiledMutex::sites;
+      ProfiledMutex::sites = site;
+    }
+  } pthread_mutex_unlock(&ProfiledMutex::sitesMutex);
+
+  return site;
+
+}
+
+#endif
@@ -0,0 +1,239 @@
+/*******************************************************************************
+  File: ProfiledMutex.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ProfiledMutex.h file.
+  - Added ProfiledMutex class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __PROFILEDMUTEX_H__
+#define __PROFILEDMUTEX_H__
+
+
+//
+// Multithreading library.
+//
+#include <pthread.h>
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <ostream>
+
+//
+// Clock library.
+//
+#include <time.h>
+
+#ifdef LOCK_PROFILING
+//
+// LatencyHistogram.
+//
+#include "LatencyHistogram.h"
+#endif
+
+
+/// <summary>
+///   A mutex with a name, such as "session.cells", shared by every mutex that
+///   guards the same thing.
+/// </summary>
+/// <remarks>
+///   When the program is built with LOCK_PROFILING defined, each name keeps
+///   how often its mutexes were locked, how often a thread had to wait for
+///   one, and histograms of how long threads waited and how long they held
+///   them, so that lock convoys can be found.  Without it, the methods are
+///   inline calls to pthread and the name is not kept, so the mutex costs
+///   the same as a pthread_mutex_t.  Every file must be built with the same
+///   setting.
+/// </remarks>
+class ProfiledMutex {
+
+private:
+
+#ifdef LOCK_PROFILING
+  /// <summary>
+  ///   The counters of every mutex with the same name.
+  /// </summary>
+  typedef struct lockSite {
+    const char *name;             // The name of the mutexes.
+    LatencyHistogram wait;        // How long each lock waited, 0 if it did
+                                  //   not have to.
+    LatencyHistogram hold;        // How long each lock was held.
+    unsigned long long contended; // The number of locks that had to wait.
+    lockSite *next;               // The site created before this one.
+  } lockSite;
+
+
+  /// <summary>
+  ///   The sites of every name, newest first.  Sites are never freed.
+  /// </summary>
+  static lockSite *sites;
+
+
+  /// <summary>
+  ///   Guards the list of sites.
+  /// </summary>
+  static pthread_mutex_t sitesMutex;
+
+
+  /// <summary>
+  ///   The site of this mutex.
+  /// </summary>
+  lockSite *site;
+
+
+  /// <summary>
+  ///   When the thread holding the mutex locked it, in microseconds.
+  /// </summary>
+  unsigned long long acquired;
+#endif
+
+
+  /// <summary>
+  ///   The mutex.
+  /// </summary>
+  pthread_mutex_t mutex;
+
+
+  /// <summary>
+  ///   Copy constructor.  Mutexes cannot be copied; a class that holds one
+  ///   creates its own in its copy constructor.
+  /// </summary>
+  ProfiledMutex(const ProfiledMutex &);
+
+
+  /// <summary>
+  ///   Assignment operator.  Mutexes cannot be assigned.
+  /// </summary>
+  ProfiledMutex & operator=(const ProfiledMutex &);
+
+
+public:
+
+  /// <summary>
+  ///   Creates an unlocked mutex.
+  /// </summary>
+  /// <param name="name">
+  ///   The name of what the mutex guards.  Must outlive the program, such as
+  ///   a string literal.
+  /// </param>
+  ProfiledMutex(const char *name);
+
+
+  /// <summary>
+  ///   Destructor.
+  /// </summary>
+  ~ProfiledMutex();
+
+
+  /// <summary>
+  ///   Locks the mutex, waiting for it if another thread holds it.
+  /// </summary>
+  void Lock(void);
+
+
+  /// <summary>
+  ///   Unlocks the mutex.
+  /// </summary>
+  void Unlock(void);
+
+
+  /// <summary>
+  ///   Waits on a condition variable, unlocking the mutex meanwhile.  The
+  ///   time spent waiting does not count as held.
+  /// </summary>
+  void Wait(pthread_cond_t *cond);
+
+
+  /// <summary>
+  ///   Waits on a condition variable until an absolute time on the realtime
+  ///   clock, unlocking the mutex meanwhile.
+  /// </summary>
+  /// <returns>The result of pthread_cond_timedwait.</returns>
+  int TimedWait(pthread_cond_t *cond, const struct timespec *until);
+
+
+  /// <summary>
+  ///   Writes the counters of every name as Prometheus metrics.  Writes
+  ///   nothing unless LOCK_PROFILING is defined.
+  /// </summary>
+  static void WriteMetrics(std::ostream &out);
+
+
+  /// <summary>
+  ///   Writes the wait and hold percentiles of every name, one line each,
+  ///   such as "lock session.cells wait count 12 p50 ...".  Writes nothing
+  ///   unless LOCK_PROFILING is defined.
+  /// </summary>
+  static void WriteReport(std::ostream &out);
+
+
+#ifdef LOCK_PROFILING
+private:
+
+  /// <summary>
+  ///   Gets the site of a name, creating it the first time.
+  /// </summary>
+  static lockSite * findSite(const char *name);
+#endif
+
+};
+
+
+#ifndef LOCK_PROFILING
+/*******************************************************************************
+  Inline methods, without profiling.
+*******************************************************************************/
+
+
+inline ProfiledMutex::ProfiledMutex(const char *) {
+  pthread_mutex_init(&this->mutex, NULL);
+}
+
+
+inline ProfiledMutex::~ProfiledMutex() {
+  pthread_mutex_destroy(&this->mutex);
+}
+
+
+inline void ProfiledMutex::Lock(void) {
+  pthread_mutex_lock(&this->mutex);
+}
+
+
+inline void ProfiledMutex::Unlock(void) {
+  pthread_mutex_unlock(&this->mutex);
+}
+
+
+inline void ProfiledMutex::Wait(pthread_cond_t *cond) {
+  pthread_cond_wait(cond, &this->mutex);
+}
+
+
+inline int ProfiledMutex::TimedWait(pthread_cond_t *cond,
+    const struct timespec *until) {
+  return pthread_cond_timedwait(cond, &this->mutex, until);
+}
+
+
+inline void ProfiledMutex::WriteMetrics(std::ostream &) {
+}
+
+
+inline void ProfiledMutex::WriteReport(std::ostream &) {
+}
+#endif
+
+
+#endif
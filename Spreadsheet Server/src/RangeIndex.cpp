@@ -0,0 +1,173 @@
+/*******************************************************************************
+  File: RangeIndex.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c RangeIndex.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created RangeIndex.cpp file.
+  - Added RangeIndex class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "RangeIndex.h"
+
+
+//
+// Key of a block by the sizes of its runs, as powers of two, and the index of
+//   each run among the runs of its size.
+//
+#define RI_BLOCK_KEY(rowLevel, colLevel, colIndex, rowIndex) \
+  (((cellKey)(rowLevel) << 40) | ((cellKey)(colLevel) << 35) \
+      | CA_KEY(colIndex, rowIndex))
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Default constructor.
+/// </summary>
+RangeIndex::RangeIndex(void) {
+
+  for(int r = 0; r < RI_ROW_LEVELS; r++)
+    for(int c = 0; c < RI_COL_LEVELS; c++)
+      this->levelUse[r][c] = 0;
+
+}
+
+
+/// <summary>
+///   Replaces the ranges that the formula of a cell reads.
+/// </summary>
+void RangeIndex::Set(cellKey owner, const std::vector<cellRange> &ranges) {
+
+  std::map<cellKey, std::vector<cellRange> >::iterator it =
+      this->owners.find(owner);
+  if(it != this->owners.end()) {
+    for(size_t i = 0; i < it->second.size(); i++)
+      this->update(owner, it->second[i], false);
+    this->owners.erase(it);
+  }
+
+  if(ranges.empty())
+    return;
+
+  for(size_t i = 0; i < ranges.size(); i++)
+    this->update(owner, ranges[i], true);
+  this->owners[owner] = ranges;
+
+}
+
+
+/// <summary>
+///   Gets the ranges that the formula of a cell reads.
+/// </summary>
+void RangeIndex::Get(cellKey owner, std::vector<cellRange> *ranges) const {
+
+  std::map<cellKey, std::vector<cellRange> >::const_iterator it =
+      this->owners.find(owner);
+  if(it == this->owners.end())
+    ranges->clear();
+  else
+    *ranges = it->second;
+
+}
+
+
+/// <summary>
+///   Gets the cells whose formulas read a cell through a range.
+/// </summary>
+void RangeIndex::Find(int col, int row, std::set<cellKey> *readers) const {
+
+  if(this->blocks.empty())
+    return;
+
+  for(int r = 0; r < RI_ROW_LEVELS; r++) {
+    for(int c = 0; c < RI_COL_LEVELS; c++) {
+      if(this->levelUse[r][c] == 0)
+        continue;
+
+      std::map<cellKey, std::multiset<cellKey> >::const_iterator it =
+          this->blocks.find(RI_BLOCK_KEY(r, c, col >> c, row >> r));
+      if(it != this->blocks.end())
+        readers->insert(it->second.begin(), it->second.end());
+    }
+  }
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Lists a range under, or removes it from, each block it is split into.
+/// </summary>
+void RangeIndex::update(cellKey owner, const cellRange &range, bool add) {
+
+  std::vector< std::pair<int, int> > rowRuns;
+  std::vector< std::pair<int, int> > colRuns;
+  split(range.row0, range.row1, RI_ROW_LEVELS, &rowRuns);
+  split(range.col0, range.col1, RI_COL_LEVELS, &colRuns);
+
+  for(size_t r = 0; r < rowRuns.size(); r++) {
+    for(size_t c = 0; c < colRuns.size(); c++) {
+      int rowLevel = rowRuns[r].first;
+      int colLevel = colRuns[c].first;
+      cellKey key = RI_BLOCK_KEY(rowLevel, colLevel, colRuns[c].second,
+          rowRuns[r].second);
+
+      if(add) {
+        this->blocks[key].insert(owner);
+        this->levelUse[rowLevel][colLevel]++;
+      }
+      else {
+        std::map<cellKey, std::multiset<cellKey> >::iterator it =
+            this->blocks.find(key);
+        it->second.erase(it->second.find(owner));
+        if(it->second.empty())
+          this->blocks.erase(it);
+        this->levelUse[rowLevel][colLevel]--;
+      }
+    }
+  }
+
+}
+
+
+/// <summary>
+///   Splits the lines from first to last into the largest aligned runs.  Each
+///   run is the largest one that starts at the first line not yet covered and
+///   ends within the lines.
+/// </summary>
+void RangeIndex::split(int first, int last, int levels,
+    std::vector< std::pair<int, int> > *runs) {
+
+  int line = first;
+  while(line <= last) {
+    int level = 0;
+    while(level + 1 < levels && (line & ((2 << level) - 1)) == 0
+        && line + (2 << level) - 1 <= last)
+      level++;
+
+    runs->push_back(std::make_pair(level, line >> level));
+    line += 1 << level;
+  }
+
+}
@@ -0,0 +1,153 @@
+/*******************************************************************************
+  File: RangeIndex.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created RangeIndex.h file.
+  - Added RangeIndex class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __RANGEINDEX_H__
+#define __RANGEINDEX_H__
+
+
+//
+// Project headers.
+//
+#include "CellAddress.h"
+
+//
+// Standard libraries.
+//
+#include <map>
+#include <set>
+#include <vector>
+
+
+//
+// Number of sizes of block along each axis, from 1 line to every line of the
+//   sheet: 2^20 rows and 2^14 columns.
+//
+#define RI_ROW_LEVELS 21
+#define RI_COL_LEVELS 15
+
+
+/// <summary>
+///   A block of cells, by where they are stored.
+/// </summary>
+typedef struct cellRange {
+  int col0;                   // The first column of the block.
+  int row0;                   // The first row of the block.
+  int col1;                   // The last column of the block.
+  int row1;                   // The last row of the block.
+} cellRange;
+
+
+/// <summary>
+///   Finds the formulas that read a cell through a function range, such as
+///   SUM(A1:A1000000), without listing every cell of the range.
+/// </summary>
+/// <remarks>
+/// <para>
+///   The rows and the columns of each range are each split into at most two
+///   aligned runs of each power of two lines, like the nodes of a segment
+///   tree, and the range is listed under every block that pairs a run of rows
+///   with a run of columns.  A range of a million rows in one column is
+///   listed under about 40 blocks rather than a million cells.  Finding the
+///   readers of a cell looks up the one block of each size that holds it,
+///   skipping the sizes that no range uses, and every reader listed there
+///   covers the cell.
+/// </para>
+/// <para>
+///   Ranges are kept by where cells are stored, so they survive layout
+///   changes the way the keys in the dependency graph do.  The index does no
+///   locking of its own.
+/// </para>
+/// </remarks>
+class RangeIndex {
+
+private:
+
+  /// <summary>
+  ///   The cells that read a range listed under each block that any range is
+  ///   listed under, keyed by the sizes and position of the block.  A cell is
+  ///   listed once for each of its ranges that covers the block.
+  /// </summary>
+  std::map<cellKey, std::multiset<cellKey> > blocks;
+
+
+  /// <summary>
+  ///   The number of listings under blocks of each size, by the size of their
+  ///   runs of rows and of columns.
+  /// </summary>
+  int levelUse[RI_ROW_LEVELS][RI_COL_LEVELS];
+
+
+  /// <summary>
+  ///   The ranges of each cell that reads any.
+  /// </summary>
+  std::map<cellKey, std::vector<cellRange> > owners;
+
+
+public:
+
+  /// <summary>
+  ///   Creates an index that holds no ranges.
+  /// </summary>
+  RangeIndex(void);
+
+
+  /// <summary>
+  ///   Replaces the ranges that the formula of a cell reads.  Each range must
+  ///   be given with its first column and row no later than its last.
+  /// </summary>
+  /// <param name="owner">The cell, by where it is stored.</param>
+  /// <param name="ranges">The ranges, which may be none.</param>
+  void Set(cellKey owner, const std::vector<cellRange> &ranges);
+
+
+  /// <summary>
+  ///   Gets the ranges that the formula of a cell reads.
+  /// </summary>
+  /// <param name="ranges">
+  ///   An output parameter that is replaced by the ranges.
+  /// </param>
+  void Get(cellKey owner, std::vector<cellRange> *ranges) const;
+
+
+  /// <summary>
+  ///   Gets the cells whose formulas read a cell through a range.
+  /// </summary>
+  /// <param name="readers">
+  ///   An output parameter that each cell found is added to.
+  /// </param>
+  void Find(int col, int row, std::set<cellKey> *readers) const;
+
+
+private:
+
+  /// <summary>
+  ///   Lists a range under, or removes it from, each block it is split into.
+  /// </summary>
+  void update(cellKey owner, const cellRange &range, bool add);
+
+
+  /// <summary>
+  ///   Splits the lines from first to last into the largest aligned runs,
+  ///   adding the size and index of each run to runs.
+  /// </summary>
+  static void split(int first, int last, int levels,
+      std::vector< std::pair<int, int> > *runs);
+
+};
+
+
+#endif
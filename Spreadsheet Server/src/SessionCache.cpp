@@ -0,0 +1,181 @@
+/*******************************************************************************
+  File: SessionCache.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -pthread -c SessionCache.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created SessionCache.cpp file.
+  - Added SessionCache class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "SessionCache.h"
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates an empty cache.
+/// </summary>
+SessionCache::SessionCache(size_t budget, int policy)
+    : budget(budget), policy(policy), bytes(0), hits(0), misses(0),
+      evictions(0) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Destructor.  Deletes every cached session.
+/// </summary>
+SessionCache::~SessionCache(void) {
+  this->Clear();
+}
+
+
+/// <summary>
+///   Takes the session of a sheet out of the cache.
+/// </summary>
+SpreadsheetSession * SessionCache::Take(const std::string &name) {
+
+  std::map<std::string, std::list<entry>::iterator>::iterator it =
+      this->byName.find(name);
+  if(it == this->byName.end()) {
+    this->misses++;
+    return NULL;
+  }
+
+  SpreadsheetSession *session = it->second->session;
+  this->bytes -= it->second->bytes;
+  this->entries.erase(it->second);
+  this->byName.erase(it);
+  this->hits++;
+
+  return session;
+
+}
+
+
+/// <summary>
+///   Adds a saved session that no client is connected to.
+/// </summary>
+void SessionCache::Put(SpreadsheetSession *session) {
+
+  entry added;
+  added.session = session;
+  added.bytes = session->Shrink();
+
+  if(added.bytes > this->budget || this->byName.count(session->GetName())) {
+    delete session;
+    this->evictions++;
+    return;
+  }
+
+  while(this->bytes + added.bytes > this->budget)
+    this->evict();
+
+  this->entries.push_back(added);
+  this->byName[session->GetName()] = --this->entries.end();
+  this->bytes += added.bytes;
+
+}
+
+
+/// <summary>
+///   Deletes every cached session.
+/// </summary>
+void SessionCache::Clear(void) {
+
+  for(std::list<entry>::iterator it = this->entries.begin();
+      it != this->entries.end(); it++)
+    delete it->session;
+
+  this->entries.clear();
+  this->byName.clear();
+  this->bytes = 0;
+
+}
+
+
+/// <summary>
+///   Gets the number of cached sessions.
+/// </summary>
+size_t SessionCache::Count(void) const {
+  return this->entries.size();
+}
+
+
+/// <summary>
+///   Gets the number of bytes held by the cached sessions.
+/// </summary>
+size_t SessionCache::Bytes(void) const {
+  return this->bytes;
+}
+
+
+/// <summary>
+///   Gets the number of sheets opened from the cache.
+/// </summary>
+unsigned long long SessionCache::Hits(void) const {
+  return this->hits;
+}
+
+
+/// <summary>
+///   Gets the number of sheets that had to be loaded.
+/// </summary>
+unsigned long long SessionCache::Misses(void) const {
+  return this->misses;
+}
+
+
+/// <summary>
+///   Gets the number of sessions deleted to keep to the budget.
+/// </summary>
+unsigned long long SessionCache::Evictions(void) const {
+  return this->evictions;
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Deletes the session that the policy picks.
+/// </summary>
+void SessionCache::evict(void) {
+
+  std::list<entry>::iterator victim = this->entries.begin();
+  if(this->policy == SC_EVICT_LARGEST) {
+    for(std::list<entry>::iterator it = this->entries.begin();
+        it != this->entries.end(); it++) {
+      if(it->bytes > victim->bytes)
+        victim = it;
+    }
+  }
+
+  this->byName.erase(victim->session->GetName());
+  this->bytes -= victim->bytes;
+  delete victim->session;
+  this->entries.erase(victim);
+  this->evictions++;
+
+}
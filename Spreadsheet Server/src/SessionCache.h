@@ -0,0 +1,222 @@
+/*******************************************************************************
+  File: SessionCache.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created SessionCache.h file.
+  - Added SessionCache class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __SESSIONCACHE_H__
+#define __SESSIONCACHE_H__
+
+
+//
+// Project headers.
+//
+#include "SpreadsheetSession.h"
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <list>
+#include <map>
+#include <string>
+
+
+//
+// Eviction policies.
+//
+#define SC_EVICT_LRU     0    // Evicts the session closed longest ago.
+#define SC_EVICT_LARGEST 1    // Evicts the session holding the most memory.
+
+//
+// Number of bytes of closed sessions kept by default.
+//
+#define SC_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+
+/// <summary>
+///   Keeps sessions that no client is connected to in memory, so that the
+///   next client to open the sheet does not have to load it again.
+/// </summary>
+/// <remarks>
+/// <para>
+///   Sessions are added once their last client leaves and they have been
+///   saved, so the cache never holds an edit that is not on disk, and evicting
+///   a session is just deleting it.  Each session is shrunk as it is added,
+///   and counted against the budget by the memory it still holds.  Sessions
+///   are evicted until the cache fits its budget again, either the one closed
+///   longest ago first or the largest first.
+/// </para>
+/// <para>
+///   The cache does no locking of its own.  The server only uses it while
+///   holding the lock of its open sheets, so a sheet is never both open and
+///   cached.
+/// </para>
+/// </remarks>
+class SessionCache {
+
+private:
+
+  /// <summary>
+  ///   A closed session and the memory it holds.
+  /// </summary>
+  typedef struct entry {
+    SpreadsheetSession *session;  // The closed session.
+    size_t bytes;                 // The memory the session holds.
+  } entry;
+
+
+  /// <summary>
+  ///   The number of bytes of sessions allowed in the cache.
+  /// </summary>
+  size_t budget;
+
+
+  /// <summary>
+  ///   The SC_EVICT_ policy used to pick the session to evict.
+  /// </summary>
+  int policy;
+
+
+  /// <summary>
+  ///   The cached sessions, the one closed longest ago first.
+  /// </summary>
+  std::list<entry> entries;
+
+
+  /// <summary>
+  ///   The position of each cached session in the list, by sheet name.
+  /// </summary>
+  std::map<std::string, std::list<entry>::iterator> byName;
+
+
+  /// <summary>
+  ///   The number of bytes held by the cached sessions.
+  /// </summary>
+  size_t bytes;
+
+
+  /// <summary>
+  ///   The number of sheets opened from the cache.
+  /// </summary>
+  unsigned long long hits;
+
+
+  /// <summary>
+  ///   The number of sheets that had to be loaded.
+  /// </summary>
+  unsigned long long misses;
+
+
+  /// <summary>
+  ///   The number of sessions deleted to keep to the budget.
+  /// </summary>
+  unsigned long long evictions;
+
+
+  /// <summary>
+  ///   Copy constructor.  Caches cannot be copied.
+  /// </summary>
+  SessionCache(const SessionCache &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Caches cannot be copied.
+  /// </summary>
+  SessionCache & operator=(const SessionCache &other);
+
+
+public:
+
+  /// <summary>
+  ///   Creates an empty cache.
+  /// </summary>
+  /// <param name="budget">
+  ///   The number of bytes of sessions to keep.  A budget of 0 keeps none.
+  /// </param>
+  /// <param name="policy">The SC_EVICT_ policy.</param>
+  SessionCache(size_t budget, int policy);
+
+
+  /// <summary>
+  ///   Destructor.  Deletes every cached session.
+  /// </summary>
+  ~SessionCache(void);
+
+
+  /// <summary>
+  ///   Takes the session of a sheet out of the cache, counting a hit if it
+  ///   was there and a miss if not.
+  /// </summary>
+  /// <returns>
+  ///   The session, which the caller now owns, or NULL if it was not cached.
+  /// </returns>
+  SpreadsheetSession * Take(const std::string &name);
+
+
+  /// <summary>
+  ///   Adds a saved session that no client is connected to, evicting
+  ///   sessions until the cache fits its budget.  The cache owns the session
+  ///   from then on, and deletes it right away if it does not fit at all.
+  /// </summary>
+  void Put(SpreadsheetSession *session);
+
+
+  /// <summary>
+  ///   Deletes every cached session.
+  /// </summary>
+  void Clear(void);
+
+
+  /// <summary>
+  ///   Gets the number of cached sessions.
+  /// </summary>
+  size_t Count(void) const;
+
+
+  /// <summary>
+  ///   Gets the number of bytes held by the cached sessions.
+  /// </summary>
+  size_t Bytes(void) const;
+
+
+  /// <summary>
+  ///   Gets the number of sheets opened from the cache.
+  /// </summary>
+  unsigned long long Hits(void) const;
+
+
+  /// <summary>
+  ///   Gets the number of sheets that had to be loaded.
+  /// </summary>
+  unsigned long long Misses(void) const;
+
+
+  /// <summary>
+  ///   Gets the number of sessions deleted to keep to the budget.
+  /// </summary>
+  unsigned long long Evictions(void) const;
+
+
+private:
+
+  /// <summary>
+  ///   Deletes the session that the policy picks.
+  /// </summary>
+  void evict(void);
+
+};
+
+
+#endif
@@ -0,0 +1,92 @@
+/*******************************************************************************
+  File: ShardedCounter.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c ShardedCounter.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ShardedCounter.cpp file.
+  - Added ShardedCounter class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "ShardedCounter.h"
+
+
+//
+// The shard of each thread, or COUNTER_SHARDS before it is given one.
+//
+static __thread unsigned int threadShard = COUNTER_SHARDS;
+
+//
+// The number of threads given a shard so far.
+//
+static unsigned int threadsSeen = 0;
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates a counter at zero.
+/// </summary>
+ShardedCounter::ShardedCounter(void) {
+
+  for(int i = 0; i < COUNTER_SHARDS; i++)
+    this->shards[i].value = 0;
+
+}
+
+
+/// <summary>
+///   Adds to the count.
+/// </summary>
+void ShardedCounter::Add(unsigned long long amount) {
+  __sync_fetch_and_add(&this->shards[ShardedCounter::index()].value, amount);
+}
+
+
+/// <summary>
+///   Gets the count.
+/// </summary>
+unsigned long long ShardedCounter::Sum(void) const {
+
+  unsigned long long sum = 0;
+  for(int i = 0; i < COUNTER_SHARDS; i++)
+    sum += ((const volatile shard *)&this->shards[i])->value;
+
+  return sum;
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Gets the shard of the calling thread, giving it the next one if it has
+///   none yet.
+/// </summary>
+unsigned int ShardedCounter::index(void) {
+
+  if(threadShard == COUNTER_SHARDS)
+    threadShard = __sync_fetch_and_add(&threadsSeen, 1) & (COUNTER_SHARDS - 1);
+
+  return threadShard;
+
+}
@@ -0,0 +1,105 @@
+/*******************************************************************************
+  File: ShardedCounter.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ShardedCounter.h file.
+  - Added ShardedCounter class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __SHARDEDCOUNTER_H__
+#define __SHARDEDCOUNTER_H__
+
+
+//
+// Number of shards of a counter.  Must be a power of two.
+//
+#define COUNTER_SHARDS 16
+
+//
+// Size of a cache line, which each shard is padded to.
+//
+#define COUNTER_LINE_BYTES 64
+
+
+/// <summary>
+///   A counter that many threads add to at once.
+/// </summary>
+/// <remarks>
+///   The count is split into shards, each on its own cache line.  Every thread
+///   is given a shard the first time it counts anything, round robin, and only
+///   ever adds to that one, so threads seldom touch the same cache line and
+///   adding is an uncontended atomic add.  Reading the count sums the shards,
+///   which is slower, but only done when the counters are reported.
+/// </remarks>
+class ShardedCounter {
+
+private:
+
+  /// <summary>
+  ///   A part of the count, alone on its cache line.
+  /// </summary>
+  typedef struct shard {
+    unsigned long long value;     // The part of the count.
+    char padding[COUNTER_LINE_BYTES - sizeof(unsigned long long)];
+  } shard;
+
+
+  /// <summary>
+  ///   The parts of the count.
+  /// </summary>
+  shard shards[COUNTER_SHARDS] __attribute__((aligned(COUNTER_LINE_BYTES)));
+
+
+  /// <summary>
+  ///   Copy constructor.  Counters cannot be copied.
+  /// </summary>
+  ShardedCounter(const ShardedCounter &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Counters cannot be copied.
+  /// </summary>
+  ShardedCounter & operator=(const ShardedCounter &other);
+
+
+public:
+
+  /// <summary>
+  ///   Creates a counter at zero.
+  /// </summary>
+  ShardedCounter(void);
+
+
+  /// <summary>
+  ///   Adds to the count.
+  /// </summary>
+  void Add(unsigned long long amount);
+
+
+  /// <summary>
+  ///   Gets the count.  Amounts being added at the same time may or may not be
+  ///   included.
+  /// </summary>
+  unsigned long long Sum(void) const;
+
+
+private:
+
+  /// <summary>
+  ///   Gets the shard of the calling thread.
+  /// </summary>
+  static unsigned int index(void);
+
+};
+
+
+#endif
@@ -0,0 +1,334 @@
+/*******************************************************************************
+  File: SnapshotStream.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -pthread -c SnapshotStream.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created SnapshotStream.cpp file.
+  - Added SheetSnapshot and SnapshotStream class implementations.
+  - Moved chunking into SheetSnapshot and added compressed chunks.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "SnapshotStream.h"
+
+//
+// Project headers.
+//
+#include "MessageCodec.h"
+
+
+/*******************************************************************************
+  SheetSnapshot methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates a snapshot holding one reference for the caller.
+/// </summary>
+SheetSnapshot::SheetSnapshot(const std::string &text, size_t cells,
+    unsigned long long version)
+    : text(text), cells(cells), version(version), refs(1) {
+
+  pthread_mutex_init(&this->mutex, NULL);
+
+  // End each chunk at the last message that fits, or after the first message
+  //   if even that does not fit.
+  size_t start = 0;
+  while(start < this->text.size()) {
+    this->chunks.push_back(start);
+
+    size_t end = start + SNS_CHUNK_SIZE;
+    if(end >= this->text.size())
+      break;
+    size_t br = this->text.rfind('\n', end);
+    if(br == std::string::npos || br < start)
+      br = this->text.find('\n', end);
+    if(br == std::string::npos)
+      break;
+    start = br + 1;
+  }
+
+  this->deflated.resize(this->chunks.size());
+  this->tried.resize(this->chunks.size(), false);
+
+}
+
+
+/// <summary>
+///   Destructor.
+/// </summary>
+SheetSnapshot::~SheetSnapshot(void) {
+  pthread_mutex_destroy(&this->mutex);
+}
+
+
+/// <summary>
+///   Gets the cell messages, separated by single newlines.
+/// </summary>
+const std::string & SheetSnapshot::Text(void) const {
+  return this->text;
+}
+
+
+/// <summary>
+///   Gets the number of cell messages.
+/// </summary>
+size_t SheetSnapshot::Cells(void) const {
+  return this->cells;
+}
+
+
+/// <summary>
+///   Gets the version of the sheet the snapshot was taken at.
+/// </summary>
+unsigned long long SheetSnapshot::Version(void) const {
+  return this->version;
+}
+
+
+/// <summary>
+///   Gets the number of chunks the text is sent in.
+/// </summary>
+size_t SheetSnapshot::ChunkCount(void) const {
+  return this->chunks.size();
+}
+
+
+/// <summary>
+///   Gets the cell messages of a chunk as one message.
+/// </summary>
+std::string SheetSnapshot::Chunk(size_t index, bool compress) {
+
+  // Every chunk but the last ends just before the newline ahead of the next.
+  size_t start = this->chunks[index];
+  size_t end = index + 1 < this->chunks.size() ? this->chunks[index + 1] - 1
+      : this->text.size();
+  std::string chunk = this->text.substr(start, end - start);
+  if(!compress)
+    return chunk;
+
+  std::string framed;
+  pthread_mutex_lock(&this->mutex); {
+    if(!this->tried[index]) {
+      this->tried[index] = true;
+      CompressMessage(chunk, &this->deflated[index]);
+    }
+    framed = this->deflated[index];
+  } pthread_mutex_unlock(&this->mutex);
+
+  return framed.empty() ? chunk : framed;
+
+}
+
+
+/// <summary>
+///   Adds a reference to the snapshot.
+/// </summary>
+void SheetSnapshot::Retain(void) {
+  __sync_add_and_fetch(&this->refs, 1);
+}
+
+
+/// <summary>
+///   Removes a reference to the snapshot, deleting it with the last one.
+/// </summary>
+void SheetSnapshot::Release(void) {
+  if(__sync_sub_and_fetch(&this->refs, 1) == 0)
+    delete this;
+}
+
+
+/*******************************************************************************
+  SnapshotStream methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Sends the header to the client and begins streaming the snapshot after
+///   it.
+/// </summary>
+SnapshotStream * SnapshotStream::Start(StringSocket *client,
+    const std::string &header, SheetSnapshot *snapshot, bool compress) {
+
+  SnapshotStream *stream = new SnapshotStream(client, snapshot, compress);
+
+  pthread_mutex_lock(&stream->mutex); {
+    client->BeginSend(header, SnapshotStream::messageSent, NULL);
+    stream->sendNext();
+  } pthread_mutex_unlock(&stream->mutex);
+
+  return stream;
+
+}
+
+
+/// <summary>
+///   Sends a message to the client once the snapshot has been sent.
+/// </summary>
+void SnapshotStream::Send(const std::string &message) {
+
+  pthread_mutex_lock(&this->mutex); {
+    if(this->client != NULL) {
+      if(this->snapshot != NULL)
+        this->pending.push_back(message);
+      else
+        this->client->BeginSend(message, SnapshotStream::messageSent, NULL);
+    }
+  } pthread_mutex_unlock(&this->mutex);
+
+}
+
+
+/// <summary>
+///   Gets whether the whole snapshot and every held back message have been
+///   sent, or the client failed.
+/// </summary>
+bool SnapshotStream::IsFinished(void) {
+
+  bool finished;
+  pthread_mutex_lock(&this->mutex); {
+    finished = this->client == NULL || this->snapshot == NULL;
+  } pthread_mutex_unlock(&this->mutex);
+
+  return finished;
+
+}
+
+
+/// <summary>
+///   Stops the stream and gives up the reference of the owner.
+/// </summary>
+void SnapshotStream::Close(void) {
+
+  pthread_mutex_lock(&this->mutex); {
+    this->client = NULL;
+    this->pending.clear();
+  } pthread_mutex_unlock(&this->mutex);
+
+  this->release();
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates a stream of a snapshot to a client, holding one reference for
+///   the owner.
+/// </summary>
+SnapshotStream::SnapshotStream(StringSocket *client, SheetSnapshot *snapshot,
+    bool compress)
+    : refs(1), client(client), snapshot(snapshot), next(0), compress(compress) {
+  pthread_mutex_init(&this->mutex, NULL);
+  snapshot->Retain();
+}
+
+
+/// <summary>
+///   Destructor.
+/// </summary>
+SnapshotStream::~SnapshotStream(void) {
+
+  if(this->snapshot != NULL)
+    this->snapshot->Release();
+
+  pthread_mutex_destroy(&this->mutex);
+
+}
+
+
+/// <summary>
+///   Queues the next chunk of the snapshot, or the held back messages once
+///   the snapshot is finished.
+/// </summary>
+void SnapshotStream::sendNext(void) {
+
+  if(this->client == NULL || this->snapshot == NULL)
+    return;
+
+  if(this->next < this->snapshot->ChunkCount()) {
+
+    // The chunk holds a reference until its callback.
+    this->refs++;
+    this->client->BeginSend(this->snapshot->Chunk(this->next++, this->compress),
+        SnapshotStream::chunkSent, this);
+    return;
+
+  }
+
+
+  // The snapshot has been sent, so the held back messages follow it.
+  this->snapshot->Release();
+  this->snapshot = NULL;
+  for(size_t i = 0; i < this->pending.size(); i++)
+    this->client->BeginSend(this->pending[i], SnapshotStream::messageSent,
+        NULL);
+  this->pending.clear();
+
+}
+
+
+/// <summary>
+///   Removes a reference, deleting the stream with the last one.
+/// </summary>
+void SnapshotStream::release(void) {
+
+  int refs;
+  pthread_mutex_lock(&this->mutex); {
+    refs = --this->refs;
+  } pthread_mutex_unlock(&this->mutex);
+
+  if(refs == 0)
+    delete this;
+
+}
+
+
+/// <summary>
+///   Send callback for a chunk.  Queues the next one.
+/// </summary>
+void SnapshotStream::chunkSent(int ex, void *payload) {
+
+  SnapshotStream *stream = static_cast<SnapshotStream *>(payload);
+
+  pthread_mutex_lock(&stream->mutex); {
+
+    // A client that failed is not sent anything more.
+    if(ex != SS_NO_EXCEPTION) {
+      stream->client = NULL;
+      stream->pending.clear();
+    }
+    else
+      stream->sendNext();
+
+  } pthread_mutex_unlock(&stream->mutex);
+
+  stream->release();
+
+}
+
+
+/// <summary>
+///   Send callback for the header and held back messages.  Does nothing.
+/// </summary>
+void SnapshotStream::messageSent(int ex, void *payload) {
+  //
+  // Do nothing.
+  //
+}
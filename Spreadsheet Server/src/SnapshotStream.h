@@ -0,0 +1,355 @@
+/*******************************************************************************
+  File: SnapshotStream.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created SnapshotStream.h file.
+  - Added SheetSnapshot and SnapshotStream class declarations.
+  - Added documentation.
+  - Moved chunking into SheetSnapshot and added compressed chunks.
+*******************************************************************************/
+
+
+#ifndef __SNAPSHOTSTREAM_H__
+#define __SNAPSHOTSTREAM_H__
+
+
+//
+// Project headers.
+//
+#include "StringSocket.h"
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//
+// Threading library.
+//
+#include <pthread.h>
+
+
+//
+// Largest number of bytes of a snapshot sent to a client in one message.
+//
+#define SNS_CHUNK_SIZE 65536
+
+
+/// <summary>
+///   The "cell" messages for every cell of a sheet at one version.  A
+///   snapshot never changes once it is built, so it can be read without a
+///   lock by every client it is streamed to.
+/// </summary>
+/// <remarks>
+/// <para>
+///   The text is split into chunks of whole cell messages of at most
+///   SNS_CHUNK_SIZE bytes.  A compressed chunk is built the first time a
+///   client that takes compressed messages asks for it, and is then shared
+///   by every such client.
+/// </para>
+/// <para>
+///   Snapshots are reference counted, since a stream can outlive the sheet
+///   moving on to a later snapshot.  The count is changed atomically, as the
+///   session and its streams hold references under different locks.
+/// </para>
+/// </remarks>
+class SheetSnapshot {
+
+private:
+
+  /// <summary>
+  ///   The cell messages, separated by single newlines.
+  /// </summary>
+  const std::string text;
+
+
+  /// <summary>
+  ///   The number of cell messages in the text.
+  /// </summary>
+  const size_t cells;
+
+
+  /// <summary>
+  ///   The version of the sheet the snapshot was taken at.
+  /// </summary>
+  const unsigned long long version;
+
+
+  /// <summary>
+  ///   The offset in the text of the start of each chunk.
+  /// </summary>
+  std::vector<size_t> chunks;
+
+
+  /// <summary>
+  ///   The compressed message of each chunk, or an empty string if it has not
+  ///   been built or does not save anything.
+  /// </summary>
+  std::vector<std::string> deflated;
+
+
+  /// <summary>
+  ///   Whether each compressed chunk has been built.
+  /// </summary>
+  std::vector<bool> tried;
+
+
+  /// <summary>
+  ///   Guards the compressed chunks.
+  /// </summary>
+  pthread_mutex_t mutex;
+
+
+  /// <summary>
+  ///   The number of references held to the snapshot.
+  /// </summary>
+  int refs;
+
+
+  /// <summary>
+  ///   Destructor.  Snapshots are deleted by their last Release.
+  /// </summary>
+  ~SheetSnapshot(void);
+
+
+  /// <summary>
+  ///   Copy constructor.  Snapshots cannot be copied.
+  /// </summary>
+  SheetSnapshot(const SheetSnapshot &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Snapshots cannot be copied.
+  /// </summary>
+  SheetSnapshot & operator=(const SheetSnapshot &other);
+
+
+public:
+
+  /// <summary>
+  ///   Creates a snapshot holding one reference for the caller.
+  /// </summary>
+  SheetSnapshot(const std::string &text, size_t cells,
+      unsigned long long version);
+
+
+  /// <summary>
+  ///   Gets the cell messages, separated by single newlines.
+  /// </summary>
+  const std::string & Text(void) const;
+
+
+  /// <summary>
+  ///   Gets the number of cell messages.
+  /// </summary>
+  size_t Cells(void) const;
+
+
+  /// <summary>
+  ///   Gets the version of the sheet the snapshot was taken at.
+  /// </summary>
+  unsigned long long Version(void) const;
+
+
+  /// <summary>
+  ///   Gets the number of chunks the text is sent in.
+  /// </summary>
+  size_t ChunkCount(void) const;
+
+
+  /// <summary>
+  ///   Gets the cell messages of a chunk as one message.
+  /// </summary>
+  /// <param name="compress">
+  ///   Whether the chunk may be sent as a compressed "deflate" message.
+  /// </param>
+  std::string Chunk(size_t index, bool compress);
+
+
+  /// <summary>
+  ///   Adds a reference to the snapshot.
+  /// </summary>
+  void Retain(void);
+
+
+  /// <summary>
+  ///   Removes a reference to the snapshot, deleting it with the last one.
+  /// </summary>
+  void Release(void);
+
+};
+
+
+/// <summary>
+///   Sends a snapshot to a joining client a chunk at a time, holding back
+///   the messages for later versions until the whole snapshot has been sent.
+/// </summary>
+/// <remarks>
+/// <para>
+///   The snapshot is sent one chunk at a time, compressed if the client takes
+///   compressed messages.  The next chunk is only queued once the socket has
+///   sent the one before, so a large sheet neither fills the send queue of
+///   the client nor holds the locks of the session while it is copied.
+/// </para>
+/// <para>
+///   Messages sent to the stream before the snapshot is finished are queued
+///   and sent in order right after it, so the client sees the sheet at the
+///   version of the snapshot and then every edit after it.  Once finished,
+///   messages are sent straight to the client.
+/// </para>
+/// <para>
+///   The stream is shared by its owner and the chunk being sent, and is
+///   deleted once both have let go of it.  After its owner closes it, the
+///   stream never touches the client again, so the client may then be freed
+///   while a chunk callback is still pending.
+/// </para>
+/// </remarks>
+class SnapshotStream {
+
+private:
+
+  /// <summary>
+  ///   Guards every member below.
+  /// </summary>
+  pthread_mutex_t mutex;
+
+
+  /// <summary>
+  ///   The number of references held by the owner and the chunk being sent.
+  /// </summary>
+  int refs;
+
+
+  /// <summary>
+  ///   The client, or NULL once the stream is closed or the client failed.
+  /// </summary>
+  StringSocket *client;
+
+
+  /// <summary>
+  ///   The snapshot being sent, or NULL once all of it has been sent.
+  /// </summary>
+  SheetSnapshot *snapshot;
+
+
+  /// <summary>
+  ///   The index of the next chunk of the snapshot.
+  /// </summary>
+  size_t next;
+
+
+  /// <summary>
+  ///   Whether chunks are sent compressed.
+  /// </summary>
+  bool compress;
+
+
+  /// <summary>
+  ///   The messages held back until the snapshot has been sent.
+  /// </summary>
+  std::vector<std::string> pending;
+
+
+  /// <summary>
+  ///   Creates a stream of a snapshot to a client.
+  /// </summary>
+  SnapshotStream(StringSocket *client, SheetSnapshot *snapshot, bool compress);
+
+
+  /// <summary>
+  ///   Destructor.
+  /// </summary>
+  ~SnapshotStream(void);
+
+
+  /// <summary>
+  ///   Copy constructor.  Streams cannot be copied.
+  /// </summary>
+  SnapshotStream(const SnapshotStream &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Streams cannot be copied.
+  /// </summary>
+  SnapshotStream & operator=(const SnapshotStream &other);
+
+
+public:
+
+  /// <summary>
+  ///   Sends the header to the client and begins streaming the snapshot
+  ///   after it.
+  /// </summary>
+  /// <param name="header">
+  ///   The message sent ahead of the snapshot.
+  /// </param>
+  /// <param name="compress">
+  ///   Whether the client takes compressed "deflate" messages.
+  /// </param>
+  /// <returns>
+  ///   The stream, with one reference held for the caller, who must Close it.
+  /// </returns>
+  static SnapshotStream * Start(StringSocket *client, const std::string &header,
+      SheetSnapshot *snapshot, bool compress);
+
+
+  /// <summary>
+  ///   Sends a message to the client once the snapshot has been sent.
+  /// </summary>
+  void Send(const std::string &message);
+
+
+  /// <summary>
+  ///   Gets whether the whole snapshot and every held back message have been
+  ///   sent, or the client failed.
+  /// </summary>
+  bool IsFinished(void);
+
+
+  /// <summary>
+  ///   Stops the stream, dropping any held back messages, and gives up the
+  ///   reference of the owner.  The stream must not be used afterwards.
+  /// </summary>
+  void Close(void);
+
+
+private:
+
+  /// <summary>
+  ///   Queues the next chunk of the snapshot, or the held back messages once
+  ///   the snapshot is finished.  The mutex must be held.
+  /// </summary>
+  void sendNext(void);
+
+
+  /// <summary>
+  ///   Removes a reference, deleting the stream with the last one.  The mutex
+  ///   must not be held.
+  /// </summary>
+  void release(void);
+
+
+  /// <summary>
+  ///   Send callback for a chunk.  Queues the next one.
+  /// </summary>
+  static void chunkSent(int ex, void *payload);
+
+
+  /// <summary>
+  ///   Send callback for the header and held back messages.  Does nothing.
+  /// </summary>
+  static void messageSent(int ex, void *payload);
+
+};
+
+
+#endif
@@ -4,7 +4,7 @@
   CS 3505 - Spring 2015
   Team SegFault
   Date created: April 5, 2015
-  Last updated: April 24, 2015
+  Last updated: October 18, 2026
 *******************************************************************************/
 
 
@@ -13,6 +13,11 @@
 //
 #include "SpreadsheetServer.h"
 
+//
+// Project headers.
+//
+#include "CellAddress.h"
+
 //
 // Standard libraries.
 //
@@ -26,6 +31,19 @@
 // Threading libraries.
 //
 #include <signal.h>
+#include <time.h>
+#include <unistd.h>
+
+
+//
+// The commands whose latency is measured on their own.  Every other command
+//   is counted as "other".
+//
+static const char * const timedCommands[] = {
+  "connect", "reconnect", "register", "cell", "edit", "batch", "capabilities",
+  "stats", "fill", "copy", "move", "clear", "insert", "delete", "subscribe",
+  "unsubscribe", "range", "undo", "other"
+};
 
 
 /*******************************************************************************
@@ -38,13 +56,93 @@ int main(int argc, char **argv) {
   // Ignore the SIGPIPE signal.
   signal(SIGPIPE, SIG_IGN);
 
+  // Leave SIGUSR1 to the thread that writes the latency report.  Every thread
+  //   started from here on inherits the mask.
+  sigset_t dumpSignal;
+  sigemptyset(&dumpSignal);
+  sigaddset(&dumpSignal, SIGUSR1);
+  pthread_sigmask(SIG_BLOCK, &dumpSignal, NULL);
+
   // Set a pointer to the server to NULL.
 	SpreadsheetServer *server = NULL;
 
+
+  // Take the options out of the arguments, leaving the port.
+  size_t cacheBytes = SC_DEFAULT_BUDGET;
+  int cachePolicy = SC_EVICT_LRU;
+  int stopDeadline = SERVER_STOP_DEADLINE;
+  std::string adminPort;
+  int positional = 1;
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    if ((option != "-c" && option != "-m" && option != "-e" && option != "-d"
+        && option != "-a") || i + 1 == argc) {
+      argv[positional++] = argv[i];
+      continue;
+    }
+
+    std::string value = argv[++i];
+    char *end;
+    long number = strtol(value.c_str(), &end, 10);
+    bool valid = !value.empty() && *end == '\0' && number >= 0;
+
+    // Set the coalescing window.
+    if (option == "-c") {
+      if (!valid || number > SS_MAX_COALESCE_WINDOW) {
+        std::cout << "Invalid coalescing window. Window must be between 0 and "
+            << SS_MAX_COALESCE_WINDOW << " milliseconds." << std::endl;
+        return -1;
+      }
+      SpreadsheetSession::SetDefaultCoalesceWindow(number);
+    }
+
+    // Set the memory kept for closed spreadsheets.
+    else if (option == "-m") {
+      if (!valid || number > 65536) {
+        std::cout << "Invalid cache size. Size must be between 0 and 65536 "
+            << "megabytes." << std::endl;
+        return -1;
+      }
+      cacheBytes = (size_t)number * 1024 * 1024;
+    }
+
+    // Set how long the server waits for spreadsheets to be saved as it stops.
+    else if (option == "-d") {
+      if (!valid || number > 3600) {
+        std::cout << "Invalid stop deadline. Deadline must be between 0 and "
+            << "3600 seconds." << std::endl;
+        return -1;
+      }
+      stopDeadline = number;
+    }
+
+    // Set the port on which metrics are served.
+    else if (option == "-a") {
+      if (!valid || number < 1 || number > 65535) {
+        std::cout << "Invalid admin port. Port must be between 1 and 65535."
+            << std::endl;
+        return -1;
+      }
+      adminPort = value;
+    }
+
+    // Set the eviction policy for closed spreadsheets.
+    else if (value == "lru")
+      cachePolicy = SC_EVICT_LRU;
+    else if (value == "largest")
+      cachePolicy = SC_EVICT_LARGEST;
+    else {
+      std::cout << "Invalid eviction policy. Policy must be lru or largest."
+          << std::endl;
+      return -1;
+    }
+  }
+  argc = positional;
+
   
 	// Create a SpreadsheetServer with the default port if one was not specified.
 	if (argc == 1)
-		server = new SpreadsheetServer("2000");
+		server = new SpreadsheetServer("2000", cacheBytes, cachePolicy);
   
   // Check if an argument was provided at the command prompt.
 	else if (argc == 2) {
@@ -56,7 +154,7 @@ int main(int argc, char **argv) {
 		// Create a SpreadsheetServer with a specific port number if one was
     //   specified.
 		if (port >= 2112 && port <= 2120)
-			server = new SpreadsheetServer(argv[1]);
+			server = new SpreadsheetServer(argv[1], cacheBytes, cachePolicy);
     
     // Print an error message if an invalid port number was provided and exit.
 		else {
@@ -70,16 +168,45 @@ int main(int argc, char **argv) {
   // Print the usage message and exit if too many arguments were provided.
 	else {
     
-		std::cout << "Usage: " << argv[0] << " <port>" << std::endl;
+		std::cout << "Usage: " << argv[0]
+        << " [<port>] [-c <window>] [-m <megabytes>] [-e <policy>]"
+        << " [-d <seconds>] [-a <admin port>]" << std::endl;
     std::cout << "\t<port>\tA valid port number used for accepting connections."
         << std::endl;
     std::cout << "\t      \t  Valid ports are 2000 and 2112 to 2120."
         << std::endl;
+    std::cout << "\t<window>\tMilliseconds within which edits that retype the"
+        << std::endl;
+    std::cout << "\t        \t  same cells are merged. 0, the default, turns"
+        << std::endl;
+    std::cout << "\t        \t  merging off." << std::endl;
+    std::cout << "\t<megabytes>\tMemory kept for spreadsheets that every client"
+        << std::endl;
+    std::cout << "\t           \t  has closed, so they reopen at once. The"
+        << std::endl;
+    std::cout << "\t           \t  default is 64." << std::endl;
+    std::cout << "\t<policy>\tWhich closed spreadsheet is dropped first when"
+        << std::endl;
+    std::cout << "\t        \t  that memory runs out: lru, the default, or"
+        << std::endl;
+    std::cout << "\t        \t  largest." << std::endl;
+    std::cout << "\t<seconds>\tHow long the server waits for spreadsheets to"
+        << std::endl;
+    std::cout << "\t         \t  be saved when it stops. The default is "
+        << SERVER_STOP_DEADLINE << "." << std::endl;
+    std::cout << "\t<admin port>\tA port on the local host on which metrics"
+        << std::endl;
+    std::cout << "\t            \t  are served over HTTP, in the Prometheus"
+        << std::endl;
+    std::cout << "\t            \t  text format. None are served by default."
+        << std::endl;
     return 0;
     
 	}
 	
   
+  server->SetStopDeadline(stopDeadline);
+  server->SetAdminPort(adminPort);
   std::cout << "The server can be stopped with the STOP command." << std::endl;
 
   
@@ -109,30 +236,47 @@ int main(int argc, char **argv) {
 *******************************************************************************/
 
 
-SpreadsheetServer::SpreadsheetServer(std::string portNumber)
-    : port(portNumber), listener(NULL) {
+SpreadsheetServer::SpreadsheetServer(std::string portNumber, size_t cacheBytes,
+    int cachePolicy)
+    : port(portNumber), listener(NULL), adminListener(NULL),
+      associatedSpreadsheetsMutex("server.associated_spreadsheets"),
+      openSpreadsheetsMutex("server.open_spreadsheets"),
+      callbackStatesMutex("server.callback_states"),
+      closedSpreadsheets(cacheBytes, cachePolicy), ioPool(TP_DEFAULT_THREADS),
+      stopDeadline(SERVER_STOP_DEADLINE), stopping(false), runningCallbacks(0),
+      acceptedConnections(0), latencyDumperRunning(false) {
 
-  pthread_mutex_init(&this->associatedSpreadsheetsMutex, NULL);
-  pthread_mutex_init(&this->openSpreadsheetsMutex, NULL);
-  pthread_mutex_init(&this->registeredUsernamesMutex, NULL);
-  pthread_mutex_init(&this->callbackStatesMutex, NULL);
+  pthread_cond_init(&this->callbacksFinished, NULL);
+  for(size_t i = 0; i < sizeof(timedCommands) / sizeof(*timedCommands); i++)
+    this->commandLatency[timedCommands[i]] = new LatencyHistogram();
 
 }
 
 
 SpreadsheetServer::SpreadsheetServer(const SpreadsheetServer & server)
     : port(server.port), listener(server.listener),
-      associatedSpreadsheetsMutex(server.associatedSpreadsheetsMutex),
-      openSpreadsheetsMutex(server.openSpreadsheetsMutex),
-      registeredUsernamesMutex(server.registeredUsernamesMutex),
-      callbackStatesMutex(server.callbackStatesMutex),
+      adminPort(server.adminPort),
+      adminListener(server.adminListener),
+      associatedSpreadsheetsMutex("server.associated_spreadsheets"),
+      openSpreadsheetsMutex("server.open_spreadsheets"),
+      callbackStatesMutex("server.callback_states"),
       associatedSpreadsheets(server.associatedSpreadsheets),
       openSpreadsheets(server.openSpreadsheets),
-      registeredUsernames(server.registeredUsernames),
-      callbackStates(server.callbackStates) {
-  //
-  // Do nothing.
-  //
+      closedSpreadsheets(SC_DEFAULT_BUDGET, SC_EVICT_LRU),
+      ioPool(TP_DEFAULT_THREADS),
+      stopDeadline(server.stopDeadline),
+      stopping(server.stopping),
+      runningCallbacks(0),
+      callbackStates(server.callbackStates),
+      acceptedConnections(server.acceptedConnections),
+      latencyDumperRunning(false) {
+
+  pthread_cond_init(&this->callbacksFinished, NULL);
+
+  // The copy measures its own latencies.
+  for(size_t i = 0; i < sizeof(timedCommands) / sizeof(*timedCommands); i++)
+    this->commandLatency[timedCommands[i]] = new LatencyHistogram();
+
 }
 
 
@@ -140,13 +284,13 @@ SpreadsheetServer::~SpreadsheetServer() {
   
   // Stop the server if it is still running.
   this->Stop();
-  
-  
-  // Release all the lock objects.
-  pthread_mutex_destroy(&this->associatedSpreadsheetsMutex);
-  pthread_mutex_destroy(&this->openSpreadsheetsMutex);
-  pthread_mutex_destroy(&this->registeredUsernamesMutex);
-  pthread_mutex_destroy(&this->callbackStatesMutex);
+
+  // Release the latency histograms.
+  for(std::map<std::string, LatencyHistogram *>::iterator it =
+      this->commandLatency.begin(); it != this->commandLatency.end(); it++)
+    delete (*it).second;
+
+  pthread_cond_destroy(&this->callbacksFinished);
   
 }
 
@@ -155,8 +299,11 @@ void SpreadsheetServer::Start() {
   
   // Load usernames.
   std::cout << "Loading usernames...";
-  this->loadUsernames();
-  std::cout << " done." << std::endl;
+  if(!this->registeredUsers.Open("users"))
+    std::cout << " the users file cannot be written; new names will be lost...";
+  this->registeredUsers.Add("sysadmin");
+  std::cout << " done (" << this->registeredUsers.Count() << " users)."
+      << std::endl;
 
   
   // Create a TcpListener to listen for connections.
@@ -174,6 +321,29 @@ void SpreadsheetServer::Start() {
       this
     );
 
+
+  // Write the latency report whenever SIGUSR1 arrives.
+  this->latencyDumperRunning = pthread_create(&this->latencyDumper, NULL,
+      SpreadsheetServer::dumpLatencies, this) == 0;
+
+
+  // Serve metrics on the admin port, to the local host only.
+  if(!this->adminPort.empty()) {
+    if(TcpListener::CreateTcpListener("127.0.0.1", this->adminPort,
+        &this->adminListener) != TL_NO_EXCEPTION
+        || this->adminListener->Start() != TL_NO_EXCEPTION) {
+      freeTcpListener(&this->adminListener);
+      std::cout << "Metrics cannot be served on port " << this->adminPort
+          << "." << std::endl;
+    }
+    else {
+      std::cout << "Serving metrics on " << this->adminListener->ToString()
+          << std::endl;
+      this->adminListener->BeginAcceptSocket(
+          SpreadsheetServer::adminAcceptCallback, this);
+    }
+  }
+
 }
 
 
@@ -182,38 +352,89 @@ void SpreadsheetServer::Stop() {
   // Shut down the server if the listener is not NULL.
   if(this->listener != NULL) {
     
-    // Save all the spreadsheets.
-    for(std::map<std::string, SpreadsheetSession *>::iterator it =
-        this->openSpreadsheets.begin(); it != this->openSpreadsheets.end();
-        it++) {
-
-      (*it).second->Save();
-      delete (*it).second;
-
-    }
-    this->openSpreadsheets.clear();
-    this->associatedSpreadsheets.clear();
+    // Finish the loads in progress, so that their clients join first.
+    this->ioPool.Shutdown();
+
+    // From here on, the callbacks of closed sockets leave the sockets and
+    //   sessions alone, so they are not freed while this thread is still
+    //   using them, and no more connections are accepted.
+    std::map<StringSocket *, callbackState *> clients;
+    std::map<StringSocket *, adminState *> admins;
+    this->callbackStatesMutex.Lock(); {
+      this->stopping = true;
+      __sync_fetch_and_or(&this->runningCallbacks, SERVER_CALLBACKS_CLOSED);
+      clients.swap(this->callbackStates);
+      admins.swap(this->adminStates);
+    } this->callbackStatesMutex.Unlock();
 
-    
     // Stop listening for connections and close TcpListener.
     listener->Stop();
     freeTcpListener(&listener);
+    if(this->adminListener != NULL) {
+      this->adminListener->Stop();
+      freeTcpListener(&this->adminListener);
+    }
+
+    // Wake the latency dumper, which sees that the server is stopping.
+    if(this->latencyDumperRunning) {
+      pthread_kill(this->latencyDumper, SIGUSR1);
+      pthread_join(this->latencyDumper, NULL);
+      this->latencyDumperRunning = false;
+    }
     
     // Close all of the sockets.
+
     for(std::map<StringSocket *, callbackState *>::iterator it =
-        this->callbackStates.begin(); it != this->callbackStates.end(); it++)
+        clients.begin(); it != clients.end(); it++)
       (*it).first->Close();
+    for(std::map<StringSocket *, adminState *>::iterator it =
+        admins.begin(); it != admins.end(); it++)
+      (*it).first->Close();
+
+    // Wait for the callbacks that were already running to finish before
+    //   their sessions are deleted.  Callbacks that start from here on return
+    //   at once.  The sockets and their states are left for the process to
+    //   release, as a callback may still be about to run.
+    this->callbackStatesMutex.Lock(); {
+      while(__sync_add_and_fetch(&this->runningCallbacks, 0)
+          != SERVER_CALLBACKS_CLOSED)
+        this->callbackStatesMutex.Wait(&this->callbacksFinished);
+    } this->callbackStatesMutex.Unlock();
+    
+    // Save all the spreadsheets.
+    this->saveSpreadsheets();
+    for(std::map<std::string, SpreadsheetSession *>::iterator it =
+        this->openSpreadsheets.begin(); it != this->openSpreadsheets.end();
+        it++)
+      delete (*it).second;
+    this->openSpreadsheets.clear();
+    this->associatedSpreadsheets.clear();
+
+    // Closed spreadsheets were saved when their last client left.
+    std::cout << "Closed spreadsheet cache: " << this->closedSpreadsheets.Hits()
+        << " hits, " << this->closedSpreadsheets.Misses() << " misses, "
+        << this->closedSpreadsheets.Evictions() << " evictions." << std::endl;
+    this->closedSpreadsheets.Clear();
     
     
-    // Save the user names.
-    this->saveUsernames();
-    this->registeredUsernames.clear();
+    // Write the user names registered since the last batch.
+    this->registeredUsers.Close();
     
   }
   
 }
 
 
+void SpreadsheetServer::SetStopDeadline(int seconds) {
+  this->stopDeadline = seconds;
+}
+
+
+void SpreadsheetServer::SetAdminPort(std::string portNumber) {
+  this->adminPort = portNumber;
+}
+
+
 void SpreadsheetServer::clientSendCallback(int ex, void *payload) {
   //
   // Do nothing.
@@ -233,6 +454,68 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
   // Try to get the callbackState from the payload.
   callbackState *state = static_cast<callbackState*>(payload);
 
+  // If there is no state, there is nothing to do here.
+  if(state == NULL)
+    return;
+
+  // Count the callback as running while the message is handled, so that
+  //   Stop can wait for it.  Once the server is stopping, the message is
+  //   dropped.  The state may be freed by the time it returns.
+  SpreadsheetServer *p_this = state->p_this;
+  if(!p_this->enterCallback())
+    return;
+  unsigned long long start = LatencyHistogram::NowMicros();
+
+  // Edits are timed from the message being received to each stage they go
+  //   through.
+  std::string cmd = message.substr(0, message.find(' '));
+  unsigned long long received = StringSocket::ReceivedMicros();
+  if (ex == SS_NO_EXCEPTION && received != 0 && (cmd == "cell" || cmd == "edit" || cmd == "batch"))
+    SpreadsheetSession::StageLatency(SS_STAGE_DISPATCH).Record(start - received);
+
+  SpreadsheetServer::handleMessage(message, ex, payload);
+
+  // Count the time taken against the command.
+  if (ex == SS_NO_EXCEPTION)
+  {
+    std::map<std::string, LatencyHistogram *>::iterator it = p_this->commandLatency.find(cmd);
+    if (it == p_this->commandLatency.end())
+      it = p_this->commandLatency.find("other");
+    (*it).second->RecordSince(start);
+  }
+  p_this->leaveCallback();
+}
+
+
+bool SpreadsheetServer::enterCallback()
+{
+  // Stop sets the closed bit before it waits, so either it sees this callback
+  //   counted or this callback sees the bit.
+  if(__sync_add_and_fetch(&this->runningCallbacks, 1)
+      & SERVER_CALLBACKS_CLOSED) {
+    this->leaveCallback();
+    return false;
+  }
+  return true;
+}
+
+
+void SpreadsheetServer::leaveCallback()
+{
+  if(__sync_sub_and_fetch(&this->runningCallbacks, 1)
+      == SERVER_CALLBACKS_CLOSED) {
+    this->callbackStatesMutex.Lock(); {
+      pthread_cond_broadcast(&this->callbacksFinished);
+    } this->callbackStatesMutex.Unlock();
+  }
+}
+
+
+void SpreadsheetServer::handleMessage(std::string message, int ex, void *payload)
+{
+  // Try to get the callbackState from the payload.
+  callbackState *state = static_cast<callbackState*>(payload);
+
   // If there is no state, there is nothing to do here.
   if(state == NULL)
     return;
@@ -258,13 +541,35 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
     
 
     // Parse the message and process it accordingly.
-    if (cmd == "connect")
+    if (cmd == "connect" || cmd == "reconnect")
     {
+      // A reconnect command carries the last sheet version the client saw
+      //   ahead of the username, so that it is only sent what changed since.
+      unsigned long long lastVersion = 0;
+      if (cmd == "reconnect")
+      {
+        br = info.find(' ');
+        std::string version = info.substr(0, br);
+        info = br == std::string::npos ? "" : info.substr(br + 1);
+        if (version.empty() || version.find_first_not_of("0123456789") != std::string::npos)
+        {
+          client->BeginSend("error 2 " + version + " is not a valid version.", SpreadsheetServer::clientSendCallback, state);
+
+          // Continue receiving messages from the client and return;
+          client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+          return;
+        }
+        lastVersion = strtoull(version.c_str(), NULL, 10);
+
+        // A client that resumes from a version keeps tracking it.
+        state->capabilities |= SS_CAP_VERSIONS;
+      }
+
       // Stop any other threads from accessing the map at the same time.
       int connected = 0;
-      pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
+      p_this->associatedSpreadsheetsMutex.Lock(); {
         connected = p_this->associatedSpreadsheets.count(client);
-      } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
       // If this StringSocket is already connected to a spreadsheet, send an error message.
       if (connected)
@@ -286,14 +591,8 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
       }
       
 
-      // Stop any other threads from accessing the set at the same time.
-      int registered = 0;
-      pthread_mutex_lock(&p_this->registeredUsernamesMutex); {
-        registered = p_this->registeredUsernames.count(username);
-      } pthread_mutex_unlock(&p_this->registeredUsernamesMutex);
-
       // If the username is not registered, send an error message to the client.
-      if (!registered)
+      if (!p_this->registeredUsers.Contains(username))
       {
         client->BeginSend("error 4 " + username, SpreadsheetServer::clientSendCallback, state);
 
@@ -301,55 +600,71 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
         client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
         return;
       }
+      state->username = username;
 
       SpreadsheetSession *session = NULL;
 
       // Stop any other threads from accessing the map at the same time.
-      int opened = 0;
-      pthread_mutex_lock(&p_this->openSpreadsheetsMutex); {
-        opened = p_this->openSpreadsheets.count(spreadsheetName);
-      } pthread_mutex_unlock(&p_this->openSpreadsheetsMutex);
-
-      // If the spreadsheet is not opened by another client, add a new SpreadsheetSession to the server.
-      if (!opened)
-      {
-        session = new SpreadsheetSession(spreadsheetName);
-        bool successful = session->Load();
-        if (!successful)
+      // A spreadsheet that every client closed a moment ago is reopened from
+      //   the cache.  Otherwise it is loaded on the I/O pool, just once no
+      //   matter how many clients ask for it while it loads.  The lock of the
+      //   associatedSpreadsheets map is held until the client is added, so
+      //   that the last client of the spreadsheet cannot close it meanwhile.
+      pendingOpen *open = NULL;
+      bool loading = false;
+      bool added = false;
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        p_this->openSpreadsheetsMutex.Lock(); {
+          std::map<std::string, SpreadsheetSession *>::iterator open_it = p_this->openSpreadsheets.find(spreadsheetName);
+          std::map<std::string, pendingOpen *>::iterator load_it = p_this->loadingSpreadsheets.find(spreadsheetName);
+          if (open_it != p_this->openSpreadsheets.end())
+            session = open_it->second;
+          else if (load_it == p_this->loadingSpreadsheets.end())
+          {
+            session = p_this->closedSpreadsheets.Take(spreadsheetName);
+            if (session != NULL)
+              p_this->openSpreadsheets.insert(std::pair<std::string, SpreadsheetSession*>(spreadsheetName, session));
+            else
+            {
+              open = new pendingOpen;
+              open->server = p_this;
+              open->name = spreadsheetName;
+              load_it = p_this->loadingSpreadsheets.insert(std::pair<std::string, pendingOpen*>(spreadsheetName, open)).first;
+            }
+          }
+
+          // Wait for the load in progress.
+          if (session == NULL)
+          {
+            waitingClient waiter;
+            waiter.client = client;
+            waiter.state = state;
+            waiter.lastVersion = lastVersion;
+            load_it->second->waiting.push_back(waiter);
+            loading = true;
+          }
+        } p_this->openSpreadsheetsMutex.Unlock();
+
+        // Add the StringSocket to the map of Sockets to SpreadsheetSessions, and
+        //   the socket to the SpreadsheetSession.  In addition to adding the
+        //   client to the session, AddClient sends the client all needed
+        //   spreadsheet data.
+        if (!loading)
         {
-          // Since the spreadsheet could not be opened, delete the session and send an error message.
-          delete session;
-
-          client->BeginSend("error 0 The spreadsheet could not be loaded correctly.", SpreadsheetServer::clientSendCallback, state);
-
-          // Continue receiving messages from the client and return.
-          client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
-          return;
+          p_this->associatedSpreadsheets.insert(std::pair<StringSocket*, SpreadsheetSession*>(client, session));
+          added = session->AddClient(client, state->capabilities, lastVersion);
         }
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
-        // Stop any other threads from accessing the map at the same time.
-        pthread_mutex_lock(&p_this->openSpreadsheetsMutex); {
-          p_this->openSpreadsheets.insert(std::pair<std::string, SpreadsheetSession*>(spreadsheetName, session));
-        } pthread_mutex_unlock(&p_this->openSpreadsheetsMutex);
-
-      }
-      else
+      // The client is sent the spreadsheet, and its messages are read again,
+      //   once the load finishes.
+      if (loading)
       {
-        // Stop any other threads from accessing the map at the same time.
-        pthread_mutex_lock(&p_this->openSpreadsheetsMutex); {
-          session = p_this->openSpreadsheets.find(spreadsheetName)->second;
-        } pthread_mutex_unlock(&p_this->openSpreadsheetsMutex);
+        if (open != NULL && !p_this->ioPool.Queue(SpreadsheetServer::loadSpreadsheet, open))
+          SpreadsheetServer::loadSpreadsheet(open);
+        return;
       }
 
-      // Stop any other threads from accessing the map at the same time.
-      pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
-      // Add the StringSocket to the map of Sockets to SpreadsheetSessions.
-        p_this->associatedSpreadsheets.insert(std::pair<StringSocket*, SpreadsheetSession*>(client, session));
-      } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
-
-      // Add the socket to the SpreadsheetSession.
-      // In addition to adding the client to the session, AddClient sends the client all needed spreadsheet data.
-      bool added = session->AddClient(client);
       if (!added)
       {
         client->BeginSend("error 3 You are already connected to this spreadsheet.", p_this->clientSendCallback, state);
@@ -365,9 +680,9 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
     {
       int connected = 0;
       // Stop any other threads from accessing the map at the same time.
-      pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
+      p_this->associatedSpreadsheetsMutex.Lock(); {
         connected = p_this->associatedSpreadsheets.count(client);
-      } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
       // If the client trying to register the username isn't connected, send an error message.
       if (!connected)
@@ -385,39 +700,18 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
       if(br != std::string::npos)
         username = info.substr(0, br);
 
-      int alreadyAdded = 0;
-      // Stop any other threads from accessing the set at the same time.
-      pthread_mutex_lock(&p_this->registeredUsernamesMutex); {
-        alreadyAdded = p_this->registeredUsernames.count(username);
-      } pthread_mutex_unlock(&p_this->registeredUsernamesMutex);
-
-      // Add the username to the list of registered usernames.
-      if (!alreadyAdded)
+      // Add the username to the registered usernames.  This returns once the
+      //   name is in the users file, along with any other names registered at
+      //   the same time.
+      int added = p_this->registeredUsers.Add(username);
+      if (added == UR_REGISTERED)
       {
-        // Stop any other threads from accessing the set at the same time
-        bool added = false;
-        pthread_mutex_lock(&p_this->registeredUsernamesMutex); {
-          added = p_this->registeredUsernames.insert(username).second;
-        } pthread_mutex_unlock(&p_this->registeredUsernamesMutex);
-
-        if (!added)
-        {
-          // If the name could not be added, send an error message to the client.
-          client->BeginSend("error 0 There was a problem registering the username.", p_this->clientSendCallback, state);
-
-          // Continue receiving messages from the client and return.
-          client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
-          return;
-        }
-        
-        // Append the username to the users file.
-        std::ofstream users("users", std::ofstream::out | std::ofstream::app);
-        users << username << "\n";
-        users.close();
+        client->BeginSend("error 4 The username you are trying to register is already registered.", p_this->clientSendCallback, state);
       }
-      else
+      else if (added != UR_ADDED)
       {
-        client->BeginSend("error 4 The username you are trying to register is already registered.", p_this->clientSendCallback, state);
+        // If the name could not be added, send an error message to the client.
+        client->BeginSend("error 0 There was a problem registering the username.", p_this->clientSendCallback, state);
       }
 
       // Continue receiving messages from the client and return.
@@ -426,18 +720,38 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
     }
     
     
-    else if (cmd == "cell")
+    else if (cmd == "cell" || cmd == "edit")
     {
+      // An edit command carries the client's sequence number ahead of the
+      //   cell, and is answered with an ack or nack that repeats it.
+      std::string failure = "error ";
+      std::string seq;
+      if (cmd == "edit")
+      {
+        br = info.find(' ');
+        seq = info.substr(0, br);
+        info = br == std::string::npos ? "" : info.substr(br + 1);
+        if (seq.empty() || seq.find_first_not_of("0123456789") != std::string::npos)
+        {
+          client->BeginSend("error 2 " + seq + " is not a valid sequence number.", p_this->clientSendCallback, state);
+
+          // Continue receiving messages from the client and return;
+          client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+          return;
+        }
+        failure = "nack " + seq + " ";
+      }
+
       int connected = 0;
       // Stop any other threads from accessing the map at the same time.
-      pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
+      p_this->associatedSpreadsheetsMutex.Lock(); {
         connected = p_this->associatedSpreadsheets.count(client);
-      } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
       // If the client isn't connected to a spreadsheet, send an error message.
       if (!connected)
       {
-        client->BeginSend("error 3 You must be connected to a spreadsheet in order to use an edit command.", SpreadsheetServer::clientSendCallback, state);
+        client->BeginSend(failure + "3 You must be connected to a spreadsheet in order to use an edit command.", SpreadsheetServer::clientSendCallback, state);
 
         // Continue receiving messages from the client and return;
         client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
@@ -447,9 +761,9 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
       SpreadsheetSession *session = NULL;
 
       // Stop any other threads from accessing the map at the same time.
-      pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
+      p_this->associatedSpreadsheetsMutex.Lock(); {
         session = p_this->associatedSpreadsheets[client];
-      } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
       // Get the cell name and contents out of the info.
       std::string cellName = info;
@@ -460,31 +774,54 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
         cellContents = info.substr(br + 1);
       }
 
+      // Only cell addresses can be edited.
+      int col, row;
+      if (!ParseCellName(cellName, &col, &row))
+      {
+        client->BeginSend(failure + "2 " + cellName + " is not a valid cell name.", p_this->clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
       // If there is a circular dependency, send an error message to the client who attempted the edit.
       // Otherwise, EditCell pushes edits out to all clients connected to the session.
-      if (!session->EditCell(cellName, cellContents))
+      unsigned long long version = 0;
+      if (!session->EditCell(cellName, cellContents, &version))
       {
-        client->BeginSend("error 1 When trying to edit cell " + cellName + ", a circular dependency occured: the edit was not made.", p_this->clientSendCallback, state);
+        client->BeginSend(failure + "1 When trying to edit cell " + cellName + ", a circular dependency occured: the edit was not made.", p_this->clientSendCallback, state);
 
         // Continue receiving messages from the client and return;
         client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
         return;
       }
+
+      // Unless coalescing held the edit back, it has already gone out to every
+      //   client and the ack follows it. A held edit is acked right away with
+      //   the version it was given, and goes out when the coalescing window
+      //   runs out.
+      if (cmd == "edit")
+      {
+        std::ostringstream ack;
+        ack << "ack " << seq << " " << version;
+        client->BeginSend(ack.str(), p_this->clientSendCallback, state);
+      }
     }
     
     
-    else if (cmd == "undo")
+    else if (cmd == "batch")
     {
-      // Stop any other threads from accessing the map at the same time.
       int connected = 0;
-      pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
+      // Stop any other threads from accessing the map at the same time.
+      p_this->associatedSpreadsheetsMutex.Lock(); {
         connected = p_this->associatedSpreadsheets.count(client);
-      } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
       // If the client isn't connected to a spreadsheet, send an error message.
       if (!connected)
       {
-        client->BeginSend("error 3 You must be connected to a spreadsheet in order to use an undo command.", SpreadsheetServer::clientSendCallback, state);
+        client->BeginSend("error 3 You must be connected to a spreadsheet in order to use a batch command.", SpreadsheetServer::clientSendCallback, state);
 
         // Continue receiving messages from the client and return;
         client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
@@ -494,92 +831,441 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
       SpreadsheetSession *session = NULL;
 
       // Stop any other threads from accessing the map at the same time.
-      pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
+      p_this->associatedSpreadsheetsMutex.Lock(); {
         session = p_this->associatedSpreadsheets[client];
-      } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
-      // Undo the last edit made to the spreadsheet.
-      bool successful = session->UndoAll();
-	  if (!successful)
-	  {
-		  client->BeginSend("error 3 Your undo command was unable to be processed.", SpreadsheetServer::clientSendCallback, state);
-	  }
+      // Get the cell names and contents out of the info.
+      std::vector<std::pair<std::string, std::string> > edits;
+      if (!parseBatch(info, &edits))
+      {
+        client->BeginSend("error 2 batch The batch of edits could not be read.", p_this->clientSendCallback, state);
 
-      // Continue receiving messages from the client and return;
-      client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
-      return;
-    }
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
 
+      // The whole batch is applied as one edit, or not at all.
+      if (!session->EditCells(edits, NULL))
+      {
+        client->BeginSend("error 1 When trying to apply a batch of edits, a circular dependency occured: no edit was made.", p_this->clientSendCallback, state);
 
-    // Since the keyword is not acceptable, send an error message back to the client.
-    else
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+    }
+    
+    
+    else if (cmd == "capabilities")
     {
-      client->BeginSend("error 2 " + cmd, p_this->clientSendCallback, state);
+      // Keep the capabilities this server knows and echo them back.
+      unsigned int capabilities = 0;
+      std::string accepted;
+      std::istringstream names(info);
+      std::string name;
+      while (names >> name)
+      {
+        if (name == "ranges" && !(capabilities & SS_CAP_RANGES))
+        {
+          capabilities |= SS_CAP_RANGES;
+          accepted += " ranges";
+        }
+        else if (name == "layout" && !(capabilities & SS_CAP_LAYOUT))
+        {
+          capabilities |= SS_CAP_LAYOUT;
+          accepted += " layout";
+        }
+        else if (name == "versions" && !(capabilities & SS_CAP_VERSIONS))
+        {
+          capabilities |= SS_CAP_VERSIONS;
+          accepted += " versions";
+        }
+        else if (name == "deflate" && !(capabilities & SS_CAP_DEFLATE))
+        {
+          capabilities |= SS_CAP_DEFLATE;
+          accepted += " deflate";
+        }
+        else if (name == "viewport" && !(capabilities & SS_CAP_VIEWPORT))
+        {
+          capabilities |= SS_CAP_VIEWPORT;
+          accepted += " viewport";
+        }
+      }
+      state->capabilities = capabilities;
 
-      // Continue receiving messages from the client and return.
-      client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
-      return;
-    }
-  }
+      // A client that is already connected changes how it is sent edits from now on.
+      SpreadsheetSession *session = NULL;
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        std::map<StringSocket*, SpreadsheetSession*>::iterator it = p_this->associatedSpreadsheets.find(client);
+        if (it != p_this->associatedSpreadsheets.end())
+          session = it->second;
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
+      if (session != NULL)
+        session->SetClientCapabilities(client, capabilities);
 
-  else if (ex == SS_EXCEPTION)
-  {
-    client->BeginSend("error 0 An error occured while sending or receiving data.", p_this->clientSendCallback, state);
+      client->BeginSend("capabilities" + accepted, p_this->clientSendCallback, state);
+    }
 
-    // Continue receiving messages from the client and return.
-    client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
-    return;
-  }
 
+    else if (cmd == "stats")
+    {
+      // Only the system administrator may see what the server is doing.
+      if (state->username != "sysadmin")
+        client->BeginSend("error 4 Only sysadmin may use the stats command.", p_this->clientSendCallback, state);
+      else
+        client->BeginSend(p_this->statsMessage(), p_this->clientSendCallback, state);
+    }
 
-  else if (ex == SS_CLOSED_EXCEPTION)
-  {
-    std::cout << "Connection closed: " << client->ToString() << std::endl;
 
-    int connected = 0;
-    pthread_mutex_lock(&p_this->associatedSpreadsheetsMutex); {
-      connected = p_this->associatedSpreadsheets.count(client);
+    else if (cmd == "fill" || cmd == "copy" || cmd == "move" || cmd == "clear")
+    {
+      int connected = 0;
+      // Stop any other threads from accessing the map at the same time.
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        connected = p_this->associatedSpreadsheets.count(client);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
-      //if the client was connected to a session
-      if (connected)
+      // If the client isn't connected to a spreadsheet, send an error message.
+      if (!connected)
       {
-        //remove the client from the session
-        SpreadsheetSession *session = NULL;
+        client->BeginSend("error 3 You must be connected to a spreadsheet in order to use a " + cmd + " command.", SpreadsheetServer::clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      SpreadsheetSession *session = NULL;
+
+      // Stop any other threads from accessing the map at the same time.
+      p_this->associatedSpreadsheetsMutex.Lock(); {
         session = p_this->associatedSpreadsheets[client];
-        session->RemoveClient(client);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
 
-        // Remove the client from the map of sockets to sessions.
-        std::map<StringSocket*, SpreadsheetSession*>::iterator associated_it = p_this->associatedSpreadsheets.find(client);
-        p_this->associatedSpreadsheets.erase(associated_it);
+      // Get the source range and, except for clear, the destination out of the info.
+      std::string source = info;
+      std::string target;
+      br = info.find(' ');
+      if (br != std::string::npos) {
+        source = info.substr(0, br);
+        target = info.substr(br + 1);
+      }
 
-        //if the session has no more connected clients
-        if (session->GetUserCount() == 0)
+      int col0, row0, col1, row1;
+      int destCol0, destRow0, destCol1, destRow1;
+      bool parsed = ParseCellRange(source, &col0, &row0, &col1, &row1);
+      if (cmd == "clear")
+        parsed = parsed && target.empty();
+      else if (cmd == "fill")
+        parsed = parsed && ParseCellRange(target, &destCol0, &destRow0, &destCol1, &destRow1);
+      else
+        parsed = parsed && ParseCellName(target, &destCol0, &destRow0);
+
+      if (!parsed)
+      {
+        client->BeginSend("error 2 " + info + " is not a valid range.", p_this->clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      // The whole range is edited as one edit, or not at all.
+      bool applied;
+      if (cmd == "fill")
+        applied = session->FillRange(col0, row0, col1, row1, destCol0, destRow0, destCol1, destRow1);
+      else if (cmd == "copy")
+        applied = session->CopyRange(col0, row0, col1, row1, destCol0, destRow0);
+      else if (cmd == "move")
+        applied = session->MoveRange(col0, row0, col1, row1, destCol0, destRow0);
+      else
+        applied = session->ClearRange(col0, row0, col1, row1);
+
+      if (!applied)
+      {
+        client->BeginSend("error 1 When trying to " + cmd + " " + source + ", a circular dependency occured or the range was off the sheet: no edit was made.", p_this->clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+    }
+
+
+    else if (cmd == "insert" || cmd == "delete")
+    {
+      int connected = 0;
+      // Stop any other threads from accessing the map at the same time.
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        connected = p_this->associatedSpreadsheets.count(client);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
+
+      // If the client isn't connected to a spreadsheet, send an error message.
+      if (!connected)
+      {
+        client->BeginSend("error 3 You must be connected to a spreadsheet in order to use an " + cmd + " command.", SpreadsheetServer::clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      SpreadsheetSession *session = NULL;
+
+      // Stop any other threads from accessing the map at the same time.
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        session = p_this->associatedSpreadsheets[client];
+      } p_this->associatedSpreadsheetsMutex.Unlock();
+
+      // Get "row <number> [count]" or "column <letters> [count]" out of the info.
+      std::istringstream words(info);
+      std::string axis;
+      std::string line;
+      std::string number;
+      std::string extra;
+      long count = 1;
+      int index = 0;
+      bool parsed = (bool)(words >> axis >> line);
+      if (parsed && (words >> number))
+      {
+        count = atol(number.c_str());
+        parsed = number.find_first_not_of("0123456789") == std::string::npos && count > 0 && count <= CA_MAX_ROW + 1;
+      }
+      parsed = parsed && !(words >> extra);
+      if (parsed && axis == "row")
+      {
+        long row = atol(line.c_str());
+        parsed = line.find_first_not_of("0123456789") == std::string::npos && row >= 1 && row <= CA_MAX_ROW + 1;
+        index = (int)row - 1;
+      }
+      else if (parsed && axis == "column")
+        parsed = ParseColumnName(line, &index);
+      else
+        parsed = false;
+
+      if (!parsed)
+      {
+        client->BeginSend("error 2 " + info + " is not a valid row or column.", p_this->clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      // Every line is moved as one edit, or none are.
+      bool applied;
+      if (cmd == "insert")
+        applied = axis == "row" ? session->InsertRows(index, (int)count) : session->InsertColumns(index, (int)count);
+      else
+        applied = axis == "row" ? session->DeleteRows(index, (int)count) : session->DeleteColumns(index, (int)count);
+
+      if (!applied)
+      {
+        client->BeginSend("error 1 When trying to " + cmd + " " + info + ", cells or references would have been pushed off the sheet: no edit was made.", p_this->clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+    }
+
+
+    else if (cmd == "subscribe" || cmd == "unsubscribe" || cmd == "range")
+    {
+      SpreadsheetSession *session = NULL;
+
+      // Stop any other threads from accessing the map at the same time.
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        std::map<StringSocket*, SpreadsheetSession*>::iterator it = p_this->associatedSpreadsheets.find(client);
+        if (it != p_this->associatedSpreadsheets.end())
+          session = it->second;
+      } p_this->associatedSpreadsheetsMutex.Unlock();
+
+      // If the client isn't connected to a spreadsheet, send an error message.
+      if (session == NULL)
+      {
+        client->BeginSend("error 3 You must be connected to a spreadsheet in order to use a " + cmd + " command.", SpreadsheetServer::clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      // Unsubscribing with no range drops every block the client watches.
+      if (cmd == "unsubscribe" && info.empty())
+      {
+        session->UnsubscribeAll(client);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      int col0, row0, col1, row1;
+      if (!ParseCellRange(info, &col0, &row0, &col1, &row1))
+      {
+        client->BeginSend("error 2 " + info + " is not a valid range.", p_this->clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      // The cells of the block are sent back in a "range" message.
+      std::string failure;
+      if (cmd == "subscribe" && !session->Subscribe(client, col0, row0, col1, row1))
+        failure = "error 2 " + info + " is too large, or too many blocks are already subscribed to.";
+      else if (cmd == "unsubscribe" && !session->Unsubscribe(client, col0, row0, col1, row1))
+        failure = "error 2 " + info + " is not subscribed to.";
+      else if (cmd == "range" && !session->SendRange(client, col0, row0, col1, row1))
+        failure = "error 2 " + info + " is too large.";
+
+      if (!failure.empty())
+        client->BeginSend(failure, p_this->clientSendCallback, state);
+
+      // Continue receiving messages from the client and return;
+      client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+      return;
+    }
+
+
+    else if (cmd == "undo")
+    {
+      // Stop any other threads from accessing the map at the same time.
+      int connected = 0;
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        connected = p_this->associatedSpreadsheets.count(client);
+      } p_this->associatedSpreadsheetsMutex.Unlock();
+
+      // If the client isn't connected to a spreadsheet, send an error message.
+      if (!connected)
+      {
+        client->BeginSend("error 3 You must be connected to a spreadsheet in order to use an undo command.", SpreadsheetServer::clientSendCallback, state);
+
+        // Continue receiving messages from the client and return;
+        client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+        return;
+      }
+
+      SpreadsheetSession *session = NULL;
+
+      // Stop any other threads from accessing the map at the same time.
+      p_this->associatedSpreadsheetsMutex.Lock(); {
+        session = p_this->associatedSpreadsheets[client];
+      } p_this->associatedSpreadsheetsMutex.Unlock();
+
+      // Undo the last edit made to the spreadsheet.
+      bool successful = session->UndoAll();
+	  if (!successful)
+	  {
+		  client->BeginSend("error 3 Your undo command was unable to be processed.", SpreadsheetServer::clientSendCallback, state);
+	  }
+
+      // Continue receiving messages from the client and return;
+      client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+      return;
+    }
+
+
+    // Since the keyword is not acceptable, send an error message back to the client.
+    else
+    {
+      client->BeginSend("error 2 " + cmd, p_this->clientSendCallback, state);
+
+      // Continue receiving messages from the client and return.
+      client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+      return;
+    }
+  }
+
+
+  else if (ex == SS_EXCEPTION)
+  {
+    client->BeginSend("error 0 An error occured while sending or receiving data.", p_this->clientSendCallback, state);
+
+    // Continue receiving messages from the client and return.
+    client->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+    return;
+  }
+
+
+  else if (ex == SS_CLOSED_EXCEPTION)
+  {
+    std::cout << "Connection closed: " << client->ToString() << std::endl;
+
+    // A server that is stopping saves the spreadsheets and keeps the sockets
+    //   itself.
+    bool stopping;
+    p_this->callbackStatesMutex.Lock(); {
+      stopping = p_this->stopping;
+    } p_this->callbackStatesMutex.Unlock();
+    if (stopping)
+      return;
+
+    int connected = 0;
+    SpreadsheetSession *session = NULL;
+    pendingOpen *closing = NULL;
+    p_this->associatedSpreadsheetsMutex.Lock(); {
+      connected = p_this->associatedSpreadsheets.count(client);
+
+      //if the client was connected to a session
+      if (connected)
+      {
+        //remove the client from the session
+        session = p_this->associatedSpreadsheets[client];
+        session->RemoveClient(client);
+
+        // Remove the client from the map of sockets to sessions.
+        std::map<StringSocket*, SpreadsheetSession*>::iterator associated_it = p_this->associatedSpreadsheets.find(client);
+        p_this->associatedSpreadsheets.erase(associated_it);
+
+        //if the session has no more connected clients
+        if (session->GetUserCount() == 0)
         {
-          // Save the spreadsheet.
-          session->Save();
-          
-          // Remove the spreadsheet from the map of open spreadsheets.
-          pthread_mutex_lock(&p_this->openSpreadsheetsMutex); {
+          // Take the spreadsheet out of the map of open spreadsheets while it
+          //   is saved.  Clients that connect to it meanwhile wait for it as
+          //   they would for a load.
+          p_this->openSpreadsheetsMutex.Lock(); {
             std::map<std::string, SpreadsheetSession *>::iterator open_it = p_this->openSpreadsheets.find(session->GetName());
             p_this->openSpreadsheets.erase(open_it);
-          } pthread_mutex_unlock(&p_this->openSpreadsheetsMutex);
-          
-          // Delete the spreadsheet session.
-          delete session;
+
+            closing = new pendingOpen;
+            closing->server = p_this;
+            closing->name = session->GetName();
+            p_this->loadingSpreadsheets.insert(std::pair<std::string, pendingOpen*>(closing->name, closing));
+          } p_this->openSpreadsheetsMutex.Unlock();
         }
       }
-    } pthread_mutex_unlock(&p_this->associatedSpreadsheetsMutex);
+    } p_this->associatedSpreadsheetsMutex.Unlock();
+
+    // Save the spreadsheet without holding up other clients, then move it into
+    //   the cache of closed ones, which deletes it once it is evicted, or
+    //   reopen it for the clients that connected while it was saved.
+    if (closing != NULL)
+    {
+      session->Save();
+      SpreadsheetServer::finishOpen(closing, session);
+    }
     
-    // Remove the client and callback state from the callback states map.
-    pthread_mutex_lock(&p_this->callbackStatesMutex); {
+    // Remove the client and callback state from the callback states map,
+    //   unless a server that began stopping meanwhile has taken them over.
+    bool removed = false;
+    p_this->callbackStatesMutex.Lock(); {
       std::map<StringSocket *, callbackState *>::iterator it = p_this->callbackStates.find(client);
-      delete (*it).second;
-      p_this->callbackStates.erase(it);
-    } pthread_mutex_unlock(&p_this->callbackStatesMutex);
+      if (it != p_this->callbackStates.end())
+      {
+        delete (*it).second;
+        p_this->callbackStates.erase(it);
+        removed = true;
+      }
+    } p_this->callbackStatesMutex.Unlock();
 
     // Delete the client
-    freeStringSocket(&client);
+    if (removed)
+      freeStringSocket(&client);
 
     // Return before calling BeginReceive again.
     return;
@@ -590,12 +1276,517 @@ void SpreadsheetServer::clientRecvCallback(std::string message, int ex, void *pa
 }
 
 
+void SpreadsheetServer::loadSpreadsheet(void *payload) {
+
+  pendingOpen *open = static_cast<pendingOpen *>(payload);
+
+  SpreadsheetSession *session = new SpreadsheetSession(open->name);
+  if (!session->Load()) {
+    delete session;
+    session = NULL;
+  }
+
+  SpreadsheetServer::finishOpen(open, session);
+
+}
+
+
+void SpreadsheetServer::finishOpen(pendingOpen *open,
+    SpreadsheetSession *session) {
+
+  SpreadsheetServer *p_this = open->server;
+
+  // Open the spreadsheet and add every client that waited for it before any
+  //   other client can find it, so that it is never open without clients.
+  std::vector<waitingClient> waiting;
+  p_this->associatedSpreadsheetsMutex.Lock(); {
+    p_this->openSpreadsheetsMutex.Lock(); {
+
+      p_this->loadingSpreadsheets.erase(open->name);
+      waiting.swap(open->waiting);
+
+      if (session != NULL && waiting.empty())
+        p_this->closedSpreadsheets.Put(session);
+      else if (session != NULL) {
+        p_this->openSpreadsheets.insert(std::pair<std::string, SpreadsheetSession*>(open->name, session));
+        for (size_t i = 0; i < waiting.size(); i++) {
+          p_this->associatedSpreadsheets.insert(std::pair<StringSocket*, SpreadsheetSession*>(waiting[i].client, session));
+          session->AddClient(waiting[i].client, waiting[i].state->capabilities, waiting[i].lastVersion);
+        }
+      }
+
+    } p_this->openSpreadsheetsMutex.Unlock();
+  } p_this->associatedSpreadsheetsMutex.Unlock();
+
+
+  // Since the spreadsheet could not be opened, send an error message to every
+  //   client that waited for it.
+  for (size_t i = 0; i < waiting.size(); i++) {
+    if (session == NULL)
+      waiting[i].client->BeginSend("error 0 The spreadsheet could not be loaded correctly.", SpreadsheetServer::clientSendCallback, waiting[i].state);
+
+    // Continue receiving messages from the client.
+    waiting[i].client->BeginReceive(SpreadsheetServer::clientRecvCallback, waiting[i].state);
+  }
+
+  delete open;
+
+}
+
+
+void SpreadsheetServer::saveSpreadsheet(void *payload) {
+
+  saveJob *job = static_cast<saveJob *>(payload);
+
+  bool cancelled;
+  pthread_mutex_lock(&job->progress->mutex); {
+    cancelled = job->progress->cancelled;
+  } pthread_mutex_unlock(&job->progress->mutex);
+
+  // A save that gives up at the deadline counts as past it.
+  int result = 3;
+  if (!cancelled && job->session->Save(&job->progress->deadline))
+    result = 1;
+  else if (!cancelled) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (now.tv_sec < job->progress->deadline.tv_sec
+        || (now.tv_sec == job->progress->deadline.tv_sec
+        && now.tv_nsec < job->progress->deadline.tv_nsec))
+      result = 2;
+  }
+
+  pthread_mutex_lock(&job->progress->mutex); {
+    job->result = result;
+    job->progress->done++;
+    pthread_cond_signal(&job->progress->finished);
+  } pthread_mutex_unlock(&job->progress->mutex);
+
+}
+
+
+void SpreadsheetServer::saveSpreadsheets() {
+
+  // Only spreadsheets with changes since they were last saved are written.
+  std::vector<saveJob> jobs;
+  size_t clean = 0;
+  saveProgress progress;
+  pthread_mutex_init(&progress.mutex, NULL);
+  pthread_cond_init(&progress.finished, NULL);
+  progress.done = 0;
+  progress.cancelled = false;
+  clock_gettime(CLOCK_REALTIME, &progress.deadline);
+  progress.deadline.tv_sec += this->stopDeadline;
+
+  for(std::map<std::string, SpreadsheetSession *>::iterator it =
+      this->openSpreadsheets.begin(); it != this->openSpreadsheets.end();
+      it++) {
+    if (!(*it).second->IsDirty()) {
+      clean++;
+      continue;
+    }
+    saveJob job;
+    job.session = (*it).second;
+    job.progress = &progress;
+    job.result = 0;
+    jobs.push_back(job);
+  }
+
+  std::cout << "Saving " << jobs.size() << " spreadsheets (" << clean
+      << " already saved)..." << std::endl;
+
+
+  // Save them in parallel, reporting progress every second until they are
+  //   all saved or the deadline passes.
+  ThreadPool savers(SERVER_SAVE_THREADS);
+  for(size_t i = 0; i < jobs.size(); i++) {
+    if (!savers.Queue(SpreadsheetServer::saveSpreadsheet, &jobs[i]))
+      SpreadsheetServer::saveSpreadsheet(&jobs[i]);
+  }
+
+  const struct timespec &deadline = progress.deadline;
+
+  pthread_mutex_lock(&progress.mutex); {
+    while (progress.done < jobs.size()) {
+      struct timespec now;
+      clock_gettime(CLOCK_REALTIME, &now);
+      if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec
+          && now.tv_nsec >= deadline.tv_nsec))
+        break;
+
+      struct timespec report = now;
+      report.tv_sec++;
+      if (report.tv_sec > deadline.tv_sec || (report.tv_sec == deadline.tv_sec
+          && report.tv_nsec > deadline.tv_nsec))
+        report = deadline;
+
+      size_t before = progress.done;
+      pthread_cond_timedwait(&progress.finished, &progress.mutex, &report);
+      if (progress.done == before && progress.done < jobs.size())
+        std::cout << "  " << progress.done << " of " << jobs.size()
+            << " saved..." << std::endl;
+    }
+    progress.cancelled = true;
+  } pthread_mutex_unlock(&progress.mutex);
+
+  // Saves still running give up within a chunk of the deadline; the rest
+  //   skip themselves.
+  savers.Shutdown();
+
+
+  size_t saved = 0;
+  size_t failed = 0;
+  for(size_t i = 0; i < jobs.size(); i++) {
+    if (jobs[i].result == 1)
+      saved++;
+    else {
+      if (jobs[i].result == 2)
+        failed++;
+      std::cout << "  " << jobs[i].session->GetName()
+          << (jobs[i].result == 2 ? " could not be saved."
+          : " was not saved before the deadline.") << std::endl;
+    }
+  }
+  std::cout << "Saved " << saved << " of " << jobs.size() << " spreadsheets ("
+      << failed << " failed, " << jobs.size() - saved - failed
+      << " past the deadline)." << std::endl;
+
+  pthread_cond_destroy(&progress.finished);
+  pthread_mutex_destroy(&progress.mutex);
+
+}
+
+
+std::string SpreadsheetServer::statsMessage() {
+
+  std::vector<std::string> lines;
+  std::ostringstream line;
+
+
+  // The open, loading and closed spreadsheets.  Each session is read while
+  //   the lock keeps it from being closed and evicted.
+  this->openSpreadsheetsMutex.Lock(); {
+    line << "server sessions " << this->openSpreadsheets.size()
+        << " loading " << this->loadingSpreadsheets.size()
+        << " users " << this->registeredUsers.Count();
+    lines.push_back(line.str());
+
+    line.str("");
+    line << "cache sessions " << this->closedSpreadsheets.Count()
+        << " bytes " << this->closedSpreadsheets.Bytes()
+        << " hits " << this->closedSpreadsheets.Hits()
+        << " misses " << this->closedSpreadsheets.Misses()
+        << " evictions " << this->closedSpreadsheets.Evictions();
+    lines.push_back(line.str());
+
+    for(std::map<std::string, SpreadsheetSession *>::iterator it =
+        this->openSpreadsheets.begin(); it != this->openSpreadsheets.end();
+        it++) {
+      sessionStats stats;
+      (*it).second->GetStats(&stats, true);
+      line.str("");
+      line << "session " << (*it).first << " clients " << stats.clients
+          << " edits " << stats.edits << " edits_per_sec "
+          << stats.editsPerSecond << " graph_size " << stats.graphSize
+          << " version " << stats.version;
+      lines.push_back(line.str());
+    }
+  } this->openSpreadsheetsMutex.Unlock();
+
+
+  // The traffic over every socket, and over each connected one.  A socket is
+  //   only freed once it is out of the map.
+  socketStats totals;
+  StringSocket::GetTotals(&totals);
+  line.str("");
+  line << "traffic messages_in " << totals.messagesIn << " messages_out "
+      << totals.messagesOut << " bytes_in " << totals.bytesIn << " bytes_out "
+      << totals.bytesOut;
+  lines.push_back(line.str());
+
+  this->callbackStatesMutex.Lock(); {
+    for(std::map<StringSocket *, callbackState *>::iterator it =
+        this->callbackStates.begin(); it != this->callbackStates.end(); it++) {
+      socketStats stats;
+      (*it).first->GetStats(&stats);
+      line.str("");
+      line << "socket " << (*it).first->ToString() << " user "
+          << ((*it).second->username.empty() ? "-" : (*it).second->username)
+          << " messages_in " << stats.messagesIn << " messages_out "
+          << stats.messagesOut << " bytes_in " << stats.bytesIn
+          << " bytes_out " << stats.bytesOut << " send_queue "
+          << stats.sendQueue;
+      lines.push_back(line.str());
+    }
+  } this->callbackStatesMutex.Unlock();
+
+
+  // The header gives the number of lines that follow it.
+  std::ostringstream message;
+  message << "stats " << lines.size();
+  for(size_t i = 0; i < lines.size(); i++)
+    message << "\n" << lines[i];
+
+  return message.str();
+
+}
+
+
+std::string SpreadsheetServer::metricsText() {
+
+  std::ostringstream out;
+
+
+  // The connections and threads.
+  size_t connections;
+  size_t sendQueued = 0;
+  int sendQueueMax = 0;
+  this->callbackStatesMutex.Lock(); {
+    connections = this->callbackStates.size();
+    for(std::map<StringSocket *, callbackState *>::iterator it =
+        this->callbackStates.begin(); it != this->callbackStates.end(); it++) {
+      socketStats stats;
+      (*it).first->GetStats(&stats);
+      sendQueued += stats.sendQueue;
+      if(stats.sendQueue > sendQueueMax)
+        sendQueueMax = stats.sendQueue;
+    }
+  } this->callbackStatesMutex.Unlock();
+
+  metricHeader(out, "spreadsheet_connections", "gauge",
+      "Clients connected now.");
+  out << "spreadsheet_connections " << connections << "\n";
+  metricHeader(out, "spreadsheet_connections_accepted_total", "counter",
+      "Clients accepted since the server started.");
+  out << "spreadsheet_connections_accepted_total "
+      << __sync_add_and_fetch(&this->acceptedConnections, 0) << "\n";
+  metricHeader(out, "spreadsheet_threads", "gauge",
+      "Threads of the server process.");
+  out << "spreadsheet_threads " << SpreadsheetServer::threadCount() << "\n";
+
+
+  // The latencies.
+  metricHeader(out, "spreadsheet_command_duration_seconds", "histogram",
+      "Time taken to handle each command.");
+  for(std::map<std::string, LatencyHistogram *>::iterator it =
+      this->commandLatency.begin(); it != this->commandLatency.end(); it++)
+    (*it).second->Write(out, "spreadsheet_command_duration_seconds",
+        metricLabel("command", (*it).first));
+  metricHeader(out, "spreadsheet_edit_stage_duration_seconds", "histogram",
+      "Time taken by each stage of an edit.  The wire stage covers every "
+      "message sent.");
+  for(int i = 0; i < SS_STAGES; i++) {
+    SpreadsheetSession::StageLatency(i).Write(out,
+        "spreadsheet_edit_stage_duration_seconds",
+        metricLabel("stage", SpreadsheetSession::StageName(i)));
+    if(i == SS_STAGE_BROADCAST)
+      StringSocket::SendLatency().Write(out,
+          "spreadsheet_edit_stage_duration_seconds",
+          metricLabel("stage", "wire"));
+  }
+  metricHeader(out, "spreadsheet_save_duration_seconds", "histogram",
+      "Time taken to save a spreadsheet to its file.");
+  SpreadsheetSession::SaveLatency().Write(out,
+      "spreadsheet_save_duration_seconds", "");
+  metricHeader(out, "spreadsheet_users_sync_duration_seconds", "histogram",
+      "Time taken to write and sync a batch of registered user names.");
+  this->registeredUsers.SyncLatency().Write(out,
+      "spreadsheet_users_sync_duration_seconds", "");
+
+
+  // The queues.
+  metricHeader(out, "spreadsheet_io_queue_depth", "gauge",
+      "Spreadsheet loads waiting for an I/O thread.");
+  out << "spreadsheet_io_queue_depth " << this->ioPool.Pending() << "\n";
+  metricHeader(out, "spreadsheet_send_queue_depth", "gauge",
+      "Messages waiting to be sent, over every connected client.");
+  out << "spreadsheet_send_queue_depth " << sendQueued << "\n";
+  metricHeader(out, "spreadsheet_send_queue_max", "gauge",
+      "Messages waiting to be sent to the client with the most.");
+  out << "spreadsheet_send_queue_max " << sendQueueMax << "\n";
+
+
+  // The open, loading and closed spreadsheets.  Each session is read while
+  //   the lock keeps it from being closed and evicted.
+  std::ostringstream memory, clients, edits;
+  this->openSpreadsheetsMutex.Lock(); {
+    metricHeader(out, "spreadsheet_sessions", "gauge", "Open spreadsheets.");
+    out << "spreadsheet_sessions " << this->openSpreadsheets.size() << "\n";
+    metricHeader(out, "spreadsheet_loading_sessions", "gauge",
+        "Spreadsheets being loaded.");
+    out << "spreadsheet_loading_sessions " << this->loadingSpreadsheets.size()
+        << "\n";
+
+    metricHeader(out, "spreadsheet_cache_sessions", "gauge",
+        "Closed spreadsheets kept in memory.");
+    out << "spreadsheet_cache_sessions " << this->closedSpreadsheets.Count()
+        << "\n";
+    metricHeader(out, "spreadsheet_cache_bytes", "gauge",
+        "Memory held by the closed spreadsheets kept.");
+    out << "spreadsheet_cache_bytes " << this->closedSpreadsheets.Bytes()
+        << "\n";
+    metricHeader(out, "spreadsheet_cache_hits_total", "counter",
+        "Spreadsheets reopened from memory.");
+    out << "spreadsheet_cache_hits_total " << this->closedSpreadsheets.Hits()
+        << "\n";
+    metricHeader(out, "spreadsheet_cache_misses_total", "counter",
+        "Spreadsheets opened from their files.");
+    out << "spreadsheet_cache_misses_total "
+        << this->closedSpreadsheets.Misses() << "\n";
+    metricHeader(out, "spreadsheet_cache_evictions_total", "counter",
+        "Closed spreadsheets dropped from memory.");
+    out << "spreadsheet_cache_evictions_total "
+        << this->closedSpreadsheets.Evictions() << "\n";
+
+    for(std::map<std::string, SpreadsheetSession *>::iterator it =
+        this->openSpreadsheets.begin(); it != this->openSpreadsheets.end();
+        it++) {
+      sessionStats stats;
+      (*it).second->GetStats(&stats, false);
+      std::string sheet = "{" + metricLabel("sheet", (*it).first) + "} ";
+      memory << "spreadsheet_session_memory_bytes" << sheet
+          << stats.memoryBytes << "\n";
+      clients << "spreadsheet_session_clients" << sheet << stats.clients
+          << "\n";
+      edits << "spreadsheet_session_edits_total" << sheet << stats.edits
+          << "\n";
+    }
+  } this->openSpreadsheetsMutex.Unlock();
+
+  metricHeader(out, "spreadsheet_session_memory_bytes", "gauge",
+      "Approximate memory held by each open spreadsheet.");
+  out << memory.str();
+  metricHeader(out, "spreadsheet_session_clients", "gauge",
+      "Clients of each open spreadsheet.");
+  out << clients.str();
+  metricHeader(out, "spreadsheet_session_edits_total", "counter",
+      "Cells edited in each open spreadsheet since it was opened.");
+  out << edits.str();
+
+
+  // The traffic over every socket, and the users.
+  socketStats totals;
+  StringSocket::GetTotals(&totals);
+  metricHeader(out, "spreadsheet_messages_received_total", "counter",
+      "Messages received from clients.");
+  out << "spreadsheet_messages_received_total " << totals.messagesIn << "\n";
+  metricHeader(out, "spreadsheet_messages_sent_total", "counter",
+      "Messages sent to clients.");
+  out << "spreadsheet_messages_sent_total " << totals.messagesOut << "\n";
+  metricHeader(out, "spreadsheet_received_bytes_total", "counter",
+      "Bytes received from clients.");
+  out << "spreadsheet_received_bytes_total " << totals.bytesIn << "\n";
+  metricHeader(out, "spreadsheet_sent_bytes_total", "counter",
+      "Bytes sent to clients.");
+  out << "spreadsheet_sent_bytes_total " << totals.bytesOut << "\n";
+  metricHeader(out, "spreadsheet_registered_users", "gauge",
+      "Registered user names.");
+  out << "spreadsheet_registered_users " << this->registeredUsers.Count()
+      << "\n";
+
+  // The locks, if the server was built to profile them.
+  ProfiledMutex::WriteMetrics(out);
+
+  return out.str();
+
+}
+
+
+std::string SpreadsheetServer::latencyReport() {
+
+  std::ostringstream out;
+  out << "Latency percentiles, in milliseconds:\n";
+
+  // The stages of an edit, in the order it goes through them.
+  for(int i = 0; i < SS_STAGES; i++) {
+    if(i == SS_STAGE_PERSIST) {
+      out << "stage wire ";
+      StringSocket::SendLatency().WritePercentiles(out);
+      out << "\n";
+    }
+    out << "stage " << SpreadsheetSession::StageName(i) << " ";
+    SpreadsheetSession::StageLatency(i).WritePercentiles(out);
+    out << "\n";
+  }
+
+  // The commands that were handled at least once.
+  for(std::map<std::string, LatencyHistogram *>::iterator it =
+      this->commandLatency.begin(); it != this->commandLatency.end(); it++) {
+    if((*it).second->Count() == 0)
+      continue;
+    out << "command " << (*it).first << " ";
+    (*it).second->WritePercentiles(out);
+    out << "\n";
+  }
+
+  out << "save ";
+  SpreadsheetSession::SaveLatency().WritePercentiles(out);
+  out << "\nusers_sync ";
+  this->registeredUsers.SyncLatency().WritePercentiles(out);
+  out << "\n";
+
+  // The locks, if the server was built to profile them.
+  ProfiledMutex::WriteReport(out);
+
+  return out.str();
+
+}
+
+
+/// <summary>
+///   Writes the HELP and TYPE lines of a metric.
+/// </summary>
+void SpreadsheetServer::metricHeader(std::ostream &out,
+    const std::string &name, const std::string &type,
+    const std::string &help) {
+
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " " << type << "\n";
+
+}
+
+
+/// <summary>
+///   Gets a label with its value escaped for the Prometheus text format.
+/// </summary>
+std::string SpreadsheetServer::metricLabel(const std::string &name,
+    const std::string &value) {
+
+  std::string label = name + "=\"";
+  for(size_t i = 0; i < value.length(); i++) {
+    if(value[i] == '\\' || value[i] == '"')
+      label += '\\';
+    if(value[i] == '\n')
+      label += "\\n";
+    else
+      label += value[i];
+  }
+
+  return label + "\"";
+
+}
+
+
+/// <summary>
+///   Gets the number of threads of the server process, from the Threads line
+///   of /proc/self/status.
+/// </summary>
+int SpreadsheetServer::threadCount() {
+
+  std::ifstream status("/proc/self/status");
+  std::string line;
+  while(std::getline(status, line))
+    if(line.compare(0, 8, "Threads:") == 0)
+      return atoi(line.c_str() + 8);
+
+  return 0;
+
+}
+
+
 void SpreadsheetServer::listenerAcceptCallback(int ex, StringSocket *socket,
     void *payload) {
   
-  std::cout << "Connection established: " << socket->ToString() << std::endl;
-  
-  
   // Get a SpreadsheetServer out of the payload.
   SpreadsheetServer *pthis = static_cast<SpreadsheetServer *>(payload);
   
@@ -606,76 +1797,255 @@ void SpreadsheetServer::listenerAcceptCallback(int ex, StringSocket *socket,
     return;
   
   
-  // Take care of the new socket if there were no exceptions.
-  if(ex == TL_NO_EXCEPTION) {
+  // Count the connection.
+  if(ex == TL_NO_EXCEPTION)
+    __sync_add_and_fetch(&pthis->acceptedConnections, 1);
+
+
+  // Take care of the new socket if there were no exceptions, and start
+  //   waiting for the next connection, unless the server is stopping and the
+  //   listener is about to be freed.
+  callbackState *state = NULL;
+  bool stopping;
+  pthis->callbackStatesMutex.Lock(); {
+    stopping = pthis->stopping;
+    if(!stopping && ex == TL_NO_EXCEPTION) {
       
-    // Create a new callbackState for the StringSocket.
-    callbackState *state =
-        static_cast<callbackState*>(malloc(sizeof(callbackState)));
-    state->clientPayload = socket;
-    state->p_this = pthis;
-    
-    
-    // Add the callbackState to the map of callbackStates.
-    pthread_mutex_lock(&pthis->callbackStatesMutex); {
+      // Create a new callbackState for the StringSocket, and add it to the map
+      //   of callbackStates.
+      state = new callbackState;
+      state->clientPayload = socket;
+      state->p_this = pthis;
+      state->capabilities = 0;
       pthis->callbackStates[socket] = state;
-    } pthread_mutex_unlock(&pthis->callbackStatesMutex);
+      
+    }
+    if(!stopping)
+      pthis->listener->BeginAcceptSocket(
+          SpreadsheetServer::listenerAcceptCallback, pthis);
+  } pthis->callbackStatesMutex.Unlock();
 
-    
-    // Start receiving messages on the StringSocket.
-    socket->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
-    
-  }
+
+  // A connection made as the server stops is closed right away.
+  if(stopping && ex == TL_NO_EXCEPTION)
+    socket->Close();
   
   
-  // Start waiting for the next connection.
-  pthis->listener->BeginAcceptSocket(SpreadsheetServer::listenerAcceptCallback,
-      pthis);
+  // Start receiving messages on the StringSocket.
+  if(state != NULL) {
+    std::cout << "Connection established: " << socket->ToString() << std::endl;
+    socket->BeginReceive(SpreadsheetServer::clientRecvCallback, state);
+  }
   
 }
 
 
-void SpreadsheetServer::loadUsernames() {
-  
-  // Add sysadmin to the set of registered names.
-  this->registeredUsernames.insert("sysadmin");
-  
-  
-  // Open the users text file for reading.
-  std::ifstream users("users");
-  
-  
-  // Add each name to the set of usernames from the text file.
-  std::string name;
-  while(users.peek() != EOF) {
-    name = "";
-    std::getline(users, name);
-    if(name != "")
-      this->registeredUsernames.insert(name);
+void SpreadsheetServer::adminAcceptCallback(int ex, StringSocket *socket,
+    void *payload) {
+
+  SpreadsheetServer *pthis = static_cast<SpreadsheetServer *>(payload);
+  if(pthis == NULL)
+    return;
+
+
+  // Keep track of the new socket, and wait for the next one, unless the
+  //   server is stopping and the admin listener is about to be freed.
+  adminState *state = NULL;
+  bool stopping;
+  pthis->callbackStatesMutex.Lock(); {
+    stopping = pthis->stopping;
+    if(!stopping && ex == TL_NO_EXCEPTION) {
+      state = new adminState;
+      state->socket = socket;
+      state->p_this = pthis;
+      state->lines = 0;
+      pthis->adminStates[socket] = state;
+    }
+    if(!stopping)
+      pthis->adminListener->BeginAcceptSocket(
+          SpreadsheetServer::adminAcceptCallback, pthis);
+  } pthis->callbackStatesMutex.Unlock();
+
+
+  if(stopping && ex == TL_NO_EXCEPTION)
+    socket->Close();
+
+  if(state != NULL)
+    socket->BeginReceive(SpreadsheetServer::adminRecvCallback, state);
+
+}
+
+
+void SpreadsheetServer::adminRecvCallback(std::string message, int ex,
+    void *payload) {
+
+  adminState *state = static_cast<adminState *>(payload);
+  if(state == NULL)
+    return;
+
+  StringSocket *socket = state->socket;
+  SpreadsheetServer *p_this = state->p_this;
+  if(!p_this->enterCallback())
+    return;
+
+
+  // Free the socket if the other end closes it before the request ends.
+  if(ex != SS_NO_EXCEPTION) {
+    p_this->freeAdminSocket(socket);
+    p_this->leaveCallback();
+    return;
   }
-  if(name != "")
-    this->registeredUsernames.insert(name);
-  
-  
-  // Close the users text file.
-  users.close();
-  
+
+
+  // Read the request line and the headers up to the blank line that ends
+  //   them.  Anything sent after them is ignored.
+  if(!message.empty() && message[message.length() - 1] == '\r')
+    message.erase(message.length() - 1);
+  if(state->lines++ == 0)
+    state->request = message;
+
+  if(message.empty() || state->lines >= SERVER_ADMIN_MAX_LINES) {
+
+    // Only GET /metrics, or /, and GET /latency are served.
+    std::istringstream request(state->request);
+    std::string method, path;
+    request >> method >> path;
+
+    std::string status = "200 OK";
+    std::string body;
+    if(method != "GET") {
+      status = "405 Method Not Allowed";
+      body = "Only GET is supported.\n";
+    }
+    else if(path == "/latency")
+      body = p_this->latencyReport();
+    else if(path != "/metrics" && path != "/") {
+      status = "404 Not Found";
+      body = "Metrics are served at /metrics and latencies at /latency.\n";
+    }
+    else
+      body = p_this->metricsText();
+
+    std::ostringstream response;
+    response << "HTTP/1.0 " << status << "\r\n"
+        << "Content-Type: text/plain; version=0.0.4\r\n"
+        << "Content-Length: " << body.length() << "\r\n"
+        << "Connection: close\r\n\r\n" << body;
+
+    // The send callback closes the connection once the response is out.
+    socket->BeginSend(response.str(), SpreadsheetServer::adminSendCallback,
+        state);
+  }
+
+  // Wait for more of the request.
+  else
+    socket->BeginReceive(SpreadsheetServer::adminRecvCallback, state);
+  p_this->leaveCallback();
+
 }
 
 
-void SpreadsheetServer::saveUsernames() {
-  
-  // Open the users text file for writing.
-  std::ofstream users("users");
-  
-  
-  // Write all the user names to the text file.
-  for(std::set<std::string>::iterator it = this->registeredUsernames.begin();
-      it != this->registeredUsernames.end(); it++)
-    users << *it << "\n";
+void SpreadsheetServer::adminSendCallback(int ex, void *payload) {
+
+  adminState *state = static_cast<adminState *>(payload);
+  if(state == NULL)
+    return;
+
+  SpreadsheetServer *p_this = state->p_this;
+  if(!p_this->enterCallback())
+    return;
+
+  // The response has been sent, or could not be, so the connection is done.
+  p_this->freeAdminSocket(state->socket);
+  p_this->leaveCallback();
+
+}
+
+
+void SpreadsheetServer::freeAdminSocket(StringSocket *socket) {
+
+  bool removed = false;
+  this->callbackStatesMutex.Lock(); {
+    std::map<StringSocket *, adminState *>::iterator it =
+        this->adminStates.find(socket);
+    if(it != this->adminStates.end()) {
+      delete (*it).second;
+      this->adminStates.erase(it);
+      removed = true;
+    }
+  } this->callbackStatesMutex.Unlock();
+
+  if(removed)
+    freeStringSocket(&socket);
+
+}
+
+
+void * SpreadsheetServer::dumpLatencies(void *server) {
+
+  SpreadsheetServer *pthis = static_cast<SpreadsheetServer *>(server);
+
+  sigset_t dumpSignal;
+  sigemptyset(&dumpSignal);
+  sigaddset(&dumpSignal, SIGUSR1);
+
+  while(true) {
+    int signal;
+    if(sigwait(&dumpSignal, &signal) != 0)
+      break;
+
+    // Stop sends the signal itself once the server is stopping.
+    bool stopping;
+    pthis->callbackStatesMutex.Lock(); {
+      stopping = pthis->stopping;
+    } pthis->callbackStatesMutex.Unlock();
+    if(stopping)
+      break;
+
+    std::cout << pthis->latencyReport() << std::flush;
+  }
+
+  return NULL;
+
+}
+
+
+/// <summary>
+///   Parses the info of a batch command into cell names and contents.
+/// </summary>
+bool SpreadsheetServer::parseBatch(const std::string &info,
+    std::vector<std::pair<std::string, std::string> > *edits) {
   
+  size_t pos = 0;
+  while(pos < info.length()) {
+    
+    // Read the cell name and the length of its contents.
+    size_t br = info.find(' ', pos);
+    if(br == std::string::npos || br == pos)
+      return false;
+    std::string name = info.substr(pos, br - pos);
+    
+    pos = br + 1;
+    size_t length = 0;
+    size_t digits = pos;
+    while(pos < info.length() && info[pos] >= '0' && info[pos] <= '9')
+      length = length * 10 + (info[pos++] - '0');
+    if(pos == digits || pos >= info.length() || info[pos] != ' ')
+      return false;
+    
+    // Take exactly that many characters of contents.
+    pos++;
+    if(length > info.length() - pos)
+      return false;
+    edits->push_back(std::make_pair(name, info.substr(pos, length)));
+    pos += length;
+    
+    // Entries are separated by a single space.
+    if(pos < info.length() && info[pos++] != ' ')
+      return false;
+    
+  }
   
-  // Close the users text file.
-  users.close();
+  return true;
   
 }
\ No newline at end of file
@@ -4,7 +4,7 @@
   CS 3505 - Spring 2015
   Team SegFault
   Date created: April 5, 2015
-  Last updated: April 21, 2015
+  Last updated: October 18, 2026
 *******************************************************************************/
 
 
@@ -16,6 +16,11 @@
 // Project headers.
 //
 #include "SpreadsheetSession.h"
+#include "SessionCache.h"
+#include "LatencyHistogram.h"
+#include "ProfiledMutex.h"
+#include "ThreadPool.h"
+#include "UserRegistry.h"
 #include "StringSocket.h"
 #include "TcpListener.h"
 
@@ -30,11 +35,36 @@
 // Standard libraries.
 //
 #include <map>
-#include <set>
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 
 
+//
+// Number of threads that save spreadsheets while the server stops.
+//
+#define SERVER_SAVE_THREADS 8
+
+//
+// Seconds the server waits for spreadsheets to be saved while it stops, by
+//   default.
+//
+#define SERVER_STOP_DEADLINE 30
+
+//
+// Number of header lines an admin request may have before it is answered
+//   anyway.
+//
+#define SERVER_ADMIN_MAX_LINES 64
+
+//
+// Bit of runningCallbacks set once the server is stopping, after which no
+//   more callbacks are let in.
+//
+#define SERVER_CALLBACKS_CLOSED 0x40000000
+
+
 /// <summary>
 ///   Represents a server for hosting spreadsheets that can be edited by
 ///   multiple concurrent users.
@@ -51,7 +81,72 @@ private :
                                     //   callback.
 		SpreadsheetServer *p_this;      // A pointer to the SpreadsheetServer object
                                     //   that the StringSocket belongs to.
+		unsigned int capabilities;      // The SS_CAP_ flags the client asked for.
+		std::string username;           // The registered name the client
+                                    //   connected as, or empty.
 	} callbackState;
+
+
+  /// <summary>
+  ///   A client waiting for the spreadsheet it connected to to be loaded.
+  /// </summary>
+	typedef struct waitingClient {
+		StringSocket *client;           // The client.
+		callbackState *state;           // The callback state of the client.
+		unsigned long long lastVersion; // The version the client reconnected
+                                    //   from, or 0.
+	} waitingClient;
+
+
+  /// <summary>
+  ///   A spreadsheet being loaded on the I/O pool, or being saved as its last
+  ///   client leaves, and the clients waiting for it.  Used as the payload of
+  ///   the load job.
+  /// </summary>
+	typedef struct pendingOpen {
+		SpreadsheetServer *server;      // The server loading the spreadsheet.
+		std::string name;               // The name of the spreadsheet.
+		std::vector<waitingClient> waiting; // The clients to add once loaded.
+	} pendingOpen;
+
+
+  /// <summary>
+  ///   How far the saves made while the server stops have got.  Shared by the
+  ///   save jobs.
+  /// </summary>
+	typedef struct saveProgress {
+		pthread_mutex_t mutex;          // Guards the members below.
+		pthread_cond_t finished;        // Signalled as each save finishes.
+		size_t done;                    // The number of saves finished.
+		bool cancelled;                 // Whether the deadline has passed, so
+                                    //   saves not yet started are skipped.
+		struct timespec deadline;       // When saves still running give up,
+                                    //   on CLOCK_REALTIME.
+	} saveProgress;
+
+
+  /// <summary>
+  ///   A spreadsheet to save while the server stops.  Used as the payload of
+  ///   the save job.
+  /// </summary>
+	typedef struct saveJob {
+		SpreadsheetSession *session;    // The spreadsheet to save.
+		saveProgress *progress;         // The progress shared by every job.
+		int result;                     // 0 until the job runs, then 1 if the
+                                    //   spreadsheet was saved, 2 if it could
+                                    //   not be and 3 if it was skipped.
+	} saveJob;
+
+
+  /// <summary>
+  ///   Used as the payload for the callbacks of a socket on the admin port.
+  /// </summary>
+	typedef struct adminState {
+		StringSocket *socket;           // The socket of the request.
+		SpreadsheetServer *p_this;      // The server the socket belongs to.
+		std::string request;            // The first line of the request.
+		int lines;                      // The number of lines received.
+	} adminState;
   
 
 public :
@@ -62,7 +157,13 @@ public :
   /// <param name="portNumber">
   ///   The specific port number to listen for connections.
   /// </param>
-	SpreadsheetServer(std::string portNumber);
+  /// <param name="cacheBytes">
+  ///   The number of bytes of closed spreadsheets to keep in memory.
+  /// </param>
+  /// <param name="cachePolicy">
+  ///   The SC_EVICT_ policy for closed spreadsheets.
+  /// </param>
+	SpreadsheetServer(std::string portNumber, size_t cacheBytes, int cachePolicy);
   
   
   /// <summary>
@@ -84,9 +185,25 @@ public :
   
   
   /// <summary>
-  ///   Shuts down the server.
+  ///   Shuts down the server.  The open spreadsheets with unsaved changes are
+  ///   saved in parallel, for as long as the stop deadline allows.
   /// </summary>
 	void Stop();
+  
+  
+  /// <summary>
+  ///   Sets the number of seconds that Stop waits for spreadsheets to be
+  ///   saved.  Saves that have not started by then are skipped, and saves
+  ///   still running give up, leaving their files as they were.
+  /// </summary>
+	void SetStopDeadline(int seconds);
+
+
+  /// <summary>
+  ///   Sets the port on which metrics are served to the local host, in the
+  ///   Prometheus text format.  Empty, the default, serves none.
+  /// </summary>
+	void SetAdminPort(std::string portNumber);
 
   
 private :	
@@ -100,26 +217,31 @@ private :
   ///   Keeps track of the TcpListener for accepting socket connections.
   /// </summary>
 	TcpListener *listener;
-  
+
   /// <summary>
-  ///   Lock object for the associatedSpreadsheets map.
+  ///   Keeps track of the port on which metrics are served, or empty.
   /// </summary>
-  pthread_mutex_t associatedSpreadsheetsMutex;
+	std::string adminPort;
+
+  /// <summary>
+  ///   Keeps track of the TcpListener for the admin port, or NULL.
+  /// </summary>
+	TcpListener *adminListener;
   
   /// <summary>
-  ///   Lock object for the openSpreadsheets map.
+  ///   Lock object for the associatedSpreadsheets map.
   /// </summary>
-  pthread_mutex_t openSpreadsheetsMutex;
+  ProfiledMutex associatedSpreadsheetsMutex;
   
   /// <summary>
-  ///   Lock object for the registeredUsernames set.
+  ///   Lock object for the openSpreadsheets map.
   /// </summary>
-  pthread_mutex_t registeredUsernamesMutex;
+  ProfiledMutex openSpreadsheetsMutex;
   
   /// <summary>
   ///   Lock object for the callbackStates map.
   /// </summary>
-  pthread_mutex_t callbackStatesMutex;
+  ProfiledMutex callbackStatesMutex;
 
   /// <summary>
   ///   Keeps track of associations between a SpreadsheetSession and
@@ -134,15 +256,86 @@ private :
 	std::map<std::string, SpreadsheetSession *> openSpreadsheets;
   
   /// <summary>
-  ///   Keeps track of all registered user names.
+  ///   Keeps spreadsheets that every client has closed in memory for a while.
+  ///   Guarded by the lock of the openSpreadsheets map.
+  /// </summary>
+	SessionCache closedSpreadsheets;
+  
+  /// <summary>
+  ///   Keeps track of the spreadsheets being loaded, or saved as they close, by
+  ///   name.  Guarded by the lock of the openSpreadsheets map.
+  /// </summary>
+	std::map<std::string, pendingOpen *> loadingSpreadsheets;
+  
+  /// <summary>
+  ///   Runs the loads of spreadsheets, off the threads that serve sockets.
+  /// </summary>
+	ThreadPool ioPool;
+  
+  /// <summary>
+  ///   The number of seconds that Stop waits for spreadsheets to be saved.
+  /// </summary>
+	int stopDeadline;
+  
+  /// <summary>
+  ///   Whether the server is stopping, after which the receive callbacks of
+  ///   closed sockets leave the sockets and sessions to Stop.  Guarded by the
+  ///   lock of the callbackStates map.
+  /// </summary>
+	bool stopping;
+  
+  /// <summary>
+  ///   The number of receive callbacks running, plus SERVER_CALLBACKS_CLOSED
+  ///   once the server is stopping.  Only changed atomically.
+  /// </summary>
+	int runningCallbacks;
+
+  /// <summary>
+  ///   Signalled, with the lock of the callbackStates map, when the last
+  ///   callback running leaves after the server began stopping.
+  /// </summary>
+	pthread_cond_t callbacksFinished;
+  
+  /// <summary>
+  ///   Keeps track of all registered user names, in memory and in the users
+  ///   file.
   /// </summary>
-	std::set<std::string> registeredUsernames;
+	UserRegistry registeredUsers;
   
   /// <summary>
   ///   Keeps track of associations between a StringSocket and callbackState.
   /// </summary>
 	std::map<StringSocket *, callbackState *> callbackStates;
 
+  /// <summary>
+  ///   Keeps track of the sockets on the admin port.  Guarded by the lock of
+  ///   the callbackStates map.
+  /// </summary>
+	std::map<StringSocket *, adminState *> adminStates;
+
+  /// <summary>
+  ///   The number of clients accepted since the server started.
+  /// </summary>
+	unsigned long long acceptedConnections;
+
+  /// <summary>
+  ///   How long each command took to be handled, by command.  Commands that
+  ///   are not known are counted as "other".  Filled in by the constructor and
+  ///   only read afterwards.
+  /// </summary>
+	std::map<std::string, LatencyHistogram *> commandLatency;
+
+  /// <summary>
+  ///   The thread that writes the latency report to the standard output each
+  ///   time the process is sent SIGUSR1.
+  /// </summary>
+	pthread_t latencyDumper;
+
+  /// <summary>
+  ///   Whether the latencyDumper thread was started.
+  /// </summary>
+	bool latencyDumperRunning;
+
   
   /// <summary>
   ///   The callback for the StringSocket::BeginSend method.
@@ -156,23 +349,163 @@ private :
 	static void clientRecvCallback(std::string message, int ex, void *payload);
   
   
+  /// <summary>
+  ///   Counts a receive callback as running, unless the server is stopping.
+  /// </summary>
+  /// <returns>Whether the callback may go on.</returns>
+  bool enterCallback();
+
+
+  /// <summary>
+  ///   Counts a receive callback as finished, waking Stop if it was the last
+  ///   one it waits for.
+  /// </summary>
+  void leaveCallback();
+
+
+  /// <summary>
+  ///   Handles a message received from a client, or the client closing.
+  /// </summary>
+	static void handleMessage(std::string message, int ex, void *payload);
+  
+  
   /// <summary>
   ///   The callback for the TcpListener::BeginAcceptSocket method.
   /// </summary>
   static void listenerAcceptCallback(int ex, StringSocket *socket,
       void *payload);
+
+
+  /// <summary>
+  ///   The callback for the BeginAcceptSocket method of the admin listener.
+  /// </summary>
+  static void adminAcceptCallback(int ex, StringSocket *socket,
+      void *payload);
+
+
+  /// <summary>
+  ///   The callback for the BeginReceive method of a socket on the admin
+  ///   port.  Reads an HTTP request line by line and answers it with the
+  ///   metrics once its headers end.
+  /// </summary>
+  static void adminRecvCallback(std::string message, int ex, void *payload);
+
+
+  /// <summary>
+  ///   The callback for the BeginSend method of a socket on the admin port.
+  ///   Closes the connection once the response has been sent.
+  /// </summary>
+  static void adminSendCallback(int ex, void *payload);
+
+
+  /// <summary>
+  ///   Removes a socket on the admin port and its state from the adminStates
+  ///   map and frees them, unless a server that began stopping has taken them
+  ///   over.
+  /// </summary>
+  void freeAdminSocket(StringSocket *socket);
+
+
+  /// <summary>
+  ///   Entry point of the latencyDumper thread.  Waits for SIGUSR1, which
+  ///   every other thread blocks, and writes the latency report each time it
+  ///   arrives, until the server stops.
+  /// </summary>
+  /// <param name="server">The SpreadsheetServer.</param>
+  static void * dumpLatencies(void *server);
+  
+  
+  /// <summary>
+  ///   Loads a spreadsheet on the I/O pool, then opens it and adds every
+  ///   client that waited for it, or sends them each an error if it could not
+  ///   be loaded.
+  /// </summary>
+  /// <param name="payload">The pendingOpen of the spreadsheet.</param>
+  static void loadSpreadsheet(void *payload);
+
+
+  /// <summary>
+  ///   Opens a spreadsheet that was loaded or saved and adds every client that
+  ///   waited for it, or puts it in the cache of closed spreadsheets if none
+  ///   did.  Sends the clients an error if it could not be loaded.
+  /// </summary>
+  /// <param name="open">The pendingOpen of the spreadsheet, which is freed.</param>
+  /// <param name="session">The spreadsheet, or NULL if it could not be loaded.</param>
+  static void finishOpen(pendingOpen *open, SpreadsheetSession *session);
+  
+  
+  /// <summary>
+  ///   Saves a spreadsheet on the save pool while the server stops, unless
+  ///   the deadline has passed.
+  /// </summary>
+  /// <param name="payload">The saveJob of the spreadsheet.</param>
+  static void saveSpreadsheet(void *payload);
+  
+  
+  /// <summary>
+  ///   Saves every open spreadsheet with unsaved changes in parallel, reporting
+  ///   progress, until they are all saved or the stop deadline passes.
+  /// </summary>
+  void saveSpreadsheets();
   
   
   /// <summary>
-  ///   Loads the set of usernames from the users file.
+  ///   Gets the "stats" message: the counters of the server, of each open
+  ///   spreadsheet and of each connected socket, one line each.
+  /// </summary>
+  std::string statsMessage();
+
+
+  /// <summary>
+  ///   Gets the metrics of the server in the Prometheus text format.
+  /// </summary>
+  std::string metricsText();
+
+
+  /// <summary>
+  ///   Gets the percentiles of every stage of an edit and of every command
+  ///   handled so far, in milliseconds, one line each.
+  /// </summary>
+  std::string latencyReport();
+
+
+  /// <summary>
+  ///   Writes the HELP and TYPE lines of a metric.
+  /// </summary>
+  static void metricHeader(std::ostream &out, const std::string &name,
+      const std::string &type, const std::string &help);
+
+
+  /// <summary>
+  ///   Gets a label with its value escaped for the Prometheus text format,
+  ///   such as sheet="a\"b".
+  /// </summary>
+  static std::string metricLabel(const std::string &name,
+      const std::string &value);
+
+
+  /// <summary>
+  ///   Gets the number of threads of the server process, or 0 if it cannot
+  ///   be read.
   /// </summary>
-  void loadUsernames();
+  static int threadCount();
   
   
   /// <summary>
-  ///   Saves the set of usernames to the users file.
+  ///   Parses the info of a batch command into cell names and contents.
   /// </summary>
-  void saveUsernames();
+  /// <param name="info">
+  ///   The entries of the batch, each of the form "name length contents",
+  ///   separated by single spaces.  The length is the number of characters
+  ///   in the contents, which may themselves contain spaces.
+  /// </param>
+  /// <param name="edits">
+  ///   An output parameter for the cell names and contents.
+  /// </param>
+  /// <returns>True if the info was well formed; otherwise, false.</returns>
+  static bool parseBatch(const std::string &info,
+      std::vector<std::pair<std::string, std::string> > *edits);
+
 
 };
 
@@ -3,19 +3,80 @@ File: SpreadsheetSession.cpp
 Author: Garrett Bigelow, CJ Dimaano
 CS 3505 - Spring 2015
 Date created: April 5, 2015
-Last updated: April 24, 2015
+Last updated: October 18, 2026
 *******************************************************************************/
 
 
 #include "SpreadsheetSession.h"
 #include "StringSocket.h"
+#include "CellAddress.h"
+#include "MessageCodec.h"
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
+#include <fcntl.h>
 #include <sys/stat.h>
+#include <unistd.h>
 
 using namespace std;
 
+// Undo records of a layout change carry the change in their key instead of a cell
+#define SS_LAYOUT_BIT    (1ULL << 62)
+#define SS_LAYOUT_ROWS   (1ULL << 61)
+#define SS_LAYOUT_DELETE (1ULL << 60)
+#define SS_LAYOUT_KEY(rows, at, count) (SS_LAYOUT_BIT | ((rows) ? SS_LAYOUT_ROWS : 0) | ((count) < 0 ? SS_LAYOUT_DELETE : 0) | ((cellKey)(at) << 24) | (cellKey)abs(count))
+
+// Versions start from the time the sheet was opened, shifted by this many bits, so
+// that a version a client saw before the sheet was reopened is never taken as a later one
+#define SS_VERSION_TIME_SHIFT 20
+
+int SpreadsheetSession::defaultCoalesceWindow = 0;
+LatencyHistogram SpreadsheetSession::saveLatency;
+LatencyHistogram SpreadsheetSession::stageLatency[SS_STAGES];
+
+// Names of the SS_STAGE_ stages
+static const char * const stageNames[SS_STAGES] = { "dispatch", "lock", "graph", "broadcast", "persist", "total" };
+
+/// <summary>
+///		Gets the current time in milliseconds, on the clock that condition
+///		variables time out against.
+/// </summary>
+static unsigned long long nowMillis()
+{
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (unsigned long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+/// <summary>
+///		Attempts to read non-formula cell contents as a number. The whole string,
+///		apart from surrounding spaces, must be consumed.
+/// </summary>
+static bool parseNumber(const string &contents, double *value)
+{
+	const char *start = contents.c_str();
+	while (*start == ' ')
+		start++;
+	if (*start == '\0')
+		return false;
+
+	char *end;
+	double v = strtod(start, &end);
+	if (end == start)
+		return false;
+	while (*end == ' ')
+		end++;
+	if (*end != '\0')
+		return false;
+
+	*value = v;
+	return true;
+}
+
 /// <summary>
 ///		Constructs a spreadsheet session with the given name. Does not load the spreadsheet or 
 ///		add any clients.
@@ -23,19 +84,24 @@ using namespace std;
 ///		If the name does not include a ".txt" extension, adds the extension to the name.
 /// </summary>
 SpreadsheetSession::SpreadsheetSession(string name)
+  : history(strings), rowMap(CA_MAX_ROW + 1), colMap(CA_MAX_COL + 1), rowExtent(0), colExtent(0), sheetVersion((unsigned long long)time(NULL) << SS_VERSION_TIME_SHIFT), changeLogCells(0), snapshot(NULL), savedVersion(0), savedCells(0), coalesceWindow(defaultCoalesceWindow), burstVersion(0), burstLast(0), heldSince(0), flusherRunning(false), flusherStopping(false), editedCells(0), statsEditedCells(0), statsTaken(nowMillis()), graphUpdated(0), dirtySince(0), clientsMutex("session.clients"), cellsMutex("session.cells")
 {
+  changeLogBase = sheetVersion;
   sprdName = name;
-  pthread_mutex_init(&clientsMutex, NULL);
-  pthread_mutex_init(&cellsMutex, NULL);
+  pthread_cond_init(&flushCond, NULL);
 }
 
 /// <summary>
-///		Copy constructor
+///		Copy constructor. The copy starts with an empty undo history, since the
+///		history belongs to the open log file of the original, and with no burst
+///		of edits going on.
 /// </summary>
 SpreadsheetSession::SpreadsheetSession(const SpreadsheetSession & other)
-  : sprdName(other.sprdName), history(other.history), clientNames(other.clientNames), clientSockets(other.clientSockets), cellMap(other.cellMap), depGraph(other.depGraph), clientsMutex(other.clientsMutex), cellsMutex(other.cellsMutex)
+  : sprdName(other.sprdName), clientNames(other.clientNames), clientSockets(other.clientSockets), strings(other.strings), history(strings), cells(other.cells), rowMap(other.rowMap), colMap(other.colMap), rowExtent(other.rowExtent), colExtent(other.colExtent), looseFormulas(other.looseFormulas), templates(other.templates), cellValues(other.cellValues), depGraph(other.depGraph), rangeReaders(other.rangeReaders), sheetVersion(other.sheetVersion), changeLog(other.changeLog), changeLogCells(other.changeLogCells), changeLogBase(other.changeLogBase), snapshot(other.snapshot), savedVersion(other.savedVersion), savedCells(other.savedCells), viewports(other.viewports), coalesceWindow(other.coalesceWindow), burstVersion(0), burstLast(0), heldSince(0), flusherRunning(false), flusherStopping(false), editedCells(other.editedCells), statsEditedCells(other.statsEditedCells), statsTaken(other.statsTaken), graphUpdated(0), dirtySince(other.dirtySince), clientsMutex("session.clients"), cellsMutex("session.cells")
 {
-	// Does nothing
+	pthread_cond_init(&flushCond, NULL);
+	if (snapshot != NULL)
+		snapshot->Retain();
 }
 
 /// <summary>
@@ -43,8 +109,21 @@ SpreadsheetSession::SpreadsheetSession(const SpreadsheetSession & other)
 /// </summary>
 SpreadsheetSession::~SpreadsheetSession()
 {
-	pthread_mutex_destroy(&clientsMutex);
-	pthread_mutex_destroy(&cellsMutex);
+	if (flusherRunning)
+	{
+		cellsMutex.Lock();
+		flusherStopping = true;
+		pthread_cond_signal(&flushCond);
+		cellsMutex.Unlock();
+		pthread_join(flusher, NULL);
+	}
+
+	for (map<StringSocket*, SnapshotStream*>::iterator it = joining.begin(); it != joining.end(); it++)
+		it->second->Close();
+	if (snapshot != NULL)
+		snapshot->Release();
+
+	pthread_cond_destroy(&flushCond);
 }
 
 /// <summary>
@@ -52,70 +131,347 @@ SpreadsheetSession::~SpreadsheetSession()
 ///		and adds the edit to the stack history. If there is a circular exception, sends an edit 
 ///		command to the client to undo their edit.
 ///
-///		Returns whether or not an edit was made.
+///		Returns whether or not an edit was made. Names that are not cell
+///		addresses are never edited. If version is not NULL, it is set to the
+///		version of the sheet that first includes the edit.
 /// </summary>
-bool SpreadsheetSession::EditCell(string cellName, string cellContents)
+bool SpreadsheetSession::EditCell(string cellName, string cellContents, unsigned long long *version)
 {
-	pthread_mutex_lock(&cellsMutex);
+	return EditCells(vector< pair<string, string> >(1, make_pair(cellName, cellContents)), version);
+}
 
-  string oldContents = cellMap[cellName];
-  if(oldContents == "")
-    cellMap.erase(cellName);
-  
-  // Return false if editing the cell would result in a circular dependency.
-  if(!updateCell(cellName, cellContents)) {
-    pthread_mutex_unlock(&cellsMutex);
+/// <summary>
+///		Applies the edits of many cells as one transaction. The whole batch is
+///		checked for circular dependencies at once, becomes a single entry in the
+///		history, goes out to each client as a single message, and is saved once.
+///		If a cell is edited more than once, its last edit wins. Edits that would
+///		leave a cell as it is are left out.
+///
+///		Within the coalescing window, edits of exactly the cells of the last edit
+///		are merged into it: they are applied and versioned at once, but share the
+///		history entry of the first edit, so an undo goes back to before them all,
+///		and are sent to clients and saved when the window runs out.
+///
+///		Returns whether or not the edits were made. No edit is made if any name
+///		is not a cell address or if the edits together would result in a circular
+///		dependency. If version is not NULL, it is set to the version of the sheet
+///		that first includes the edits.
+/// </summary>
+bool SpreadsheetSession::EditCells(const vector< pair<string, string> > &edits, unsigned long long *version)
+{
+	// Parse the names once; everything below works on packed positions.
+	map<cellKey, string> changes;
+	for (size_t i = 0; i < edits.size(); i++)
+	{
+		int col, row;
+		if (!ParseCellName(edits[i].first, &col, &row))
+			return false;
+		changes[CA_KEY(col, row)] = edits[i].second;
+	}
+	if (changes.empty()) {
+		if (version != NULL)
+			*version = GetVersion();
+		return true;
+	}
+
+	unsigned long long start = LatencyHistogram::NowMicros();
+	cellsMutex.Lock();
+	unsigned long long locked = LatencyHistogram::NowMicros();
+	stageLatency[SS_STAGE_LOCK].Record(locked - start);
+	graphUpdated = 0;
+
+  // Return false if the edits would result in a circular dependency.
+	bool held;
+  if(!coalesceEdits(changes, &held) || (!held && !commitEdits(changes, ""))) {
+    cellsMutex.Unlock();
     return false;
   }
-  
-  // Update the edit history.
-	history.push(make_pair(cellName, oldContents));
 
-	// Send to clients
-	for (set<StringSocket*>::iterator it = clientSockets.begin(); it != clientSockets.end(); it++)
+	// Time the stages the edits went through. Held edits are broadcast later,
+	// by the flusher.
+	if (graphUpdated != 0)
+	{
+		unsigned long long queued = LatencyHistogram::NowMicros();
+		unsigned long long received = StringSocket::ReceivedMicros();
+		stageLatency[SS_STAGE_GRAPH].Record(graphUpdated - locked);
+		if (!held)
+			stageLatency[SS_STAGE_BROADCAST].Record(queued - graphUpdated);
+		if (!held && received != 0)
+			stageLatency[SS_STAGE_TOTAL].Record(queued - received);
+	}
+
+	// Later edits of the same cells are merged into this one.
+	if (!held && !changes.empty() && coalesceWindow > 0)
 	{
-    sendCell(cellName, cellContents, *it);
+		burstCells.clear();
+		for (map<cellKey, string>::iterator it = changes.begin(); it != changes.end(); it++)
+			burstCells.insert(it->first);
+		burstVersion = sheetVersion;
+		burstLast = nowMillis();
 	}
 
-	pthread_mutex_unlock(&cellsMutex);
+	if (version != NULL)
+		*version = sheetVersion;
+
+	cellsMutex.Unlock();
   
-  // Save the spreadsheet.
-  this->Save();
+  // Save the spreadsheet, unless nothing changed or the flusher saves it later.
+  if (!held && !changes.empty())
+    this->Save();
 
 	return true;
 }
 
+/// <summary>
+///		Repeats the block of cells with the given corners over the destination
+///		range, shifting relative references in formulas to each new position.
+///		Filling A1:C1 over A2:C100 fills the first row down; the block is tiled
+///		when the destination is larger than it in both directions.
+///
+///		Returns whether or not the range was filled.
+/// </summary>
+bool SpreadsheetSession::FillRange(int col0, int row0, int col1, int row1, int destCol0, int destRow0, int destCol1, int destRow1)
+{
+	return fillRange(col0, row0, col1, row1, destCol0, destRow0, destCol1, destRow1, "fill " + FormatCellRange(col0, row0, col1, row1) + " " + FormatCellRange(destCol0, destRow0, destCol1, destRow1));
+}
+
+/// <summary>
+///		Copies the block of cells with the given corners so that its top left
+///		cell lands on the destination cell, shifting relative references in
+///		formulas by the same amount. Empty cells of the block empty the cells
+///		they land on.
+///
+///		Returns whether or not the block was copied.
+/// </summary>
+bool SpreadsheetSession::CopyRange(int col0, int row0, int col1, int row1, int destCol, int destRow)
+{
+	int destCol1 = destCol + col1 - col0;
+	int destRow1 = destRow + row1 - row0;
+	if (destCol1 > CA_MAX_COL || destRow1 > CA_MAX_ROW)
+		return false;
+
+	return fillRange(col0, row0, col1, row1, destCol, destRow, destCol1, destRow1, "copy " + FormatCellRange(col0, row0, col1, row1) + " " + FormatCellName(destCol, destRow));
+}
+
+/// <summary>
+///		Repeats a block of cells over a range as one transaction, sending the
+///		given range message to clients that can apply it themselves.
+/// </summary>
+bool SpreadsheetSession::fillRange(int col0, int row0, int col1, int row1, int destCol0, int destRow0, int destCol1, int destRow1, const string &rangeMessage)
+{
+	if ((long)(destCol1 - destCol0 + 1) * (destRow1 - destRow0 + 1) > SS_MAX_RANGE_CELLS)
+		return false;
+
+	int width = col1 - col0 + 1;
+	int height = row1 - row0 + 1;
+
+	cellsMutex.Lock();
+
+	// Blank out the destination, then lay each cell of the block down at every
+	// position of the destination that lines up with it.
+	map<cellKey, string> changes;
+	vector<placedCell> found;
+	collectCells(destCol0, destRow0, destCol1, destRow1, &found);
+	for (size_t i = 0; i < found.size(); i++)
+		changes[CA_KEY(found[i].col, found[i].row)] = "";
+
+	collectCells(col0, row0, col1, row1, &found);
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		for (int r = destRow0 + found[i].row - row0; r <= destRow1; r += height)
+			for (int c = destCol0 + found[i].col - col0; c <= destCol1; c += width)
+				changes[CA_KEY(c, r)] = cellText(*found[i].entry, c, r);
+	}
+
+	bool filled = commitEdits(changes, rangeMessage);
+
+	cellsMutex.Unlock();
+
+	if (filled && !changes.empty())
+		this->Save();
+
+	return filled;
+}
+
+/// <summary>
+///		Moves the block of cells with the given corners so that its top left
+///		cell lands on the destination cell. Moved formulas keep referring to the
+///		same cells, and the cells that the block leaves behind are emptied.
+///
+///		Returns whether or not the block was moved.
+/// </summary>
+bool SpreadsheetSession::MoveRange(int col0, int row0, int col1, int row1, int destCol, int destRow)
+{
+	int destCol1 = destCol + col1 - col0;
+	int destRow1 = destRow + row1 - row0;
+	if (destCol1 > CA_MAX_COL || destRow1 > CA_MAX_ROW)
+		return false;
+	if ((long)(col1 - col0 + 1) * (row1 - row0 + 1) > SS_MAX_RANGE_CELLS)
+		return false;
+
+	cellsMutex.Lock();
+
+	// Blank out the destination and the source, then write the moved cells.
+	map<cellKey, string> changes;
+	vector<placedCell> found;
+	collectCells(destCol, destRow, destCol1, destRow1, &found);
+	for (size_t i = 0; i < found.size(); i++)
+		changes[CA_KEY(found[i].col, found[i].row)] = "";
+
+	collectCells(col0, row0, col1, row1, &found);
+	for (size_t i = 0; i < found.size(); i++)
+		changes[CA_KEY(found[i].col, found[i].row)] = "";
+
+	for (size_t i = 0; i < found.size(); i++)
+		changes[CA_KEY(destCol + found[i].col - col0, destRow + found[i].row - row0)] = cellText(*found[i].entry, found[i].col, found[i].row);
+
+	bool moved = commitEdits(changes, "move " + FormatCellRange(col0, row0, col1, row1) + " " + FormatCellName(destCol, destRow));
+
+	cellsMutex.Unlock();
+
+	if (moved && !changes.empty())
+		this->Save();
+
+	return moved;
+}
+
+/// <summary>
+///		Empties every cell of the block with the given corners.
+///
+///		Returns whether or not the block was cleared.
+/// </summary>
+bool SpreadsheetSession::ClearRange(int col0, int row0, int col1, int row1)
+{
+	cellsMutex.Lock();
+
+	map<cellKey, string> changes;
+	vector<placedCell> found;
+	collectCells(col0, row0, col1, row1, &found);
+	for (size_t i = 0; i < found.size(); i++)
+		changes[CA_KEY(found[i].col, found[i].row)] = "";
+
+	bool cleared = commitEdits(changes, "clear " + FormatCellRange(col0, row0, col1, row1));
+
+	cellsMutex.Unlock();
+
+	if (cleared && !changes.empty())
+		this->Save();
+
+	return cleared;
+}
+
+/// <summary>
+///		Inserts count empty rows before the given row. Later rows move down, and
+///		formulas anywhere on the sheet are rewritten to keep referring to the
+///		same cells. A range that spans the new rows grows to include them.
+///
+///		Returns false, without making any change, if cells or references would
+///		be pushed off the bottom of the sheet.
+/// </summary>
+bool SpreadsheetSession::InsertRows(int row, int count)
+{
+	return changeLayout(true, row, count);
+}
+
+/// <summary>
+///		Deletes count rows starting at the given row. Later rows move up.
+///		References to deleted cells become #REF!, while ranges only lose the
+///		deleted rows unless every one of their rows was deleted.
+///
+///		Returns whether or not the rows were deleted.
+/// </summary>
+bool SpreadsheetSession::DeleteRows(int row, int count)
+{
+	return changeLayout(true, row, -count);
+}
+
+/// <summary>
+///		Inserts count empty columns before the given column, like InsertRows.
+/// </summary>
+bool SpreadsheetSession::InsertColumns(int col, int count)
+{
+	return changeLayout(false, col, count);
+}
+
+/// <summary>
+///		Deletes count columns starting at the given column, like DeleteRows.
+/// </summary>
+bool SpreadsheetSession::DeleteColumns(int col, int count)
+{
+	return changeLayout(false, col, -count);
+}
+
 /// <summary>
 ///		Sends a command to every client to revert the last cell edit by 
-///		sending them the information of the last edit.
+///		sending them the information of the last edit. An edit of many cells is
+///		reverted as a whole.
 ///
-///		Returns false if there are no edits in the history to undo
+///		Returns false if there are no edits in the history to undo, or if the
+///		previous contents can no longer be restored without a circular dependency.
 /// </summary>
 bool SpreadsheetSession::UndoAll()
 {
-	pthread_mutex_lock(&cellsMutex);
+	cellsMutex.Lock();
 
-	// If there is nothing in history, do nothing
-	if (history.size() == 0)
+	// Held edits go out first, since the undo may revert them.
+	flushEdits();
+
+	// Get the last edit. If there is nothing in history, do nothing
+	vector< pair<cellKey, string> > edits;
+	if (!history.Pop(&edits))
 	{
-		pthread_mutex_unlock(&cellsMutex);
+		cellsMutex.Unlock();
 		return false;
 	}
-
-	// Otherwise, get last edit
-	pair<string, string> edit = history.top();
-	history.pop();
   
-  // Update the cell.
-  updateCell(edit.first, edit.second);
+	// A layout change is recorded ahead of the cells it rewrote, so it comes
+	// off last. Undoing it first puts the lines back where the recorded cells
+	// expect them.
+	map<cellKey, string> changes;
+	map<cellKey, string> resync;
+	bool rows = false;
+	int at = 0;
+	int count = 0;
+	if (edits.back().first & SS_LAYOUT_BIT)
+	{
+		cellKey key = edits.back().first;
+		edits.pop_back();
 
-	// Send the edit to every client
-	for (set<StringSocket*>::iterator it = clientSockets.begin(); it != clientSockets.end(); it++)
+		rows = (key & SS_LAYOUT_ROWS) != 0;
+		at = (int)((key >> 24) & CA_MAX_ROW);
+		count = (int)(key & 0xFFFFFF);
+		if (!(key & SS_LAYOUT_DELETE))
+			count = -count;
+
+		if (!shiftLayout(rows, at, &count, NULL, &changes, hasClientsWithout(SS_CAP_LAYOUT) ? &resync : NULL))
+		{
+			cellsMutex.Unlock();
+			return false;
+		}
+	}
+
+  // Restore the cells.
+	map<cellKey, string> restored(edits.begin(), edits.end());
+	if (!applyEdits(restored, NULL))
+	{
+		cellsMutex.Unlock();
+		return false;
+	}
+	for (map<cellKey, string>::iterator it = restored.begin(); it != restored.end(); it++)
 	{
-    sendCell(edit.first, edit.second, *it);
+		changes[it->first] = it->second;
+		resync[it->first] = it->second;
 	}
+
+	recordVersion(changes, count != 0);
+
+	// Send the edit to every client
+	if (count == 0)
+		sendCells(changes, "", 0);
+	else
+		sendCells(resync, layoutMessage(rows, at, count, changes), SS_CAP_LAYOUT);
   
-	pthread_mutex_unlock(&cellsMutex);
+	cellsMutex.Unlock();
   
   // Save the spreadsheet.
   this->Save();
@@ -127,34 +483,113 @@ bool SpreadsheetSession::UndoAll()
 ///		Attempts to add a client's socket to the spreadsheet session, allowing communication between
 ///		the two. Will not add the same client socket to the session.
 ///
+///		A client that presents the last version it saw, and whose changes since are
+///		still in the change log, is sent "resync" and only the cells changed since
+///		then. Otherwise the client is sent "connected" and every cell in the sheet.
+///		A lastVersion of 0 always asks for every cell. A client that watches
+///		viewports is sent no cells until it subscribes to a block or asks for one.
+///
 ///		Returns true if the client and their associated socket are added to this spreadsheet session.
 /// </summary>
-bool SpreadsheetSession::AddClient(StringSocket* client)
+bool SpreadsheetSession::AddClient(StringSocket* client, unsigned int capabilities, unsigned long long lastVersion)
 {
-	pthread_mutex_lock(&clientsMutex);
+	clientsMutex.Lock();
+
+	// Keep edits and compaction out while the clients change and the cells are read.
+	cellsMutex.Lock();
 
-	pair<set<StringSocket*>::iterator, bool> ret;
-	ret = clientSockets.insert(client);		// Returns true if the socket was added to the set, false otherwise
+	pair<map<StringSocket*, unsigned int>::iterator, bool> ret;
+	ret = clientSockets.insert(make_pair(client, capabilities));		// Returns true if the socket was added to the map, false otherwise
 	
-	if (ret.second)
+	// The saved file holds the sheet as cell messages, so while the change log
+	// reaches back to it, a client that does not take compressed messages is
+	// sent the file straight from the page cache and then the cells changed since.
+	int savedFile = -1;
+	struct stat sb;
+	if (ret.second && !(lastVersion >= changeLogBase && lastVersion <= sheetVersion) && !(capabilities & (SS_CAP_DEFLATE | SS_CAP_VIEWPORT)) && savedVersion >= changeLogBase)
+	{
+		savedFile = open((string("./spreadsheets/") + sprdName).c_str(), O_RDONLY);
+		if (savedFile >= 0 && fstat(savedFile, &sb) == -1)
+		{
+			close(savedFile);
+			savedFile = -1;
+		}
+	}
+
+	if (ret.second && (capabilities & SS_CAP_VIEWPORT))
 	{
-		// Send a message to the client to confirm the connection
 		ostringstream cmd;
-		cmd << "connected " << cellMap.size();
+		cmd << "connected 0";
+		if (capabilities & SS_CAP_VERSIONS)
+			cmd << " " << sheetVersion;
 		client->BeginSend(cmd.str(), clientSendCallback, NULL);
+	}
+	else if (ret.second && lastVersion >= changeLogBase && lastVersion <= sheetVersion)
+	{
+		size_t count;
+		string text = changedCells(lastVersion, &count);
 
-		// Send the client the spreadsheet data
-		for (map<string, string>::iterator it = cellMap.begin(); it != cellMap.end(); it++)
-		{
-      sendCell(it->first, it->second, client);
-		}
+		ostringstream cmd;
+		cmd << "resync " << count << " " << sheetVersion;
+		string message = cmd.str();
+		string deflated;
+		if ((capabilities & SS_CAP_DEFLATE) && CompressMessage(text, &deflated))
+			text.swap(deflated);
+		if (!text.empty())
+			message += "\n" + text;
+		client->BeginSend(message, clientSendCallback, NULL);
+	}
+	else if (savedFile >= 0)
+	{
+		size_t count;
+		string tail = changedCells(savedVersion, &count);
+
+		ostringstream cmd;
+		cmd << "connected " << savedCells + count;
+		if (capabilities & SS_CAP_VERSIONS)
+			cmd << " " << sheetVersion;
+		client->BeginSend(cmd.str(), clientSendCallback, NULL);
+
+		// The socket closes the file once it has been sent.
+		if (sb.st_size > 0)
+			client->BeginSendFile(savedFile, 0, sb.st_size, clientSendCallback, NULL);
+		else
+			close(savedFile);
+		if (!tail.empty())
+			client->BeginSend(tail, clientSendCallback, NULL);
+	}
+	else if (ret.second)
+	{
+		// Confirm the connection, then stream the spreadsheet data in chunks.
+		// Edits made meanwhile are held back until the client has the whole sheet.
+		SheetSnapshot *current = currentSnapshot();
+		ostringstream cmd;
+		cmd << "connected " << current->Cells();
+		if (capabilities & SS_CAP_VERSIONS)
+			cmd << " " << sheetVersion;
+		joining[client] = SnapshotStream::Start(client, cmd.str(), current, (capabilities & SS_CAP_DEFLATE) != 0);
 	}
 
-	pthread_mutex_unlock(&clientsMutex);
+	cellsMutex.Unlock();
+	clientsMutex.Unlock();
 
 	return ret.second;
 }
 
+/// <summary>
+///		Changes the SS_CAP_ flags of a client that is connected to this session.
+/// </summary>
+void SpreadsheetSession::SetClientCapabilities(StringSocket* client, unsigned int capabilities)
+{
+	cellsMutex.Lock();
+
+	map<StringSocket*, unsigned int>::iterator it = clientSockets.find(client);
+	if (it != clientSockets.end())
+		it->second = capabilities;
+
+	cellsMutex.Unlock();
+}
+
 /// <summary>
 ///		Attempts to remove a client's socket to the spreadsheet session. If the client's socket does 
 ///		not exist in this spreadsheet session, does nothing.
@@ -164,63 +599,189 @@ bool SpreadsheetSession::AddClient(StringSocket* client)
 /// </summary>
 bool SpreadsheetSession::RemoveClient(StringSocket* client)
 {
-	pthread_mutex_lock(&clientsMutex);
+	clientsMutex.Lock();
+	cellsMutex.Lock();
 
-	set<StringSocket*>::iterator it;
+	map<StringSocket*, unsigned int>::iterator it;
 	it = clientSockets.find(client);
 	if (it != clientSockets.end())
 	{
-		clientSockets.erase(client);
+		clientSockets.erase(it);
+		viewports.RemoveAll(client);
+
+		// Stop streaming the snapshot, so the socket can be freed.
+		map<StringSocket*, SnapshotStream*>::iterator joined = joining.find(client);
+		if (joined != joining.end())
+		{
+			joined->second->Close();
+			joining.erase(joined);
+		}
     
-		pthread_mutex_unlock(&clientsMutex);
+		cellsMutex.Unlock();
+		clientsMutex.Unlock();
 
 		return true;
 	}
 
-	pthread_mutex_unlock(&clientsMutex);
+	cellsMutex.Unlock();
+	clientsMutex.Unlock();
 
 	return false;
 }
 
+/// <summary>
+///		Sends a client the cells in use within a block as a "range" message, and
+///		from then on every edit within the block, if the client watches viewports.
+///		Both are sent while edits are kept out, so the client misses none.
+///
+///		Returns false if the client is not connected, the block is larger than
+///		SS_MAX_RANGE_CELLS or the client already watches SS_MAX_VIEWPORTS blocks.
+/// </summary>
+bool SpreadsheetSession::Subscribe(StringSocket* client, int col0, int row0, int col1, int row1)
+{
+	cellsMutex.Lock();
+
+	map<StringSocket*, unsigned int>::iterator it = clientSockets.find(client);
+	if (it == clientSockets.end() || (long long)(col1 - col0 + 1) * (row1 - row0 + 1) > SS_MAX_RANGE_CELLS || viewports.Count(client) >= SS_MAX_VIEWPORTS)
+	{
+		cellsMutex.Unlock();
+		return false;
+	}
+
+	viewports.Add(client, col0, row0, col1, row1);
+	sendTo(client, rangeReply(col0, row0, col1, row1, it->second));
+
+	cellsMutex.Unlock();
+	return true;
+}
+
+/// <summary>
+///		Stops sending a client the edits within a block it subscribed to.
+///
+///		Returns false if the client did not subscribe to exactly that block.
+/// </summary>
+bool SpreadsheetSession::Unsubscribe(StringSocket* client, int col0, int row0, int col1, int row1)
+{
+	cellsMutex.Lock();
+	bool removed = viewports.Remove(client, col0, row0, col1, row1);
+	cellsMutex.Unlock();
+
+	return removed;
+}
+
+/// <summary>
+///		Stops sending a client the edits within every block it subscribed to.
+/// </summary>
+void SpreadsheetSession::UnsubscribeAll(StringSocket* client)
+{
+	cellsMutex.Lock();
+	viewports.RemoveAll(client);
+	cellsMutex.Unlock();
+}
+
+/// <summary>
+///		Sends a client the cells in use within a block as a "range" message,
+///		without subscribing to later edits within it.
+///
+///		Returns false if the client is not connected or the block is larger than
+///		SS_MAX_RANGE_CELLS.
+/// </summary>
+bool SpreadsheetSession::SendRange(StringSocket* client, int col0, int row0, int col1, int row1)
+{
+	cellsMutex.Lock();
+
+	map<StringSocket*, unsigned int>::iterator it = clientSockets.find(client);
+	if (it == clientSockets.end() || (long long)(col1 - col0 + 1) * (row1 - row0 + 1) > SS_MAX_RANGE_CELLS)
+	{
+		cellsMutex.Unlock();
+		return false;
+	}
+
+	sendTo(client, rangeReply(col0, row0, col1, row1, it->second));
+
+	cellsMutex.Unlock();
+	return true;
+}
+
 /// <summary>
 ///		Saves the spreadsheet session's cells and correspondnig content information to a plain text file
-///		in the following format:
+///		in the following format, which is the same as the cell messages sent to clients:
 ///
-///		cellname1 contents1 
-///		cellname2 contents2 
+///		cell cellname1 contents1 
+///		cell cellname2 contents2 
 ///		
+///		The file is written next to the old one and then renamed over it, so a
+///		client being sent the old file still gets all of it.
+///
 ///		Returns true upon successfully saving the file. False otherwise.
 /// </summary>
 bool SpreadsheetSession::Save()
 {
-	pthread_mutex_lock(&cellsMutex);
+	return Save(NULL);
+}
+
+/// <summary>
+///		Saves the spreadsheet as Save does, writing SS_SAVE_CHUNK bytes at a
+///		time. Once the deadline passes, the new file is abandoned and the old
+///		one is left as it was. A NULL deadline never passes.
+/// </summary>
+bool SpreadsheetSession::Save(const struct timespec *deadline)
+{
+	unsigned long long start = LatencyHistogram::NowMicros();
+	cellsMutex.Lock();
   
 	// Make the file
-	ofstream sprdFile((string("./spreadsheets/") + sprdName).c_str());	// The data in this file will be overwritten
+	string filename = string("./spreadsheets/") + sprdName;
+	ofstream sprdFile((filename + ".tmp").c_str());
 	if (sprdFile.is_open())
 	{
-		// Some temp variables
-		string cell;
-		string contents;
+		// Write the cell messages at the positions that clients see
+		SheetSnapshot *current = currentSnapshot();
+		bool late = false;
+		if (current->Cells() > 0)
+		{
+			const string &text = current->Text();
+			for (size_t at = 0; at < text.length() && !late && sprdFile.good(); at += SS_SAVE_CHUNK)
+			{
+				sprdFile.write(text.data() + at, min((size_t)SS_SAVE_CHUNK, text.length() - at));
+				if (deadline != NULL)
+				{
+					struct timespec now;
+					clock_gettime(CLOCK_REALTIME, &now);
+					late = now.tv_sec > deadline->tv_sec || (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+				}
+			}
+			sprdFile << "\n";
+		}
+		sprdFile.close();
 
-		// Write to the file
-		for (map<string, string>::iterator it = cellMap.begin(); it != cellMap.end(); it++)
+		if (late)
+			unlink((filename + ".tmp").c_str());
+		if (late || sprdFile.fail() || rename((filename + ".tmp").c_str(), filename.c_str()) == -1)
 		{
-			cell = it->first + " ";
-			contents = it->second;
-			sprdFile << cell;
-			sprdFile << contents;
-      sprdFile << "\n";
+			cellsMutex.Unlock();
+			saveLatency.RecordSince(start);
+			return false;
 		}
+		savedVersion = sheetVersion;
+		savedCells = current->Cells();
+		if (dirtySince != 0)
+			stageLatency[SS_STAGE_PERSIST].RecordSince(dirtySince);
+		dirtySince = 0;
 
-		sprdFile.close();
+		// Reclaim the space of contents that are no longer used while the
+		// sheet is at rest.
+		if (strings.NeedsCompaction())
+			strings.Compact();
 
-		pthread_mutex_unlock(&cellsMutex);
+		cellsMutex.Unlock();
+		saveLatency.RecordSince(start);
 
 		return true;
 	}
 
-	pthread_mutex_unlock(&cellsMutex);
+	cellsMutex.Unlock();
+	saveLatency.RecordSince(start);
 	
 	return false;
 }
@@ -233,11 +794,11 @@ bool SpreadsheetSession::Save()
 /// </summary>
 bool SpreadsheetSession::Load()
 {
-	pthread_mutex_lock(&cellsMutex);
+	cellsMutex.Lock();
   
-	// Make sure the edit history and the cell map are empty so we don't reaload
-	//   the data file if it has already been loaded.
-	if (history.empty() && cellMap.empty())
+	// Make sure the edit history has not been opened and the cells are empty
+	//   so we don't reaload the data file if it has already been loaded.
+	if (!history.IsOpen() && cells.Size() == 0)
 	{
 		string filename = string("./spreadsheets/") + sprdName;
 
@@ -256,68 +817,290 @@ bool SpreadsheetSession::Load()
 			string cell;
 			string content;
 			string line;
+			size_t lines = 0;
+			bool messages = true;
+			vector<cellKey> loaded;
 
 			// Get each line
 			while (getline(sprdFile, line))
 			{
+        // Files saved before the sheet was saved as cell messages have no "cell" in front.
+        size_t start = 0;
+        if (line.compare(0, 5, "cell ") == 0)
+          start = 5;
+        else
+          messages = false;
+
         // Get the cell name and contents.
-        size_t br = line.find(' ');
-        cell = line.substr(0, br);
-        content = line.substr(br + 1);
+        size_t br = line.find(' ', start);
+        cell = line.substr(start, br - start);
+        content = br == string::npos ? string() : line.substr(br + 1);
 
-        // Update the cell.
-        updateCell(cell, content);
+        // Update the cell, skipping lines that do not name a cell. Saved sheets
+        // have no circular dependencies, so the cells are checked all at once
+        // after the file is read.
+        int col, row;
+        if (ParseCellName(cell, &col, &row))
+        {
+          int templateId = internFormula(col, row, content);
+          linkCell(col, row, content, templateId);
+          storeCell(col, row, content, templateId);
+          loaded.push_back(CA_KEY(col, row));
+        }
+        else
+          messages = false;
+        lines++;
 
       }
 
+			// A file edited by hand may close circular dependencies, which are
+			// left out, so it no longer holds what the sheet does.
+			set<cellKey> keys;
+			vector<cellKey> order;
+			for (size_t i = 0; i < loaded.size(); i++)
+				keys.insert(nodeKey(CA_KEY_COL(loaded[i]), CA_KEY_ROW(loaded[i])));
+			if (!orderDependents(keys, &order))
+			{
+				breakCycles(loaded);
+				messages = false;
+			}
+
+			// The file can be sent to clients as it is if every line is a cell message.
+			if (messages && !sprdFile.bad())
+			{
+				savedVersion = sheetVersion;
+				savedCells = lines;
+			}
+
 			// Done - close 
 			sprdFile.close();
+
+			// Compute every cell value now that all of the cells are known.
+			recalculateAll();
+
+			// A snapshot of the sheet from before it was loaded is out of date.
+			if (snapshot != NULL)
+			{
+				snapshot->Release();
+				snapshot = NULL;
+			}
 		}
 		else
 		{
+      // A new sheet starts with no history, even if an old log was left behind.
+			unlink((filename + ".undo").c_str());
+
       // Create the file if it does not exist.
 			std::ofstream file(filename.c_str());
 			file.close();
+			savedVersion = sheetVersion;
+			savedCells = 0;
 
 			// Make sure that the file was created.
 			struct stat sb;
 
 			if (stat(filename.c_str(), &sb) == -1)
 			{
-				pthread_mutex_unlock(&cellsMutex);
+				cellsMutex.Unlock();
 				return false;
 			}
 		}
-		pthread_mutex_unlock(&cellsMutex);
 
-		return true;
+		// Continue the undo history from the log next to the sheet. Without the
+		// log, the history is only kept in memory.
+		history.Open(filename + ".undo");
 	}
+
+	cellsMutex.Unlock();
+
+	return true;
 }
 
 /// <summary>
-///		Returns the number of connected users to this spreadsheet session
+///		Gets whether the sheet has changed since it was last saved, or was
+///		loaded from a file in the old format.
 /// </summary>
-int SpreadsheetSession::GetUserCount()
+bool SpreadsheetSession::IsDirty()
 {
-	return clientSockets.size();
+	cellsMutex.Lock();
+	bool dirty = savedVersion != sheetVersion;
+	cellsMutex.Unlock();
+
+	return dirty;
 }
 
-///	<summary>
-///		Returns the name of the spreadsheet session, ".txt" appended
-///	</summary>
-string SpreadsheetSession::GetName()
+/// <summary>
+///		Frees what a session that no client is connected to can rebuild when one
+///		joins: the snapshot of its cells and the space of contents that are no
+///		longer used.
+///
+///		Returns the approximate number of bytes the session still holds.
+/// </summary>
+size_t SpreadsheetSession::Shrink()
 {
-	return sprdName;
-}
+	cellsMutex.Lock();
 
-///	<summary>
-///		Returns the map of cells to contents in this spreadsheet session
+	if (snapshot != NULL)
+	{
+		snapshot->Release();
+		snapshot = NULL;
+	}
+	if (strings.NeedsCompaction())
+		strings.Compact();
+
+	size_t bytes = heldBytes();
+
+	cellsMutex.Unlock();
+
+	return bytes;
+}
+
+/// <summary>
+///		Returns the number of connected users to this spreadsheet session
+/// </summary>
+int SpreadsheetSession::GetUserCount()
+{
+	return clientSockets.size();
+}
+
+/// <summary>
+///		Gets the counters of the session for the stats command. The edit rate
+///		is measured since the stats were last taken, or the sheet was opened.
+///		Edits are counted as they are versioned, with the cells mutex already
+///		held, so counting them takes no lock of its own.
+/// </summary>
+void SpreadsheetSession::GetStats(sessionStats *stats, bool restartRate)
+{
+	clientsMutex.Lock();
+	stats->clients = clientSockets.size();
+	clientsMutex.Unlock();
+
+	cellsMutex.Lock();
+	unsigned long long now = nowMillis();
+	stats->edits = editedCells;
+	stats->editsPerSecond = now > statsTaken ? (editedCells - statsEditedCells) * 1000.0 / (now - statsTaken) : 0;
+	stats->graphSize = depGraph.size();
+	stats->memoryBytes = heldBytes();
+	stats->version = sheetVersion;
+	if (restartRate)
+	{
+		statsEditedCells = editedCells;
+		statsTaken = now;
+	}
+	cellsMutex.Unlock();
+}
+
+/// <summary>
+///		Gets how long each save of any sheet took, from taking the cells mutex
+///		to the file being in place.
+/// </summary>
+const LatencyHistogram &SpreadsheetSession::SaveLatency()
+{
+	return saveLatency;
+}
+
+/// <summary>
+///		Gets how long a stage of the edits of any sheet took, one of the
+///		SS_STAGE_ stages.
+/// </summary>
+LatencyHistogram &SpreadsheetSession::StageLatency(int stage)
+{
+	return stageLatency[stage];
+}
+
+/// <summary>
+///		Gets the name of an SS_STAGE_ stage, as it is labelled in the metrics.
+/// </summary>
+const char *SpreadsheetSession::StageName(int stage)
+{
+	return stageNames[stage];
+}
+
+/// <summary>
+///		Gets the approximate number of bytes the session holds: the contents of
+///		its cells, and an estimate of what each cell in use costs across the
+///		grid, values and dependency graph. The cells mutex must be held.
+/// </summary>
+size_t SpreadsheetSession::heldBytes()
+{
+	return sizeof(SpreadsheetSession) + strings.BytesReserved() + cells.Size() * SS_CELL_BYTES;
+}
+
+///	<summary>
+///		Returns the name of the spreadsheet session, ".txt" appended
+///	</summary>
+string SpreadsheetSession::GetName()
+{
+	return sprdName;
+}
+
+///	<summary>
+///		Returns the map of cells to contents in this spreadsheet session
 ///	</summary>
 map<string, string> SpreadsheetSession::GetCellMap()
 {
+	map<string, string> cellMap;
+	vector<placedCell> found;
+	collectCells(0, 0, CA_MAX_COL, CA_MAX_ROW, &found);
+	for (size_t i = 0; i < found.size(); i++)
+		cellMap[FormatCellName(found[i].col, found[i].row)] = cellText(*found[i].entry, found[i].col, found[i].row);
 	return cellMap;
 }
 
+///	<summary>
+///		Gets the computed numeric value of a cell. Returns false if the cell is
+///		empty, holds text, or holds a formula that could not be evaluated.
+///	</summary>
+bool SpreadsheetSession::GetCellValue(string cellName, double *value)
+{
+	int col, row;
+	if (!ParseCellName(cellName, &col, &row))
+		return false;
+
+	cellsMutex.Lock();
+	bool found = Lookup(col, row, value);
+	cellsMutex.Unlock();
+
+	return found;
+}
+
+
+///	<summary>
+///		Returns the version of the sheet. Every transaction applied since the
+///		sheet was opened, including an undo, adds one to the version. Versions
+///		continue to increase across the sheet being closed and reopened.
+///	</summary>
+unsigned long long SpreadsheetSession::GetVersion()
+{
+	cellsMutex.Lock();
+	unsigned long long version = sheetVersion;
+	cellsMutex.Unlock();
+
+	return version;
+}
+
+/// <summary>
+///		Sets the coalescing window, in milliseconds, of the sessions opened
+///		afterwards. A window of 0 never merges edits.
+/// </summary>
+void SpreadsheetSession::SetDefaultCoalesceWindow(int milliseconds)
+{
+	defaultCoalesceWindow = max(0, min(milliseconds, SS_MAX_COALESCE_WINDOW));
+}
+
+/// <summary>
+///		Sets the coalescing window, in milliseconds, of this session. Edits
+///		already held back are sent once the new window runs out. A window of 0
+///		never merges edits.
+/// </summary>
+void SpreadsheetSession::SetCoalesceWindow(int milliseconds)
+{
+	cellsMutex.Lock();
+	coalesceWindow = max(0, min(milliseconds, SS_MAX_COALESCE_WINDOW));
+	pthread_cond_signal(&flushCond);
+	cellsMutex.Unlock();
+}
+
 
 /****************************
 
@@ -374,30 +1157,1200 @@ set<string> SpreadsheetSession::GetCellsFromCommand(string contents)
 	return refCells;
 }
 
+///	<summary>
+///		Gets the cells referenced by a compiled formula owned by the given
+///		cell, by where they are stored. The ranges of its functions are not listed cell by
+///		cell; they are added to ranges as the blocks where their cells are
+///		stored. References that fall off the sheet are skipped.
+///	</summary>
+set<cellKey> SpreadsheetSession::GetCellsFromFormula(const Formula &formula, int col, int row, vector<cellRange> *ranges)
+{
+	set<cellKey> refCells;
+
+	const vector<Formula::cellRef> &refs = formula.GetReferences();
+	for (size_t i = 0; i < refs.size(); i++)
+	{
+		int c = refs[i].col + col;
+		int r = refs[i].row + row;
+		if (c >= 0 && r >= 0 && c <= CA_MAX_COL && r <= CA_MAX_ROW)
+		{
+			growExtent(c, r);
+			refCells.insert(nodeKey(c, r));
+		}
+	}
+
+	// A range does not count towards the extent of the sheet, so that a
+	// reference to a whole column does not stretch it to the last row.
+	const vector<Formula::rangeRef> &refRanges = formula.GetRanges();
+	for (size_t i = 0; i < refRanges.size(); i++)
+	{
+		int col0 = max(refRanges[i].col0 + col, 0);
+		int row0 = max(refRanges[i].row0 + row, 0);
+		int col1 = min(refRanges[i].col1 + col, CA_MAX_COL);
+		int row1 = min(refRanges[i].row1 + row, CA_MAX_ROW);
+		if (col0 > col1 || row0 > row1)
+			continue;
+
+		// One stored block per pair of row and column runs.
+		vector<axisRun> colRuns;
+		vector<axisRun> rowRuns;
+		colMap.Runs(col0, col1, &colRuns);
+		rowMap.Runs(row0, row1, &rowRuns);
+		for (size_t c = 0; c < colRuns.size(); c++)
+		{
+			for (size_t r = 0; r < rowRuns.size(); r++)
+			{
+				cellRange block;
+				block.col0 = colRuns[c].physical;
+				block.row0 = rowRuns[r].physical;
+				block.col1 = colRuns[c].physical + colRuns[c].length - 1;
+				block.row1 = rowRuns[r].physical + rowRuns[r].length - 1;
+				ranges->push_back(block);
+			}
+		}
+	}
+
+	return refCells;
+}
+
 /// <summary>
-///   Attempts to updates the contents of a cell and returns true if successful.
+///		Links the given cells into the graph again one at a time, in order,
+///		emptying each cell that would close a circular dependency, as if they
+///		had been typed in one after another. Only a file edited by hand needs
+///		this.
 /// </summary>
-bool SpreadsheetSession::updateCell(string name, string contents)
+void SpreadsheetSession::breakCycles(const vector<cellKey> &keys)
 {
-	// Parse the contents to discover if there are any cell names in it
-	set<string> refCells;
-	refCells = GetCellsFromCommand(contents);
-  
-  // Return false if a circular dependency would occur.
-  if(!depGraph.replace_dependees(name, refCells))
-    return false;
+	for (size_t i = 0; i < keys.size(); i++)
+		linkCell(CA_KEY_COL(keys[i]), CA_KEY_ROW(keys[i]), "", -1);
 
-  // Update the cell map.
-	if(contents == "")
-		cellMap.erase(name);
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		int col = CA_KEY_COL(keys[i]);
+		int row = CA_KEY_ROW(keys[i]);
+		const cellEntry *cell = cells.Find(colMap.ToPhysical(col), rowMap.ToPhysical(row));
+		if (cell == NULL)
+			continue;
+
+		// The graph is free of cycles without the cell, so any cycle found now
+		// goes through it.
+		set<cellKey> key;
+		vector<cellKey> order;
+		key.insert(nodeKey(col, row));
+		linkCell(col, row, cellText(*cell, col, row), cell->templateId);
+		if (!orderDependents(key, &order))
+		{
+			linkCell(col, row, "", -1);
+			storeCell(col, row, "", -1);
+		}
+	}
+}
+
+/// <summary>
+///		Applies the edits of many cells as one transaction: the edits are made,
+///		recorded as a single entry in the history, and sent to every client.
+///		The cells mutex must be held.
+///
+///		Returns false, without making any edit, if the edits would result in a
+///		circular dependency.
+/// </summary>
+bool SpreadsheetSession::commitEdits(map<cellKey, string> &changes, const string &rangeMessage)
+{
+	// A range with no cells in use, or edits that change nothing, are a
+	// transaction with nothing to do.
+	dropUnchanged(changes);
+	if (changes.empty())
+		return true;
+
+	// Held edits of the last burst go out ahead of this one.
+	flushEdits();
+
+	vector< pair<cellKey, stringId> > previous;
+	if (!applyEdits(changes, &previous))
+		return false;
+
+	history.Push(previous);
+	recordVersion(changes, false);
+	sendCells(changes, rangeMessage, SS_CAP_RANGES);
+	return true;
+}
+
+/// <summary>
+///		Leaves out the edits that would not change a cell, so that retyping the
+///		contents a cell already has is neither recorded, sent nor saved.
+/// </summary>
+void SpreadsheetSession::dropUnchanged(map<cellKey, string> &changes)
+{
+	for (map<cellKey, string>::iterator it = changes.begin(); it != changes.end(); )
+	{
+		int col = CA_KEY_COL(it->first);
+		int row = CA_KEY_ROW(it->first);
+		const cellEntry *cell = cells.Find(colMap.ToPhysical(col), rowMap.ToPhysical(row));
+		if (cell == NULL ? it->second.empty() : cellText(*cell, col, row) == it->second)
+			changes.erase(it++);
+		else
+			it++;
+	}
+}
+
+/// <summary>
+///		Merges edits into the burst going on if they edit exactly the cells of
+///		the last edit, nothing else has changed since and the last edit was made
+///		within the coalescing window. Merged edits are applied and versioned, but
+///		not recorded in the history, and are held back from clients until the
+///		flusher sends them. The cells mutex must be held.
+///
+///		Returns false if the edits would result in a circular dependency. Sets
+///		held to whether the edits were merged; if not, they still need to be
+///		committed.
+/// </summary>
+bool SpreadsheetSession::coalesceEdits(map<cellKey, string> &changes, bool *held)
+{
+	*held = false;
+
+	dropUnchanged(changes);
+	if (changes.empty() || coalesceWindow <= 0 || burstVersion != sheetVersion || changes.size() != burstCells.size())
+		return true;
+
+	unsigned long long now = nowMillis();
+	if (now > burstLast + coalesceWindow)
+		return true;
+	for (map<cellKey, string>::iterator it = changes.begin(); it != changes.end(); it++)
+	{
+		if (burstCells.find(it->first) == burstCells.end())
+			return true;
+	}
+
+	// The history entry of the first edit of the burst already holds what
+	// these cells were before it.
+	if (!applyEdits(changes, NULL))
+		return false;
+	recordVersion(changes, false);
+
+	if (heldCells.empty())
+		heldSince = now;
+	for (map<cellKey, string>::iterator it = changes.begin(); it != changes.end(); it++)
+		heldCells[it->first] = it->second;
+	burstVersion = sheetVersion;
+	burstLast = now;
+	*held = true;
+
+	if (!flusherRunning)
+		flusherRunning = pthread_create(&flusher, NULL, flushThread, this) == 0;
+	pthread_cond_signal(&flushCond);
+
+	// Without a flusher, the edits go out right away.
+	if (!flusherRunning)
+		flushEdits();
+
+	return true;
+}
+
+/// <summary>
+///		Sends the edits held back by the burst going on to every client, as
+///		one message. The burst itself goes on. The cells mutex must be held.
+/// </summary>
+void SpreadsheetSession::flushEdits()
+{
+	if (heldCells.empty())
+		return;
+
+	sendCells(heldCells, "", 0);
+	heldCells.clear();
+}
+
+/// <summary>
+///		Entry point of the thread that sends held back edits.
+/// </summary>
+void *SpreadsheetSession::flushThread(void *session)
+{
+	static_cast<SpreadsheetSession *>(session)->flushLoop();
+	return NULL;
+}
+
+/// <summary>
+///		Sends held back edits once the first of them has waited out the
+///		coalescing window, then saves the sheet. Runs until the session is
+///		destroyed.
+/// </summary>
+void SpreadsheetSession::flushLoop()
+{
+	cellsMutex.Lock();
+
+	while (!flusherStopping)
+	{
+		if (heldCells.empty())
+		{
+			cellsMutex.Wait(&flushCond);
+			continue;
+		}
+
+		unsigned long long due = heldSince + coalesceWindow;
+		if (nowMillis() < due)
+		{
+			struct timespec until;
+			until.tv_sec = due / 1000;
+			until.tv_nsec = (due % 1000) * 1000000;
+			cellsMutex.TimedWait(&flushCond, &until);
+			continue;
+		}
+
+		flushEdits();
+
+		cellsMutex.Unlock();
+		this->Save();
+		cellsMutex.Lock();
+	}
+
+	cellsMutex.Unlock();
+}
+
+/// <summary>
+///		Inserts (count > 0) or deletes (count < 0) rows or columns as one
+///		transaction: the lines are moved, the change is recorded in the history
+///		along with the cells it rewrote, and every client is told about it.
+///		Clients that cannot apply the change themselves are sent every cell in
+///		the lines that moved.
+///
+///		Returns false, without making any change, if the change would push
+///		cells or references off the sheet.
+/// </summary>
+bool SpreadsheetSession::changeLayout(bool rows, int at, int count)
+{
+	int size = rows ? CA_MAX_ROW + 1 : CA_MAX_COL + 1;
+	if (count == 0 || at < 0 || at >= size || abs(count) > size)
+		return false;
+
+	cellsMutex.Lock();
+
+	// Held edits are sent at the positions they were made at.
+	flushEdits();
+
+	vector< pair<cellKey, stringId> > previous;
+	map<cellKey, string> changes;
+	map<cellKey, string> resync;
+	if (!shiftLayout(rows, at, &count, &previous, &changes, hasClientsWithout(SS_CAP_LAYOUT) ? &resync : NULL))
+	{
+		cellsMutex.Unlock();
+		return false;
+	}
+
+	// Lines past the end of the sheet in use are empty, so there is nothing to record.
+	if (count == 0)
+	{
+		cellsMutex.Unlock();
+		return true;
+	}
+
+	// Record the change ahead of the cells it rewrote, so that it is undone last.
+	previous.insert(previous.begin(), make_pair(SS_LAYOUT_KEY(rows, at, count), (stringId)0));
+	history.Push(previous);
+	recordVersion(changes, true);
+
+	sendCells(resync, layoutMessage(rows, at, count, changes), SS_CAP_LAYOUT);
+
+	cellsMutex.Unlock();
+
+	this->Save();
+
+	return true;
+}
+
+/// <summary>
+///		Inserts (count > 0) or deletes (count < 0) rows or columns. The lines
+///		after the change keep their cells where they are stored and are only
+///		renumbered, so the cells that get rewritten are the deleted ones and the
+///		formulas whose references reach across the change. Those formulas are
+///		found through the span of each template rather than by visiting every
+///		formula. The cells mutex must be held.
+///
+///		On return, count holds the number of lines actually inserted or deleted,
+///		which is 0 if they were all past the end of the sheet in use. If previous
+///		is not NULL, the rewritten cells and their contents before the change are
+///		added to it. The rewritten cells and their new contents are added to
+///		changes. If resync is not NULL, every cell position in the moved lines is
+///		added to it along with its new contents.
+///
+///		Returns false, without making any change, if the change would push
+///		cells or references off the sheet.
+/// </summary>
+bool SpreadsheetSession::shiftLayout(bool rows, int at, int *count, vector< pair<cellKey, stringId> > *previous, map<cellKey, string> *changes, map<cellKey, string> *resync)
+{
+	AxisMap &axis = rows ? rowMap : colMap;
+	int &extent = rows ? rowExtent : colExtent;
+	int size = rows ? CA_MAX_ROW + 1 : CA_MAX_COL + 1;
+
+	// Lines past the extent are empty and only read through ranges, so nothing
+	// moves.
+	if (at >= extent)
+	{
+		*count = 0;
+		return true;
+	}
+
+	// The change rotates the lines from at to the end of the extent. An insert
+	// brings unused lines from past the end in; a delete sends lines out.
+	int middle, last;
+	if (*count > 0)
+	{
+		if (extent + *count > size)
+			return false;
+		middle = extent;
+		last = extent + *count;
+	}
 	else
-		cellMap[name] = contents;
-	
+	{
+		middle = min(at - *count, extent);
+		last = extent;
+		*count = at - middle;
+	}
+	int oldExtent = extent;
+	int windowEnd = oldExtent + max(*count, 0) - 1;
+
+	vector<placedCell> found;
+	if (resync != NULL)
+	{
+		collectCells(rows ? 0 : at, rows ? at : 0, rows ? CA_MAX_COL : windowEnd, rows ? windowEnd : CA_MAX_ROW, &found);
+		for (size_t i = 0; i < found.size(); i++)
+			(*resync)[CA_KEY(found[i].col, found[i].row)] = "";
+	}
+
+	// Work out the new contents of each rewritten cell while everything is in
+	// place, keyed by where it is stored.
+	map<cellKey, string> rewritten;
+	if (*count < 0)
+	{
+		collectCells(rows ? 0 : at, rows ? at : 0, rows ? CA_MAX_COL : middle - 1, rows ? middle - 1 : CA_MAX_ROW, &found);
+		for (size_t i = 0; i < found.size(); i++)
+		{
+			rewritten[CA_KEY(colMap.ToPhysical(found[i].col), rowMap.ToPhysical(found[i].row))] = "";
+			if (previous != NULL)
+				previous->push_back(make_pair(CA_KEY(found[i].col, found[i].row), strings.Intern(cellText(*found[i].entry, found[i].col, found[i].row))));
+		}
+	}
+
+	vector<cellKey> spanning;
+	if (*count > 0)
+		findSpanning(rows, at - 1, at, &spanning);
+	else
+		findSpanning(rows, middle - 1, at, &spanning);
+	for (size_t i = 0; i < spanning.size(); i++)
+	{
+		if (rewritten.find(spanning[i]) != rewritten.end())
+			continue;
+
+		int physCol = CA_KEY_COL(spanning[i]);
+		int physRow = CA_KEY_ROW(spanning[i]);
+		int col = colMap.ToLogical(physCol);
+		int row = rowMap.ToLogical(physRow);
+		const cellEntry *cell = cells.Find(physCol, physRow);
+
+		rewritten[spanning[i]] = Formula::Restructure(templates.GetText(cell->templateId), col, row, rows, at, *count);
+		if (previous != NULL)
+			previous->push_back(make_pair(CA_KEY(col, row), strings.Intern(cellText(*cell, col, row))));
+	}
+
+	// Formulas that did not compile have no template, so they are each checked.
+	for (set<cellKey>::iterator it = looseFormulas.begin(); it != looseFormulas.end(); it++)
+	{
+		if (rewritten.find(*it) != rewritten.end())
+			continue;
+
+		int col = colMap.ToLogical(CA_KEY_COL(*it));
+		int row = rowMap.ToLogical(CA_KEY_ROW(*it));
+		const cellEntry *cell = cells.Find(CA_KEY_COL(*it), CA_KEY_ROW(*it));
+		string relative = Formula::Normalize(strings.Get(cell->contents), col, row);
+		string contents = Formula::Restructure(relative, col, row, rows, at, *count);
+		if (contents == Formula::Denormalize(relative, col, row))
+			continue;
+
+		rewritten[*it] = contents;
+		if (previous != NULL)
+		{
+			strings.Retain(cell->contents);
+			previous->push_back(make_pair(CA_KEY(col, row), cell->contents));
+		}
+	}
+
+	// Lines past the extent stay where they are stored, so the ranges of
+	// formulas that move with the lines and read past the extent have to be
+	// found again once the lines have moved.
+	vector<cellKey> reaching;
+	vector<cellKey> relink;
+	findSpanning(rows, oldExtent - 1, oldExtent, &reaching);
+	for (size_t i = 0; i < reaching.size(); i++)
+	{
+		int line = rows ? rowMap.ToLogical(CA_KEY_ROW(reaching[i])) : colMap.ToLogical(CA_KEY_COL(reaching[i]));
+		if (line >= at && rewritten.find(reaching[i]) == rewritten.end())
+			relink.push_back(reaching[i]);
+	}
+
+	// Move the lines, then rewrite the cells where they now appear.
+	axis.Rotate(at, middle, last);
+	extent = oldExtent + *count;
+
+	for (map<cellKey, string>::iterator it = rewritten.begin(); it != rewritten.end(); it++)
+		(*changes)[CA_KEY(colMap.ToLogical(CA_KEY_COL(it->first)), rowMap.ToLogical(CA_KEY_ROW(it->first)))] = it->second;
+
+	if (!applyEdits(*changes, NULL))
+	{
+		axis.Rotate(at, at + last - middle, last);
+		extent = oldExtent;
+		changes->clear();
+		if (previous != NULL)
+		{
+			for (size_t i = 0; i < previous->size(); i++)
+				strings.Release((*previous)[i].second);
+			previous->clear();
+		}
+		return false;
+	}
+
+	// The ranges only gain or lose lines past the extent, which are empty, so
+	// no value changes and no cycle can be closed.
+	for (size_t i = 0; i < relink.size(); i++)
+	{
+		const cellEntry *cell = cells.Find(CA_KEY_COL(relink[i]), CA_KEY_ROW(relink[i]));
+		int col = colMap.ToLogical(CA_KEY_COL(relink[i]));
+		int row = rowMap.ToLogical(CA_KEY_ROW(relink[i]));
+		linkCell(col, row, cellText(*cell, col, row), cell->templateId);
+	}
+
+	// Formulas before the moved lines may have been rewritten too.
+	if (resync != NULL)
+	{
+		collectCells(rows ? 0 : at, rows ? at : 0, rows ? CA_MAX_COL : windowEnd, rows ? windowEnd : CA_MAX_ROW, &found);
+		for (size_t i = 0; i < found.size(); i++)
+			(*resync)[CA_KEY(found[i].col, found[i].row)] = cellText(*found[i].entry, found[i].col, found[i].row);
+		for (map<cellKey, string>::iterator it = changes->begin(); it != changes->end(); it++)
+			(*resync)[it->first] = it->second;
+	}
+
 	return true;
 }
 
 /// <summary>
+///		Gets the cells, by where they are stored, whose formulas reach back to
+///		line from or before it and forward to line to or after it. A template
+///		knows how far its references reach from the owning cell, so only the
+///		cells of each template on the lines that could reach that far are
+///		looked at.
 /// </summary>
-void SpreadsheetSession::sendCell(string name, string content, StringSocket *ss) {
-  ss->BeginSend("cell " + name + " " + content, SpreadsheetSession::clientSendCallback, NULL);
+void SpreadsheetSession::findSpanning(bool rows, int from, int to, vector<cellKey> *found)
+{
+	AxisMap &axis = rows ? rowMap : colMap;
+
+	vector<int> ids;
+	templates.GetIds(&ids);
+	for (size_t i = 0; i < ids.size(); i++)
+	{
+		int col0, row0, col1, row1;
+		templates.GetSpan(ids[i], &col0, &row0, &col1, &row1);
+
+		// A formula on line n reaches lines n + first to n + last.
+		int first = rows ? row0 : col0;
+		int last = rows ? row1 : col1;
+		vector<axisRun> runs;
+		axis.Runs(to - last, from - first, &runs);
+		for (size_t j = 0; j < runs.size(); j++)
+			templates.FindCells(ids[i], rows, runs[j].physical, runs[j].physical + runs[j].length - 1, found);
+	}
+}
+
+/// <summary>
+///		Gets the message that tells clients which can apply layout changes
+///		themselves about an insert (count > 0) or a delete (count < 0), such as
+///		"insert row 5 2" or "delete column C 1", followed by the cells that were
+///		rewritten. Cells emptied by a delete are left out, since the delete
+///		already empties them.
+/// </summary>
+string SpreadsheetSession::layoutMessage(bool rows, int at, int count, const map<cellKey, string> &changes)
+{
+	ostringstream message;
+	message << (count > 0 ? "insert " : "delete ");
+	if (rows)
+		message << "row " << at + 1;
+	else
+		message << "column " << FormatColumnName(at);
+	message << " " << abs(count);
+
+	for (map<cellKey, string>::const_iterator it = changes.begin(); it != changes.end(); it++)
+	{
+		if (!it->second.empty())
+			message << "\ncell " << FormatCellName(CA_KEY_COL(it->first), CA_KEY_ROW(it->first)) << " " << it->second;
+	}
+	return message.str();
+}
+
+/// <summary>
+///		Applies the edits of many cells, checking them for circular dependencies
+///		all at once, and recomputes every cell affected by them. If previous is
+///		not NULL, the previous contents of each edited cell are retained and
+///		added to it.
+///
+///		Returns false, without making any edit, if the edits would result in a
+///		circular dependency.
+/// </summary>
+bool SpreadsheetSession::applyEdits(map<cellKey, string> &changes, vector< pair<cellKey, stringId> > *previous)
+{
+	// Link every cell into the graph first, remembering how to put it back.
+	// Linking grows the extent of the sheet by the cells referenced.
+	vector<int> templateIds;
+	vector< set<cellKey> > oldDependees;
+	vector< vector<cellRange> > oldRanges;
+	set<cellKey> keys;
+	int oldRowExtent = rowExtent;
+	int oldColExtent = colExtent;
+	for (map<cellKey, string>::const_iterator it = changes.begin(); it != changes.end(); it++)
+	{
+		int col = CA_KEY_COL(it->first);
+		int row = CA_KEY_ROW(it->first);
+		cellKey key = nodeKey(col, row);
+		int templateId = internFormula(col, row, it->second);
+
+		templateIds.push_back(templateId);
+		oldDependees.push_back(depGraph.get_dependees(key));
+		oldRanges.push_back(vector<cellRange>());
+		rangeReaders.Get(key, &oldRanges.back());
+		linkCell(col, row, it->second, templateId);
+		keys.insert(key);
+	}
+
+	// A single search over the graph validates the whole batch and finds the
+	// order to recompute the cells in.
+	vector<cellKey> order;
+	if (!orderDependents(keys, &order))
+	{
+		size_t i = 0;
+		for (map<cellKey, string>::const_iterator it = changes.begin(); it != changes.end(); it++, i++)
+		{
+			int col = CA_KEY_COL(it->first);
+			int row = CA_KEY_ROW(it->first);
+			depGraph.set_dependees(nodeKey(col, row), oldDependees[i]);
+			rangeReaders.Set(nodeKey(col, row), oldRanges[i]);
+			if (templateIds[i] >= 0)
+				templates.Release(templateIds[i]);
+		}
+		rowExtent = oldRowExtent;
+		colExtent = oldColExtent;
+		return false;
+	}
+
+	// Store the new contents.
+	size_t i = 0;
+	for (map<cellKey, string>::iterator it = changes.begin(); it != changes.end(); it++, i++)
+	{
+		int col = CA_KEY_COL(it->first);
+		int row = CA_KEY_ROW(it->first);
+
+		if (previous != NULL)
+		{
+			const cellEntry *old = cells.Find(colMap.ToPhysical(col), rowMap.ToPhysical(row));
+			stringId oldContents = 0;
+			if (old != NULL && old->templateId >= 0)
+				oldContents = strings.Intern(cellText(*old, col, row));
+			else if (old != NULL)
+			{
+				oldContents = old->contents;
+				strings.Retain(oldContents);
+			}
+			previous->push_back(make_pair(it->first, oldContents));
+		}
+
+		storeCell(col, row, it->second, templateIds[i]);
+	}
+
+	// Recompute the cells and everything that depends on them. The search
+	// finishes dependents first, so walk it backwards.
+	for (vector<cellKey>::reverse_iterator it = order.rbegin(); it != order.rend(); it++)
+		computeValue(*it);
+	graphUpdated = LatencyHistogram::NowMicros();
+	return true;
+}
+
+/// <summary>
+///		Gets the shared template of formula contents, or -1 if the contents are
+///		not a valid formula. Formulas are only compiled the first time that their
+///		relative form is seen.
+/// </summary>
+int SpreadsheetSession::internFormula(int col, int row, const string &contents)
+{
+	if (contents[0] == '=')
+		return templates.Intern(contents, col, row);
+	return -1;
+}
+
+/// <summary>
+///		Discovers the cells referenced by the contents of a cell, by where they
+///		are stored. Compiled formulas know their references, and add the blocks
+///		of their function ranges to ranges.
+/// </summary>
+set<cellKey> SpreadsheetSession::referencedCells(int col, int row, const string &contents, int templateId, vector<cellRange> *ranges)
+{
+	if (templateId >= 0)
+		return GetCellsFromFormula(templates.GetFormula(templateId), col, row, ranges);
+
+	// Names that are cell addresses are linked to where the cell is stored.
+	// Other names can never change, so nothing depends on them.
+	set<string> names = GetCellsFromCommand(contents);
+	set<cellKey> refCells;
+	for (set<string>::iterator it = names.begin(); it != names.end(); it++)
+	{
+		int c, r;
+		if (ParseCellName(*it, &c, &r))
+		{
+			growExtent(c, r);
+			refCells.insert(nodeKey(c, r));
+		}
+	}
+	return refCells;
+}
+
+/// <summary>
+///		Links a cell into the dependency graph by the cells and ranges that its
+///		contents reference, in place of what it referenced before.
+/// </summary>
+void SpreadsheetSession::linkCell(int col, int row, const string &contents, int templateId)
+{
+	vector<cellRange> ranges;
+	depGraph.set_dependees(nodeKey(col, row), referencedCells(col, row, contents, templateId, &ranges));
+	rangeReaders.Set(nodeKey(col, row), ranges);
+}
+
+/// <summary>
+///		Replaces the contents of a cell in the grid, giving up its previous
+///		contents and template and keeping the new template for recalculation.
+/// </summary>
+void SpreadsheetSession::storeCell(int col, int row, const string &contents, int templateId)
+{
+	int physCol = colMap.ToPhysical(col);
+	int physRow = rowMap.ToPhysical(row);
+
+	// Give up the previous contents and template.
+	looseFormulas.erase(CA_KEY(physCol, physRow));
+	cellEntry *old = cells.Find(physCol, physRow);
+	if (old != NULL)
+	{
+		strings.Release(old->contents);
+		if (old->templateId >= 0)
+		{
+			templates.Detach(old->templateId, physCol, physRow);
+			templates.Release(old->templateId);
+		}
+	}
+
+  // Update the cell grid. A formula only keeps the text it was entered as if
+  // the text differs from the one rebuilt from its template.
+	if(contents == "")
+		cells.Erase(physCol, physRow);
+	else
+	{
+		growExtent(col, row);
+		cellEntry &cell = cells.Insert(physCol, physRow);
+		if (templateId >= 0 && contents == Formula::Denormalize(templates.GetText(templateId), col, row))
+			cell.contents = 0;
+		else
+			cell.contents = strings.Intern(contents);
+		cell.templateId = templateId;
+		if (templateId >= 0)
+			templates.Attach(templateId, physCol, physRow);
+		else if (contents[0] == '=')
+			looseFormulas.insert(CA_KEY(physCol, physRow));
+	}
+}
+
+/// <summary>
+///		Gets the cells in use within a block, at their positions as clients see
+///		them. Only the part of the block within the extent of the sheet is
+///		looked at, one stored rectangle per pair of row and column runs.
+/// </summary>
+void SpreadsheetSession::collectCells(int col0, int row0, int col1, int row1, vector<placedCell> *found)
+{
+	found->clear();
+
+	vector<axisRun> colRuns;
+	vector<axisRun> rowRuns;
+	colMap.Runs(col0, min(col1, colExtent - 1), &colRuns);
+	rowMap.Runs(row0, min(row1, rowExtent - 1), &rowRuns);
+
+	for (size_t r = 0; r < rowRuns.size(); r++)
+	{
+		for (size_t c = 0; c < colRuns.size(); c++)
+		{
+			const axisRun &cr = colRuns[c];
+			const axisRun &rr = rowRuns[r];
+			for (CellGrid::iterator it = cells.Range(cr.physical, rr.physical, cr.physical + cr.length - 1, rr.physical + rr.length - 1); !it.Done(); it.Next())
+			{
+				placedCell cell;
+				cell.col = cr.logical + it.Col() - cr.physical;
+				cell.row = rr.logical + it.Row() - rr.physical;
+				cell.entry = &it.Cell();
+				found->push_back(cell);
+			}
+		}
+	}
+}
+
+/// <summary>
+///		Gets the contents of a cell as they read at the given position.
+///		Relative references of formulas are shifted to the position, so this also
+///		gives the contents that a cell would have if it were copied there.
+///		A formula reads as it was entered while that text still compiles to its
+///		template at the position, and is rebuilt from the template once a copy
+///		or a layout change moves its references.
+/// </summary>
+string SpreadsheetSession::cellText(const cellEntry &cell, int col, int row)
+{
+	if (cell.templateId >= 0)
+	{
+		const string &relative = templates.GetText(cell.templateId);
+		if (cell.contents != 0)
+		{
+			string entered = strings.Get(cell.contents);
+			if (Formula::Normalize(entered, col, row) == relative)
+				return entered;
+		}
+		return Formula::Denormalize(relative, col, row);
+	}
+	return strings.Get(cell.contents);
+}
+
+/// <summary>
+///		Gets the key of a cell in the dependency graph, which is the key of
+///		where the cell is stored so that it survives layout changes.
+/// </summary>
+cellKey SpreadsheetSession::nodeKey(int col, int row)
+{
+	return CA_KEY(colMap.ToPhysical(col), rowMap.ToPhysical(row));
+}
+
+/// <summary>
+///		Notes that a cell is in use or referenced by name, so that layout
+///		changes know where the sheet in use ends. The ranges of functions do
+///		not count, since lines past the end are empty either way.
+/// </summary>
+void SpreadsheetSession::growExtent(int col, int row)
+{
+	if (col >= colExtent)
+		colExtent = col + 1;
+	if (row >= rowExtent)
+		rowExtent = row + 1;
+}
+
+/// <summary>
+///		Gets a "cell" message for every cell in use at the current version. The
+///		snapshot is built the first time a client joins at a version and shared
+///		by every later join until an edit changes the version. Streams keep the
+///		snapshot they were started with. The cells mutex must be held.
+/// </summary>
+SheetSnapshot *SpreadsheetSession::currentSnapshot()
+{
+	if (snapshot != NULL && snapshot->Version() == sheetVersion)
+		return snapshot;
+
+	vector<placedCell> found;
+	collectCells(0, 0, CA_MAX_COL, CA_MAX_ROW, &found);
+
+	string text;
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		if (i > 0)
+			text += '\n';
+		text += "cell " + FormatCellName(found[i].col, found[i].row) + " " + cellText(*found[i].entry, found[i].col, found[i].row);
+	}
+
+	if (snapshot != NULL)
+		snapshot->Release();
+	snapshot = new SheetSnapshot(text, found.size(), sheetVersion);
+
+	return snapshot;
+}
+
+/// <summary>
+///		Gets a "cell" message, separated by single newlines, for every cell
+///		changed after the given version, which the change log must reach back
+///		to. The cells mutex must be held.
+/// </summary>
+string SpreadsheetSession::changedCells(unsigned long long since, size_t *count)
+{
+	// Gather the cells changed after the version, newest transaction first.
+	set<cellKey> changed;
+	for (deque< pair<unsigned long long, vector<cellKey> > >::reverse_iterator it = changeLog.rbegin(); it != changeLog.rend() && it->first > since; it++)
+		changed.insert(it->second.begin(), it->second.end());
+
+	string text;
+	for (set<cellKey>::iterator it = changed.begin(); it != changed.end(); it++)
+	{
+		int col = CA_KEY_COL(*it);
+		int row = CA_KEY_ROW(*it);
+		const cellEntry *cell = cells.Find(colMap.ToPhysical(col), rowMap.ToPhysical(row));
+		if (!text.empty())
+			text += '\n';
+		text += "cell " + FormatCellName(col, row) + " " + (cell == NULL ? string() : cellText(*cell, col, row));
+	}
+
+	*count = changed.size();
+	return text;
+}
+
+/// <summary>
+///		Advances the version of the sheet for a transaction and logs the cells
+///		it changed, so that a reconnecting client can be sent only those. The
+///		oldest transactions are forgotten once the log holds too many cells. A
+///		layout change moves cells the log knows by position, so clients must
+///		resume from after it. The cells mutex must be held.
+/// </summary>
+void SpreadsheetSession::recordVersion(const map<cellKey, string> &changes, bool layout)
+{
+	if (savedVersion == sheetVersion)
+		dirtySince = LatencyHistogram::NowMicros();
+	sheetVersion++;
+	editedCells += changes.size();
+
+	if (layout || changes.size() > SS_CHANGE_LOG_CELLS)
+	{
+		changeLog.clear();
+		changeLogCells = 0;
+		changeLogBase = sheetVersion;
+		return;
+	}
+
+	changeLog.push_back(make_pair(sheetVersion, vector<cellKey>()));
+	vector<cellKey> &keys = changeLog.back().second;
+	keys.reserve(changes.size());
+	for (map<cellKey, string>::const_iterator it = changes.begin(); it != changes.end(); it++)
+		keys.push_back(it->first);
+	changeLogCells += keys.size();
+
+	while (changeLogCells > SS_CHANGE_LOG_CELLS)
+	{
+		changeLogCells -= changeLog.front().second.size();
+		changeLogBase = changeLog.front().first;
+		changeLog.pop_front();
+	}
+}
+
+/// <summary>
+///		Sends edited cells to every client, as one message of cell commands per
+///		client. If the edits came from a range operation or a layout change,
+///		clients with the given SS_CAP_ flag are sent the compact message
+///		instead. Clients that watch viewports are only sent the cells within
+///		the blocks they subscribed to, found through the viewport index.
+/// </summary>
+void SpreadsheetSession::sendCells(const map<cellKey, string> &changes, const string &compactMessage, unsigned int capability)
+{
+	string message;
+	for (map<cellKey, string>::const_iterator it = changes.begin(); it != changes.end(); it++)
+	{
+		if (!message.empty())
+			message += '\n';
+		message += "cell " + FormatCellName(CA_KEY_COL(it->first), CA_KEY_ROW(it->first)) + " " + it->second;
+	}
+
+	// Clients that track the version are told the one the edits bring them to.
+	ostringstream version;
+	version << "version " << sheetVersion;
+
+	// Clients that take compressed messages share one compressed copy of a large batch.
+	string deflated;
+	bool compressed = false;
+	bool watching = false;
+
+	for (map<StringSocket*, unsigned int>::iterator it = clientSockets.begin(); it != clientSockets.end(); it++)
+	{
+		if (it->second & SS_CAP_VIEWPORT)
+		{
+			watching = true;
+			continue;
+		}
+
+		bool compact = !compactMessage.empty() && (it->second & capability);
+		string sent = compact ? compactMessage : message;
+		if (!compact && (it->second & SS_CAP_DEFLATE) && message.size() >= MC_MIN_SIZE)
+		{
+			if (!compressed)
+			{
+				compressed = true;
+				if (!CompressMessage(message, &deflated))
+					deflated = message;
+			}
+			sent = deflated;
+		}
+		if (it->second & SS_CAP_VERSIONS)
+			sent += (sent.empty() ? "" : "\n") + version.str();
+		if (!sent.empty())
+			sendTo(it->first, sent);
+	}
+
+	if (!watching)
+		return;
+
+	// Gather the changed cells that each client watches.
+	map<StringSocket*, string> visible;
+	vector<StringSocket*> watchers;
+	for (map<cellKey, string>::const_iterator it = changes.begin(); it != changes.end(); it++)
+	{
+		watchers.clear();
+		viewports.Find(CA_KEY_COL(it->first), CA_KEY_ROW(it->first), &watchers);
+		for (size_t i = 0; i < watchers.size(); i++)
+		{
+			string &text = visible[watchers[i]];
+			if (!text.empty())
+				text += '\n';
+			text += "cell " + FormatCellName(CA_KEY_COL(it->first), CA_KEY_ROW(it->first)) + " " + it->second;
+		}
+	}
+
+	for (map<StringSocket*, unsigned int>::iterator it = clientSockets.begin(); it != clientSockets.end(); it++)
+	{
+		if (!(it->second & SS_CAP_VIEWPORT))
+			continue;
+
+		string sent;
+		map<StringSocket*, string>::iterator seen = visible.find(it->first);
+		if (seen != visible.end())
+			sent.swap(seen->second);
+		if ((it->second & SS_CAP_DEFLATE) && CompressMessage(sent, &deflated))
+			sent.swap(deflated);
+		if (it->second & SS_CAP_VERSIONS)
+			sent += (sent.empty() ? "" : "\n") + version.str();
+		if (!sent.empty())
+			sendTo(it->first, sent);
+	}
+}
+
+/// <summary>
+///		Gets the message that sends a client the cells in use within a block:
+///		"range <block> <n>" followed by n cell messages, compressed if the client
+///		takes compressed messages. Cells of the block that are not listed are
+///		empty. The cells mutex must be held.
+/// </summary>
+string SpreadsheetSession::rangeReply(int col0, int row0, int col1, int row1, unsigned int capabilities)
+{
+	vector<placedCell> found;
+	collectCells(col0, row0, col1, row1, &found);
+
+	string text;
+	for (size_t i = 0; i < found.size(); i++)
+	{
+		if (i > 0)
+			text += '\n';
+		text += "cell " + FormatCellName(found[i].col, found[i].row) + " " + cellText(*found[i].entry, found[i].col, found[i].row);
+	}
+
+	ostringstream cmd;
+	cmd << "range " << FormatCellRange(col0, row0, col1, row1) << " " << found.size();
+	if (capabilities & SS_CAP_VERSIONS)
+		cmd << " " << sheetVersion;
+	string message = cmd.str();
+	string deflated;
+	if ((capabilities & SS_CAP_DEFLATE) && CompressMessage(text, &deflated))
+		text.swap(deflated);
+	if (!text.empty())
+		message += "\n" + text;
+
+	return message;
+}
+
+/// <summary>
+///		Sends a message to a client. A client still being streamed the snapshot
+///		it joined at is sent the message right after the snapshot.
+/// </summary>
+void SpreadsheetSession::sendTo(StringSocket *client, const string &message)
+{
+	map<StringSocket*, SnapshotStream*>::iterator joined = joining.find(client);
+	if (joined == joining.end())
+	{
+		client->BeginSend(message, SpreadsheetSession::clientSendCallback, NULL);
+		return;
+	}
+
+	joined->second->Send(message);
+
+	// Once the snapshot is through, the stream has nothing left to hold back.
+	if (joined->second->IsFinished())
+	{
+		joined->second->Close();
+		joining.erase(joined);
+	}
+}
+
+/// <summary>
+///		Gets whether any connected client lacks the given SS_CAP_ flag. Clients
+///		that watch viewports are sent cells rather than compact messages, so
+///		they count as lacking every flag.
+/// </summary>
+bool SpreadsheetSession::hasClientsWithout(unsigned int capability)
+{
+	for (map<StringSocket*, unsigned int>::iterator it = clientSockets.begin(); it != clientSockets.end(); it++)
+	{
+		if (!(it->second & capability) || (it->second & SS_CAP_VIEWPORT))
+			return true;
+	}
+	return false;
+}
+
+///	<summary>
+///		Looks up the computed numeric value of a cell for formula evaluation.
+///	</summary>
+bool SpreadsheetSession::Lookup(int col, int row, double *value)
+{
+	if (col < 0 || row < 0 || col > CA_MAX_COL || row > CA_MAX_ROW)
+		return false;
+	return cellValues.Get(colMap.ToPhysical(col), rowMap.ToPhysical(row), value);
+}
+
+///	<summary>
+///		Aggregates the computed numeric values of a range for formula evaluation.
+///	</summary>
+void SpreadsheetSession::Aggregate(int col0, int row0, int col1, int row1, aggregateResult *result)
+{
+	vector<axisRun> colRuns;
+	vector<axisRun> rowRuns;
+	colMap.Runs(min(col0, col1), max(col0, col1), &colRuns);
+	rowMap.Runs(min(row0, row1), max(row0, row1), &rowRuns);
+
+	// Until the layout changes, the range is stored as one rectangle.
+	if (colRuns.size() == 1 && rowRuns.size() == 1)
+	{
+		cellValues.Aggregate(colRuns[0].physical, rowRuns[0].physical, colRuns[0].physical + colRuns[0].length - 1, rowRuns[0].physical + rowRuns[0].length - 1, result);
+		return;
+	}
+
+	// Otherwise combine the stored rectangles of each pair of runs.
+	result->sum = 0;
+	result->min = 0;
+	result->max = 0;
+	result->count = 0;
+	for (size_t c = 0; c < colRuns.size(); c++)
+	{
+		for (size_t r = 0; r < rowRuns.size(); r++)
+		{
+			aggregateResult part;
+			cellValues.Aggregate(colRuns[c].physical, rowRuns[r].physical, colRuns[c].physical + colRuns[c].length - 1, rowRuns[r].physical + rowRuns[r].length - 1, &part);
+			if (part.count == 0)
+				continue;
+
+			result->min = result->count == 0 ? part.min : min(result->min, part.min);
+			result->max = result->count == 0 ? part.max : max(result->max, part.max);
+			result->sum += part.sum;
+			result->count += part.count;
+		}
+	}
+}
+
+///	<summary>
+///		Recomputes the value of a single cell from its contents. Formula cells
+///		are evaluated against the current values of the cells they reference.
+///	</summary>
+void SpreadsheetSession::computeValue(cellKey key)
+{
+	int col = CA_KEY_COL(key);
+	int row = CA_KEY_ROW(key);
+	double value;
+	bool hasValue = false;
+
+	// Graph keys are where cells are stored, but formulas are evaluated at
+	// their position as clients see it.
+	const cellEntry *cell = cells.Find(col, row);
+	if (cell != NULL && cell->templateId >= 0)
+		hasValue = templates.GetFormula(cell->templateId).Evaluate(*this, colMap.ToLogical(col), rowMap.ToLogical(row), &value);
+	else
+		hasValue = cell != NULL && parseNumber(strings.Get(cell->contents), &value);
+
+	if (hasValue)
+		cellValues.Set(col, row, value);
+	else
+		cellValues.Clear(col, row);
+}
+
+///	<summary>
+///		Orders the given cells and every cell that directly or indirectly
+///		depends on any of them so that each comes after all of its dependents.
+///		Returns false if a cycle is reachable from any of the cells.
+///	</summary>
+bool SpreadsheetSession::orderDependents(const set<cellKey> &keys, vector<cellKey> *order)
+{
+	set<cellKey> visited;
+	for (set<cellKey>::const_iterator it = keys.begin(); it != keys.end(); it++)
+	{
+		if (visited.find(*it) == visited.end() && !visitDependents(*it, visited, *order))
+			return false;
+	}
+	return true;
+}
+
+///	<summary>
+///		Recomputes every cell, making sure each cell is computed after the cells
+///		that it references.
+///	</summary>
+void SpreadsheetSession::recalculateAll()
+{
+	cellValues.ClearAll();
+
+	set<cellKey> keys;
+	vector<cellKey> order;
+	for (CellGrid::iterator it = cells.Begin(); !it.Done(); it.Next())
+		keys.insert(CA_KEY(it.Col(), it.Row()));
+
+	// The graph never holds a cycle, so every cell is ordered. Walking the
+	// order backwards computes each cell after the cells that it references.
+	orderDependents(keys, &order);
+	for (vector<cellKey>::reverse_iterator it = order.rbegin(); it != order.rend(); it++)
+		computeValue(*it);
+}
+
+///	<summary>
+///		Depth-first search over dependents. Appends each cell to the order after
+///		all of its dependents. The path being searched is kept on the heap, so a
+///		long chain of formulas cannot run the thread out of stack. Returns false
+///		if the search reaches a cell on its own path, which closes a cycle.
+///	</summary>
+bool SpreadsheetSession::visitDependents(cellKey key, set<cellKey> &visited, vector<cellKey> &order)
+{
+	// The cells on the path, along with the dependents of each that are yet to
+	// be visited.
+	vector<cellKey> path(1, key);
+	set<cellKey> onPath;
+	vector< vector<cellKey> > pending(1);
+	visited.insert(key);
+	onPath.insert(key);
+	listDependents(key, &pending.back());
+
+	while (!path.empty())
+	{
+		// Finish the cell once all of its dependents have been visited.
+		if (pending.back().empty())
+		{
+			order.push_back(path.back());
+			onPath.erase(path.back());
+			path.pop_back();
+			pending.pop_back();
+			continue;
+		}
+
+		cellKey next = pending.back().back();
+		pending.back().pop_back();
+		if (onPath.find(next) != onPath.end())
+			return false;
+		if (!visited.insert(next).second)
+			continue;
+
+		path.push_back(next);
+		onPath.insert(next);
+		pending.push_back(vector<cellKey>());
+		listDependents(next, &pending.back());
+	}
+	return true;
+}
+
+///	<summary>
+///		Gets the cells that reference a cell, whether by name or through the
+///		range of a function.
+///	</summary>
+void SpreadsheetSession::listDependents(cellKey key, vector<cellKey> *found)
+{
+	set<cellKey> dents = depGraph.get_dependents(key);
+	rangeReaders.Find(CA_KEY_COL(key), CA_KEY_ROW(key), &dents);
+	found->assign(dents.begin(), dents.end());
 }
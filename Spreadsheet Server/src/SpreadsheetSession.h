@@ -3,7 +3,7 @@ File: SpreadsheetSession.h
 Authors: Garrett Bigelow, CJ Dimaano
 CS 3505 - Spring 2015
 Date created: April 5, 2015
-Last updated: April 24, 2015
+Last updated: October 18, 2026
 *******************************************************************************/
 
 #ifndef SPREADSHEETSESSION_H
@@ -11,14 +11,70 @@ Last updated: April 24, 2015
 
 #include "StringSocket.h"
 #include "dependency_graph.h"
+#include "ColumnStore.h"
+#include "RangeIndex.h"
+#include "Formula.h"
+#include "FormulaTemplates.h"
+#include "CellGrid.h"
+#include "AxisMap.h"
+#include "StringPool.h"
+#include "UndoLog.h"
+#include "SnapshotStream.h"
+#include "ViewportIndex.h"
+#include "LatencyHistogram.h"
+#include "ProfiledMutex.h"
 #include <string>
 #include <vector>
-#include <stack>
+#include <deque>
 #include <map>
 #include <set>
 #include <pthread.h>
 
-class SpreadsheetSession {
+// Client capabilities
+#define SS_CAP_RANGES 0x1		// Applies fill, copy, move and clear messages itself
+#define SS_CAP_LAYOUT 0x2		// Applies row and column insert and delete messages itself
+#define SS_CAP_VERSIONS 0x4		// Tracks the sheet version, so it can resume from it after reconnecting
+#define SS_CAP_DEFLATE 0x8		// Inflates "deflate" messages holding snapshots and large batches
+#define SS_CAP_VIEWPORT 0x10	// Joins with no cells and is only sent the cells within the blocks it subscribes to
+
+// Largest number of cells that a single range operation may write
+#define SS_MAX_RANGE_CELLS 1048576
+
+// Largest number of cell changes kept for clients resuming from an earlier version
+#define SS_CHANGE_LOG_CELLS 65536
+
+// Largest number of blocks of cells that a single client may subscribe to
+#define SS_MAX_VIEWPORTS 16
+
+// Longest coalescing window, in milliseconds
+#define SS_MAX_COALESCE_WINDOW 10000
+
+// Bytes of the sheet written at a time by a save with a deadline
+#define SS_SAVE_CHUNK 1048576
+
+// Approximate bytes each cell in use holds across the grid, values and dependency graph
+#define SS_CELL_BYTES 160
+
+// Stages of an edit, each timed in a histogram of its own
+#define SS_STAGE_DISPATCH 0		// From the message being received to its handler running
+#define SS_STAGE_LOCK 1			// Waiting for the cells mutex
+#define SS_STAGE_GRAPH 2		// Updating the dependency graph and recalculating
+#define SS_STAGE_BROADCAST 3	// Queueing the changed cells to every client
+#define SS_STAGE_PERSIST 4		// From the first edit not yet saved to the file being in place
+#define SS_STAGE_TOTAL 5		// From the message being received to its broadcast being queued
+#define SS_STAGES 6
+
+// Counters of a session, as reported by the stats command
+typedef struct sessionStats {
+	int clients;							// Number of connected clients
+	unsigned long long edits;				// Cells changed since the sheet was opened
+	double editsPerSecond;					// Cells changed per second since the stats were last taken
+	int graphSize;							// Number of dependencies in the dependency graph
+	size_t memoryBytes;						// Approximate bytes the session holds
+	unsigned long long version;				// Version of the sheet
+} sessionStats;
+
+class SpreadsheetSession : private FormulaContext {
 
 public:
 	SpreadsheetSession(std::string name);					// Normal Constructor
@@ -27,34 +83,147 @@ public:
 
 	// pair<cellName, newContents> , userSendingTheCommand  
 	// Checks for dependencies, then edits the cell's contents
-	bool EditCell(std::string cellName, std::string editCommand);	
+	// If version is not NULL, it is set to the sheet version that includes the edit
+	bool EditCell(std::string cellName, std::string editCommand, unsigned long long *version);	
+	bool EditCells(const std::vector< std::pair<std::string, std::string> > &edits, unsigned long long *version);	// Edits many cells as one transaction
+
+	// Range operations. Each one is a single transaction and a single message to capable clients.
+	bool FillRange(int col0, int row0, int col1, int row1, int destCol0, int destRow0, int destCol1, int destRow1);	// Repeats a block over a range, shifting references
+	bool CopyRange(int col0, int row0, int col1, int row1, int destCol, int destRow);	// Copies a block, shifting references
+	bool MoveRange(int col0, int row0, int col1, int row1, int destCol, int destRow);	// Moves a block, keeping references
+	bool ClearRange(int col0, int row0, int col1, int row1);	// Empties every cell of a block
+
+	// Layout changes. Later rows or columns shift over and formulas are rewritten to follow them.
+	bool InsertRows(int row, int count);			// Inserts empty rows before the given row
+	bool DeleteRows(int row, int count);			// Deletes rows starting at the given row
+	bool InsertColumns(int col, int count);			// Inserts empty columns before the given column
+	bool DeleteColumns(int col, int count);			// Deletes columns starting at the given column
 
-	bool AddClient(StringSocket* client1);			// Attempts to add a client to the session. Returns true if added
+	// Attempts to add a client to the session. Returns true if added
+	// A client that last saw lastVersion is only sent the cells changed since, if they are still known
+	bool AddClient(StringSocket* client1, unsigned int capabilities, unsigned long long lastVersion);
+	void SetClientCapabilities(StringSocket* client, unsigned int capabilities);	// Changes the SS_CAP_ flags of a connected client
 	bool RemoveClient(StringSocket* client2);		// Attempts to remove a client from this session. Returns true if removed
+	bool Subscribe(StringSocket* client, int col0, int row0, int col1, int row1);	// Sends a block of cells to a client and then every edit within it
+	bool Unsubscribe(StringSocket* client, int col0, int row0, int col1, int row1);	// Stops sending a client the edits within a block it subscribed to
+	void UnsubscribeAll(StringSocket* client);		// Stops sending a client the edits within every block it subscribed to
+	bool SendRange(StringSocket* client, int col0, int row0, int col1, int row1);	// Sends a block of cells to a client once
 	bool Save();									// Saves the state of the spreadsheet to a plain text file
+	bool Save(const struct timespec *deadline);		// Saves, giving up and keeping the old file once the CLOCK_REALTIME deadline passes
 	bool Load();									// Loads the spreadsheet via the name of the plain text file
 	bool UndoAll();									// Sends an undo command to all connected clients
+	bool IsDirty();									// Gets whether the sheet has changed since it was last saved
+	size_t Shrink();								// Frees what a session with no clients can rebuild, and gets the bytes it still holds
 
 	int GetUserCount();								// Returns the number of connected users to the server
 	std::string GetName();
 	std::map<std::string, std::string> GetCellMap();
+	bool GetCellValue(std::string cellName, double *value);	// Gets the computed numeric value of a cell
+	unsigned long long GetVersion();				// Gets the number of transactions applied since the sheet was opened
+	void GetStats(sessionStats *stats, bool restartRate);	// Gets the counters of the session, and, if asked to, starts measuring the edit rate anew
+	static const LatencyHistogram &SaveLatency();	// Gets how long each save of any sheet took
+	static LatencyHistogram &StageLatency(int stage);	// Gets how long an SS_STAGE_ stage of the edits of any sheet took
+	static const char *StageName(int stage);		// Gets the name of an SS_STAGE_ stage, such as "lock"
+
+	// Retyping the cells of the last edit within the window is merged into it: one history entry, and one broadcast per window
+	static void SetDefaultCoalesceWindow(int milliseconds);	// Sets the coalescing window of sessions opened afterwards. 0 turns it off
+	void SetCoalesceWindow(int milliseconds);		// Sets the coalescing window of this session. 0 turns it off
 
 private:
+	// A cell in use at its position as clients see it
+	typedef struct placedCell {
+		int col;
+		int row;
+		const cellEntry *entry;
+	} placedCell;
+
 	std::set<std::string> GetCellsFromCommand(std::string);		// Takes in a command string and parses it, creating and return a set of cell names if possible
+	std::set<cellKey> GetCellsFromFormula(const Formula &formula, int col, int row, std::vector<cellRange> *ranges);	// Gets the cells and the ranges referenced by a compiled formula
 	static void clientSendCallback(int ex, void *payload);		// Callback for sending clients messages
-  bool updateCell(std::string name, std::string contents);  // Updates the contents of a cell.
+  void breakCycles(const std::vector<cellKey> &keys);      // Relinks loaded cells one at a time, emptying those that close a cycle
+  bool commitEdits(std::map<cellKey, std::string> &changes, const std::string &rangeMessage);  // Applies, records and sends a transaction
+  void dropUnchanged(std::map<cellKey, std::string> &changes);  // Leaves out the edits that would not change a cell
+  bool coalesceEdits(std::map<cellKey, std::string> &changes, bool *held);  // Merges edits into the burst going on, holding back their broadcast
+  void flushEdits();                                        // Sends the held back edits of the burst to every client
+  static void *flushThread(void *session);                  // Entry point of the thread that sends held back edits
+  void flushLoop();                                         // Sends held back edits once they have waited out the window
+  bool fillRange(int col0, int row0, int col1, int row1, int destCol0, int destRow0, int destCol1, int destRow1, const std::string &rangeMessage);  // Repeats a block over a range
+  bool changeLayout(bool rows, int at, int count);  // Inserts (count > 0) or deletes (count < 0) rows or columns as one transaction
+  bool shiftLayout(bool rows, int at, int *count, std::vector< std::pair<cellKey, stringId> > *previous, std::map<cellKey, std::string> *changes, std::map<cellKey, std::string> *resync);  // Moves lines and rewrites the formulas that reach across them
+  void findSpanning(bool rows, int from, int to, std::vector<cellKey> *found);  // Gets the formula cells whose references reach from one line to another
+  std::string layoutMessage(bool rows, int at, int count, const std::map<cellKey, std::string> &changes);  // Gets the message that tells capable clients about a layout change
+  bool applyEdits(std::map<cellKey, std::string> &changes, std::vector< std::pair<cellKey, stringId> > *previous);  // Updates many cells after one cycle check
+  int internFormula(int col, int row, const std::string &contents);  // Gets the template id of formula contents, or -1
+  std::set<cellKey> referencedCells(int col, int row, const std::string &contents, int templateId, std::vector<cellRange> *ranges);  // Gets the cells and the ranges referenced by contents
+  void linkCell(int col, int row, const std::string &contents, int templateId);  // Links a cell into the dependency graph by what it references
+  void storeCell(int col, int row, const std::string &contents, int templateId);  // Replaces the contents of a cell in the grid
+  void collectCells(int col0, int row0, int col1, int row1, std::vector<placedCell> *found);  // Gets the cells in use within a block
+  std::string cellText(const cellEntry &cell, int col, int row);  // Gets the contents of a cell as they read at a position
+  cellKey nodeKey(int col, int row);                        // Gets the dependency graph key of a cell
+  void growExtent(int col, int row);                        // Notes that a cell is used or referenced by name
+  SheetSnapshot *currentSnapshot();                         // Gets the cell messages that bring a joining client up to date
+  std::string changedCells(unsigned long long since, size_t *count);  // Gets the cell messages for the cells changed after a version
+  void recordVersion(const std::map<cellKey, std::string> &changes, bool layout);  // Advances the version and logs the cells a transaction changed
   
-  void sendCell(std::string name, std::string content, StringSocket *ss);
+  std::string rangeReply(int col0, int row0, int col1, int row1, unsigned int capabilities);  // Gets the "range" message holding the cells in use within a block
+  void sendTo(StringSocket *client, const std::string &message);  // Sends a message, after the snapshot if the client is still joining
+  void sendCells(const std::map<cellKey, std::string> &changes, const std::string &compactMessage, unsigned int capability);  // Sends edited cells to every client in one message
+  bool hasClientsWithout(unsigned int capability);         // Gets whether any client lacks an SS_CAP_ flag
+  size_t heldBytes();                                       // Gets the approximate bytes the session holds. The cells mutex must be held
+
+  bool Lookup(int col, int row, double *value);             // FormulaContext lookup of a computed cell value
+  void Aggregate(int col0, int row0, int col1, int row1, aggregateResult *result);  // FormulaContext range aggregate
+  void computeValue(cellKey key);                           // Recomputes the value of a single cell
+  bool orderDependents(const std::set<cellKey> &keys, std::vector<cellKey> *order);  // Orders cells and their dependents for recomputing, or finds a cycle
+  void recalculateAll();                                    // Recomputes every cell in dependency order
+  bool visitDependents(cellKey key, std::set<cellKey> &visited, std::vector<cellKey> &order);
+  void listDependents(cellKey key, std::vector<cellKey> *found);  // Gets the cells that reference a cell by name or range
 
 	std::string sprdName;
-	std::stack < std::pair < std::string, std::string > > history;
 	std::set < std::string > clientNames;
-	std::set < StringSocket* > clientSockets;
-	std::map < std::string, std::string > cellMap;
+	std::map < StringSocket*, unsigned int > clientSockets;	// Connected clients and their SS_CAP_ flags
+	StringPool strings;								// Interned cell contents, stored in the session's arena
+	UndoLog history;								// Edited cells and their previous contents, spilled to disk
+	CellGrid cells;									// Cell contents and template ids in row-major tiles, by physical position
+	AxisMap rowMap;									// Maps the rows clients see onto physical rows
+	AxisMap colMap;									// Maps the columns clients see onto physical columns
+	int rowExtent;									// Rows at and after this one are empty and only referenced by ranges
+	int colExtent;									// Columns at and after this one are empty and only referenced by ranges
+	std::set<cellKey> looseFormulas;				// Stored positions of formulas that did not compile
+	FormulaTemplates templates;						// Shared compiled formulas keyed by relative form
+	ColumnStore cellValues;							// Computed numeric values in dense per-column arrays
 	dependency_graph depGraph;
+	RangeIndex rangeReaders;						// Function ranges that formulas read, by where the cells are stored
+	unsigned long long sheetVersion;				// Version of the sheet, one more for every transaction applied
+	std::deque< std::pair<unsigned long long, std::vector<cellKey> > > changeLog;	// Versions and the cells they changed, oldest first
+	size_t changeLogCells;							// Number of cells across the change log
+	unsigned long long changeLogBase;				// Oldest version a client can resume from
+	SheetSnapshot *snapshot;						// Cell messages for every cell in use at the version a client last joined at, or NULL
+	std::map < StringSocket*, SnapshotStream* > joining;	// Clients that may still be being sent the snapshot they joined at
+	unsigned long long savedVersion;				// Version the saved file holds as cell messages, or 0 if it is in the old format
+	size_t savedCells;								// Number of cell messages in the saved file
+	ViewportIndex viewports;						// Blocks of cells that SS_CAP_VIEWPORT clients watch, by the position clients see
+	static int defaultCoalesceWindow;				// Coalescing window of new sessions, in milliseconds
+	int coalesceWindow;								// Coalescing window, in milliseconds, or 0 if edits are never merged
+	std::set<cellKey> burstCells;					// Cells of the last edit, which later edits of the same cells are merged into
+	unsigned long long burstVersion;				// Version after the last edit of the burst, or 0 if there is none
+	unsigned long long burstLast;					// Time of the last edit of the burst, in milliseconds
+	std::map<cellKey, std::string> heldCells;		// Edits merged into the burst that clients have not been sent yet
+	unsigned long long heldSince;					// Time the first held edit was made, in milliseconds
+	bool flusherRunning;							// Whether the thread sending held edits has been started
+	bool flusherStopping;							// Whether the thread sending held edits should finish
+	pthread_t flusher;								// Sends held edits once they have waited out the window
+	pthread_cond_t flushCond;						// Wakes the flusher when edits are held or the session closes
+	unsigned long long editedCells;					// Cells changed since the sheet was opened
+	unsigned long long statsEditedCells;			// Cells changed as of the last time the stats were taken
+	unsigned long long statsTaken;					// Time the stats were last taken, or the sheet was opened, in milliseconds
+	unsigned long long graphUpdated;				// Time the last edits were applied to the graph, in microseconds
+	unsigned long long dirtySince;					// Time of the first edit not yet saved, in microseconds, or 0
+	static LatencyHistogram saveLatency;			// How long each save of any sheet took
+	static LatencyHistogram stageLatency[SS_STAGES];	// How long each stage of the edits of any sheet took
   
-  pthread_mutex_t clientsMutex;
-  pthread_mutex_t cellsMutex;
+  ProfiledMutex clientsMutex;
+  ProfiledMutex cellsMutex;
   
 };
 
@@ -0,0 +1,314 @@
+/*******************************************************************************
+  File: StringPool.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c StringPool.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created StringPool.cpp file.
+  - Added StringPool class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "StringPool.h"
+
+//
+// Standard libraries.
+//
+#include <cstring>
+
+
+//
+// Initial number of hash buckets.  Must be a power of two.
+//
+#define SP_INITIAL_BUCKETS 64
+
+
+/// <summary>
+///   Computes the 32-bit FNV-1a hash of a run of characters.
+/// </summary>
+static unsigned int hashBytes(const char *data, size_t length) {
+
+  unsigned int hash = 2166136261u;
+  for(size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+
+}
+
+
+/// <summary>
+///   Default constructor.
+/// </summary>
+StringPool::StringPool(void) {
+  this->Clear();
+}
+
+
+/// <summary>
+///   Copy constructor.
+/// </summary>
+StringPool::StringPool(const StringPool &other) {
+  *this = other;
+}
+
+
+/// <summary>
+///   Assignment operator.  The strings are copied into this pool's own arena.
+/// </summary>
+StringPool & StringPool::operator=(const StringPool &other) {
+
+  if(this == &other)
+    return *this;
+
+  this->arena.Reset();
+  this->entries = other.entries;
+  this->buckets = other.buckets;
+  this->freeIds = other.freeIds;
+  this->count = other.count;
+  this->liveBytes = other.liveBytes;
+
+  for(size_t i = 1; i < this->entries.size(); i++) {
+    if(this->entries[i].uses > 0)
+      this->entries[i].data = this->store(this->entries[i].data,
+          this->entries[i].length);
+  }
+
+  return *this;
+
+}
+
+
+/// <summary>
+///   Gets the id of a string, adding it to the pool if it is not already
+///   there.
+/// </summary>
+stringId StringPool::Intern(const std::string &str) {
+
+  if(str.empty())
+    return 0;
+
+
+  // Look for the string in its hash chain.
+  unsigned int hash = hashBytes(str.data(), str.length());
+  stringId &head = this->buckets[hash & (this->buckets.size() - 1)];
+  for(stringId id = head; id != 0; id = this->entries[id].next) {
+    entry &e = this->entries[id];
+    if(e.hash == hash && e.length == str.length()
+        && memcmp(e.data, str.data(), e.length) == 0) {
+      e.uses++;
+      return id;
+    }
+  }
+
+
+  // Add the string, reusing a free entry if there is one.
+  stringId id;
+  if(!this->freeIds.empty()) {
+    id = this->freeIds.back();
+    this->freeIds.pop_back();
+  }
+  else {
+    id = this->entries.size();
+    this->entries.push_back(entry());
+  }
+
+  entry &e = this->entries[id];
+  e.data = this->store(str.data(), str.length());
+  e.length = str.length();
+  e.hash = hash;
+  e.uses = 1;
+  e.next = head;
+  head = id;
+
+  this->count++;
+  this->liveBytes += e.length;
+
+  // Keep the chains short.
+  if(this->count > this->buckets.size())
+    this->grow();
+
+  return id;
+
+}
+
+
+/// <summary>
+///   Takes another reference to a string.
+/// </summary>
+void StringPool::Retain(stringId id) {
+  if(id != 0)
+    this->entries[id].uses++;
+}
+
+
+/// <summary>
+///   Gives back a reference to a string.
+/// </summary>
+void StringPool::Release(stringId id) {
+
+  if(id == 0 || --this->entries[id].uses > 0)
+    return;
+
+
+  // Unlink the entry from its hash chain.
+  entry &e = this->entries[id];
+  stringId *link = &this->buckets[e.hash & (this->buckets.size() - 1)];
+  while(*link != id)
+    link = &this->entries[*link].next;
+  *link = e.next;
+
+
+  // The characters stay in the arena until the next compaction.
+  this->count--;
+  this->liveBytes -= e.length;
+  e.data = NULL;
+  e.length = 0;
+  e.next = 0;
+  this->freeIds.push_back(id);
+
+}
+
+
+/// <summary>
+///   Gets the characters of a string.
+/// </summary>
+const char * StringPool::Data(stringId id) const {
+  return this->entries[id].data;
+}
+
+
+/// <summary>
+///   Gets the length of a string.
+/// </summary>
+size_t StringPool::Length(stringId id) const {
+  return this->entries[id].length;
+}
+
+
+/// <summary>
+///   Gets a copy of a string.
+/// </summary>
+std::string StringPool::Get(stringId id) const {
+  const entry &e = this->entries[id];
+  return std::string(e.data, e.length);
+}
+
+
+/// <summary>
+///   Gets whether the space taken by strings that are no longer used
+///   outweighs the live strings enough to be worth compacting.
+/// </summary>
+bool StringPool::NeedsCompaction(void) const {
+  return this->arena.Used() > 2 * this->liveBytes + ARENA_BLOCK_SIZE;
+}
+
+
+/// <summary>
+///   Copies the strings in use into a fresh arena and frees the old one.
+/// </summary>
+void StringPool::Compact(void) {
+
+  Arena fresh;
+  for(size_t i = 1; i < this->entries.size(); i++) {
+    entry &e = this->entries[i];
+    if(e.uses == 0)
+      continue;
+    char *data = fresh.Allocate(e.length);
+    memcpy(data, e.data, e.length);
+    e.data = data;
+  }
+
+  // The old blocks are freed when fresh goes out of scope.
+  this->arena.Swap(fresh);
+
+}
+
+
+/// <summary>
+///   Gets the number of strings in use.
+/// </summary>
+size_t StringPool::Count(void) const {
+  return this->count;
+}
+
+
+/// <summary>
+///   Gets the number of bytes held by the pool.
+/// </summary>
+size_t StringPool::BytesReserved(void) const {
+  return this->arena.Reserved()
+      + this->entries.capacity() * sizeof(entry)
+      + this->buckets.capacity() * sizeof(stringId)
+      + this->freeIds.capacity() * sizeof(stringId);
+}
+
+
+/// <summary>
+///   Removes every string.
+/// </summary>
+void StringPool::Clear(void) {
+
+  this->arena.Reset();
+  this->entries.assign(1, entry());
+  this->buckets.assign(SP_INITIAL_BUCKETS, 0);
+  this->freeIds.clear();
+  this->count = 0;
+  this->liveBytes = 0;
+
+  // Entry 0 is the empty string, which is never freed.
+  entry &empty = this->entries[0];
+  empty.data = "";
+  empty.length = 0;
+  empty.hash = 0;
+  empty.uses = 1;
+  empty.next = 0;
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Copies the characters of a string into the arena.
+/// </summary>
+const char * StringPool::store(const char *data, size_t length) {
+  char *copy = this->arena.Allocate(length);
+  memcpy(copy, data, length);
+  return copy;
+}
+
+
+/// <summary>
+///   Doubles the number of hash buckets.
+/// </summary>
+void StringPool::grow(void) {
+
+  this->buckets.assign(this->buckets.size() * 2, 0);
+  size_t mask = this->buckets.size() - 1;
+
+  for(size_t i = 1; i < this->entries.size(); i++) {
+    entry &e = this->entries[i];
+    if(e.uses == 0)
+      continue;
+    e.next = this->buckets[e.hash & mask];
+    this->buckets[e.hash & mask] = i;
+  }
+
+}
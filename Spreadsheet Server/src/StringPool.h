@@ -0,0 +1,215 @@
+/*******************************************************************************
+  File: StringPool.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created StringPool.h file.
+  - Added StringPool class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __STRINGPOOL_H__
+#define __STRINGPOOL_H__
+
+
+//
+// Project headers.
+//
+#include "Arena.h"
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+/// <summary>
+///   Identifies an interned string.  Id 0 is always the empty string.
+/// </summary>
+typedef unsigned int stringId;
+
+
+/// <summary>
+///   An interning table of reference counted strings stored in an arena.
+/// </summary>
+/// <remarks>
+/// <para>
+///   Identical strings are stored exactly once and are referred to by a small
+///   integer id, so a sheet full of repeated values costs one copy of each
+///   distinct value.  String data is packed into the blocks of an arena
+///   instead of being allocated one string at a time.
+/// </para>
+/// <para>
+///   Since the arena never frees individual strings, the space of strings
+///   that are no longer used is only reclaimed by Compact, which copies the
+///   live strings into a fresh arena and frees the old one in one step.
+/// </para>
+/// </remarks>
+class StringPool {
+
+private:
+
+  /// <summary>
+  ///   A single interned string.
+  /// </summary>
+  typedef struct entry {
+    const char *data;         // The characters, stored in the arena.
+    unsigned int length;      // The number of characters.
+    unsigned int hash;        // The hash of the characters.
+    unsigned int uses;        // The number of references, or 0 if free.
+    stringId next;            // The next entry of the hash chain.
+  } entry;
+
+
+  /// <summary>
+  ///   Holds the characters of every string.
+  /// </summary>
+  Arena arena;
+
+
+  /// <summary>
+  ///   The strings indexed by id.
+  /// </summary>
+  std::vector<entry> entries;
+
+
+  /// <summary>
+  ///   The first entry of each hash chain, or 0 for an empty chain.
+  /// </summary>
+  std::vector<stringId> buckets;
+
+
+  /// <summary>
+  ///   Ids of entries that are no longer used.
+  /// </summary>
+  std::vector<stringId> freeIds;
+
+
+  /// <summary>
+  ///   The number of strings in use.
+  /// </summary>
+  size_t count;
+
+
+  /// <summary>
+  ///   The number of characters in strings that are in use.
+  /// </summary>
+  size_t liveBytes;
+
+
+public:
+
+  /// <summary>
+  ///   Default constructor.
+  /// </summary>
+  StringPool(void);
+
+
+  /// <summary>
+  ///   Copy constructor.
+  /// </summary>
+  StringPool(const StringPool &other);
+
+
+  /// <summary>
+  ///   Assignment operator.
+  /// </summary>
+  StringPool & operator=(const StringPool &other);
+
+
+  /// <summary>
+  ///   Gets the id of a string, adding it to the pool if it is not already
+  ///   there.  Every id returned must eventually be given back with Release.
+  /// </summary>
+  stringId Intern(const std::string &str);
+
+
+  /// <summary>
+  ///   Takes another reference to a string.
+  /// </summary>
+  void Retain(stringId id);
+
+
+  /// <summary>
+  ///   Gives back a reference to a string.  The string is removed once it has
+  ///   no more references.
+  /// </summary>
+  void Release(stringId id);
+
+
+  /// <summary>
+  ///   Gets the characters of a string.  The characters are not terminated.
+  /// </summary>
+  const char * Data(stringId id) const;
+
+
+  /// <summary>
+  ///   Gets the length of a string.
+  /// </summary>
+  size_t Length(stringId id) const;
+
+
+  /// <summary>
+  ///   Gets a copy of a string.
+  /// </summary>
+  std::string Get(stringId id) const;
+
+
+  /// <summary>
+  ///   Gets whether the space taken by strings that are no longer used
+  ///   outweighs the live strings enough to be worth compacting.
+  /// </summary>
+  bool NeedsCompaction(void) const;
+
+
+  /// <summary>
+  ///   Copies the strings in use into a fresh arena and frees the old one.
+  ///   Ids are unchanged.
+  /// </summary>
+  void Compact(void);
+
+
+  /// <summary>
+  ///   Gets the number of strings in use.
+  /// </summary>
+  size_t Count(void) const;
+
+
+  /// <summary>
+  ///   Gets the number of bytes held by the pool.
+  /// </summary>
+  size_t BytesReserved(void) const;
+
+
+  /// <summary>
+  ///   Removes every string.
+  /// </summary>
+  void Clear(void);
+
+
+private:
+
+  /// <summary>
+  ///   Copies the characters of a string into the arena.
+  /// </summary>
+  const char * store(const char *data, size_t length);
+
+
+  /// <summary>
+  ///   Doubles the number of hash buckets.
+  /// </summary>
+  void grow(void);
+
+};
+
+
+#endif
@@ -4,7 +4,7 @@
   Team: SegFault
   CS 3505 - Spring 2015
   Date created: April 3, 2015
-  Last updated: April 24, 2015
+  Last updated: October 18, 2026
   
   
   Compile with:
@@ -22,6 +22,20 @@
   
   Changelog:
   
+  October 18, 2026
+  - Changed the queue mutexes to ProfiledMutex.
+  - Added timing of the messages sent and received.
+  - Added SendLatency and ReceivedMicros implementations.
+  - Added counting of the messages and bytes sent and received.
+  - Added GetStats and GetTotals implementations.
+  - Added BeginSendFile implementation.
+  - Moved starting the send thread into the startSendThread helper method.
+  - Fixed the received message buffer being one byte too short for its
+      terminator, which corrupted the heap.
+  - Restored freeing the received message buffer.
+  - Made closing the socket wait for BeginSend, BeginSendFile and
+      BeginReceive calls that are still running.
+  
   April 24, 2015
   - Moved some locks around.
   - Fixed some broken messages.
@@ -93,6 +107,7 @@
 //
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netdb.h>
@@ -147,6 +162,24 @@ static short getPort(struct sockaddr *sa) {
 }
 
 
+/*******************************************************************************
+  Static members.
+*******************************************************************************/
+
+
+ShardedCounter StringSocket::totalMessagesIn;
+ShardedCounter StringSocket::totalMessagesOut;
+ShardedCounter StringSocket::totalBytesIn;
+ShardedCounter StringSocket::totalBytesOut;
+LatencyHistogram StringSocket::sendLatency;
+
+//
+// When the message being handled by the receive callback running on this
+//   thread was received, or 0.
+//
+static __thread unsigned long long receivedAt = 0;
+
+
 /*******************************************************************************
   Global functions.
 *******************************************************************************/
@@ -179,12 +212,13 @@ StringSocket::StringSocket(const StringSocket &other)
       recvQueue(other.recvQueue), sendQueue(other.sendQueue),
       recvBuf(other.recvBuf), recvBufLen(other.recvBufLen),
       recvBufDLen(other.recvBufDLen), searchIndex(other.searchIndex), 
-      sendQueueMutex(other.sendQueueMutex), 
-      recvQueueMutex(other.recvQueueMutex), sendThread(other.sendThread),
+      sendQueueMutex("socket.send_queue"), 
+      recvQueueMutex("socket.recv_queue"),
+      beginMutex("socket.begin"), sendThread(other.sendThread),
       recvThread(other.recvThread),
       mreSend(other.mreSend), mreRecv(other.mreRecv), mreClose(other.mreClose),
       sendSafeToJoin(other.sendSafeToJoin),
-      recvSafeToJoin(other.recvSafeToJoin) {
+      recvSafeToJoin(other.recvSafeToJoin), stats(other.stats) {
   //
   // Do nothing.
   //
@@ -203,11 +237,6 @@ StringSocket::~StringSocket(void) {
   // Delete the receive buffer.
   delete [] this->recvBuf;
   
-  
-  // Destroy the mutex handles.
-  pthread_mutex_destroy(&this->sendQueueMutex);
-  pthread_mutex_destroy(&this->recvQueueMutex);
-  
 }
 
 
@@ -336,6 +365,9 @@ std::string StringSocket::ToString(void) const {
 /// </remarks>
 void StringSocket::BeginSend(std::string msg, sendCallback callback,
     void *payload) {
+  
+  // Keep the socket from being closed until this call is done with it.
+  this->beginMutex.Lock();
       
   // Send the socket closed exception of the socket is closed.
   if(this->mreClose.IsSet()) {
@@ -347,6 +379,7 @@ void StringSocket::BeginSend(std::string msg, sendCallback callback,
     state->payload = payload;
     state->buf = NULL;
     state->bufLen = 0;
+    state->fd = -1;
     state->ex = SS_CLOSED_EXCEPTION;
     
     // Call the callback on a separate thread.
@@ -365,7 +398,7 @@ void StringSocket::BeginSend(std::string msg, sendCallback callback,
   else {
     
     // Make sure only one thread is accessing the send queue at a time.
-    pthread_mutex_lock(&this->sendQueueMutex); {
+    this->sendQueueMutex.Lock(); {
         
       // Append the message terminator to the end of the message if it does not
       //   already end in one.
@@ -380,7 +413,9 @@ void StringSocket::BeginSend(std::string msg, sendCallback callback,
       state->callback = callback;
       state->payload = payload;
       state->bufLen = msg.length();
+      state->fd = -1;
       state->ex = SS_NO_EXCEPTION;
+      state->queued = LatencyHistogram::NowMicros();
 
       
       // Copy the message to the send callback state buffer.
@@ -394,42 +429,88 @@ void StringSocket::BeginSend(std::string msg, sendCallback callback,
       
       // Push the callback state onto the queue.
       this->sendQueue.push(state);
+      __sync_add_and_fetch(&this->stats.sendQueue, 1);
     
-    } pthread_mutex_unlock(&this->sendQueueMutex);
+    } this->sendQueueMutex.Unlock();
     
     
 
     // Start sending the message on a separate thread if one is not already
     //   running.
-    if(this->mreSend.Wait(0)) {
-      
-      // Reset the event trigger.
-      this->mreSend.Reset();
-      
-      
-      // Join the previous send thread.
-      if(this->sendSafeToJoin)
-        pthread_join(this->sendThread, NULL);
+    this->startSendThread();
     
+  }
+  
+  this->beginMutex.Unlock();
+  
+}
+
+
+/// <summary>
+///   Begins the asynchronous call for sending messages straight from a file.
+/// </summary>
+/// <param name="fd">
+///   The file to send from.  The socket takes over the file descriptor.
+/// </param>
+/// <param name="offset">The offset of the data in the file.</param>
+/// <param name="length">The number of bytes to send.</param>
+/// <param name="callback">The send callback function.</param>
+/// <param name="payload">
+///   A pointer to an object that uniquely identifies this send request.
+/// </param>
+void StringSocket::BeginSendFile(int fd, off_t offset, int length,
+    sendCallback callback, void *payload) {
+  
+  // Keep the socket from being closed until this call is done with it.
+  this->beginMutex.Lock();
+  
+  // Set up the callback state.
+  sendCallbackState *state =
+      static_cast<sendCallbackState *>(malloc(sizeof(sendCallbackState)));
+  state->callback = callback;
+  state->payload = payload;
+  state->buf = NULL;
+  state->bufLen = length;
+  state->fd = fd;
+  state->offset = offset;
+  state->ex = SS_NO_EXCEPTION;
+  state->queued = LatencyHistogram::NowMicros();
+  
+  
+  // Send the socket closed exception of the socket is closed.
+  if(this->mreClose.IsSet()) {
     
-      // Send the data on a separate thread.
-      int rtcreate = pthread_create(
-          &this->sendThread,
-          NULL,
-          StringSocket::sendData,
-          (void*)this
-        );
-        
-        
-      // Set the send safe to join flag to true if a thread was successfully
-      //   created.
-      if(rtcreate == 0)
-        this->sendSafeToJoin = true;
-        
-    }
+    state->ex = SS_CLOSED_EXCEPTION;
+    
+    // Call the callback on a separate thread.
+    pthread_t dthread;
+    pthread_create(
+        &dthread, 
+        NULL, 
+        StringSocket::invokeSendCallback,
+        (void *)state
+      );
+    pthread_detach(dthread);
     
   }
   
+  // Add the file to the queue and send it off if the socket is not closed.
+  else {
+    
+    // Make sure only one thread is accessing the send queue at a time.
+    this->sendQueueMutex.Lock(); {
+      this->sendQueue.push(state);
+      __sync_add_and_fetch(&this->stats.sendQueue, 1);
+    } this->sendQueueMutex.Unlock();
+    
+    
+    // Start sending on a separate thread if one is not already running.
+    this->startSendThread();
+    
+  }
+  
+  this->beginMutex.Unlock();
+  
 }
 
 
@@ -444,6 +525,9 @@ void StringSocket::BeginSend(std::string msg, sendCallback callback,
 ///   Once a receive has completed, the receive callback function is called.
 /// </remarks>
 void StringSocket::BeginReceive(recvCallback callback, void *payload) {
+  
+  // Keep the socket from being closed until this call is done with it.
+  this->beginMutex.Lock();
       
   // Send the socket closed exception of the socket is closed.
   if(this->mreClose.IsSet()) {
@@ -456,6 +540,7 @@ void StringSocket::BeginReceive(recvCallback callback, void *payload) {
   state->buf = NULL;
   state->bufLen = 0;
   state->ex = SS_CLOSED_EXCEPTION;
+  state->received = 0;
     
     // Call the callback on a separate thread.
     pthread_t dthread;
@@ -478,15 +563,16 @@ void StringSocket::BeginReceive(recvCallback callback, void *payload) {
         static_cast<recvCallbackState *>(malloc(sizeof(recvCallbackState)));
     state->callback = callback;
     state->payload = payload;
+    state->received = 0;
     
     
     // Make sure only one thread is accessing the receive queue at a time.
-    pthread_mutex_lock(&this->recvQueueMutex); {
+    this->recvQueueMutex.Lock(); {
     
       // Push the state onto the queue.
       this->recvQueue.push(state);
     
-    } pthread_mutex_unlock(&this->recvQueueMutex);
+    } this->recvQueueMutex.Unlock();
     
     
     // Send received messages to the queued callbacks that are in the buffer.
@@ -524,6 +610,8 @@ void StringSocket::BeginReceive(recvCallback callback, void *payload) {
   
   }
   
+  this->beginMutex.Unlock();
+  
 }
 
 
@@ -532,6 +620,10 @@ void StringSocket::BeginReceive(recvCallback callback, void *payload) {
 /// </summary>
 void StringSocket::Close(void) {
   
+  // Wait for BeginReceive calls that are still running, and keep new ones
+  //   from starting a receive thread until the socket is closed.
+  this->beginMutex.Lock();
+  
   // Make sure the socket is not already closed.
   if(!this->mreClose.IsSet()) {
     
@@ -551,6 +643,57 @@ void StringSocket::Close(void) {
     
   }
   
+  this->beginMutex.Unlock();
+  
+}
+
+
+/// <summary>
+///   Gets the traffic over this socket so far.
+/// </summary>
+/// <param name="stats">An output parameter for the counters.</param>
+void StringSocket::GetStats(socketStats *stats) const {
+  
+  const volatile socketStats *current = &this->stats;
+  stats->messagesIn = current->messagesIn;
+  stats->messagesOut = current->messagesOut;
+  stats->bytesIn = current->bytesIn;
+  stats->bytesOut = current->bytesOut;
+  stats->sendQueue = current->sendQueue;
+  
+}
+
+
+/// <summary>
+///   Gets the traffic over every socket since the program started.
+/// </summary>
+/// <param name="totals">An output parameter for the counters.</param>
+void StringSocket::GetTotals(socketStats *totals) {
+  
+  totals->messagesIn = StringSocket::totalMessagesIn.Sum();
+  totals->messagesOut = StringSocket::totalMessagesOut.Sum();
+  totals->bytesIn = StringSocket::totalBytesIn.Sum();
+  totals->bytesOut = StringSocket::totalBytesOut.Sum();
+  totals->sendQueue = 0;
+  
+}
+
+
+/// <summary>
+///   Gets how long each message sent over any socket waited, from being queued
+///   until its last byte was written.
+/// </summary>
+const LatencyHistogram & StringSocket::SendLatency(void) {
+  return StringSocket::sendLatency;
+}
+
+
+/// <summary>
+///   Gets when the message being handled by the calling receive callback was
+///   received, or 0.
+/// </summary>
+unsigned long long StringSocket::ReceivedMicros(void) {
+  return receivedAt;
 }
 
 
@@ -573,13 +716,19 @@ void StringSocket::Close(void) {
 /// </remarks>
 StringSocket::StringSocket(int sockfd, std::string addr)
     : sockfd(sockfd), sockaddr(addr), recvBufLen(1024), recvBufDLen(0),
-      searchIndex(0), sendSafeToJoin(false), recvSafeToJoin(false) {
+      searchIndex(0), sendQueueMutex("socket.send_queue"),
+      recvQueueMutex("socket.recv_queue"),
+      beginMutex("socket.begin"), sendSafeToJoin(false),
+      recvSafeToJoin(false) {
   
   this->mreSend.Set();
   this->mreRecv.Set();
   
-  pthread_mutex_init(&this->sendQueueMutex, NULL);
-  pthread_mutex_init(&this->recvQueueMutex, NULL);
+  this->stats.messagesIn = 0;
+  this->stats.messagesOut = 0;
+  this->stats.bytesIn = 0;
+  this->stats.bytesOut = 0;
+  this->stats.sendQueue = 0;
   
   this->recvBuf = new char[this->recvBufLen];
   this->recvBuf[0] = '\0';
@@ -592,6 +741,41 @@ StringSocket::StringSocket(int sockfd, std::string addr)
 *******************************************************************************/
 
 
+/// <summary>
+///   Starts the send thread if one is not already running.
+/// </summary>
+void StringSocket::startSendThread(void) {
+  
+  if(this->mreSend.Wait(0)) {
+    
+    // Reset the event trigger.
+    this->mreSend.Reset();
+    
+    
+    // Join the previous send thread.
+    if(this->sendSafeToJoin)
+      pthread_join(this->sendThread, NULL);
+  
+  
+    // Send the data on a separate thread.
+    int rtcreate = pthread_create(
+        &this->sendThread,
+        NULL,
+        StringSocket::sendData,
+        (void*)this
+      );
+      
+      
+    // Set the send safe to join flag to true if a thread was successfully
+    //   created.
+    if(rtcreate == 0)
+      this->sendSafeToJoin = true;
+      
+  }
+  
+}
+
+
 /// <summary>
 ///   Sends complete messages over the socket and calls the send callback for
 ///   every message that is completely sent.
@@ -621,7 +805,7 @@ void * StringSocket::sendData(void *stringSocket) {
 
       
       // Make sure only one thread is accessing the send queue at a time.
-      pthread_mutex_lock(&pthis->sendQueueMutex);
+      pthis->sendQueueMutex.Lock();
 
       
       // Get the current element in the queue and remove it.
@@ -632,7 +816,7 @@ void * StringSocket::sendData(void *stringSocket) {
       // Exit the thread if no sendCallbackState was in the queue.
       if(state == NULL) {
         pthis->mreSend.Set();
-        pthread_mutex_unlock(&pthis->sendQueueMutex);
+        pthis->sendQueueMutex.Unlock();
         pthread_exit(NULL);
       }
       
@@ -642,14 +826,24 @@ void * StringSocket::sendData(void *stringSocket) {
       len = state->bufLen;
       
       
-      // Try to send the message.
-      do {
-        res = send(pthis->sockfd, buf, len, 0);
-        if(res > 0) {
-          buf += res;
-          len -= res;
-        }
-      } while(res > 0 && len > 0);
+      // Try to send the message, straight from the file if there is one.
+      if(state->fd >= 0) {
+        off_t offset = state->offset;
+        do {
+          res = sendfile(pthis->sockfd, state->fd, &offset, len);
+          if(res > 0)
+            len -= res;
+        } while(res > 0 && len > 0);
+      }
+      else {
+        do {
+          res = send(pthis->sockfd, buf, len, 0);
+          if(res > 0) {
+            buf += res;
+            len -= res;
+          }
+        } while(res > 0 && len > 0);
+      }
       
       
       // Set the send state exception if one was encountered while attempting to
@@ -658,6 +852,18 @@ void * StringSocket::sendData(void *stringSocket) {
         state->ex = SS_EXCEPTION;
       
       
+      // Count what was sent.
+      unsigned long long sent = state->bufLen - len;
+      pthis->stats.bytesOut += sent;
+      StringSocket::totalBytesOut.Add(sent);
+      if(res >= 0) {
+        pthis->stats.messagesOut++;
+        StringSocket::totalMessagesOut.Add(1);
+        StringSocket::sendLatency.RecordSince(state->queued);
+      }
+      __sync_sub_and_fetch(&pthis->stats.sendQueue, 1);
+      
+      
       // Invoke the send callback on a separate thread.
       pthread_t dthread;
       pthread_create(
@@ -670,7 +876,7 @@ void * StringSocket::sendData(void *stringSocket) {
 
 
       // Done with the send queue.
-      pthread_mutex_unlock(&pthis->sendQueueMutex);
+      pthis->sendQueueMutex.Unlock();
       
     }
     
@@ -738,6 +944,10 @@ void * StringSocket::recvData(void *stringSocket) {
         //   in the buffer if bytes were received.
         if(res > 0) {
 
+          // Count what was received.
+          pthis->stats.bytesIn += res;
+          StringSocket::totalBytesIn.Add(res);
+
           // Append the received data to the receive buffer.
           pthis->appendData(buf, res);
           
@@ -757,7 +967,7 @@ void * StringSocket::recvData(void *stringSocket) {
           
           // Make sure only one thread is accessing the receive queue at a
           //   time.
-          pthread_mutex_lock(&pthis->recvQueueMutex);
+          pthis->recvQueueMutex.Lock();
           
           
           // Get the current element in the queue and remove it.
@@ -768,7 +978,7 @@ void * StringSocket::recvData(void *stringSocket) {
           // Exit this thread if no receive callback states were in the queue.
           if(state == NULL) {
             pthis->mreRecv.Set();
-            pthread_mutex_unlock(&pthis->recvQueueMutex);
+            pthis->recvQueueMutex.Unlock();
             pthread_exit(NULL);
           }
           
@@ -797,7 +1007,7 @@ void * StringSocket::recvData(void *stringSocket) {
           
           
           // Done with the receive queue.
-          pthread_mutex_unlock(&pthis->recvQueueMutex);
+          pthis->recvQueueMutex.Unlock();
           
         }
 
@@ -813,7 +1023,7 @@ void * StringSocket::recvData(void *stringSocket) {
 
       
       // Make sure only one thread is accessing the receive queue at a time.
-      pthread_mutex_lock(&pthis->recvQueueMutex);
+      pthis->recvQueueMutex.Lock();
 
       
       // Get the current element in the queue and remove it.
@@ -824,7 +1034,7 @@ void * StringSocket::recvData(void *stringSocket) {
       // Exit this thread if no receive callback states were in the queue.
       if(state == NULL) {
         pthis->mreRecv.Set();
-        pthread_mutex_unlock(&pthis->recvQueueMutex);
+        pthis->recvQueueMutex.Unlock();
         pthread_exit(NULL);
       }
       
@@ -847,7 +1057,7 @@ void * StringSocket::recvData(void *stringSocket) {
 
       
       // Done with the receive queue.
-      pthread_mutex_unlock(&pthis->recvQueueMutex);
+      pthis->recvQueueMutex.Unlock();
       
     }
     
@@ -888,10 +1098,13 @@ void StringSocket::recvMessages(void) {
     //   the buffer if the message terminator was found.
     if(found) {
       
+      this->stats.messagesIn++;
+      StringSocket::totalMessagesIn.Add(1);
+      
       recvCallbackState *state = NULL;
       
       // Make sure only one thread is accessing the receive queue at a time.
-      pthread_mutex_lock(&this->recvQueueMutex);
+      this->recvQueueMutex.Lock();
       
       
       // Get the current element in the queue and remove it.
@@ -905,11 +1118,12 @@ void StringSocket::recvMessages(void) {
 
         // Set the exception for the receive callback.
         state->ex = SS_NO_EXCEPTION;
+        state->received = LatencyHistogram::NowMicros();
         
         
         // Copy the complete message to the message buffer in the state object.
         state->bufLen = this->searchIndex - 1;
-        state->buf = new char[state->bufLen];
+        state->buf = new char[state->bufLen + 1];
         const char *src = this->recvBuf;
         char *dst = state->buf;
         for(int i = 0; i < state->bufLen; i++)
@@ -941,7 +1155,7 @@ void StringSocket::recvMessages(void) {
 
       
       // Done with the receive queue.
-      pthread_mutex_unlock(&this->recvQueueMutex);
+      this->recvQueueMutex.Unlock();
       
     }
     
@@ -978,8 +1192,10 @@ void * StringSocket::invokeSendCallback(void *arg) {
     callback(ex, payload);
       
       
-    // Delete the message buffer.
+    // Delete the message buffer and close the file.
     delete [] state->buf;
+    if(state->fd >= 0)
+      close(state->fd);
       
     // Free the callback state.
     free(state);
@@ -1017,14 +1233,13 @@ void * StringSocket::invokeRecvCallback(void *arg) {
     
     
     // Call the callback.
+    receivedAt = state->received;
     callback(msg, ex, payload);
+    receivedAt = 0;
     
     
     // Delete the message buffer.
-    //   NOTE: For whatever reason, the CADE lab 1 machines regard state->buf as
-    //         an invalid pointer.  Commenting out the following line does not
-    //         produce any seg faults during runtime.  --April 13, 2015
-    //delete [] state->buf;
+    delete [] state->buf;
       
     // Free the callback state.
     free(state);
@@ -4,7 +4,7 @@
   Team: SegFault
   CS 3505 - Spring 2015
   Date created: April 3, 2015
-  Last updated: April 18, 2015
+  Last updated: October 18, 2026
   
   
   Resources:
@@ -13,6 +13,19 @@
   
   Changelog:
   
+  October 18, 2026
+  - Changed the queue mutexes to ProfiledMutex.
+  - Added beginMutex.
+  - Added SendLatency and ReceivedMicros methods.
+  - Added queued member to sendCallbackState struct and received member to
+    recvCallbackState struct.
+  - Added socketStats struct.
+  - Added stats member and the totals counters.
+  - Added GetStats and GetTotals methods.
+  - Added BeginSendFile method.
+  - Added startSendThread helper method.
+  - Added fd and offset members to sendCallbackState struct.
+  
   April 18, 2015
   - Added a manual reset event object for when the socket is closed.
   
@@ -57,12 +70,32 @@
 //
 #include "ManualResetEvent.h"
 
+//
+// ShardedCounter.
+//
+#include "ShardedCounter.h"
+
+//
+// LatencyHistogram.
+//
+#include "LatencyHistogram.h"
+
+//
+// ProfiledMutex.
+//
+#include "ProfiledMutex.h"
+
 //
 // Standard libraries.
 //
 #include <string>
 #include <queue>
 
+//
+// File offsets.
+//
+#include <sys/types.h>
+
 //
 // Open Group multithreading library.
 //
@@ -119,6 +152,19 @@ typedef void (*sendCallback)(int ex, void *payload);
 typedef void (*recvCallback)(std::string msg, int ex, void *payload);
 
 
+/// <summary>
+///   Counters of the traffic over a socket, or over every socket.
+/// </summary>
+typedef struct socketStats {
+  unsigned long long messagesIn;  // The number of messages received.
+  unsigned long long messagesOut; // The number of sends completed.
+  unsigned long long bytesIn;     // The number of bytes received.
+  unsigned long long bytesOut;    // The number of bytes sent.
+  int sendQueue;                  // The number of sends not yet completed.
+                                  //   Always 0 for the totals.
+} socketStats;
+
+
 /// <summary>
 ///   A wrapper class around a socket that takes care of network
 ///   communications asynchronously.
@@ -139,7 +185,10 @@ private:
     void *payload;            // The payload object associated with a send.
     const char *buf;          // The buffer to the message to be sent.
     int bufLen;               // The length of the buffer.
+    int fd;                   // The file to send from instead, or -1.
+    off_t offset;             // The offset of the data in the file.
     int ex;                   // The exception code encountered during a send.
+    unsigned long long queued; // When the send was queued, in microseconds.
   } sendCallbackState;
   
   
@@ -154,6 +203,8 @@ private:
     int bufLen;               // The length of the received message.
     int ex;                   // The exception code encountered during a
                               //   receive.
+    unsigned long long received; // When the message was received, in
+                              //   microseconds, or 0.
   } recvCallbackState;
   
   
@@ -209,13 +260,21 @@ private:
   /// <summary>
   ///   Mutex handle for locking the send queue across multiple threads.
   /// </summary>
-  pthread_mutex_t sendQueueMutex;
+  ProfiledMutex sendQueueMutex;
   
   
   /// <summary>
   ///   Mutex handle for locking the receive queue across multiple threads.
   /// </summary>
-  pthread_mutex_t recvQueueMutex;
+  ProfiledMutex recvQueueMutex;
+  
+  
+  /// <summary>
+  ///   Held by BeginSend, BeginSendFile and BeginReceive while they run, so
+  ///   that closing the socket waits for them.  A callback that frees the
+  ///   socket may start on another thread before they are done with it.
+  /// </summary>
+  ProfiledMutex beginMutex;
   
   
   /// <summary>
@@ -260,6 +319,45 @@ private:
   bool recvSafeToJoin;
   
   
+  /// <summary>
+  ///   The traffic over this socket.  The in counters are only written by the
+  ///   receive thread and the out counters by the send thread, so they need
+  ///   no lock.  The send queue depth is kept with atomic adds.
+  /// </summary>
+  socketStats stats;
+  
+  
+  /// <summary>
+  ///   The messages received over every socket.
+  /// </summary>
+  static ShardedCounter totalMessagesIn;
+  
+  
+  /// <summary>
+  ///   The sends completed over every socket.
+  /// </summary>
+  static ShardedCounter totalMessagesOut;
+  
+  
+  /// <summary>
+  ///   The bytes received over every socket.
+  /// </summary>
+  static ShardedCounter totalBytesIn;
+  
+  
+  /// <summary>
+  ///   The bytes sent over every socket.
+  /// </summary>
+  static ShardedCounter totalBytesOut;
+  
+  
+  /// <summary>
+  ///   How long each message sent over any socket waited, from being queued
+  ///   until its last byte was written.
+  /// </summary>
+  static LatencyHistogram sendLatency;
+  
+  
 protected:
 
   friend class TcpListener;
@@ -340,6 +438,33 @@ public:
   void BeginSend(std::string msg, sendCallback callback, void *payload);
 
   
+  /// <summary>
+  ///   Begins the asynchronous call for sending messages straight from a
+  ///   file, without copying them through a buffer.
+  /// </summary>
+  /// <param name="fd">
+  ///   The file to send from.  The socket takes over the file descriptor and
+  ///   closes it once the send is complete.
+  /// </param>
+  /// <param name="offset">The offset of the data in the file.</param>
+  /// <param name="length">The number of bytes to send.</param>
+  /// <param name="callback">The send callback function.</param>
+  /// <param name="payload">
+  ///   A pointer to an object that uniquely identifies this send request.
+  /// </param>
+  /// <remarks>
+  /// <para>
+  ///   The data is sent as it is, so it must hold whole messages, each ending
+  ///   with the message terminator.
+  /// </para>
+  /// <para>
+  ///   Once the send is complete, the send callback function is called.
+  /// </para>
+  /// </remarks>
+  void BeginSendFile(int fd, off_t offset, int length, sendCallback callback,
+      void *payload);
+
+  
   /// <summary>
   ///   Begins the asynchronous call for receiving a message.
   /// </summary>
@@ -359,9 +484,44 @@ public:
   void Close(void);
   
   
+  /// <summary>
+  ///   Gets the traffic over this socket so far.
+  /// </summary>
+  /// <param name="stats">An output parameter for the counters.</param>
+  void GetStats(socketStats *stats) const;
+  
+  
+  /// <summary>
+  ///   Gets the traffic over every socket since the program started.
+  /// </summary>
+  /// <param name="totals">An output parameter for the counters.</param>
+  static void GetTotals(socketStats *totals);
+  
+  
+  /// <summary>
+  ///   Gets how long each message sent over any socket waited, from being
+  ///   queued until its last byte was written.
+  /// </summary>
+  static const LatencyHistogram & SendLatency(void);
+  
+  
+  /// <summary>
+  ///   Gets when the message being handled by the calling receive callback was
+  ///   received, as given by LatencyHistogram::NowMicros, or 0 if the calling
+  ///   thread is not running a receive callback for a message.
+  /// </summary>
+  static unsigned long long ReceivedMicros(void);
+  
+  
 private:
 
 
+  /// <summary>
+  ///   Starts the send thread if one is not already running.
+  /// </summary>
+  void startSendThread(void);
+  
+  
   /// <summary>
   ///   Sends complete messages over the socket and calls the send callback for
   ///   every message that is completely sent.
@@ -4,7 +4,7 @@
   Team: SegFault
   CS 3505 - Spring 2015
   Date created: April 4, 2015
-  Last updated: April 17, 2015
+  Last updated: October 18, 2026
   
   
   Compile with:
@@ -19,6 +19,11 @@
   
   Changelog:
   
+  October 18, 2026
+  - Fixed listening on the given host.
+  - Fixed the listener no longer accepting when an accept callback asked for
+      the next socket before the accept thread finished.
+  
   April 17, 2015
   - Added mutlithreaded functionality.
   
@@ -270,8 +275,9 @@ int TcpListener::CreateTcpListener(std::string host, std::string service,
     if(setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(int)) == -1)
       return TL_EX_SETSOCKOPT;
 
-    // Accept connections from anywhere.
-    ((sockaddr_in *)p->ai_addr)->sin_addr.s_addr = INADDR_ANY;
+    // Accept connections from anywhere, unless a host was given.
+    if(host == "")
+      ((sockaddr_in *)p->ai_addr)->sin_addr.s_addr = INADDR_ANY;
     
     // Try to bind the socket.
     if(bind(sockfd, p->ai_addr, p->ai_addrlen) == -1) {
@@ -532,6 +538,9 @@ void * TcpListener::acceptSocket(void *tcpListener) {
       // Set the exception.
       state->ex = TL_EXCEPTION;
       
+      // Let the callback start the next accept thread, as this one is done.
+      pthis->mreAccept.Set();
+      
       // Invoke the accept callback on a separate thread.
       pthread_t dthread;
       pthread_create(
@@ -543,7 +552,6 @@ void * TcpListener::acceptSocket(void *tcpListener) {
       pthread_detach(dthread);
       
       // Break from the select loop.
-      pthis->mreAccept.Set();
       break;
       
     }
@@ -583,6 +591,8 @@ void * TcpListener::acceptSocket(void *tcpListener) {
         state->socket = new StringSocket(remotefd,
             getSocketString((struct sockaddr *)&remote_addr));
 
+      // Let the callback start the next accept thread, as this one is done.
+      pthis->mreAccept.Set();
             
       // Invoke the accept callback on a separate thread.
       pthread_t dthread;
@@ -595,7 +605,6 @@ void * TcpListener::acceptSocket(void *tcpListener) {
       pthread_detach(dthread);
       
       // Break from the select loop.
-      pthis->mreAccept.Set();
       break;
       
     }
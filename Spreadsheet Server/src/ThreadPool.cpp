@@ -0,0 +1,152 @@
+/*******************************************************************************
+  File: ThreadPool.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -pthread -c ThreadPool.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ThreadPool.cpp file.
+  - Added ThreadPool class implementation.
+  - Added Pending implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "ThreadPool.h"
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Starts a pool with the given number of threads.
+/// </summary>
+ThreadPool::ThreadPool(int count) : stopping(false) {
+
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->queued, NULL);
+
+  for(int i = 0; i < count; i++) {
+    pthread_t thread;
+    if(pthread_create(&thread, NULL, ThreadPool::run, this) == 0)
+      this->threads.push_back(thread);
+  }
+
+}
+
+
+/// <summary>
+///   Destructor.  Shuts the pool down.
+/// </summary>
+ThreadPool::~ThreadPool(void) {
+
+  this->Shutdown();
+
+  pthread_cond_destroy(&this->queued);
+  pthread_mutex_destroy(&this->mutex);
+
+}
+
+
+/// <summary>
+///   Queues a job to be run on one of the threads.
+/// </summary>
+bool ThreadPool::Queue(void (*work)(void *), void *payload) {
+
+  job queuedJob;
+  queuedJob.work = work;
+  queuedJob.payload = payload;
+
+  bool accepted;
+  pthread_mutex_lock(&this->mutex); {
+    accepted = !this->stopping && !this->threads.empty();
+    if(accepted) {
+      this->jobs.push_back(queuedJob);
+      pthread_cond_signal(&this->queued);
+    }
+  } pthread_mutex_unlock(&this->mutex);
+
+  return accepted;
+
+}
+
+
+/// <summary>
+///   Runs the jobs already queued, then stops the threads.
+/// </summary>
+void ThreadPool::Shutdown(void) {
+
+  std::vector<pthread_t> joined;
+  pthread_mutex_lock(&this->mutex); {
+    this->stopping = true;
+    joined.swap(this->threads);
+    pthread_cond_broadcast(&this->queued);
+  } pthread_mutex_unlock(&this->mutex);
+
+  for(size_t i = 0; i < joined.size(); i++)
+    pthread_join(joined[i], NULL);
+
+}
+
+
+/// <summary>
+///   Gets the number of jobs waiting for a thread.
+/// </summary>
+size_t ThreadPool::Pending(void) {
+
+  size_t pending;
+  pthread_mutex_lock(&this->mutex); {
+    pending = this->jobs.size();
+  } pthread_mutex_unlock(&this->mutex);
+
+  return pending;
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Entry point of the threads.  Runs jobs until the pool shuts down and no
+///   job is left.
+/// </summary>
+void * ThreadPool::run(void *pool) {
+
+  ThreadPool *p_this = static_cast<ThreadPool *>(pool);
+
+  while(true) {
+
+    job next;
+    pthread_mutex_lock(&p_this->mutex); {
+      while(p_this->jobs.empty() && !p_this->stopping)
+        pthread_cond_wait(&p_this->queued, &p_this->mutex);
+
+      if(p_this->jobs.empty()) {
+        pthread_mutex_unlock(&p_this->mutex);
+        return NULL;
+      }
+
+      next = p_this->jobs.front();
+      p_this->jobs.pop_front();
+    } pthread_mutex_unlock(&p_this->mutex);
+
+    next.work(next.payload);
+
+  }
+
+}
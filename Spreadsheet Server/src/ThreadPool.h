@@ -0,0 +1,153 @@
+/*******************************************************************************
+  File: ThreadPool.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ThreadPool.h file.
+  - Added ThreadPool class declaration.
+  - Added Pending method.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+//
+// Threading library.
+//
+#include <pthread.h>
+
+
+//
+// Number of threads in a pool by default.
+//
+#define TP_DEFAULT_THREADS 4
+
+
+/// <summary>
+///   A fixed number of threads that run queued jobs in the order they were
+///   queued.
+/// </summary>
+/// <remarks>
+///   Jobs that block on the disk are run on a pool so that the threads that
+///   serve sockets are never held up by them.  Shutting the pool down runs
+///   every job already queued before the threads exit.
+/// </remarks>
+class ThreadPool {
+
+private:
+
+  /// <summary>
+  ///   A queued job.
+  /// </summary>
+  typedef struct job {
+    void (*work)(void *);       // The function to run.
+    void *payload;              // The argument passed to the function.
+  } job;
+
+
+  /// <summary>
+  ///   Guards every member below.
+  /// </summary>
+  pthread_mutex_t mutex;
+
+
+  /// <summary>
+  ///   Wakes the threads when a job is queued or the pool shuts down.
+  /// </summary>
+  pthread_cond_t queued;
+
+
+  /// <summary>
+  ///   The jobs waiting for a thread, oldest first.
+  /// </summary>
+  std::deque<job> jobs;
+
+
+  /// <summary>
+  ///   The threads of the pool.
+  /// </summary>
+  std::vector<pthread_t> threads;
+
+
+  /// <summary>
+  ///   Whether the pool is shutting down.
+  /// </summary>
+  bool stopping;
+
+
+  /// <summary>
+  ///   Copy constructor.  Pools cannot be copied.
+  /// </summary>
+  ThreadPool(const ThreadPool &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Pools cannot be copied.
+  /// </summary>
+  ThreadPool & operator=(const ThreadPool &other);
+
+
+public:
+
+  /// <summary>
+  ///   Starts a pool with the given number of threads.
+  /// </summary>
+  ThreadPool(int count);
+
+
+  /// <summary>
+  ///   Destructor.  Shuts the pool down.
+  /// </summary>
+  ~ThreadPool(void);
+
+
+  /// <summary>
+  ///   Queues a job to be run on one of the threads.
+  /// </summary>
+  /// <returns>
+  ///   True if the job was queued; otherwise, false, if the pool is shutting
+  ///   down.
+  /// </returns>
+  bool Queue(void (*work)(void *), void *payload);
+
+
+  /// <summary>
+  ///   Runs the jobs already queued, then stops the threads.  Later jobs are
+  ///   refused.  Does nothing if the pool has already shut down.
+  /// </summary>
+  void Shutdown(void);
+
+
+  /// <summary>
+  ///   Gets the number of jobs waiting for a thread.
+  /// </summary>
+  size_t Pending(void);
+
+
+private:
+
+  /// <summary>
+  ///   Entry point of the threads.
+  /// </summary>
+  static void * run(void *pool);
+
+};
+
+
+#endif
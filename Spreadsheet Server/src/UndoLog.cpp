@@ -0,0 +1,310 @@
+/*******************************************************************************
+  File: UndoLog.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c UndoLog.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created UndoLog.cpp file.
+  - Added UndoLog class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "UndoLog.h"
+
+//
+// Standard libraries.
+//
+#include <cstring>
+
+//
+// File I/O.
+//
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+//
+// Header at the start of every log file.
+//
+#define UL_MAGIC      "SSUNDO1\n"
+#define UL_MAGIC_SIZE 8
+
+//
+// Size of the length and key that trail the contents of a record on disk.
+//
+#define UL_TRAILER_SIZE (sizeof(unsigned int) + sizeof(cellKey))
+
+//
+// Bit of a key on disk that marks a record as joined to the one before it.
+//
+#define UL_JOINED_BIT (1ULL << 63)
+
+
+/// <summary>
+///   Creates an empty history whose records refer to the given strings.
+/// </summary>
+UndoLog::UndoLog(StringPool &strings)
+    : strings(strings), cacheBytes(0), budget(UL_DEFAULT_BUDGET), fd(-1),
+      size(0) {
+  //
+  // Do nothing.
+  //
+}
+
+
+/// <summary>
+///   Destructor.  Closes the log file.
+/// </summary>
+UndoLog::~UndoLog(void) {
+
+  for(size_t i = 0; i < this->cache.size(); i++)
+    this->strings.Release(this->cache[i].contents);
+
+  if(this->fd >= 0)
+    close(this->fd);
+
+}
+
+
+/// <summary>
+///   Opens the log file at the given path, creating it if it does not exist.
+/// </summary>
+bool UndoLog::Open(const std::string &path) {
+
+  int file = open(path.c_str(), O_RDWR | O_CREAT, S_IRUSR | S_IWUSR);
+  if(file < 0)
+    return false;
+
+  struct stat sb;
+  if(fstat(file, &sb) == -1) {
+    close(file);
+    return false;
+  }
+
+
+  // Start the file over if it is new or was not written by this class.
+  char magic[UL_MAGIC_SIZE];
+  if(sb.st_size < UL_MAGIC_SIZE
+      || pread(file, magic, UL_MAGIC_SIZE, 0) != UL_MAGIC_SIZE
+      || memcmp(magic, UL_MAGIC, UL_MAGIC_SIZE) != 0) {
+    if(ftruncate(file, 0) == -1
+        || pwrite(file, UL_MAGIC, UL_MAGIC_SIZE, 0) != UL_MAGIC_SIZE) {
+      close(file);
+      return false;
+    }
+    sb.st_size = UL_MAGIC_SIZE;
+  }
+
+
+  // Records pushed before the file was opened would be out of order with the
+  //   ones on disk, so they are forgotten.
+  for(size_t i = 0; i < this->cache.size(); i++)
+    this->strings.Release(this->cache[i].contents);
+  this->cache.clear();
+  this->cacheBytes = 0;
+
+  if(this->fd >= 0)
+    close(this->fd);
+  this->fd = file;
+  this->size = sb.st_size;
+
+  return true;
+
+}
+
+
+/// <summary>
+///   Gets whether a log file is open.
+/// </summary>
+bool UndoLog::IsOpen(void) const {
+  return this->fd >= 0;
+}
+
+
+/// <summary>
+///   Records an edit of one or more cells as a single entry.
+/// </summary>
+void UndoLog::Push(const std::vector<std::pair<cellKey, stringId> > &edits) {
+
+  // Lay out every record of the entry so it is appended in one write.
+  std::string buffer;
+  off_t offset = this->size;
+  size_t first = this->cache.size();
+
+  for(size_t i = 0; i < edits.size(); i++) {
+    record r;
+    r.key = edits[i].first;
+    r.contents = edits[i].second;
+    r.offset = offset + buffer.size();
+    r.joined = i > 0;
+
+    unsigned int length = this->strings.Length(r.contents);
+    cellKey key = r.joined ? r.key | UL_JOINED_BIT : r.key;
+    buffer.append(this->strings.Data(r.contents), length);
+    buffer.append((const char *)&length, sizeof(length));
+    buffer.append((const char *)&key, sizeof(key));
+
+    // Keep the record in memory for a fast undo.
+    this->cache.push_back(r);
+    this->cacheBytes += this->cost(r);
+  }
+
+
+  // Append the records to the file.  If the write fails, the records are
+  //   only kept in memory.
+  if(this->fd >= 0 && !buffer.empty()) {
+    if(pwrite(this->fd, buffer.data(), buffer.size(), offset)
+        == (ssize_t)buffer.size())
+      this->size += buffer.size();
+    else
+      for(size_t i = first; i < this->cache.size(); i++)
+        this->cache[i].offset = this->size;
+  }
+
+  this->evict();
+
+}
+
+
+/// <summary>
+///   Removes the most recent entry from the history.
+/// </summary>
+bool UndoLog::Pop(std::vector<std::pair<cellKey, std::string> > *edits) {
+
+  edits->clear();
+
+  // Take records off the end until the first record of the entry.
+  bool joined = true;
+  while(joined) {
+
+    if(this->cache.empty())
+      this->refill();
+    if(this->cache.empty())
+      break;
+
+    record r = this->cache.back();
+    this->cache.pop_back();
+    this->cacheBytes -= this->cost(r);
+
+    edits->push_back(std::make_pair(r.key, this->strings.Get(r.contents)));
+    this->strings.Release(r.contents);
+    joined = r.joined;
+
+
+    // Cut the record off the end of the file.
+    if(this->fd >= 0 && r.offset < this->size) {
+      if(ftruncate(this->fd, r.offset) == 0)
+        this->size = r.offset;
+    }
+
+  }
+
+  return !edits->empty();
+
+}
+
+
+/// <summary>
+///   Sets the number of bytes of records allowed in memory.
+/// </summary>
+void UndoLog::SetBudget(size_t bytes) {
+  this->budget = bytes;
+  this->evict();
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Gets the number of bytes charged to a record in memory.
+/// </summary>
+size_t UndoLog::cost(const record &r) const {
+  return sizeof(record) + this->strings.Length(r.contents);
+}
+
+
+/// <summary>
+///   Drops the oldest records from memory until they fit in the budget.  The
+///   most recent record is always kept.
+/// </summary>
+void UndoLog::evict(void) {
+
+  while(this->cacheBytes > this->budget && this->cache.size() > 1) {
+    record &r = this->cache.front();
+    this->cacheBytes -= this->cost(r);
+    this->strings.Release(r.contents);
+    this->cache.pop_front();
+  }
+
+}
+
+
+/// <summary>
+///   Reads the newest records on disk that are not in memory.  A record that
+///   cannot be read ends the history there.
+/// </summary>
+void UndoLog::refill(void) {
+
+  if(this->fd < 0)
+    return;
+
+  off_t end = this->cache.empty() ? this->size : this->cache.front().offset;
+  std::string buffer;
+
+  for(int n = 0; n < UL_REFILL_RECORDS && end > UL_MAGIC_SIZE; n++) {
+
+    // Read the trailer, then the contents in front of it.
+    char trailer[UL_TRAILER_SIZE];
+    unsigned int length;
+    cellKey key;
+    off_t start = end - UL_TRAILER_SIZE;
+    if(start < UL_MAGIC_SIZE
+        || pread(this->fd, trailer, UL_TRAILER_SIZE, start)
+           != (ssize_t)UL_TRAILER_SIZE)
+      break;
+    memcpy(&length, trailer, sizeof(length));
+    memcpy(&key, trailer + sizeof(length), sizeof(key));
+
+    start -= length;
+    if(start < UL_MAGIC_SIZE)
+      break;
+    buffer.resize(length);
+    if(length > 0 && pread(this->fd, &buffer[0], length, start)
+        != (ssize_t)length)
+      break;
+
+    record r;
+    r.key = key & ~UL_JOINED_BIT;
+    r.contents = this->strings.Intern(buffer);
+    r.offset = start;
+    r.joined = (key & UL_JOINED_BIT) != 0;
+    this->cache.push_front(r);
+    this->cacheBytes += this->cost(r);
+    end = start;
+
+  }
+
+
+  // Drop whatever is left in front of a damaged record.
+  if(this->cache.empty() && end > UL_MAGIC_SIZE) {
+    if(ftruncate(this->fd, UL_MAGIC_SIZE) == 0)
+      this->size = UL_MAGIC_SIZE;
+  }
+
+}
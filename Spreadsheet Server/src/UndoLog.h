@@ -0,0 +1,221 @@
+/*******************************************************************************
+  File: UndoLog.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created UndoLog.h file.
+  - Added UndoLog class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __UNDOLOG_H__
+#define __UNDOLOG_H__
+
+
+//
+// Project headers.
+//
+#include "CellAddress.h"
+#include "StringPool.h"
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+
+//
+// POSIX types.
+//
+#include <sys/types.h>
+
+
+//
+// Default number of bytes of undo records kept in memory per sheet.
+//
+#define UL_DEFAULT_BUDGET 1048576
+
+//
+// Number of records read back from disk at a time once the records in memory
+//   run out.
+//
+#define UL_REFILL_RECORDS 256
+
+
+/// <summary>
+///   The undo history of a spreadsheet, kept on disk and cached in memory up
+///   to a budget.
+/// </summary>
+/// <remarks>
+/// <para>
+///   Every edit appends a record of the cell key and the previous contents of
+///   each edited cell to an append-only log file, so the history survives a
+///   restart of the server.  Undoing an edit truncates its records off the
+///   end of the file.  An edit of many cells is a single entry in the history
+///   whose records after the first are marked as joined to the one before.
+/// </para>
+/// <para>
+///   The most recent records are also kept in memory as a cell key and an
+///   interned string id, so an undo of a recent edit never reads the file.
+///   Once the records in memory exceed the budget, the oldest ones are
+///   dropped from memory; they are read back from the end of the file when
+///   the history is unwound that far.
+/// </para>
+/// <para>
+///   A record on disk is laid out as the contents, then a 32-bit length, then
+///   the 64-bit cell key with the joined flag in its top bit, so that the log
+///   can be read backwards.
+/// </para>
+/// </remarks>
+class UndoLog {
+
+private:
+
+  /// <summary>
+  ///   A record held in memory.
+  /// </summary>
+  typedef struct record {
+    cellKey key;              // The edited cell.
+    stringId contents;        // The interned contents before the edit.
+    off_t offset;             // The offset of the record in the log file.
+    bool joined;              // Whether the record continues the one before.
+  } record;
+
+
+  /// <summary>
+  ///   Holds the contents referred to by records in memory.
+  /// </summary>
+  StringPool &strings;
+
+
+  /// <summary>
+  ///   The most recent records, oldest first.
+  /// </summary>
+  std::deque<record> cache;
+
+
+  /// <summary>
+  ///   The approximate number of bytes held by records in memory.
+  /// </summary>
+  size_t cacheBytes;
+
+
+  /// <summary>
+  ///   The number of bytes of records allowed in memory.
+  /// </summary>
+  size_t budget;
+
+
+  /// <summary>
+  ///   The log file, or -1 if the log is only kept in memory.
+  /// </summary>
+  int fd;
+
+
+  /// <summary>
+  ///   The size of the log file.
+  /// </summary>
+  off_t size;
+
+
+  /// <summary>
+  ///   Copy constructor.  Undo logs cannot be copied.
+  /// </summary>
+  UndoLog(const UndoLog &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Undo logs cannot be copied.
+  /// </summary>
+  UndoLog & operator=(const UndoLog &other);
+
+
+public:
+
+  /// <summary>
+  ///   Creates an empty history whose records refer to the given strings.
+  /// </summary>
+  UndoLog(StringPool &strings);
+
+
+  /// <summary>
+  ///   Destructor.  Closes the log file.
+  /// </summary>
+  ~UndoLog(void);
+
+
+  /// <summary>
+  ///   Opens the log file at the given path, creating it if it does not
+  ///   exist, and continues the history stored in it.
+  /// </summary>
+  /// <returns>True if the file was opened; otherwise, false.</returns>
+  bool Open(const std::string &path);
+
+
+  /// <summary>
+  ///   Gets whether a log file is open.
+  /// </summary>
+  bool IsOpen(void) const;
+
+
+  /// <summary>
+  ///   Records an edit of one or more cells as a single entry.  The history
+  ///   takes over one reference to each of the contents, which the caller
+  ///   must have retained.
+  /// </summary>
+  /// <param name="edits">
+  ///   The edited cells and their contents before the edit.
+  /// </param>
+  void Push(const std::vector<std::pair<cellKey, stringId> > &edits);
+
+
+  /// <summary>
+  ///   Removes the most recent entry from the history.
+  /// </summary>
+  /// <param name="edits">
+  ///   An output parameter for the edited cells and their contents before
+  ///   the edit, most recently recorded first.
+  /// </param>
+  /// <returns>True if there was an entry to remove; otherwise, false.</returns>
+  bool Pop(std::vector<std::pair<cellKey, std::string> > *edits);
+
+
+  /// <summary>
+  ///   Sets the number of bytes of records allowed in memory.
+  /// </summary>
+  void SetBudget(size_t bytes);
+
+
+private:
+
+  /// <summary>
+  ///   Gets the number of bytes charged to a record in memory.
+  /// </summary>
+  size_t cost(const record &r) const;
+
+
+  /// <summary>
+  ///   Drops the oldest records from memory until they fit in the budget.
+  /// </summary>
+  void evict(void);
+
+
+  /// <summary>
+  ///   Reads the newest records on disk that are not in memory.
+  /// </summary>
+  void refill(void);
+
+};
+
+
+#endif
@@ -0,0 +1,422 @@
+/*******************************************************************************
+  File: UserRegistry.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -pthread -c UserRegistry.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created UserRegistry.cpp file.
+  - Added UserRegistry class implementation.
+  - Added SyncLatency implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "UserRegistry.h"
+
+//
+// Standard libraries.
+//
+#include <cerrno>
+#include <cstring>
+
+//
+// File libraries.
+//
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+/// <summary>
+///   Computes the 32-bit FNV-1a hash of a run of characters.
+/// </summary>
+static unsigned int hashBytes(const char *data, size_t length) {
+
+  unsigned int hash = 2166136261u;
+  for(size_t i = 0; i < length; i++) {
+    hash ^= (unsigned char)data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+
+}
+
+
+/// <summary>
+///   Reads a slot of a table that may be filled by another thread.  The name
+///   it points at is fully written by the time the slot is seen filled.
+/// </summary>
+static const char * loadSlot(const char **slots, size_t i) {
+
+  const char *slot = ((const char * volatile *)slots)[i];
+  __sync_synchronize();
+  return slot;
+
+}
+
+
+/// <summary>
+///   Gets whether a slot holds the given name.
+/// </summary>
+static bool sameName(const char *slot, const char *name, size_t length) {
+  return strncmp(slot, name, length) == 0 && slot[length] == '\0';
+}
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Creates an empty registry.
+/// </summary>
+UserRegistry::UserRegistry(void)
+    : count(0), batch(1), flushed(0), failedFrom(0), file(-1),
+      writerRunning(false), closing(false) {
+
+  pthread_mutex_init(&this->mutex, NULL);
+  pthread_cond_init(&this->queued, NULL);
+  pthread_cond_init(&this->written, NULL);
+
+  this->current = new table;
+  this->current->mask = UR_MIN_SLOTS - 1;
+  this->current->slots = new const char *[UR_MIN_SLOTS]();
+
+}
+
+
+/// <summary>
+///   Destructor.  Closes the registry.
+/// </summary>
+UserRegistry::~UserRegistry(void) {
+
+  this->Close();
+
+  table *last = this->current;
+  this->retired.push_back(last);
+  for(size_t i = 0; i < this->retired.size(); i++) {
+    delete [] this->retired[i]->slots;
+    delete this->retired[i];
+  }
+
+  pthread_cond_destroy(&this->written);
+  pthread_cond_destroy(&this->queued);
+  pthread_mutex_destroy(&this->mutex);
+
+}
+
+
+/// <summary>
+///   Loads the names in a file and starts appending new names to it.
+/// </summary>
+bool UserRegistry::Open(const std::string &path) {
+
+  // Map the file and add each line of it, sizing the table for all of them
+  //   up front so that it is not grown along the way.
+  bool newline = true;
+  int loaded = open(path.c_str(), O_RDONLY);
+  struct stat sb;
+  if(loaded >= 0 && fstat(loaded, &sb) == 0 && sb.st_size > 0) {
+    size_t size = (size_t)sb.st_size;
+    void *mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, loaded, 0);
+    if(mapped != MAP_FAILED) {
+      const char *data = static_cast<const char *>(mapped);
+      madvise(mapped, size, MADV_SEQUENTIAL);
+
+      size_t lines = 1;
+      for(const char *at = data; (at = static_cast<const char *>(
+          memchr(at, '\n', data + size - at))) != NULL; at++)
+        lines++;
+
+      pthread_mutex_lock(&this->mutex); {
+        size_t slots = this->current->mask + 1;
+        while(slots < (this->count + lines) * 2)
+          slots *= 2;
+        if(slots > this->current->mask + 1)
+          this->grow(slots);
+
+        const char *line = data;
+        const char *end = data + size;
+        while(line < end) {
+          const char *next = static_cast<const char *>(
+              memchr(line, '\n', end - line));
+          if(next == NULL)
+            next = end;
+          if(next > line && memchr(line, '\0', next - line) == NULL)
+            this->insert(line, next - line);
+          line = next + 1;
+        }
+      } pthread_mutex_unlock(&this->mutex);
+
+      newline = data[size - 1] == '\n';
+      munmap(mapped, size);
+    }
+  }
+  if(loaded >= 0)
+    close(loaded);
+
+
+  // Open the file for appending, ending its last line if it was not.
+  int appended = open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if(appended >= 0 && !newline && write(appended, "\n", 1) != 1) {
+    close(appended);
+    appended = -1;
+  }
+  if(appended < 0)
+    return false;
+
+  bool started;
+  pthread_mutex_lock(&this->mutex); {
+    this->file = appended;
+    this->closing = false;
+    started = pthread_create(&this->writer, NULL, UserRegistry::writeLoop,
+        this) == 0;
+    this->writerRunning = started;
+    if(!started) {
+      close(this->file);
+      this->file = -1;
+    }
+  } pthread_mutex_unlock(&this->mutex);
+
+  return started;
+
+}
+
+
+/// <summary>
+///   Writes the names not yet written and stops appending to the file.
+/// </summary>
+void UserRegistry::Close(void) {
+
+  bool running;
+  pthread_mutex_lock(&this->mutex); {
+    running = this->writerRunning;
+    this->writerRunning = false;
+    this->closing = true;
+    pthread_cond_signal(&this->queued);
+  } pthread_mutex_unlock(&this->mutex);
+
+  if(!running)
+    return;
+
+  pthread_join(this->writer, NULL);
+  close(this->file);
+  this->file = -1;
+
+}
+
+
+/// <summary>
+///   Gets whether a name is registered.  Takes no lock.
+/// </summary>
+bool UserRegistry::Contains(const std::string &name) const {
+
+  if(!UserRegistry::valid(name))
+    return false;
+
+  const table *t = this->current;
+  __sync_synchronize();
+
+  size_t i = hashBytes(name.data(), name.length()) & t->mask;
+  for(const char *slot; (slot = loadSlot(t->slots, i)) != NULL;
+      i = (i + 1) & t->mask) {
+    if(sameName(slot, name.data(), name.length()))
+      return true;
+  }
+
+  return false;
+
+}
+
+
+/// <summary>
+///   Registers a name, waiting until it has been appended to the file.
+/// </summary>
+int UserRegistry::Add(const std::string &name) {
+
+  if(!UserRegistry::valid(name))
+    return UR_INVALID;
+
+  int result;
+  pthread_mutex_lock(&this->mutex); {
+    if(!this->insert(name.data(), name.length()))
+      result = UR_REGISTERED;
+
+    // Names added once the file is closed are only kept in memory.
+    else if(this->file < 0 || this->closing)
+      result = UR_UNSAVED;
+
+    // Queue the name for the writer, and wait for its batch to be synced.
+    else {
+      this->pending += name;
+      this->pending += '\n';
+      unsigned long long mine = this->batch;
+      pthread_cond_signal(&this->queued);
+
+      while(this->flushed < mine)
+        pthread_cond_wait(&this->written, &this->mutex);
+      result = this->failedFrom != 0 && this->failedFrom <= mine
+          ? UR_UNSAVED : UR_ADDED;
+    }
+  } pthread_mutex_unlock(&this->mutex);
+
+  return result;
+
+}
+
+
+/// <summary>
+///   Gets the number of registered names.
+/// </summary>
+size_t UserRegistry::Count(void) {
+
+  size_t names;
+  pthread_mutex_lock(&this->mutex); {
+    names = this->count;
+  } pthread_mutex_unlock(&this->mutex);
+
+  return names;
+
+}
+
+
+/// <summary>
+///   Gets how long each batch of names took to be written and synced.
+/// </summary>
+const LatencyHistogram & UserRegistry::SyncLatency(void) const {
+  return this->syncLatency;
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Adds a name to the table, growing it first if it is half full.
+/// </summary>
+bool UserRegistry::insert(const char *name, size_t length) {
+
+  if((this->count + 1) * 2 > this->current->mask + 1)
+    this->grow((this->current->mask + 1) * 2);
+
+  table *t = this->current;
+  size_t i = hashBytes(name, length) & t->mask;
+  while(t->slots[i] != NULL) {
+    if(sameName(t->slots[i], name, length))
+      return false;
+    i = (i + 1) & t->mask;
+  }
+
+  // The copy has to be complete before a reader can find the slot filled.
+  char *copy = this->names.Allocate(length + 1);
+  memcpy(copy, name, length);
+  copy[length] = '\0';
+  __sync_synchronize();
+  ((const char * volatile *)t->slots)[i] = copy;
+  this->count++;
+
+  return true;
+
+}
+
+
+/// <summary>
+///   Replaces the table with one of the given number of slots.
+/// </summary>
+void UserRegistry::grow(size_t slots) {
+
+  table *bigger = new table;
+  bigger->mask = slots - 1;
+  bigger->slots = new const char *[slots]();
+
+  table *old = this->current;
+  for(size_t i = 0; i <= old->mask; i++) {
+    const char *name = old->slots[i];
+    if(name == NULL)
+      continue;
+    size_t j = hashBytes(name, strlen(name)) & bigger->mask;
+    while(bigger->slots[j] != NULL)
+      j = (j + 1) & bigger->mask;
+    bigger->slots[j] = name;
+  }
+
+  // Readers switch to the new table only once it holds every name.
+  __sync_synchronize();
+  this->current = bigger;
+  this->retired.push_back(old);
+
+}
+
+
+/// <summary>
+///   Gets whether a name can be registered.
+/// </summary>
+bool UserRegistry::valid(const std::string &name) {
+  return !name.empty() && name.find('\0') == std::string::npos
+      && name.find('\n') == std::string::npos;
+}
+
+
+/// <summary>
+///   Entry point of the writer thread.  Appends the pending names in one write
+///   and one sync at a time, until the registry closes and none are left.
+/// </summary>
+void * UserRegistry::writeLoop(void *registry) {
+
+  UserRegistry *p_this = static_cast<UserRegistry *>(registry);
+
+  pthread_mutex_lock(&p_this->mutex);
+  while(true) {
+
+    while(p_this->pending.empty() && !p_this->closing)
+      pthread_cond_wait(&p_this->queued, &p_this->mutex);
+    if(p_this->pending.empty())
+      break;
+
+    std::string lines;
+    lines.swap(p_this->pending);
+    unsigned long long number = p_this->batch++;
+    bool ok = p_this->failedFrom == 0;
+    pthread_mutex_unlock(&p_this->mutex);
+
+    // Names added meanwhile go in the next batch.
+    unsigned long long start = LatencyHistogram::NowMicros();
+    for(size_t done = 0; ok && done < lines.length(); ) {
+      ssize_t n = write(p_this->file, lines.data() + done,
+          lines.length() - done);
+      if(n > 0)
+        done += n;
+      else if(n < 0 && errno != EINTR)
+        ok = false;
+    }
+    if(ok && fdatasync(p_this->file) != 0)
+      ok = false;
+    p_this->syncLatency.RecordSince(start);
+
+    pthread_mutex_lock(&p_this->mutex);
+    if(!ok && p_this->failedFrom == 0)
+      p_this->failedFrom = number;
+    p_this->flushed = number;
+    pthread_cond_broadcast(&p_this->written);
+
+  }
+  pthread_mutex_unlock(&p_this->mutex);
+
+  return NULL;
+
+}
@@ -0,0 +1,290 @@
+/*******************************************************************************
+  File: UserRegistry.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created UserRegistry.h file.
+  - Added UserRegistry class declaration.
+  - Added SyncLatency method.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __USERREGISTRY_H__
+#define __USERREGISTRY_H__
+
+
+//
+// Project headers.
+//
+#include "Arena.h"
+#include "LatencyHistogram.h"
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//
+// Threading library.
+//
+#include <pthread.h>
+
+
+//
+// Results of adding a user name.
+//
+#define UR_ADDED      0   // The name was added and written to the file.
+#define UR_REGISTERED 1   // The name was already registered.
+#define UR_UNSAVED    2   // The name was added but could not be written.
+#define UR_INVALID    3   // The name is empty or holds a NUL or line break.
+
+//
+// Number of slots of the smallest hash table.  Must be a power of two.
+//
+#define UR_MIN_SLOTS 64
+
+
+/// <summary>
+///   The set of registered user names, kept in memory and in a file.
+/// </summary>
+/// <remarks>
+/// <para>
+///   The names are held in an open-addressed hash table whose slots point at
+///   copies of the names in an arena.  Checking a name takes no lock: a slot is
+///   only ever filled once, after the name it points at is written, and a
+///   table that grows is copied into a new one before the new one is
+///   published.  Old tables are kept until the registry is destroyed, so a
+///   reader never sees one freed.  Adding names is serialized by a mutex.
+/// </para>
+/// <para>
+///   The file is a list of names, one per line.  It is mapped into memory to
+///   be loaded, so even millions of names are read without copying the file
+///   through a stream.  New names are only ever appended.  A writer thread
+///   appends every name added since its last write in one write and one sync,
+///   and each Add waits for the sync of the batch holding its name, so a name
+///   is on disk by the time its client hears back.
+/// </para>
+/// </remarks>
+class UserRegistry {
+
+private:
+
+  /// <summary>
+  ///   A hash table of names.
+  /// </summary>
+  typedef struct table {
+    size_t mask;                  // The number of slots, less one.
+    const char **slots;           // The names, or NULL for an empty slot.
+  } table;
+
+
+  /// <summary>
+  ///   The table that names are looked up in.  Replaced as it fills up.
+  /// </summary>
+  table * volatile current;
+
+
+  /// <summary>
+  ///   The tables replaced as the registry grew, kept for readers that may
+  ///   still be probing them.
+  /// </summary>
+  std::vector<table *> retired;
+
+
+  /// <summary>
+  ///   The copies of the names.
+  /// </summary>
+  Arena names;
+
+
+  /// <summary>
+  ///   The number of names in the table.
+  /// </summary>
+  size_t count;
+
+
+  /// <summary>
+  ///   Guards every member below, and serializes adding names.
+  /// </summary>
+  pthread_mutex_t mutex;
+
+
+  /// <summary>
+  ///   Wakes the writer when names are added or the registry closes.
+  /// </summary>
+  pthread_cond_t queued;
+
+
+  /// <summary>
+  ///   Wakes the callers of Add when a batch has been written.
+  /// </summary>
+  pthread_cond_t written;
+
+
+  /// <summary>
+  ///   The lines not yet appended to the file.
+  /// </summary>
+  std::string pending;
+
+
+  /// <summary>
+  ///   The number of the batch that pending will be written in.
+  /// </summary>
+  unsigned long long batch;
+
+
+  /// <summary>
+  ///   The number of the last batch written.
+  /// </summary>
+  unsigned long long flushed;
+
+
+  /// <summary>
+  ///   The number of the first batch that could not be written, or 0.  No
+  ///   batch is written after one fails, as the file may end in part of it.
+  /// </summary>
+  unsigned long long failedFrom;
+
+
+  /// <summary>
+  ///   The file that names are appended to, or -1 if it is not open.
+  /// </summary>
+  int file;
+
+
+  /// <summary>
+  ///   The thread that appends names to the file.
+  /// </summary>
+  pthread_t writer;
+
+
+  /// <summary>
+  ///   Whether the writer thread is running.
+  /// </summary>
+  bool writerRunning;
+
+
+  /// <summary>
+  ///   Whether the registry is closing.
+  /// </summary>
+  bool closing;
+
+
+  /// <summary>
+  ///   How long each batch took to be written and synced.
+  /// </summary>
+  LatencyHistogram syncLatency;
+
+
+  /// <summary>
+  ///   Copy constructor.  Registries cannot be copied.
+  /// </summary>
+  UserRegistry(const UserRegistry &other);
+
+
+  /// <summary>
+  ///   Assignment operator.  Registries cannot be copied.
+  /// </summary>
+  UserRegistry & operator=(const UserRegistry &other);
+
+
+public:
+
+  /// <summary>
+  ///   Creates an empty registry.
+  /// </summary>
+  UserRegistry(void);
+
+
+  /// <summary>
+  ///   Destructor.  Closes the registry.
+  /// </summary>
+  ~UserRegistry(void);
+
+
+  /// <summary>
+  ///   Loads the names in a file and starts appending new names to it.  The
+  ///   file is created if it does not exist.
+  /// </summary>
+  /// <returns>
+  ///   True if the file could be opened for appending; otherwise, false, in
+  ///   which case new names are only kept in memory.
+  /// </returns>
+  bool Open(const std::string &path);
+
+
+  /// <summary>
+  ///   Writes the names not yet written and stops appending to the file.
+  ///   Names can still be checked afterwards.
+  /// </summary>
+  void Close(void);
+
+
+  /// <summary>
+  ///   Gets whether a name is registered.  Takes no lock.
+  /// </summary>
+  bool Contains(const std::string &name) const;
+
+
+  /// <summary>
+  ///   Registers a name, waiting until it has been appended to the file.
+  /// </summary>
+  /// <returns>One of the UR_ results.</returns>
+  int Add(const std::string &name);
+
+
+  /// <summary>
+  ///   Gets the number of registered names.
+  /// </summary>
+  size_t Count(void);
+
+
+  /// <summary>
+  ///   Gets how long each batch of names took to be written and synced.
+  /// </summary>
+  const LatencyHistogram & SyncLatency(void) const;
+
+
+private:
+
+  /// <summary>
+  ///   Adds a name to the table, growing it first if it is half full.  The
+  ///   mutex must be held, or the registry not yet shared.
+  /// </summary>
+  /// <returns>
+  ///   True if the name was added; otherwise, false, if it was already there.
+  /// </returns>
+  bool insert(const char *name, size_t length);
+
+
+  /// <summary>
+  ///   Replaces the table with one of the given number of slots.
+  /// </summary>
+  void grow(size_t slots);
+
+
+  /// <summary>
+  ///   Gets whether a name can be registered: it is not empty and holds no NUL
+  ///   or line break.
+  /// </summary>
+  static bool valid(const std::string &name);
+
+
+  /// <summary>
+  ///   Entry point of the writer thread.
+  /// </summary>
+  static void * writeLoop(void *registry);
+
+};
+
+
+#endif
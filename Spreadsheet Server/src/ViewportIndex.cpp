@@ -0,0 +1,170 @@
+/*******************************************************************************
+  File: ViewportIndex.cpp
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Compile with:
+  g++ -c ViewportIndex.cpp
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ViewportIndex.cpp file.
+  - Added ViewportIndex class implementation.
+*******************************************************************************/
+
+
+//
+// Class header file.
+//
+#include "ViewportIndex.h"
+
+//
+// Standard libraries.
+//
+#include <algorithm>
+
+
+/*******************************************************************************
+  Public methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Adds a block of cells to those a client watches.
+/// </summary>
+void ViewportIndex::Add(StringSocket *owner, int col0, int row0, int col1,
+    int row1) {
+
+  viewport view;
+  view.owner = owner;
+  view.col0 = col0;
+  view.row0 = row0;
+  view.col1 = col1;
+  view.row1 = row1;
+
+  this->owners[owner].push_back(view);
+  for(int band = row0 >> VI_BAND_BITS; band <= row1 >> VI_BAND_BITS; band++)
+    this->bands[band].push_back(view);
+
+}
+
+
+/// <summary>
+///   Removes a block of cells from those a client watches.
+/// </summary>
+bool ViewportIndex::Remove(StringSocket *owner, int col0, int row0, int col1,
+    int row1) {
+
+  std::map<StringSocket *, std::vector<viewport> >::iterator it =
+      this->owners.find(owner);
+  if(it == this->owners.end())
+    return false;
+
+  viewport view;
+  view.owner = owner;
+  view.col0 = col0;
+  view.row0 = row0;
+  view.col1 = col1;
+  view.row1 = row1;
+
+  if(!ViewportIndex::erase(&it->second, view))
+    return false;
+  if(it->second.empty())
+    this->owners.erase(it);
+
+  for(int band = row0 >> VI_BAND_BITS; band <= row1 >> VI_BAND_BITS; band++) {
+    std::map<int, std::vector<viewport> >::iterator listed =
+        this->bands.find(band);
+    ViewportIndex::erase(&listed->second, view);
+    if(listed->second.empty())
+      this->bands.erase(listed);
+  }
+
+  return true;
+
+}
+
+
+/// <summary>
+///   Removes every block of cells that a client watches.
+/// </summary>
+void ViewportIndex::RemoveAll(StringSocket *owner) {
+
+  std::map<StringSocket *, std::vector<viewport> >::iterator it =
+      this->owners.find(owner);
+  if(it == this->owners.end())
+    return;
+
+  // Removing the last viewport of the client erases the list being read.
+  std::vector<viewport> views(it->second);
+  for(size_t i = 0; i < views.size(); i++)
+    this->Remove(owner, views[i].col0, views[i].row0, views[i].col1,
+        views[i].row1);
+
+}
+
+
+/// <summary>
+///   Gets the number of blocks of cells that a client watches.
+/// </summary>
+size_t ViewportIndex::Count(StringSocket *owner) const {
+
+  std::map<StringSocket *, std::vector<viewport> >::const_iterator it =
+      this->owners.find(owner);
+  return it == this->owners.end() ? 0 : it->second.size();
+
+}
+
+
+/// <summary>
+///   Gets the clients that watch a cell.
+/// </summary>
+void ViewportIndex::Find(int col, int row,
+    std::vector<StringSocket *> *watchers) const {
+
+  std::map<int, std::vector<viewport> >::const_iterator it =
+      this->bands.find(row >> VI_BAND_BITS);
+  if(it == this->bands.end())
+    return;
+
+  const std::vector<viewport> &views = it->second;
+  for(size_t i = 0; i < views.size(); i++) {
+    const viewport &view = views[i];
+    if(col < view.col0 || col > view.col1 || row < view.row0 || row > view.row1)
+      continue;
+    if(std::find(watchers->begin(), watchers->end(), view.owner)
+        == watchers->end())
+      watchers->push_back(view.owner);
+  }
+
+}
+
+
+/*******************************************************************************
+  Private methods.
+*******************************************************************************/
+
+
+/// <summary>
+///   Removes a viewport from a list of them.
+/// </summary>
+bool ViewportIndex::erase(std::vector<viewport> *list, const viewport &view) {
+
+  for(size_t i = 0; i < list->size(); i++) {
+    const viewport &listed = (*list)[i];
+    if(listed.owner == view.owner && listed.col0 == view.col0
+        && listed.row0 == view.row0 && listed.col1 == view.col1
+        && listed.row1 == view.row1) {
+      list->erase(list->begin() + i);
+      return true;
+    }
+  }
+
+  return false;
+
+}
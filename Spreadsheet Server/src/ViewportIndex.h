@@ -0,0 +1,137 @@
+/*******************************************************************************
+  File: ViewportIndex.h
+  Team: SegFault
+  CS 3505 - Spring 2015
+  Date created: October 18, 2026
+  Last updated: October 18, 2026
+
+
+  Changelog:
+
+  October 18, 2026
+  - Created ViewportIndex.h file.
+  - Added ViewportIndex class declaration.
+  - Added documentation.
+*******************************************************************************/
+
+
+#ifndef __VIEWPORTINDEX_H__
+#define __VIEWPORTINDEX_H__
+
+
+//
+// Project headers.
+//
+#include "StringSocket.h"
+
+//
+// Standard libraries.
+//
+#include <cstddef>
+#include <map>
+#include <vector>
+
+
+//
+// Number of rows in each band of the index, as a power of two.
+//
+#define VI_BAND_BITS 7
+
+
+/// <summary>
+///   A block of cells that a client watches.
+/// </summary>
+typedef struct viewport {
+  StringSocket *owner;        // The client watching the block.
+  int col0;                   // The first column of the block.
+  int row0;                   // The first row of the block.
+  int col1;                   // The last column of the block.
+  int row1;                   // The last row of the block.
+} viewport;
+
+
+/// <summary>
+///   Finds the clients that watch a cell, out of the blocks of cells that
+///   each client has subscribed to.
+/// </summary>
+/// <remarks>
+/// <para>
+///   The rows of the sheet are split into bands of 2^VI_BAND_BITS rows, and
+///   each viewport is listed in every band it overlaps.  Finding the watchers
+///   of a cell only checks the viewports of its band, which on a sheet with
+///   many clients each looking at a screen of cells is a handful at most.
+/// </para>
+/// <para>
+///   Viewports are kept by the position that clients see, so cells that a
+///   layout change moves into a viewport are found there afterwards.  The
+///   index does no locking of its own.
+/// </para>
+/// </remarks>
+class ViewportIndex {
+
+private:
+
+  /// <summary>
+  ///   The viewports that overlap each band that any viewport overlaps.
+  /// </summary>
+  std::map<int, std::vector<viewport> > bands;
+
+
+  /// <summary>
+  ///   The viewports of each client that has any.
+  /// </summary>
+  std::map<StringSocket *, std::vector<viewport> > owners;
+
+
+public:
+
+  /// <summary>
+  ///   Adds a block of cells to those a client watches.  The block must be
+  ///   given with its first column and row no later than its last.
+  /// </summary>
+  void Add(StringSocket *owner, int col0, int row0, int col1, int row1);
+
+
+  /// <summary>
+  ///   Removes a block of cells from those a client watches.
+  /// </summary>
+  /// <returns>
+  ///   True if the client was watching exactly that block; otherwise, false.
+  /// </returns>
+  bool Remove(StringSocket *owner, int col0, int row0, int col1, int row1);
+
+
+  /// <summary>
+  ///   Removes every block of cells that a client watches.
+  /// </summary>
+  void RemoveAll(StringSocket *owner);
+
+
+  /// <summary>
+  ///   Gets the number of blocks of cells that a client watches.
+  /// </summary>
+  size_t Count(StringSocket *owner) const;
+
+
+  /// <summary>
+  ///   Gets the clients that watch a cell.
+  /// </summary>
+  /// <param name="watchers">
+  ///   An output parameter that each client watching the cell is added to
+  ///   once, if not already in it.
+  /// </param>
+  void Find(int col, int row, std::vector<StringSocket *> *watchers) const;
+
+
+private:
+
+  /// <summary>
+  ///   Removes a viewport from a list of them.
+  /// </summary>
+  /// <returns>True if it was in the list; otherwise, false.</returns>
+  static bool erase(std::vector<viewport> *list, const viewport &view);
+
+};
+
+
+#endif
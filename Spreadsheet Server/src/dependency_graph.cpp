@@ -4,7 +4,7 @@
   Team: SegFault
   CS 3505 - Spring 2015
   Date created: April 4, 2015
-  Last updated: April 23, 2015
+  Last updated: October 18, 2026
    
    
   Resources:
@@ -48,7 +48,7 @@ int dependency_graph::size() {
 /// <summary>
 /// Reports whether dependents(s) is non-empty.
 /// </summary>
-int dependency_graph::has_dependents(std::string s) {
+int dependency_graph::has_dependents(cellKey s) {
 	return this->get_dependents(s).size() > 0;
 }
 
@@ -56,7 +56,7 @@ int dependency_graph::has_dependents(std::string s) {
 /// <summary>
 /// Reports whether dependees(s) is non-empty.
 /// </summary>
-int dependency_graph::has_dependees(std::string s) {
+int dependency_graph::has_dependees(cellKey s) {
 	return this->get_dependees(s).size() > 0;
 }
 
@@ -64,26 +64,26 @@ int dependency_graph::has_dependees(std::string s) {
 /// <summary>
 /// Gets the collection of dependents(s).
 /// </summary>
-std::set<std::string> dependency_graph::get_dependents(std::string s) {
+std::set<cellKey> dependency_graph::get_dependents(cellKey s) {
 	// If s has dependents, return the set containing them.
 	if (this->dependents.count(s) == 1)
-		return std::set<std::string>(this->dependents[s]);
+		return std::set<cellKey>(this->dependents[s]);
   
 	// Since there are no dependents, return an empty set.
-	return std::set<std::string>();
+	return std::set<cellKey>();
 }
 
 
 /// <summary>
 /// Gets the collection of dependees(s).
 /// </summary>
-std::set<std::string> dependency_graph::get_dependees(std::string s) {
+std::set<cellKey> dependency_graph::get_dependees(cellKey s) {
 	// If s has dependees, return the set containing them.
 	if (this->dependees.count(s) == 1)
-		return std::set<std::string>(this->dependees[s]);
+		return std::set<cellKey>(this->dependees[s]);
 
 	// Since there are no dependees, return an empty set.
-	return std::set<std::string>();
+	return std::set<cellKey>();
 }
 
 
@@ -96,7 +96,7 @@ std::set<std::string> dependency_graph::get_dependees(std::string s) {
 /// <returns>
 ///   True if the dependency was added; otherwise, false.
 /// </returns>
-bool dependency_graph::add_dependency(std::string s, std::string t) {
+bool dependency_graph::add_dependency(cellKey s, cellKey t) {
 	// If we added a dependency, increment the count.
 	if (this->dependents[s].insert(t).second
       && this->dependees[t].insert(s).second)
@@ -117,7 +117,7 @@ bool dependency_graph::add_dependency(std::string s, std::string t) {
 /// </summary>
 /// <param name="s"></param>
 /// <param name="t"></param>
-void dependency_graph::remove_dependency(std::string s, std::string t) {
+void dependency_graph::remove_dependency(cellKey s, cellKey t) {
 	// If the dependency exists, remove it.
 	if (this->dependents.count(s) == 1 && this->dependees.count(t) == 1) {
 		if (this->dependents[s].erase(t) && this->dependees[t].erase(s))
@@ -144,22 +144,22 @@ void dependency_graph::remove_dependency(std::string s, std::string t) {
 ///   True if the dependents were replaced succesfully without circular
 ///   dependencies; otherwise, false.
 /// </returns>
-bool dependency_graph::replace_dependents(std::string s,
-    std::set<std::string> new_dependents) {
+bool dependency_graph::replace_dependents(cellKey s,
+    std::set<cellKey> new_dependents) {
   // Remove (s, r) pairs.
-  std::set<std::string> remove(this->get_dependents(s));
-  for(std::set<std::string>::iterator it = remove.begin(); it != remove.end();
+  std::set<cellKey> remove(this->get_dependents(s));
+  for(std::set<cellKey>::iterator it = remove.begin(); it != remove.end();
       it++)
     this->remove_dependency(s, *it);
   
   // Add (s, t) pairs.
-  for(std::set<std::string>::iterator it = new_dependents.begin();
+  for(std::set<cellKey>::iterator it = new_dependents.begin();
       it != new_dependents.end(); it++) {
     
     // Reset dependencies and return false if adding the current dependency
     //   results in a circular dependency.
     if(!this->add_dependency(s, *it)) {
-      for(std::set<std::string>::iterator repit = remove.begin();
+      for(std::set<cellKey>::iterator repit = remove.begin();
           repit != remove.end(); repit++)
         this->add_dependency(s, *repit);
       return false;
@@ -181,22 +181,22 @@ bool dependency_graph::replace_dependents(std::string s,
 ///   True if the dependees were replaced succesfully without circular
 ///   dependencies; otherwise, false.
 /// </returns>
-bool dependency_graph::replace_dependees(std::string s,
-    std::set<std::string> new_dependees) {
+bool dependency_graph::replace_dependees(cellKey s,
+    std::set<cellKey> new_dependees) {
   // Remove (r, s) pairs.
-  std::set<std::string> remove(this->get_dependees(s));
-  for(std::set<std::string>::iterator it = remove.begin(); it != remove.end();
+  std::set<cellKey> remove(this->get_dependees(s));
+  for(std::set<cellKey>::iterator it = remove.begin(); it != remove.end();
       it++)
     this->remove_dependency(*it, s);
   
   // Add (t, s) pairs.
-  for(std::set<std::string>::iterator it = new_dependees.begin();
+  for(std::set<cellKey>::iterator it = new_dependees.begin();
       it != new_dependees.end(); it++) {
         
     // Reset dependencies and return false if adding the current dependency
     //   results in a circular dependency.
     if(!this->add_dependency(*it, s)) {
-      for(std::set<std::string>::iterator repit = remove.begin();
+      for(std::set<cellKey>::iterator repit = remove.begin();
           repit != remove.end(); repit++)
         this->add_dependency(*repit, s);
       return false;
@@ -208,6 +208,31 @@ bool dependency_graph::replace_dependees(std::string s,
 }
 
 
+/// <summary>
+///   Removes all existing ordered pairs of the form (r,s).  Then, for each
+///   t in newDependees, adds the ordered pair (t,s) without checking for
+///   circular dependencies.
+/// </summary>
+/// <param name="s"></param>
+/// <param name="new_dependees"></param>
+void dependency_graph::set_dependees(cellKey s,
+    const std::set<cellKey> &new_dependees) {
+  // Remove (r, s) pairs.
+  std::set<cellKey> remove(this->get_dependees(s));
+  for(std::set<cellKey>::iterator it = remove.begin(); it != remove.end();
+      it++)
+    this->remove_dependency(*it, s);
+  
+  // Add (t, s) pairs.
+  for(std::set<cellKey>::const_iterator it = new_dependees.begin();
+      it != new_dependees.end(); it++) {
+    if (this->dependents[*it].insert(s).second
+        && this->dependees[s].insert(*it).second)
+      this->count++;
+  }
+}
+
+
 /// <summary>
 ///   Returns true if a circular dependency is found; otherwise, returns false.
 /// </summary>
@@ -220,9 +245,9 @@ bool dependency_graph::replace_dependees(std::string s,
 ///   the C# AbstractSpreadsheet.GetCellsToRecalculate method written by Joe
 ///   Zachary for CS 3500, September 2012.
 /// </remarks>
-bool dependency_graph::check_circular_dependents(std::string name) {
+bool dependency_graph::check_circular_dependents(cellKey name) {
   // Create a set for visited nodes.
-  std::set<std::string> visited;
+  std::set<cellKey> visited;
   
   // Walk over the graph and return true at the first instance of any circular
   //   dependencies.
@@ -256,22 +281,22 @@ bool dependency_graph::check_circular_dependents(std::string name) {
 ///   Zachary for CS 3500, September 2012.
 /// </para>
 /// </remarks>
-bool dependency_graph::visit(std::string start, std::string name,
-    std::set<std::string> &visited) {
+bool dependency_graph::visit(cellKey start, cellKey name,
+    std::set<cellKey> &visited) {
   // Add the current node to the set of visited nodes.
   visited.insert(name);
   
   // Get the direct dependents of the current node.
-  std::set<std::string> dents = this->get_dependents(name);
+  std::set<cellKey> dents = this->get_dependents(name);
   
   // Check each dependent if it matches the start node, and visit it if it does
   //   not match.
-  for(std::set<std::string>::iterator it = dents.begin(); it != dents.end();
+  for(std::set<cellKey>::iterator it = dents.begin(); it != dents.end();
       it++)
   {
     // Return true if the current node matches the start node or if visiting the
     //   current results in a match for a circular dependency.
-    if((start.compare(*it) == 0) || (visited.find(*it) == visited.end()
+    if((start == *it) || (visited.find(*it) == visited.end()
         && this->visit(start, *it, visited)))
       return true;
   }
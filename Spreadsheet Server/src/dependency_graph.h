@@ -4,7 +4,7 @@
    Team: SegFault
    CS 3505 - Spring 2015
    Date created: April 4, 2015
-   Last updated: April 23, 2015
+   Last updated: October 18, 2026
    
    
    Resources:
@@ -15,16 +15,17 @@
 #ifndef DEPENDENCY_GRAPH_H
 #define DEPENDENCY_GRAPH_H
 
+#include "CellAddress.h"
 #include <map>
 #include <set>
-#include <string>
 
 /// <summary>
 ///   Represents a graph where nodes depend on other nodes.
 /// </summary>
 /// <remarks>
 /// <para>
-///   A DependencyGraph can be modeled as a set of ordered pairs of strings.
+///   A DependencyGraph can be modeled as a set of ordered pairs of cells,
+///   each given by the key of where it is stored.
 ///   Two ordered pairs (s1,t1) and (s2,t2) are considered equal if and only if
 ///   s1 equals s2 and t1 equals t2.  (Recall that sets never contain
 ///   duplicates.  If an attempt is made to add an element to a set, and the
@@ -34,11 +35,11 @@
 /// Given a DependencyGraph DG:
 /// <OL>
 ///    <LI>
-///      If s is a string, the set of all strings t such that (s,t) is in DG is
+///      If s is a cell, the set of all cells t such that (s,t) is in DG is
 ///      called dependents(s).
 ///    </LI>
 ///    <LI>
-///      If s is a string, the set of all strings t such that (t,s) is in DG is
+///      If s is a cell, the set of all cells t such that (t,s) is in DG is
 ///      called dependees(s).
 ///    </LI>
 /// </OL>
@@ -78,22 +79,22 @@ public:
 	/// <summary>
 	/// Reports whether dependents(s) is non-empty.
 	/// </summary>
-	int has_dependents	(std::string s);
+	int has_dependents	(cellKey s);
 
 	/// <summary>
 	/// Reports whether dependees(s) is non-empty.
 	/// </summary>
-	int has_dependees	(std::string s);
+	int has_dependees	(cellKey s);
 
 	/// <summary>
 	/// Gets the collection of dependents(s).
 	/// </summary>
-	std::set<std::string> get_dependents(std::string s);
+	std::set<cellKey> get_dependents(cellKey s);
 
 	/// <summary>
 	/// Gets the collection of dependees(s).
 	/// </summary>
-	std::set<std::string> get_dependees	(std::string s);
+	std::set<cellKey> get_dependees	(cellKey s);
 
 	/// <summary>
 	///   Adds the ordered pair (s,t), if it doesn't exist and does not cause a
@@ -104,14 +105,14 @@ public:
   /// <returns>
   ///   True if the dependency was added; otherwise, false.
   /// </returns>
-	bool add_dependency		(std::string s, std::string t);
+	bool add_dependency		(cellKey s, cellKey t);
 
 	/// <summary>
 	/// Removes the ordered pair (s,t), if it exists.
 	/// </summary>
 	/// <param name="s"></param>
 	/// <param name="t"></param>
-	void remove_dependency	(std::string s, std::string t);
+	void remove_dependency	(cellKey s, cellKey t);
 
 	/// <summary>
 	/// Removes all existing ordered pairs of the form (s,r).  Then, for each
@@ -123,7 +124,7 @@ public:
   ///   True if the dependents were replaced succesfully without circular
   ///   dependencies; otherwise, false.
   /// </returns>
-	bool replace_dependents	(std::string s, std::set<std::string> new_dependents);
+	bool replace_dependents	(cellKey s, std::set<cellKey> new_dependents);
 
 	/// <summary>
 	/// Removes all existing ordered pairs of the form (r,s).  Then, for each 
@@ -135,7 +136,20 @@ public:
   ///   True if the dependees were replaced succesfully without circular
   ///   dependencies; otherwise, false.
   /// </returns>
-	bool replace_dependees	(std::string s, std::set<std::string> new_dependees);
+	bool replace_dependees	(cellKey s, std::set<cellKey> new_dependees);
+
+	/// <summary>
+	///   Removes all existing ordered pairs of the form (r,s).  Then, for each
+	///   t in newDependees, adds the ordered pair (t,s) without checking for
+	///   circular dependencies.
+	/// </summary>
+  /// <param name="s"></param>
+  /// <param name="new_dependees"></param>
+  /// <remarks>
+  ///   The caller checks for circular dependencies, which lets it check a
+  ///   group of changes at once or follow dependencies kept elsewhere.
+  /// </remarks>
+	void set_dependees	(cellKey s, const std::set<cellKey> &new_dependees);
 
 private:
 
@@ -143,13 +157,13 @@ private:
 	/// Represents a collection of key-value pairs where dependees are the keys
   /// and dependents are the values.
 	/// </summary>
-	std::map<std::string, std::set<std::string> > dependents;
+	std::map<cellKey, std::set<cellKey> > dependents;
 
 	/// <summary>
 	/// Represents a collection of key-value pairs where dependents are the keys
   /// and the dependees are the values.
 	/// </summary>
-	std::map<std::string, std::set<std::string> > dependees;
+	std::map<cellKey, std::set<cellKey> > dependees;
 
 	/// <summary>
 	/// Represents the number of ordered pairs within the graph.
@@ -171,7 +185,7 @@ private:
   ///   the C# AbstractSpreadsheet.GetCellsToRecalculate method written by Joe
   ///   Zachary for CS 3500, September 2012.
   /// </remarks>
-  bool check_circular_dependents(std::string name);
+  bool check_circular_dependents(cellKey name);
   
   /// <summary>
   ///   Returns true if a circular dependency is found; otherwise, returns
@@ -199,8 +213,8 @@ private:
   ///   Zachary for CS 3500, September 2012.
   /// </para>
   /// </remarks>
-  bool visit(std::string start, std::string name,
-      std::set<std::string> &visited);
+  bool visit(cellKey start, cellKey name,
+      std::set<cellKey> &visited);
   
 };
 